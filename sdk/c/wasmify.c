@@ -2,289 +2,7529 @@
  * Wasmify C SDK Implementation
  */
 
+#define _GNU_SOURCE
 #include "wasmify.h"
+#include "wasmify_engine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef WASMIFY_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 // Global initialization state
-static int g_initialized = 0;
+static pthread_mutex_t g_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_initialized = 0;      // Balance of wasmify_init over wasmify_cleanup calls
+
+#define RESPONSE_MIN_CAPACITY 4096
+#define RESPONSE_MAX_HINT ((size_t)64 * 1024 * 1024)
+
+// Make room for extra bytes plus a terminator, growing geometrically
+static int response_reserve(wasmify_response_t* response, size_t extra) {
+    size_t need = response->size + extra + 1;
+    if (need <= response->capacity) {
+        return 1;
+    }
+    
+    size_t capacity = response->capacity ? response->capacity : RESPONSE_MIN_CAPACITY;
+    while (capacity < need) capacity *= 2;
+    char* new_data = realloc(response->data, capacity);
+    if (!new_data) {
+        return 0;
+    }
+    response->data = new_data;
+    response->capacity = capacity;
+    return 1;
+}
+
+// Empty a response buffer for reuse, keeping its allocation
+static int response_reset(wasmify_response_t* response) {
+    response->size = 0;
+    if (!response_reserve(response, 0)) {
+        return 0;
+    }
+    response->data[0] = '\0';
+    return 1;
+}
 
 // HTTP response callback
 static size_t write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
     size_t realsize = size * nmemb;
     wasmify_response_t* response = (wasmify_response_t*)userp;
     
-    char* new_data = realloc(response->data, response->size + realsize + 1);
-    if (!new_data) {
-        return 0;
+    if (!response_reserve(response, realsize)) {
+        return 0;
+    }
+    
+    memcpy(&(response->data[response->size]), contents, realsize);
+    response->size += realsize;
+    response->data[response->size] = 0;
+    
+    return realsize;
+}
+
+// HTTP header callback; sizes the response buffer from Content-Length up front
+static size_t header_callback(char* buffer, size_t size, size_t nitems, void* userp) {
+    size_t len = size * nitems;
+    wasmify_response_t* response = (wasmify_response_t*)userp;
+    
+    static const char name[] = "content-length:";
+    if (len > sizeof(name) - 1 && strncasecmp(buffer, name, sizeof(name) - 1) == 0) {
+        char digits[32];
+        size_t n = len - (sizeof(name) - 1);
+        if (n >= sizeof(digits)) n = sizeof(digits) - 1;
+        memcpy(digits, buffer + sizeof(name) - 1, n);
+        digits[n] = '\0';
+        unsigned long long hint = strtoull(digits, NULL, 10);
+        if (hint > 0 && hint <= RESPONSE_MAX_HINT) {
+            // A failed reservation only loses the hint; the body still grows on demand
+            response_reserve(response, (size_t)hint);
+        }
+    }
+    
+    return len;
+}
+
+// Initialize Wasmify SDK
+wasmify_error_t wasmify_init(void) {
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    
+    pthread_mutex_lock(&g_init_lock);
+    if (g_initialized == 0 && curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        error = WASMIFY_ERROR_NETWORK;
+    } else {
+        g_initialized++;
+    }
+    pthread_mutex_unlock(&g_init_lock);
+    
+    return error;
+}
+
+// Cleanup Wasmify SDK
+void wasmify_cleanup(void) {
+    pthread_mutex_lock(&g_init_lock);
+    if (g_initialized > 0 && --g_initialized == 0) {
+        wasmify_module_cache_clear();
+        curl_global_cleanup();
+    }
+    pthread_mutex_unlock(&g_init_lock);
+}
+
+// Growable output buffer for rendering request bodies
+typedef struct {
+    char* data;
+    size_t size;
+    size_t cap;
+    int failed;
+} json_buf_t;
+
+static int json_reserve(json_buf_t* buf, size_t extra) {
+    if (buf->failed) return 0;
+    if (buf->size + extra + 1 <= buf->cap) return 1;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->size + extra + 1) cap *= 2;
+    char* data = realloc(buf->data, cap);
+    if (!data) {
+        buf->failed = 1;
+        return 0;
+    }
+    buf->data = data;
+    buf->cap = cap;
+    return 1;
+}
+
+static void json_reset(json_buf_t* buf) {
+    buf->size = 0;
+    buf->failed = 0;
+}
+
+static void json_raw(json_buf_t* buf, const char* text, size_t len) {
+    if (!json_reserve(buf, len)) return;
+    memcpy(buf->data + buf->size, text, len);
+    buf->size += len;
+    buf->data[buf->size] = '\0';
+}
+
+#define JSON_LITERAL(buf, text) json_raw((buf), (text), sizeof(text) - 1)
+
+// Append len bytes as a quoted string, escaping what JSON requires
+static void json_string_n(json_buf_t* buf, const char* text, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    // Worst case every byte becomes \u00XX
+    if (!json_reserve(buf, len * 6 + 2)) return;
+    
+    char* out = buf->data + buf->size;
+    *out++ = '"';
+    const unsigned char* end = (const unsigned char*)text + len;
+    for (const unsigned char* p = (const unsigned char*)text; p < end; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = (char)c;
+        } else if (c >= 0x20) {
+            *out++ = (char)c;
+        } else if (c == '\n') {
+            *out++ = '\\';
+            *out++ = 'n';
+        } else if (c == '\t') {
+            *out++ = '\\';
+            *out++ = 't';
+        } else if (c == '\r') {
+            *out++ = '\\';
+            *out++ = 'r';
+        } else {
+            memcpy(out, "\\u00", 4);
+            out[4] = hex[c >> 4];
+            out[5] = hex[c & 0x0F];
+            out += 6;
+        }
+    }
+    *out++ = '"';
+    *out = '\0';
+    buf->size = (size_t)(out - buf->data);
+}
+
+static void json_string(json_buf_t* buf, const char* text) {
+    json_string_n(buf, text, strlen(text));
+}
+
+// Append a JSON array of string arguments
+static void json_args(json_buf_t* buf, char** args, int args_count) {
+    JSON_LITERAL(buf, "[");
+    for (int i = 0; i < args_count; i++) {
+        if (i > 0) JSON_LITERAL(buf, ",");
+        json_string(buf, args[i]);
+    }
+    JSON_LITERAL(buf, "]");
+}
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+// Blocks of an arena stay chained after a reset and are reused in order, so
+// a request loop that resets its arena stops allocating once warmed up
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) char data[];
+} arena_block_t;
+
+struct wasmify_arena {
+    arena_block_t* head;
+    arena_block_t* current;
+    size_t block_size;
+    void* last;                 // Latest allocation, which may still be trimmed
+};
+
+wasmify_arena_t* wasmify_arena_create(size_t block_size) {
+    wasmify_arena_t* arena = calloc(1, sizeof(wasmify_arena_t));
+    if (arena) arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    return arena;
+}
+
+static void* arena_alloc(wasmify_arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_block_t* block = arena->current;
+    if (block && block->size - block->used < size) {
+        // Move on to the next kept block if it is big enough, else put a new one before it
+        arena_block_t* next = block->next;
+        if (next && next->size >= size) {
+            next->used = 0;
+            block = next;
+        } else {
+            block = NULL;
+        }
+    }
+    if (!block) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (!block) return NULL;
+        block->size = block_size;
+        block->used = 0;
+        if (arena->current) {
+            block->next = arena->current->next;
+            arena->current->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+    arena->current = block;
+    
+    void* p = block->data + block->used;
+    block->used += size;
+    arena->last = p;
+    return p;
+}
+
+// Give back the unused end of the latest allocation
+static void arena_trim(wasmify_arena_t* arena, void* p, size_t size) {
+    if (p != arena->last) return;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena->current->used = (size_t)((char*)p - arena->current->data) + size;
+}
+
+void wasmify_arena_reset(wasmify_arena_t* arena) {
+    if (!arena) return;
+    
+    arena->current = arena->head;
+    if (arena->head) arena->head->used = 0;
+    arena->last = NULL;
+}
+
+void wasmify_arena_destroy(wasmify_arena_t* arena) {
+    if (!arena) return;
+    
+    while (arena->head) {
+        arena_block_t* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    free(arena);
+}
+
+// Allocate result memory from an arena when there is one, else the heap
+static void* result_alloc(wasmify_arena_t* arena, size_t size) {
+    return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+static char* result_strdup(wasmify_arena_t* arena, const char* text) {
+    size_t size = strlen(text) + 1;
+    char* copy = result_alloc(arena, size);
+    if (copy) memcpy(copy, text, size);
+    return copy;
+}
+
+// Request bodies smaller than this go out uncompressed
+#define COMPRESS_MIN_SIZE 1024
+
+// Streaming compressor of request bodies. Each connection keeps one, so its
+// state is set up once and only reset between bodies.
+typedef struct {
+    wasmify_compression_t method;   // Stream set up, NONE until the first body
+    z_stream zlib;
+#ifdef WASMIFY_WITH_ZSTD
+    ZSTD_CCtx* zstd;
+#endif
+} body_encoder_t;
+
+static void encoder_free(body_encoder_t* enc) {
+    if (enc->method == WASMIFY_COMPRESSION_GZIP) deflateEnd(&enc->zlib);
+#ifdef WASMIFY_WITH_ZSTD
+    ZSTD_freeCCtx(enc->zstd);
+    enc->zstd = NULL;
+#endif
+    enc->method = WASMIFY_COMPRESSION_NONE;
+}
+
+// Start a new body compressed with the given method
+static int encoder_start(body_encoder_t* enc, wasmify_compression_t method) {
+    if (enc->method == method) {
+#ifdef WASMIFY_WITH_ZSTD
+        if (method == WASMIFY_COMPRESSION_ZSTD) {
+            return !ZSTD_isError(ZSTD_CCtx_reset(enc->zstd, ZSTD_reset_session_only));
+        }
+#endif
+        return deflateReset(&enc->zlib) == Z_OK;
+    }
+    
+    encoder_free(enc);
+#ifdef WASMIFY_WITH_ZSTD
+    if (method == WASMIFY_COMPRESSION_ZSTD) {
+        enc->zstd = ZSTD_createCCtx();
+        if (!enc->zstd) return 0;
+        enc->method = method;
+        return 1;
+    }
+#endif
+    memset(&enc->zlib, 0, sizeof(enc->zlib));
+    // 16 over the window bits asks for a gzip wrapper
+    if (deflateInit2(&enc->zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return 0;
+    }
+    enc->method = WASMIFY_COMPRESSION_GZIP;
+    return 1;
+}
+
+// Compress what fits of the input into the output, advancing both. Returns 1
+// once a finishing call has written the end of the body, 0 while there is
+// more to do and -1 on failure.
+static int encoder_step(
+    body_encoder_t* enc,
+    const uint8_t** in,
+    size_t* in_size,
+    uint8_t** out,
+    size_t* out_size,
+    int finish
+) {
+#ifdef WASMIFY_WITH_ZSTD
+    if (enc->method == WASMIFY_COMPRESSION_ZSTD) {
+        ZSTD_inBuffer input = { *in, *in_size, 0 };
+        ZSTD_outBuffer output = { *out, *out_size, 0 };
+        size_t left = ZSTD_compressStream2(enc->zstd, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(left)) return -1;
+        *in += input.pos;
+        *in_size -= input.pos;
+        *out += output.pos;
+        *out_size -= output.pos;
+        return finish && left == 0 && *in_size == 0;
+    }
+#endif
+    z_stream* z = &enc->zlib;
+    uInt in_avail = *in_size > UINT_MAX ? UINT_MAX : (uInt)*in_size;
+    uInt out_avail = *out_size > UINT_MAX ? UINT_MAX : (uInt)*out_size;
+    z->next_in = (Bytef*)*in;
+    z->avail_in = in_avail;
+    z->next_out = *out;
+    z->avail_out = out_avail;
+    // Only finish once the last of the input is in this call
+    int rc = deflate(z, finish && in_avail == *in_size ? Z_FINISH : Z_NO_FLUSH);
+    *in += in_avail - z->avail_in;
+    *in_size -= in_avail - z->avail_in;
+    *out += out_avail - z->avail_out;
+    *out_size -= out_avail - z->avail_out;
+    if (rc == Z_STREAM_END) return 1;
+    return rc == Z_OK || rc == Z_BUF_ERROR ? 0 : -1;
+}
+
+// Compress a whole body into out
+static int encoder_pack(body_encoder_t* enc, wasmify_compression_t method, const char* data, size_t size, json_buf_t* out) {
+    json_reset(out);
+    if (!encoder_start(enc, method)) return 0;
+    
+    const uint8_t* in = (const uint8_t*)data;
+    size_t in_size = size;
+    for (;;) {
+        if (!json_reserve(out, out->size / 2 + 256)) return 0;
+        uint8_t* next = (uint8_t*)out->data + out->size;
+        size_t room = out->cap - out->size - 1;
+        int rc = encoder_step(enc, &in, &in_size, &next, &room, 1);
+        out->size = (size_t)((char*)next - out->data);
+        if (rc != 0) return rc > 0;
+    }
+}
+
+// Header line of a W3C trace context and the length of its value
+#define TRACEPARENT_PREFIX "traceparent: "
+#define TRACEPARENT_LEN 55
+
+// Header line of the key retries of a call repeat, and the key's length
+#define IDEMPOTENCY_PREFIX "Idempotency-Key: "
+#define IDEMPOTENCY_KEY_LEN 32
+
+// An easy handle together with the buffer its request bodies are rendered into.
+// Connections are reused across requests, so neither is reallocated per call.
+typedef struct {
+    CURL* curl;
+    json_buf_t body;
+    const char* content_type;   // Body media type when not JSON
+    wasmify_response_t response;
+    json_buf_t packed;          // Compressed copy of the body
+    body_encoder_t encoder;
+    CURLM* hedge_multi;         // Runs this request alongside its hedge
+    json_buf_t cache_key;       // Result cache key of the current call
+    struct curl_slist trace_header; // Sent ahead of the shared headers when tracing
+    char traceparent[sizeof(TRACEPARENT_PREFIX) + TRACEPARENT_LEN]; // Empty when not
+    struct curl_slist key_header;   // Sent with the current call when it may be retried
+    char idempotency_key[sizeof(IDEMPOTENCY_PREFIX) + IDEMPOTENCY_KEY_LEN];    // Empty when not
+    int pinned;                 // Its handle is the client's curl field, so it is never dropped
+} connection_t;
+
+// One request waiting on the HTTP/2 multi handle
+typedef struct pending_transfer {
+    CURL* easy;
+    CURLcode result;
+    int done;
+    struct pending_transfer* next;
+} pending_transfer_t;
+
+// Idle connections of one group of threads. Threads are spread over the
+// shards so concurrent callers rarely touch the same lock or cache line.
+typedef struct {
+    pthread_mutex_t lock;
+    connection_t** idle;
+    int idle_count;
+    int idle_cap;
+} __attribute__((aligned(64))) connection_shard_t;
+
+#define POOL_MAX_SHARDS 64
+
+// Regional endpoints are at most this many, so a module's regions fit a mask
+#define ENDPOINT_MAX 64
+#define ENDPOINT_SAMPLES 64         // Recent request times the p95 is taken over
+#define ENDPOINT_RANK_SAMPLES 8     // Times after which endpoints are ranked by their median
+#define ENDPOINT_MIN_SAMPLES 16     // Times needed before there is a p95 to hedge at
+#define ENDPOINT_STALE_MS 30000.0   // Age at which an endpoint's times are measured again
+#define ENDPOINT_WARMUP_MS 1000.0   // Or sooner, while it has too few to rank by
+#define ENDPOINT_DOWN_FAILURES 3    // Failures in a row that open an endpoint's circuit
+#define ENDPOINT_DOWN_MS 5000.0     // For this long before it is probed
+#define ENDPOINT_DOWN_MAX_MS 60000.0    // Longest it stays open after failed probes
+#define ENDPOINT_UNHEALTHY 0.25     // Error rate above which healthy endpoints are preferred
+#define ENDPOINT_ALPHA 0.1          // Weight of the latest request in the moving averages
+
+// One API endpoint and what requests to it have measured. The strings
+// belong to the client configuration, except for the execute URL.
+typedef struct {
+    pthread_mutex_t lock;
+    const char* region;
+    const char* api_url;
+    char* execute_url;
+    double rtt_ms;
+    double error_rate;
+    double samples[ENDPOINT_SAMPLES];   // Ring of the latest request times
+    uint64_t sample_count;
+    double p50_ms;              // Of the ring, refreshed every ENDPOINT_RANK_SAMPLES times
+    double p95_ms;
+    int failures;               // In a row
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t hedges;
+    double measure_at;          // When the next request should come here to measure it again
+    double down_until;          // Circuit open until then, half-open after, closed while 0
+    double down_ms;             // How long it was opened for last
+    double probe_at;            // When a request went to probe it while half-open, 0 for none
+} endpoint_t;
+
+// How a request to an endpoint went
+typedef enum {
+    REQUEST_ANSWERED,           // Any response short of a 5xx
+    REQUEST_ABANDONED,          // Given up once another request was answered
+    REQUEST_FAILED
+} request_outcome_t;
+
+// Regions a module is deployed to, as a mask of endpoint indexes
+typedef struct module_route {
+    struct module_route* next;
+    uint64_t mask;
+    char module_id[];
+} module_route_t;
+
+#define ROUTE_BUCKETS 64
+
+typedef struct result_cache result_cache_t;
+static result_cache_t* result_cache_create(size_t budget, int ttl);
+static void result_cache_destroy(result_cache_t* cache);
+
+// Idle connections of a client and, in pooled mode, the DNS, TLS sessions and
+// connection cache shared by all of them. In HTTP/2 mode whichever caller
+// finds the multi handle idle drives it for everyone until its own transfer
+// completes; the others wait on cond.
+struct wasmify_connection_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    CURLSH* share;
+    CURLM* multi;
+    int driving;
+    pending_transfer_t* queued;
+    connection_shard_t* shards;
+    int shard_count;
+    json_buf_t config_json;     // Pre-rendered tail of every execute request
+    char* execute_url;
+    char* batch_url;
+    char* pipeline_url;
+    int execute_endpoint;       // Endpoint whose URL execute_url is, -1 when none
+    // Headers of each kind of body, plain and with its Content-Encoding
+    struct curl_slist* json_headers[2];
+    struct curl_slist* frame_headers[2];
+    struct curl_slist* upload_headers[2];
+    int request_encoding;       // wasmify_compression_t of request bodies, dropped to NONE on a 415
+    char* accept_encoding;      // Response encodings asked for, NULL for none
+    endpoint_t* endpoints;      // Where executions go; api_url alone without regional ones
+    int endpoint_count;
+    pthread_rwlock_t routes_lock;
+    module_route_t* routes[ROUTE_BUCKETS];
+    int route_count;
+    result_cache_t* results;    // NULL without a result cache
+};
+
+// Shard slot of the calling thread, assigned round-robin on first use
+static unsigned g_next_shard = 0;
+static __thread int t_shard = -1;
+
+static connection_shard_t* pool_shard(wasmify_connection_pool_t* pool) {
+    if (t_shard < 0) {
+        t_shard = (int)(__atomic_fetch_add(&g_next_shard, 1, __ATOMIC_RELAXED) % POOL_MAX_SHARDS);
+    }
+    return &pool->shards[t_shard % pool->shard_count];
+}
+
+static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userp) {
+    (void)handle;
+    (void)access;
+    wasmify_connection_pool_t* pool = (wasmify_connection_pool_t*)userp;
+    pthread_mutex_lock(&pool->share_locks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userp) {
+    (void)handle;
+    wasmify_connection_pool_t* pool = (wasmify_connection_pool_t*)userp;
+    pthread_mutex_unlock(&pool->share_locks[data]);
+}
+
+static void connection_free(connection_t* conn) {
+    if (!conn) return;
+    
+    curl_easy_cleanup(conn->curl);
+    free(conn->body.data);
+    free(conn->response.data);
+    free(conn->packed.data);
+    encoder_free(&conn->encoder);
+    if (conn->hedge_multi) curl_multi_cleanup(conn->hedge_multi);
+    free(conn->cache_key.data);
+    free(conn);
+}
+
+static void pool_destroy(wasmify_connection_pool_t* pool) {
+    if (!pool) return;
+    
+    for (int i = 0; pool->shards && i < pool->shard_count; i++) {
+        connection_shard_t* shard = &pool->shards[i];
+        for (int j = 0; j < shard->idle_count; j++) {
+            connection_free(shard->idle[j]);
+        }
+        free(shard->idle);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(pool->shards);
+    free(pool->config_json.data);
+    free(pool->execute_url);
+    free(pool->batch_url);
+    free(pool->pipeline_url);
+    for (int i = 0; i < 2; i++) {
+        curl_slist_free_all(pool->json_headers[i]);
+        curl_slist_free_all(pool->frame_headers[i]);
+        curl_slist_free_all(pool->upload_headers[i]);
+    }
+    free(pool->accept_encoding);
+    for (int i = 0; i < pool->endpoint_count; i++) {
+        free(pool->endpoints[i].execute_url);
+        pthread_mutex_destroy(&pool->endpoints[i].lock);
+    }
+    free(pool->endpoints);
+    for (int i = 0; i < ROUTE_BUCKETS; i++) {
+        while (pool->routes[i]) {
+            module_route_t* next = pool->routes[i]->next;
+            free(pool->routes[i]);
+            pool->routes[i] = next;
+        }
+    }
+    pthread_rwlock_destroy(&pool->routes_lock);
+    result_cache_destroy(pool->results);
+    if (pool->multi) curl_multi_cleanup(pool->multi);
+    if (pool->share) curl_share_cleanup(pool->share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&pool->share_locks[i]);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Media type of binary execute frames
+#define FRAME_CONTENT_TYPE "application/x-wasmify-frame"
+
+// Request headers for API calls whose body is of the given media type and,
+// when not NULL, content encoding
+static struct curl_slist* header_list(
+    const wasmify_config_t* config,
+    const char* content_type,
+    const char* extra,
+    const char* encoding
+) {
+    struct curl_slist* headers = curl_slist_append(NULL, content_type);
+    const char* lines[2] = { extra, encoding };
+    for (int i = 0; headers && i < 2; i++) {
+        if (!lines[i]) continue;
+        struct curl_slist* appended = curl_slist_append(headers, lines[i]);
+        if (!appended) {
+            curl_slist_free_all(headers);
+            return NULL;
+        }
+        headers = appended;
+    }
+    if (headers && config->api_key) {
+        static const char prefix[] = "Authorization: Bearer ";
+        size_t size = sizeof(prefix) + strlen(config->api_key);
+        char* auth_header = malloc(size);
+        struct curl_slist* appended = NULL;
+        if (auth_header) {
+            snprintf(auth_header, size, "%s%s", prefix, config->api_key);
+            appended = curl_slist_append(headers, auth_header);
+            free(auth_header);
+        }
+        if (!appended) {
+            curl_slist_free_all(headers);
+            return NULL;
+        }
+        headers = appended;
+    }
+    return headers;
+}
+
+static char* api_url_join(const char* api_url, const char* path) {
+    size_t size = strlen(api_url) + strlen(path) + 1;
+    char* url = malloc(size);
+    if (url) snprintf(url, size, "%s%s", api_url, path);
+    return url;
+}
+
+static char* endpoint_url(const wasmify_config_t* config, const char* path) {
+    return api_url_join(config->api_url, path);
+}
+
+// Encoding of request bodies for the configured compression
+static int request_encoding(wasmify_compression_t compression) {
+#ifdef WASMIFY_WITH_ZSTD
+    if (compression == WASMIFY_COMPRESSION_ZSTD) return WASMIFY_COMPRESSION_ZSTD;
+#endif
+    return compression == WASMIFY_COMPRESSION_NONE ? WASMIFY_COMPRESSION_NONE : WASMIFY_COMPRESSION_GZIP;
+}
+
+// Accept-Encoding for the configured compression, limited to what libcurl decodes
+static const char* accept_encoding(wasmify_compression_t compression) {
+#ifdef CURL_VERSION_ZSTD
+    if (compression == WASMIFY_COMPRESSION_ZSTD &&
+        (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_ZSTD)) {
+        return "zstd, gzip";
+    }
+#endif
+    (void)compression;
+    return "gzip";
+}
+
+static wasmify_connection_pool_t* pool_create(const wasmify_config_t* config) {
+    wasmify_connection_pool_t* pool = calloc(1, sizeof(wasmify_connection_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&pool->share_locks[i], NULL);
+    }
+    pthread_rwlock_init(&pool->routes_lock, NULL);
+    // One shard per core up to the connection budget, which the shards split
+    int budget = config->max_connections > 0 ? config->max_connections : 1;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int shard_count = cores > 0 ? (int)cores : 1;
+    if (shard_count > POOL_MAX_SHARDS) shard_count = POOL_MAX_SHARDS;
+    if (shard_count > budget) shard_count = budget;
+    
+    pool->shards = aligned_alloc(64, sizeof(connection_shard_t) * (size_t)shard_count);
+    if (!pool->shards) {
+        pool_destroy(pool);
+        return NULL;
+    }
+    memset(pool->shards, 0, sizeof(connection_shard_t) * (size_t)shard_count);
+    for (int i = 0; i < shard_count; i++) {
+        connection_shard_t* shard = &pool->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->idle_cap = budget / shard_count + (i < budget % shard_count);
+        shard->idle = calloc((size_t)shard->idle_cap, sizeof(connection_t*));
+        pool->shard_count = i + 1;
+        if (!shard->idle) {
+            pool_destroy(pool);
+            return NULL;
+        }
+    }
+    
+    // The config part of execute requests is the same for every call
+    json_buf_t* tail = &pool->config_json;
+    JSON_LITERAL(tail, ",\"config\":{\"memory\":{\"min\":");
+    char number[32];
+    json_raw(tail, number, (size_t)snprintf(number, sizeof(number), "%d", WASMIFY_DEFAULT_MEMORY_MIN));
+    JSON_LITERAL(tail, ",\"max\":");
+    json_raw(tail, number, (size_t)snprintf(number, sizeof(number), "%d", WASMIFY_DEFAULT_MEMORY_MAX));
+    JSON_LITERAL(tail, "},\"maxExecutionTime\":");
+    json_raw(tail, number, (size_t)snprintf(number, sizeof(number), "%d", (config->timeout > 0 ? config->timeout : 30) * 1000));
+    JSON_LITERAL(tail, ",\"enableWasi\":true}}");
+    
+    // So are the endpoints and headers of every request
+    pool->execute_url = endpoint_url(config, "/wasm/execute");
+    pool->batch_url = endpoint_url(config, "/wasm/execute/batch");
+    pool->pipeline_url = endpoint_url(config, "/wasm/execute/pipeline");
+    int failed = tail->failed || !pool->execute_url || !pool->batch_url || !pool->pipeline_url;
+    pool->request_encoding = request_encoding(config->compression);
+    int kinds = pool->request_encoding != WASMIFY_COMPRESSION_NONE ? 2 : 1;
+    for (int i = 0; i < kinds; i++) {
+        const char* encoding = !i ? NULL
+            : pool->request_encoding == WASMIFY_COMPRESSION_ZSTD ? "Content-Encoding: zstd" : "Content-Encoding: gzip";
+        pool->json_headers[i] = header_list(config, "Content-Type: application/json", NULL, encoding);
+        pool->frame_headers[i] = header_list(config, "Content-Type: " FRAME_CONTENT_TYPE, "Accept: " FRAME_CONTENT_TYPE, encoding);
+        // Chunks go out without waiting for a 100 Continue round trip each
+        pool->upload_headers[i] = header_list(config, "Content-Type: application/octet-stream", "Expect:", encoding);
+        failed |= !pool->json_headers[i] || !pool->frame_headers[i] || !pool->upload_headers[i];
+    }
+    if (config->compression != WASMIFY_COMPRESSION_NONE) {
+        pool->accept_encoding = strdup(accept_encoding(config->compression));
+        failed |= !pool->accept_encoding;
+    }
+    
+    // Executions are routed over the regional endpoints, or go to api_url
+    int endpoint_count = config->endpoints_count > 0 ? config->endpoints_count : 1;
+    pool->endpoints = calloc((size_t)endpoint_count, sizeof(endpoint_t));
+    failed |= !pool->endpoints;
+    pool->execute_endpoint = -1;
+    for (int i = 0; pool->endpoints && i < endpoint_count; i++) {
+        endpoint_t* ep = &pool->endpoints[i];
+        pthread_mutex_init(&ep->lock, NULL);
+        pool->endpoint_count = i + 1;
+        if (config->endpoints_count > 0) {
+            ep->region = config->endpoints[i].region;
+            ep->api_url = config->endpoints[i].api_url;
+        } else {
+            ep->api_url = config->api_url;
+        }
+        ep->execute_url = api_url_join(ep->api_url, "/wasm/execute");
+        failed |= !ep->execute_url;
+        if (ep->execute_url && pool->execute_url && pool->execute_endpoint < 0 &&
+            strcmp(ep->execute_url, pool->execute_url) == 0) {
+            pool->execute_endpoint = i;
+        }
+    }
+    if (config->result_cache_bytes > 0) {
+        pool->results = result_cache_create(config->result_cache_bytes, config->result_cache_ttl);
+        failed |= !pool->results;
+    }
+    if (failed) {
+        pool_destroy(pool);
+        return NULL;
+    }
+    
+    if (config->max_connections == 0) {
+        return pool;
+    }
+    
+    pool->share = curl_share_init();
+    if (!pool->share) {
+        pool_destroy(pool);
+        return NULL;
+    }
+    curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    
+    if (config->http2) {
+        pool->multi = curl_multi_init();
+        if (!pool->multi) {
+            pool_destroy(pool);
+            return NULL;
+        }
+        curl_multi_setopt(pool->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(pool->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)config->max_connections);
+        curl_multi_setopt(pool->multi, CURLMOPT_MAXCONNECTS, (long)config->max_connections);
+    }
+    
+    return pool;
+}
+
+// Create and configure a connection for a client
+static connection_t* new_connection(wasmify_client_t* client) {
+    connection_t* conn = calloc(1, sizeof(connection_t));
+    if (!conn) {
+        return NULL;
+    }
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        free(conn);
+        return NULL;
+    }
+    conn->curl = curl;
+    
+    // Set common CURL options
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, client->config.timeout);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    if (client->pool->share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, client->pool->share);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    }
+    if (client->config.http2) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        // Wait for an existing connection to allow multiplexing rather than opening another
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    }
+    if (client->pool->accept_encoding) {
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, client->pool->accept_encoding);
+    }
+    
+    return conn;
+}
+
+static connection_t* shard_pop(connection_shard_t* shard, int wait) {
+    connection_t* conn = NULL;
+    if (wait) pthread_mutex_lock(&shard->lock);
+    else if (pthread_mutex_trylock(&shard->lock) != 0) return NULL;
+    if (shard->idle_count > 0) {
+        conn = shard->idle[--shard->idle_count];
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return conn;
+}
+
+static int shard_push(connection_shard_t* shard, connection_t* conn, int wait) {
+    int pushed = 0;
+    if (wait) pthread_mutex_lock(&shard->lock);
+    else if (pthread_mutex_trylock(&shard->lock) != 0) return 0;
+    if (shard->idle_count < shard->idle_cap) {
+        shard->idle[shard->idle_count++] = conn;
+        pushed = 1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return pushed;
+}
+
+// Take a connection for one request, preferring the calling thread's shard
+// and otherwise one idling in a shard nobody is using right now
+static connection_t* acquire_connection(wasmify_client_t* client) {
+    wasmify_connection_pool_t* pool = client->pool;
+    connection_shard_t* own = pool_shard(pool);
+    
+    connection_t* conn = shard_pop(own, 1);
+    for (int i = 0; !conn && i < pool->shard_count; i++) {
+        if (&pool->shards[i] != own) conn = shard_pop(&pool->shards[i], 0);
+    }
+    
+    if (!conn) conn = new_connection(client);
+    
+    // Only the calls that ask for one carry an idempotency key
+    if (conn) conn->idempotency_key[0] = '\0';
+    return conn;
+}
+
+// Return a connection taken with acquire_connection
+static void release_connection(wasmify_client_t* client, connection_t* conn) {
+    wasmify_connection_pool_t* pool = client->pool;
+    connection_shard_t* own = pool_shard(pool);
+    
+    int kept = shard_push(own, conn, 1);
+    for (int i = 0; !kept && i < pool->shard_count; i++) {
+        if (&pool->shards[i] != own) kept = shard_push(&pool->shards[i], conn, 0);
+    }
+    if (!kept && conn->pinned) {
+        // A full shard keeps the pinned connection and drops an idle one instead;
+        // the shard may have emptied since, so it is looked at again under the lock.
+        // Every shard has room for at least one, and only one is ever pinned.
+        connection_t* surplus = NULL;
+        pthread_mutex_lock(&own->lock);
+        if (own->idle_count < own->idle_cap) {
+            own->idle[own->idle_count++] = conn;
+        } else {
+            surplus = own->idle[0];
+            own->idle[0] = conn;
+        }
+        pthread_mutex_unlock(&own->lock);
+        conn = surplus;
+        kept = conn == NULL;
+    }
+    
+    if (!kept) connection_free(conn);
+}
+
+// Move finished transfers off the multi handle; called with pool->lock held
+static int collect_finished(wasmify_connection_pool_t* pool) {
+    int finished = 0;
+    int left;
+    CURLMsg* msg;
+    while ((msg = curl_multi_info_read(pool->multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        pending_transfer_t* transfer = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+        CURLcode result = msg->data.result;
+        curl_multi_remove_handle(pool->multi, msg->easy_handle);
+        transfer->result = result;
+        transfer->done = 1;
+        finished++;
+    }
+    return finished;
+}
+
+// Run a transfer on the shared HTTP/2 multi handle
+static CURLcode multi_perform(wasmify_connection_pool_t* pool, CURL* curl) {
+    pending_transfer_t transfer = { curl, CURLE_OK, 0, NULL };
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*)&transfer);
+    
+    pthread_mutex_lock(&pool->lock);
+    transfer.next = pool->queued;
+    pool->queued = &transfer;
+    while (!transfer.done) {
+        if (pool->driving) {
+            // Have the driver pick up the new transfer now rather than at its next timeout
+            curl_multi_wakeup(pool->multi);
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        
+        pool->driving = 1;
+        while (!transfer.done) {
+            while (pool->queued) {
+                pending_transfer_t* next = pool->queued->next;
+                if (curl_multi_add_handle(pool->multi, pool->queued->easy) != CURLM_OK) {
+                    pool->queued->result = CURLE_FAILED_INIT;
+                    pool->queued->done = 1;
+                }
+                pool->queued = next;
+            }
+            pthread_mutex_unlock(&pool->lock);
+            
+            int running = 0;
+            CURLMcode mc = curl_multi_perform(pool->multi, &running);
+            if (mc == CURLM_OK && running) {
+                mc = curl_multi_poll(pool->multi, NULL, 0, 1000, NULL);
+            }
+            
+            pthread_mutex_lock(&pool->lock);
+            if (mc != CURLM_OK) {
+                curl_multi_remove_handle(pool->multi, curl);
+                transfer.result = CURLE_RECV_ERROR;
+                transfer.done = 1;
+            }
+            if (collect_finished(pool) > 0) {
+                pthread_cond_broadcast(&pool->cond);
+            }
+        }
+        
+        // Hand the multi handle over to a caller still waiting on its transfer
+        pool->driving = 0;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    return transfer.result;
+}
+
+// Copy of the configured endpoints, owning their strings
+static wasmify_endpoint_t* endpoints_copy(const wasmify_endpoint_t* endpoints, int count) {
+    wasmify_endpoint_t* copy = calloc((size_t)count, sizeof(wasmify_endpoint_t));
+    for (int i = 0; copy && i < count; i++) {
+        copy[i].region = endpoints[i].region ? strdup(endpoints[i].region) : NULL;
+        copy[i].api_url = strdup(endpoints[i].api_url);
+        if (!copy[i].api_url || (endpoints[i].region && !copy[i].region)) {
+            free((char*)copy[i].region);
+            free((char*)copy[i].api_url);
+            while (i-- > 0) {
+                free((char*)copy[i].region);
+                free((char*)copy[i].api_url);
+            }
+            free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+static void endpoints_free(const wasmify_endpoint_t* endpoints, int count) {
+    for (int i = 0; endpoints && i < count; i++) {
+        free((char*)endpoints[i].region);
+        free((char*)endpoints[i].api_url);
+    }
+    free((wasmify_endpoint_t*)endpoints);
+}
+
+// Create a new Wasmify client
+wasmify_client_t* wasmify_client_create(wasmify_config_t config) {
+    if (config.endpoints_count < 0 || config.endpoints_count > ENDPOINT_MAX ||
+        (config.endpoints_count > 0 && !config.endpoints)) {
+        return NULL;
+    }
+    for (int i = 0; i < config.endpoints_count; i++) {
+        if (!config.endpoints[i].api_url) return NULL;
+    }
+    
+    wasmify_client_t* client = calloc(1, sizeof(wasmify_client_t));
+    if (!client) {
+        return NULL;
+    }
+    
+    // Copy configuration
+    if (!config.api_url && config.endpoints_count > 0) {
+        config.api_url = (char*)config.endpoints[0].api_url;
+    }
+    client->config.api_url = config.api_url ? strdup(config.api_url) : strdup("http://localhost:3000/api");
+    client->config.api_key = config.api_key ? strdup(config.api_key) : NULL;
+    client->config.timeout = config.timeout > 0 ? config.timeout : 30;
+    client->config.max_connections = config.max_connections > 0 ? config.max_connections : 0;
+    client->config.http2 = client->config.max_connections > 0 && config.http2;
+    client->config.wire_format = config.wire_format == WASMIFY_WIRE_BINARY ? WASMIFY_WIRE_BINARY : WASMIFY_WIRE_JSON;
+    client->config.compression = config.compression == WASMIFY_COMPRESSION_GZIP || config.compression == WASMIFY_COMPRESSION_ZSTD
+        ? config.compression : WASMIFY_COMPRESSION_NONE;
+    if (config.endpoints_count > 0) {
+        client->config.endpoints = endpoints_copy(config.endpoints, config.endpoints_count);
+        client->config.endpoints_count = client->config.endpoints ? config.endpoints_count : 0;
+    }
+    client->config.hedge = config.hedge != 0;
+    client->config.result_cache_bytes = config.result_cache_bytes;
+    client->config.result_cache_ttl = config.result_cache_ttl > 0 ? config.result_cache_ttl : 0;
+    client->config.retries = config.retries > 0 ? config.retries : 0;
+    client->config.retry_backoff_ms = config.retry_backoff_ms > 0 ? config.retry_backoff_ms : 0;
+    client->config.retry_max_ms = config.retry_max_ms > 0 ? config.retry_max_ms : 0;
+    
+    // Initialize CURL
+    int copied = client->config.api_url && client->config.endpoints_count == config.endpoints_count;
+    client->pool = copied ? pool_create(&client->config) : NULL;
+    connection_t* conn = client->pool ? new_connection(client) : NULL;
+    if (!conn) {
+        pool_destroy(client->pool);
+        endpoints_free(client->config.endpoints, client->config.endpoints_count);
+        free(client->config.api_url);
+        if (client->config.api_key) free(client->config.api_key);
+        free(client);
+        return NULL;
+    }
+    
+    // Without pooling the client keeps exactly this one handle
+    if (client->config.max_connections == 0) {
+        client->curl = conn->curl;
+        conn->pinned = 1;
+    }
+    release_connection(client, conn);
+    
+    return client;
+}
+
+static void loop_destroy(wasmify_client_t* client);
+
+// Destroy a Wasmify client
+void wasmify_client_destroy(wasmify_client_t* client) {
+    if (!client) return;
+    
+    loop_destroy(client);
+    pool_destroy(client->pool);
+    endpoints_free(client->config.endpoints, client->config.endpoints_count);
+    if (client->config.api_url) {
+        free(client->config.api_url);
+    }
+    if (client->config.api_key) {
+        free(client->config.api_key);
+    }
+    free(client);
+}
+
+static double monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+}
+
+// Observer of every client's events and of local execution, NULL when none
+static wasmify_observer_t g_observer = NULL;
+static void* g_observer_data = NULL;
+
+// Tell the observer about an event given by its fields. Without an observer
+// this is one load: the fields aren't even evaluated.
+#define OBSERVE(...) do { \
+    wasmify_observer_t observer_ = __atomic_load_n(&g_observer, __ATOMIC_ACQUIRE); \
+    if (__builtin_expect(observer_ != NULL, 0)) { \
+        wasmify_event_t event_ = { __VA_ARGS__ }; \
+        observer_(&event_, __atomic_load_n(&g_observer_data, __ATOMIC_RELAXED)); \
+    } \
+} while (0)
+
+static int observing(void) {
+    return __atomic_load_n(&g_observer, __ATOMIC_RELAXED) != NULL;
+}
+
+// Install the observer of SDK events
+void wasmify_set_observer(wasmify_observer_t observer, void* user_data) {
+    __atomic_store_n(&g_observer, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_observer_data, user_data, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_observer, observer, __ATOMIC_RELEASE);
+}
+
+// Trace context the calling thread's requests are propagated in
+typedef struct {
+    int active;
+    char trace_id[33];
+    char flags[3];
+} trace_context_t;
+
+static __thread trace_context_t t_trace = { 0 };
+
+// The calling thread's next pseudo-random number (splitmix64), for span IDs,
+// idempotency keys and backoff jitter; none of them needs to be unguessable
+static __thread uint64_t t_random = 0;
+
+static uint64_t thread_random(void) {
+    if (!t_random) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        t_random = (uint64_t)now.tv_nsec ^ ((uint64_t)now.tv_sec << 30) ^ (uint64_t)(uintptr_t)&t_random;
+    }
+    uint64_t z = (t_random += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Whether text holds size lowercase hex digits, not all of them zero when
+// nonzero is set
+static int trace_hex(const char* text, size_t size, int nonzero) {
+    int seen = 0;
+    for (size_t i = 0; i < size; i++) {
+        char c = text[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return 0;
+        seen |= c != '0';
+    }
+    return seen || !nonzero;
+}
+
+// Set the trace context of the calling thread's requests
+wasmify_error_t wasmify_set_trace_context(const char* traceparent) {
+    if (!traceparent) {
+        t_trace.active = 0;
+        return WASMIFY_SUCCESS;
+    }
+    
+    // Versions after 00 may append fields of their own
+    size_t len = strlen(traceparent);
+    int version_00 = strncmp(traceparent, "00", 2) == 0;
+    if (len < TRACEPARENT_LEN || (len > TRACEPARENT_LEN && (version_00 || traceparent[TRACEPARENT_LEN] != '-')) ||
+        !trace_hex(traceparent, 2, 0) || strncmp(traceparent, "ff", 2) == 0 || traceparent[2] != '-' ||
+        !trace_hex(traceparent + 3, 32, 1) || traceparent[35] != '-' ||
+        !trace_hex(traceparent + 36, 16, 1) || traceparent[52] != '-' ||
+        !trace_hex(traceparent + 53, 2, 0)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    memcpy(t_trace.trace_id, traceparent + 3, 32);
+    t_trace.trace_id[32] = '\0';
+    memcpy(t_trace.flags, traceparent + 53, 2);
+    t_trace.flags[2] = '\0';
+    t_trace.active = 1;
+    return WASMIFY_SUCCESS;
+}
+
+// A fresh parent ID for the next request of the calling thread
+static uint64_t trace_span_id(void) {
+    uint64_t z;
+    do {
+        z = thread_random();
+    } while (z == 0);
+    return z;
+}
+
+// Give the call about to be set up on conn a fresh idempotency key when it
+// may go out more than once: retried, hedged or failed over to another
+// endpoint. All of its attempts then carry the same one.
+static void request_idempotent(wasmify_client_t* client, connection_t* conn) {
+    conn->idempotency_key[0] = '\0';
+    if (client->config.retries > 0 || client->config.hedge || client->pool->endpoint_count > 1) {
+        snprintf(conn->idempotency_key, sizeof(conn->idempotency_key), IDEMPOTENCY_PREFIX "%016" PRIx64 "%016" PRIx64,
+                 thread_random(), thread_random());
+    }
+}
+
+// Send headers with the next request on conn, led by the call's idempotency
+// key and a traceparent of its own while the calling thread propagates a
+// trace. Nothing is copied, so neither costs an allocation.
+static void set_request_headers(connection_t* conn, struct curl_slist* headers) {
+    if (conn->idempotency_key[0]) {
+        conn->key_header.data = conn->idempotency_key;
+        conn->key_header.next = headers;
+        headers = &conn->key_header;
+    }
+    conn->traceparent[0] = '\0';
+    if (t_trace.active) {
+        snprintf(conn->traceparent, sizeof(conn->traceparent), TRACEPARENT_PREFIX "00-%s-%016" PRIx64 "-%s",
+                 t_trace.trace_id, trace_span_id(), t_trace.flags);
+        conn->trace_header.data = conn->traceparent;
+        conn->trace_header.next = headers;
+        headers = &conn->trace_header;
+    }
+    curl_easy_setopt(conn->curl, CURLOPT_HTTPHEADER, headers);
+}
+
+// Value of the traceparent the request on conn carries, NULL for none
+static const char* conn_traceparent(const connection_t* conn) {
+    return conn->traceparent[0] ? conn->traceparent + sizeof(TRACEPARENT_PREFIX) - 1 : NULL;
+}
+
+// Set a request body and the headers that go with it, compressing the body
+// when the client does. Returns 1 if it was compressed, 0 if not and -1 if
+// there was no memory to compress it.
+static int set_request_body(wasmify_client_t* client, connection_t* conn, const char* data, size_t size) {
+    wasmify_connection_pool_t* pool = client->pool;
+    wasmify_compression_t method = (wasmify_compression_t)__atomic_load_n(&pool->request_encoding, __ATOMIC_RELAXED);
+    int encoded = method != WASMIFY_COMPRESSION_NONE && size >= COMPRESS_MIN_SIZE;
+    if (encoded) {
+        if (!encoder_pack(&conn->encoder, method, data, size, &conn->packed)) return -1;
+        data = conn->packed.data;
+        size = conn->packed.size;
+    }
+    
+    CURL* curl = conn->curl;
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)size);
+    set_request_headers(conn, conn->content_type ? pool->frame_headers[encoded] : pool->json_headers[encoded]);
+    return encoded;
+}
+
+// Point a connection at url with the given body, or none for a GET, and its
+// response at response. Returns whether the body was compressed as
+// set_request_body does.
+static int request_setup(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* url,
+    const char* post_data,
+    size_t post_size,
+    wasmify_response_t* response
+) {
+    CURL* curl = conn->curl;
+    if (!response_reset(response)) {
+        return -1;
+    }
+    
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, response);
+    
+    // Reused handles may still carry an earlier body
+    if (post_data) {
+        return set_request_body(client, conn, post_data, post_size);
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    set_request_headers(conn, client->pool->json_headers[0]);
+    return 0;
+}
+
+// Error of a request that ended with res and, when it was answered, code
+static wasmify_error_t request_error(CURLcode res, long code) {
+    if (res == CURLE_OPERATION_TIMEDOUT) return WASMIFY_ERROR_TIMEOUT;
+    if (res != CURLE_OK) return WASMIFY_ERROR_NETWORK;
+    if (code == 200) return WASMIFY_SUCCESS;
+    if (code == 429) return WASMIFY_ERROR_RATE_LIMITED;
+    if (code >= 500) return WASMIFY_ERROR_SERVER;
+    return WASMIFY_ERROR_NETWORK;
+}
+
+// Whether a request that ended this way may go through when sent again
+static int request_retryable(CURLcode res, long code) {
+    return res != CURLE_OK || code == 408 || code == 429 || (code >= 500 && code != 501 && code != 505);
+}
+
+// Milliseconds a response asks to wait before the next attempt per its
+// Retry-After, in seconds or as an HTTP date, or -1 when it doesn't say
+static double response_retry_after(CURL* curl) {
+#if LIBCURL_VERSION_NUM >= 0x075300
+    struct curl_header* header = NULL;
+    if (curl_easy_header(curl, "Retry-After", 0, CURLH_HEADER, -1, &header) != CURLHE_OK) {
+        return -1;
+    }
+    char* end;
+    double seconds = (double)strtol(header->value, &end, 10);
+    if (end == header->value) {
+        time_t at = curl_getdate(header->value, NULL);
+        if (at < 0) return -1;
+        seconds = difftime(at, time(NULL));
+    }
+    return seconds > 0 ? seconds * 1000.0 : 0;
+#else
+    (void)curl;
+    return -1;
+#endif
+}
+
+#define RETRY_BACKOFF_MS 100.0      // First backoff unless configured
+#define RETRY_MAX_MS 10000.0        // Longest backoff unless configured
+
+// Milliseconds to wait before retry number attempt, counted from 0: a random
+// share of a backoff that doubles each retry up to retry_max_ms ("full
+// jitter", so that clients that failed together don't retry together), but
+// at least wait_ms. -1 when wait_ms is longer than retry_max_ms.
+static double retry_delay(wasmify_client_t* client, int attempt, double wait_ms) {
+    double base = client->config.retry_backoff_ms > 0 ? client->config.retry_backoff_ms : RETRY_BACKOFF_MS;
+    double max = client->config.retry_max_ms > 0 ? client->config.retry_max_ms : RETRY_MAX_MS;
+    if (wait_ms > max) return -1;
+    
+    double ceiling = ldexp(base, attempt < 30 ? attempt : 30);
+    if (ceiling > max) ceiling = max;
+    double delay = ceiling * (double)(thread_random() >> 11) * 0x1p-53;
+    return delay > wait_ms ? delay : wait_ms;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec wait = { (time_t)(ms / 1000.0), (long)(fmod(ms, 1000.0) * 1e6) };
+    while (nanosleep(&wait, &wait) != 0 && errno == EINTR) {}
+}
+
+static CURLcode request_perform(wasmify_client_t* client, connection_t* conn) {
+    return client->pool->multi
+        ? multi_perform(client->pool, conn->curl)
+        : curl_easy_perform(conn->curl);
+}
+
+// Execute HTTP request on a connection
+static wasmify_error_t execute_request(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* url,
+    const char* post_data,
+    size_t post_size,
+    wasmify_response_t* response
+) {
+    if (!client || !conn || !url || !response) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    // Only requests that are safe to repeat are retried: GETs, and POSTs
+    // whose idempotency key lets the server recognize them
+    int retries = !post_data || conn->idempotency_key[0] ? client->config.retries : 0;
+    for (int attempt = 0;;) {
+        int encoded = request_setup(client, conn, url, post_data, post_size, response);
+        if (encoded < 0) return WASMIFY_ERROR_MEMORY;
+        
+        double sent_at = observing() ? monotonic_ms() : 0;
+        OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = url, .traceparent = conn_traceparent(conn));
+        CURLcode res = request_perform(client, conn);
+        long response_code = 0;
+        curl_easy_getinfo(conn->curl, CURLINFO_RESPONSE_CODE, &response_code);
+        wasmify_error_t error = request_error(res, response_code);
+        OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = url, .traceparent = conn_traceparent(conn),
+                .status = response_code, .error = error, .duration_ms = monotonic_ms() - sent_at);
+        
+        // A server that cannot decode the body gets it again as it is
+        if (res == CURLE_OK && response_code == 415 && encoded) {
+            __atomic_store_n(&client->pool->request_encoding, WASMIFY_COMPRESSION_NONE, __ATOMIC_RELAXED);
+            OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = url);
+            continue;
+        }
+        if (error == WASMIFY_SUCCESS || attempt >= retries || !request_retryable(res, response_code)) {
+            return error;
+        }
+        
+        double delay = retry_delay(client, attempt++, res == CURLE_OK ? response_retry_after(conn->curl) : -1);
+        if (delay < 0) return error;
+        sleep_ms(delay);
+        OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = url, .error = error);
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Account one request to an endpoint that took ms
+static void endpoint_record(endpoint_t* ep, double ms, request_outcome_t outcome, double now) {
+    pthread_mutex_lock(&ep->lock);
+    ep->requests++;
+    ep->probe_at = 0;
+    if (outcome == REQUEST_FAILED) {
+        ep->errors++;
+        ep->error_rate += ENDPOINT_ALPHA * (1.0 - ep->error_rate);
+        ep->failures++;
+        
+        // Failing while half-open opens the circuit for longer each time
+        if (ep->down_until > 0) {
+            if (now >= ep->down_until) {
+                ep->down_ms = ep->down_ms * 2 < ENDPOINT_DOWN_MAX_MS ? ep->down_ms * 2 : ENDPOINT_DOWN_MAX_MS;
+                ep->down_until = now + ep->down_ms;
+            }
+        } else if (ep->failures >= ENDPOINT_DOWN_FAILURES) {
+            ep->down_ms = ENDPOINT_DOWN_MS;
+            ep->down_until = now + ep->down_ms;
+        }
+        pthread_mutex_unlock(&ep->lock);
+        return;
+    }
+    
+    // An abandoned request took at least as long as it ran, which still
+    // belongs in the times but says nothing about failures
+    if (outcome == REQUEST_ANSWERED) {
+        ep->error_rate -= ENDPOINT_ALPHA * ep->error_rate;
+        ep->failures = 0;
+        ep->down_until = 0;
+    }
+    ep->rtt_ms = ep->sample_count ? ep->rtt_ms + ENDPOINT_ALPHA * (ms - ep->rtt_ms) : ms;
+    ep->samples[ep->sample_count++ % ENDPOINT_SAMPLES] = ms;
+    ep->measure_at = now + (ep->sample_count < ENDPOINT_RANK_SAMPLES ? ENDPOINT_WARMUP_MS : ENDPOINT_STALE_MS);
+    if (ep->sample_count % ENDPOINT_RANK_SAMPLES == 0) {
+        double sorted[ENDPOINT_SAMPLES];
+        size_t n = ep->sample_count < ENDPOINT_SAMPLES ? (size_t)ep->sample_count : ENDPOINT_SAMPLES;
+        memcpy(sorted, ep->samples, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), compare_doubles);
+        ep->p50_ms = sorted[(n - 1) / 2];
+        ep->p95_ms = sorted[(n * 95 + 99) / 100 - 1];
+    }
+    pthread_mutex_unlock(&ep->lock);
+}
+
+// Milliseconds after which a request to the endpoint is hedged, or -1 while
+// it has too few times for a p95
+static double endpoint_hedge_delay(endpoint_t* ep) {
+    pthread_mutex_lock(&ep->lock);
+    double delay = ep->sample_count >= ENDPOINT_MIN_SAMPLES ? ep->p95_ms : -1;
+    pthread_mutex_unlock(&ep->lock);
+    return delay;
+}
+
+// Choose an endpoint among those in mask and not in exclude. Endpoints whose
+// circuit is open are skipped, and those whose circuit is half-open are let
+// a single probe at a time; a probe that never reports back makes way for
+// the next after ENDPOINT_DOWN_MS. With measure set, one due to be measured again
+// or to be probed is taken first and claimed for this request; otherwise the
+// fastest healthy one, by median time so that a single slow request doesn't
+// move traffic away, and half-open ones only when nothing else is left.
+// Returns -1 when no endpoint remains.
+static int endpoint_pick(wasmify_connection_pool_t* pool, uint64_t mask, uint64_t exclude, int measure, double now) {
+    int best = -1, best_rank = 0;
+    double best_key = 0;
+    for (int i = 0; i < pool->endpoint_count; i++) {
+        if (!((mask & ~exclude) >> i & 1)) continue;
+        endpoint_t* ep = &pool->endpoints[i];
+        
+        pthread_mutex_lock(&ep->lock);
+        int half_open = ep->down_until > 0;
+        if (now < ep->down_until || (half_open && ep->probe_at > 0 && now - ep->probe_at < ENDPOINT_DOWN_MS)) {
+            pthread_mutex_unlock(&ep->lock);
+            continue;
+        }
+        if (measure && (half_open || now >= ep->measure_at)) {
+            ep->measure_at = now + ENDPOINT_STALE_MS;
+            if (half_open) ep->probe_at = now;
+            pthread_mutex_unlock(&ep->lock);
+            return i;
+        }
+        int rank = half_open ? 2 : ep->error_rate > ENDPOINT_UNHEALTHY;
+        double key = ep->sample_count >= ENDPOINT_RANK_SAMPLES ? ep->p50_ms
+            : ep->sample_count > 0 ? ep->rtt_ms : HUGE_VAL;
+        pthread_mutex_unlock(&ep->lock);
+        
+        if (best < 0 || rank < best_rank || (rank == best_rank && key < best_key)) {
+            best = i;
+            best_rank = rank;
+            best_key = key;
+        }
+    }
+    
+    // Whichever half-open endpoint was chosen carries its probe
+    if (best >= 0 && best_rank == 2) {
+        endpoint_t* ep = &pool->endpoints[best];
+        pthread_mutex_lock(&ep->lock);
+        int taken = ep->probe_at > 0 && now - ep->probe_at < ENDPOINT_DOWN_MS;
+        if (!taken) ep->probe_at = now;
+        pthread_mutex_unlock(&ep->lock);
+        if (taken) return -1;
+    }
+    return best;
+}
+
+// Milliseconds until the first circuit among those in mask is half-open
+// again, 0 when one already is
+static double endpoint_reopen_in(wasmify_connection_pool_t* pool, uint64_t mask, double now) {
+    double wait = HUGE_VAL;
+    for (int i = 0; i < pool->endpoint_count; i++) {
+        if (!(mask >> i & 1)) continue;
+        endpoint_t* ep = &pool->endpoints[i];
+        pthread_mutex_lock(&ep->lock);
+        double left = ep->down_until > now ? ep->down_until - now : 0;
+        pthread_mutex_unlock(&ep->lock);
+        if (left < wait) wait = left;
+    }
+    return wait == HUGE_VAL ? 0 : wait;
+}
+
+static uint32_t route_hash(const char* module_id) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)module_id; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash % ROUTE_BUCKETS;
+}
+
+// Endpoints a module's executions may go to
+static uint64_t route_mask(wasmify_connection_pool_t* pool, const char* module_id) {
+    uint64_t all = pool->endpoint_count == 64 ? ~0ULL : (1ULL << pool->endpoint_count) - 1;
+    if (!module_id || !__atomic_load_n(&pool->route_count, __ATOMIC_RELAXED)) {
+        return all;
+    }
+    
+    uint64_t mask = all;
+    pthread_rwlock_rdlock(&pool->routes_lock);
+    for (module_route_t* route = pool->routes[route_hash(module_id)]; route; route = route->next) {
+        if (strcmp(route->module_id, module_id) == 0) {
+            mask = route->mask;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&pool->routes_lock);
+    return mask;
+}
+
+// Run the request set up on conn, and the one set up on hedge as well once
+// conn has gone delay_ms without an answer, or straight away if conn fails
+// first. Returns the connection that was answered first, or NULL when
+// neither was, and when its request went out in *sent_at; the other request
+// is abandoned. When neither is answered *failure says how the last failed.
+static connection_t* hedged_perform(
+    wasmify_client_t* client,
+    connection_t* conn,
+    endpoint_t* ep,
+    connection_t* hedge,
+    endpoint_t* hedge_ep,
+    double delay_ms,
+    double* sent_at,
+    wasmify_error_t* failure
+) {
+    CURLM* multi = conn->hedge_multi;
+    connection_t* conns[2] = { conn, hedge };
+    endpoint_t* eps[2] = { ep, hedge_ep };
+    double started[2] = { monotonic_ms(), 0 };
+    int running[2] = { 0, 0 };
+    int sent = 1;
+    connection_t* answered = NULL;
+    
+    running[0] = curl_multi_add_handle(multi, conn->curl) == CURLM_OK;
+    if (!running[0]) endpoint_record(ep, 0, REQUEST_FAILED, started[0]);
+    OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = ep->execute_url, .traceparent = conn_traceparent(conn));
+    while (!answered && (running[0] || running[1] || sent < 2)) {
+        double now = monotonic_ms();
+        if (sent < 2 && (!running[0] || now - started[0] >= delay_ms)) {
+            sent = 2;
+            started[1] = now;
+            running[1] = curl_multi_add_handle(multi, hedge->curl) == CURLM_OK;
+            __atomic_add_fetch(&hedge_ep->hedges, 1, __ATOMIC_RELAXED);
+            if (!running[1]) endpoint_record(hedge_ep, 0, REQUEST_FAILED, now);
+            OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = hedge_ep->execute_url);
+            OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = hedge_ep->execute_url,
+                    .traceparent = conn_traceparent(hedge));
+            continue;
+        }
+        
+        int active = 0;
+        if (curl_multi_perform(multi, &active) != CURLM_OK) break;
+        int left;
+        CURLMsg* msg;
+        while ((msg = curl_multi_info_read(multi, &left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            int i = msg->easy_handle == conn->curl ? 0 : 1;
+            long code = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+            request_outcome_t outcome = msg->data.result == CURLE_OK && code < 500 ? REQUEST_ANSWERED : REQUEST_FAILED;
+            wasmify_error_t error = request_error(msg->data.result, code);
+            if (outcome == REQUEST_FAILED) *failure = error;
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            running[i] = 0;
+            double finished = monotonic_ms();
+            endpoint_record(eps[i], finished - started[i], outcome, finished);
+            OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = eps[i]->execute_url,
+                    .traceparent = conn_traceparent(conns[i]), .status = code,
+                    .error = error, .duration_ms = finished - started[i]);
+            if (outcome == REQUEST_ANSWERED && !answered) {
+                answered = conns[i];
+                *sent_at = started[i];
+            }
+        }
+        if (answered || !active) continue;
+        
+        // Sleep until there is something to read or the hedge is due
+        double wait = 1000;
+        if (sent < 2) {
+            double due = delay_ms - (monotonic_ms() - started[0]);
+            if (due < wait) wait = due > 0 ? due : 0;
+        }
+        curl_multi_poll(multi, NULL, 0, (int)wait, NULL);
+    }
+    
+    double now = monotonic_ms();
+    for (int i = 0; i < 2; i++) {
+        if (!running[i]) continue;
+        curl_multi_remove_handle(multi, conns[i]->curl);
+        endpoint_record(eps[i], now - started[i], answered ? REQUEST_ABANDONED : REQUEST_FAILED, now);
+        OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = eps[i]->execute_url,
+                .traceparent = conn_traceparent(conns[i]), .error = answered ? WASMIFY_SUCCESS : WASMIFY_ERROR_NETWORK,
+                .duration_ms = now - started[i]);
+    }
+    return answered;
+}
+
+static int response_is_frame(CURL* curl);
+
+// What the headers of an execute response said, and how its transfer went
+typedef struct {
+    int frame;                  // The body is a binary frame
+    long max_age;               // Seconds the result may be reused, 0 = not at all, -1 = unsaid
+    double server_ms;           // Execution time per Server-Timing, -1 = unsaid
+    double sent_at;             // When the answered request went out, per monotonic_ms
+    wasmify_timing_t timing;    // Its transfer phases, with execute still part of send
+} reply_meta_t;
+
+// Seconds the server lets a response be reused for per its Cache-Control,
+// 0 when it forbids it and -1 when it doesn't say
+static long response_max_age(CURL* curl) {
+#if LIBCURL_VERSION_NUM >= 0x075300
+    struct curl_header* header = NULL;
+    if (curl_easy_header(curl, "Cache-Control", 0, CURLH_HEADER, -1, &header) != CURLHE_OK) {
+        return -1;
+    }
+    long max_age = -1;
+    for (const char* p = header->value; *p; ) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (strncasecmp(p, "no-store", 8) == 0 || strncasecmp(p, "no-cache", 8) == 0) {
+            return 0;
+        }
+        if (strncasecmp(p, "max-age=", 8) == 0) {
+            max_age = strtol(p + 8, NULL, 10);
+            if (max_age < 0) max_age = 0;
+        }
+        while (*p && *p != ',') p++;
+    }
+    return max_age;
+#else
+    (void)curl;
+    return -1;
+#endif
+}
+
+// Milliseconds the server says the function ran for, from the dur of the
+// execute metric in its Server-Timing, or -1 when it doesn't say
+static double response_server_timing(CURL* curl) {
+#if LIBCURL_VERSION_NUM >= 0x075300
+    struct curl_header* header = NULL;
+    for (size_t i = 0; curl_easy_header(curl, "Server-Timing", i, CURLH_HEADER, -1, &header) == CURLHE_OK; i++) {
+        const char* p = header->value;
+        while (*p) {
+            while (*p == ' ' || *p == '\t' || *p == ',') p++;
+            size_t len = strcspn(p, ";, \t");
+            int execute = len == 7 && strncasecmp(p, "execute", 7) == 0;
+            p += len;
+            
+            // Parameters of this metric
+            while (*p && *p != ',') {
+                if (*p++ != ';') continue;
+                while (*p == ' ' || *p == '\t') p++;
+                if (execute && strncasecmp(p, "dur=", 4) == 0) {
+                    double dur = strtod(p + 4, NULL);
+                    return dur > 0 ? dur : 0;
+                }
+            }
+        }
+    }
+    return -1;
+#else
+    (void)curl;
+    return -1;
+#endif
+}
+
+// Record the phases of the transfer that answered, from libcurl's timings
+static void reply_measure(CURL* curl, double sent_at, reply_meta_t* reply) {
+    curl_off_t connect = 0, appconnect = 0, start = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &start);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_off_t ready = appconnect > connect ? appconnect : connect;
+    
+    memset(&reply->timing, 0, sizeof(reply->timing));
+    reply->timing.connect = (double)connect / 1000.0;
+    reply->timing.tls = (double)(ready - connect) / 1000.0;
+    reply->timing.send = (double)(start > ready ? start - ready : 0) / 1000.0;
+    reply->timing.receive = (double)(total > start ? total - start : 0) / 1000.0;
+    reply->server_ms = response_server_timing(curl);
+    reply->sent_at = sent_at;
+}
+
+// Complete the timing of a remote call begun at started once its result is
+// parsed. The execution time the result reports stands in for Server-Timing.
+static void reply_timing(const reply_meta_t* reply, double started, double execution_time, wasmify_timing_t* timing) {
+    *timing = reply->timing;
+    timing->total = monotonic_ms() - started;
+    timing->queue = reply->sent_at > started ? reply->sent_at - started : 0;
+    double execute = reply->server_ms >= 0 ? reply->server_ms : execution_time;
+    timing->execute = execute < timing->send ? execute : timing->send;
+    timing->send -= timing->execute;
+    
+    // What is left went into handing the response over and parsing it
+    double phases = timing->queue + timing->connect + timing->tls + timing->send + timing->execute;
+    timing->receive = timing->total > phases ? timing->total - phases : 0;
+}
+
+// Send the execute request in conn's body to the best endpoint for the
+// module, hedging it when the client does and failing over to the next
+// endpoint while they can't be reached. Once every endpoint has failed, been
+// rate limited or has its circuit open, the whole round is retried after a
+// backoff while the client retries calls. The response ends up in response,
+// whichever connection received it, and *reply holds what its headers said
+// and how long its transfer took.
+static wasmify_error_t execute_routed(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* module_id,
+    wasmify_response_t* response,
+    reply_meta_t* reply
+) {
+    wasmify_connection_pool_t* pool = client->pool;
+    uint64_t mask = route_mask(pool, module_id);
+    uint64_t tried = 0;
+    connection_t* hedge = NULL;
+    wasmify_error_t error = WASMIFY_ERROR_UNAVAILABLE;
+    double retry_after = -1;
+    int attempt = 0;
+    int retry = 0;
+    
+    for (;;) {
+        double now = monotonic_ms();
+        int primary = endpoint_pick(pool, mask, tried, 1, now);
+        if (primary < 0) {
+            // Wait at least until a circuit can be probed when all are open
+            double wait = endpoint_reopen_in(pool, mask, now);
+            if (retry_after > wait) wait = retry_after;
+            double delay = attempt < client->config.retries ? retry_delay(client, attempt, wait) : -1;
+            if (delay < 0) break;
+            attempt++;
+            sleep_ms(delay);
+            tried = 0;
+            retry_after = -1;
+            continue;
+        }
+        tried |= 1ULL << primary;
+        endpoint_t* ep = &pool->endpoints[primary];
+        if (retry) OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = ep->execute_url, .module_id = module_id);
+        retry = 1;
+        
+        int encoded = request_setup(client, conn, ep->execute_url, conn->body.data, conn->body.size, response);
+        if (encoded < 0) {
+            error = WASMIFY_ERROR_MEMORY;
+            break;
+        }
+        
+        connection_t* answered = NULL;
+        double sent_at = 0;
+        double delay = client->config.hedge ? endpoint_hedge_delay(ep) : -1;
+        if (delay >= 0) {
+            // The hedge goes to the next best region, or the same one
+            int backup = endpoint_pick(pool, mask, tried, 0, now);
+            endpoint_t* hedge_ep = &pool->endpoints[backup >= 0 ? backup : primary];
+            if (backup >= 0) tried |= 1ULL << backup;
+            if (!hedge) hedge = acquire_connection(client);
+            if (hedge) {
+                hedge->content_type = conn->content_type;
+                memcpy(hedge->idempotency_key, conn->idempotency_key, sizeof(hedge->idempotency_key));
+            }
+            if (!conn->hedge_multi) conn->hedge_multi = curl_multi_init();
+            if (!hedge || !conn->hedge_multi ||
+                request_setup(client, hedge, hedge_ep->execute_url, conn->body.data, conn->body.size, &hedge->response) < 0) {
+                error = WASMIFY_ERROR_MEMORY;
+                break;
+            }
+            answered = hedged_perform(client, conn, ep, hedge, hedge_ep, delay, &sent_at, &error);
+        } else {
+            sent_at = monotonic_ms();
+            OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = ep->execute_url,
+                    .traceparent = conn_traceparent(conn), .module_id = module_id);
+            CURLcode res = request_perform(client, conn);
+            long code = 0;
+            curl_easy_getinfo(conn->curl, CURLINFO_RESPONSE_CODE, &code);
+            double finished = monotonic_ms();
+            int failed = res != CURLE_OK || code >= 500;
+            endpoint_record(ep, finished - sent_at, failed ? REQUEST_FAILED : REQUEST_ANSWERED, finished);
+            error = request_error(res, code);
+            OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = ep->execute_url,
+                    .traceparent = conn_traceparent(conn), .module_id = module_id, .status = code,
+                    .error = error, .duration_ms = finished - sent_at);
+            if (!failed) answered = conn;
+            else if (res == CURLE_OK) retry_after = response_retry_after(conn->curl);
+        }
+        if (!answered) continue;
+        
+        long code = 0;
+        curl_easy_getinfo(answered->curl, CURLINFO_RESPONSE_CODE, &code);
+        
+        // A server that cannot decode the body gets it again as it is
+        if (code == 415 && encoded) {
+            __atomic_store_n(&pool->request_encoding, WASMIFY_COMPRESSION_NONE, __ATOMIC_RELAXED);
+            tried = 0;
+            continue;
+        }
+        if (code == 200) {
+            if (answered == hedge) {
+                wasmify_response_t swapped = *response;
+                *response = hedge->response;
+                hedge->response = swapped;
+            }
+            reply->frame = response_is_frame(answered->curl);
+            reply->max_age = response_max_age(answered->curl);
+            reply_measure(answered->curl, sent_at, reply);
+            error = WASMIFY_SUCCESS;
+            break;
+        }
+        
+        // Rate limits hold for the whole service, so they aren't failed over
+        error = request_error(CURLE_OK, code);
+        if (code != 429 && code != 408) break;
+        if (code == 429) retry_after = response_retry_after(answered->curl);
+        tried = mask;
+    }
+    
+    if (hedge) release_connection(client, hedge);
+    return error;
+}
+
+// Measurements of one of the client's endpoints
+wasmify_error_t wasmify_client_endpoint_stats(
+    wasmify_client_t* client,
+    int index,
+    wasmify_endpoint_stats_t* stats
+) {
+    if (!client || !stats || index < 0 || index >= client->pool->endpoint_count) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    endpoint_t* ep = &client->pool->endpoints[index];
+    double now = monotonic_ms();
+    pthread_mutex_lock(&ep->lock);
+    stats->region = ep->region;
+    stats->api_url = ep->api_url;
+    stats->rtt_ms = ep->rtt_ms;
+    stats->p95_ms = ep->sample_count >= ENDPOINT_MIN_SAMPLES ? ep->p95_ms : 0;
+    stats->error_rate = ep->error_rate;
+    stats->requests = ep->requests;
+    stats->failures = ep->errors;
+    stats->hedges = __atomic_load_n(&ep->hedges, __ATOMIC_RELAXED);
+    stats->healthy = ep->down_until == 0 && ep->error_rate <= ENDPOINT_UNHEALTHY;
+    stats->circuit_open = now < ep->down_until;
+    pthread_mutex_unlock(&ep->lock);
+    return WASMIFY_SUCCESS;
+}
+
+// Record which regions a module is deployed to
+wasmify_error_t wasmify_set_module_regions(
+    wasmify_client_t* client,
+    const char* module_id,
+    char** regions,
+    int regions_count
+) {
+    if (!client || !module_id || regions_count < 0 || (regions_count > 0 && !regions)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_connection_pool_t* pool = client->pool;
+    uint64_t mask = 0;
+    for (int i = 0; i < regions_count; i++) {
+        for (int j = 0; regions[i] && j < pool->endpoint_count; j++) {
+            if (pool->endpoints[j].region && strcmp(pool->endpoints[j].region, regions[i]) == 0) {
+                mask |= 1ULL << j;
+            }
+        }
+    }
+    
+    module_route_t* added = NULL;
+    if (mask) {
+        size_t size = strlen(module_id) + 1;
+        added = malloc(sizeof(module_route_t) + size);
+        if (!added) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        added->mask = mask;
+        memcpy(added->module_id, module_id, size);
+    }
+    
+    // Replace whatever was recorded before
+    pthread_rwlock_wrlock(&pool->routes_lock);
+    module_route_t** link = &pool->routes[route_hash(module_id)];
+    while (*link && strcmp((*link)->module_id, module_id) != 0) {
+        link = &(*link)->next;
+    }
+    module_route_t* removed = *link;
+    if (removed) {
+        *link = removed->next;
+        __atomic_sub_fetch(&pool->route_count, 1, __ATOMIC_RELAXED);
+    }
+    if (added) {
+        added->next = *link;
+        *link = added;
+        __atomic_add_fetch(&pool->route_count, 1, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&pool->routes_lock);
+    
+    free(removed);
+    return WASMIFY_SUCCESS;
+}
+
+// SHA-256, used to key compiled modules and uploads by content
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+// Incremental SHA-256 for data that is not in memory all at once
+typedef struct {
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t buffered;
+    uint64_t total;
+} sha256_ctx_t;
+
+static void sha256_init(sha256_ctx_t* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->buffered = 0;
+    ctx->total = 0;
+}
+
+static void sha256_update(sha256_ctx_t* ctx, const uint8_t* data, size_t size) {
+    ctx->total += size;
+    if (ctx->buffered > 0) {
+        size_t take = 64 - ctx->buffered < size ? 64 - ctx->buffered : size;
+        memcpy(ctx->block + ctx->buffered, data, take);
+        ctx->buffered += take;
+        data += take;
+        size -= take;
+        if (ctx->buffered < 64) return;
+        sha256_block(ctx->state, ctx->block);
+        ctx->buffered = 0;
+    }
+    for (; size >= 64; data += 64, size -= 64) {
+        sha256_block(ctx->state, data);
+    }
+    memcpy(ctx->block, data, size);
+    ctx->buffered = size;
+}
+
+static void sha256_final(sha256_ctx_t* ctx, uint8_t digest[32]) {
+    uint8_t tail[128] = {0};
+    size_t rest = ctx->buffered;
+    memcpy(tail, ctx->block, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = ctx->total * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    sha256_block(ctx->state, tail);
+    if (tail_len == 128) sha256_block(ctx->state, tail + 64);
+    
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+static void sha256(const uint8_t* data, size_t size, uint8_t digest[32]) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, size);
+    sha256_final(&ctx, digest);
+}
+
+static void hex_encode(const uint8_t* data, size_t size, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    out[size * 2] = '\0';
+}
+
+// Chunked uploads. The file is announced by its SHA-256 and the SHA-256 of
+// each of its chunks; the server skips a module it already has and reports
+// the chunks it holds from any earlier upload. The rest are read straight
+// from the file as curl sends them, several at a time on a multi handle of
+// the upload's own.
+#define UPLOAD_DEFAULT_PARALLEL 4
+#define UPLOAD_MAX_PARALLEL 16
+#define UPLOAD_CHUNK_ATTEMPTS 3
+#define UPLOAD_READ_SIZE (1024 * 1024)
+#define UPLOAD_STAGE_SIZE (64 * 1024)
+
+// Content-defined chunking (FastCDC): a gear hash over the last 64 bytes
+// picks the cut points, so an edit only moves the boundaries next to it and
+// chunks elsewhere in the file stay identical. The mask is stricter below
+// the average size and looser above it, which keeps sizes near the average.
+#define CDC_MIN_SIZE (256 * 1024)
+#define CDC_AVG_SIZE (1024 * 1024)
+#define CDC_MAX_SIZE (4 * 1024 * 1024)
+#define CDC_MASK_STRICT (~0ULL << (64 - 22))
+#define CDC_MASK_LOOSE (~0ULL << (64 - 18))
+
+static uint64_t g_gear[256];
+static pthread_once_t g_gear_once = PTHREAD_ONCE_INIT;
+
+// A fixed splitmix64 sequence, so every process cuts the same file alike
+static void gear_init(void) {
+    uint64_t x = 0;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        g_gear[i] = z ^ (z >> 31);
+    }
+}
+
+typedef struct {
+    curl_off_t start;
+    curl_off_t length;
+    char hash[65];
+} upload_part_t;
+
+typedef struct {
+    char sha256[65];        // Digest of the whole file
+    upload_part_t* parts;
+    long part_count;
+    long part_cap;
+    char* url;              // Endpoint of the upload session
+    uint8_t* received;      // Per chunk, whether the server has it
+    cJSON* module;          // The server's record when it already had the module
+} upload_session_t;
+
+typedef struct {
+    connection_t* conn;     // NULL while the slot is free
+    int fd;
+    long index;
+    curl_off_t start;
+    curl_off_t length;
+    curl_off_t sent;        // Bytes of the chunk read so far
+    int attempts;
+    int encoding;           // wasmify_compression_t the chunk goes out with
+    uint8_t* stage;         // File data waiting to be compressed
+    size_t stage_pos;
+    size_t stage_len;
+    int finished;           // The compressed body is complete
+    double sent_at;         // When it last went out, kept for observers only
+} upload_chunk_t;
+
+static int upload_part_add(upload_session_t* session, curl_off_t start, curl_off_t length, sha256_ctx_t* ctx) {
+    if (session->part_count == session->part_cap) {
+        long cap = session->part_cap ? session->part_cap * 2 : 64;
+        upload_part_t* parts = realloc(session->parts, sizeof(upload_part_t) * (size_t)cap);
+        if (!parts) return 0;
+        session->parts = parts;
+        session->part_cap = cap;
+    }
+    upload_part_t* part = &session->parts[session->part_count++];
+    uint8_t digest[32];
+    sha256_final(ctx, digest);
+    hex_encode(digest, sizeof(digest), part->hash);
+    part->start = start;
+    part->length = length;
+    sha256_init(ctx);
+    return 1;
+}
+
+// Hash the file and cut it into chunks in one pass over it
+static wasmify_error_t upload_scan(int fd, curl_off_t file_size, upload_session_t* session) {
+    pthread_once(&g_gear_once, gear_init);
+    uint8_t* buf = malloc(UPLOAD_READ_SIZE);
+    if (!buf) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    sha256_ctx_t file_ctx, part_ctx;
+    sha256_init(&file_ctx);
+    sha256_init(&part_ctx);
+    curl_off_t offset = 0, part_start = 0;
+    uint64_t h = 0;
+    while (offset < file_size) {
+        ssize_t got;
+        do {
+            got = pread(fd, buf, UPLOAD_READ_SIZE, (off_t)offset);
+        } while (got < 0 && errno == EINTR);
+        if (got <= 0) {
+            free(buf);
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+        sha256_update(&file_ctx, buf, (size_t)got);
+        
+        size_t from = 0;
+        for (size_t i = 0; i < (size_t)got; i++) {
+            h = (h << 1) + g_gear[buf[i]];
+            curl_off_t length = offset + (curl_off_t)i + 1 - part_start;
+            if (length < CDC_MIN_SIZE) continue;
+            uint64_t mask = length < CDC_AVG_SIZE ? CDC_MASK_STRICT : CDC_MASK_LOOSE;
+            if ((h & mask) != 0 && length < CDC_MAX_SIZE) continue;
+            
+            sha256_update(&part_ctx, buf + from, i + 1 - from);
+            if (!upload_part_add(session, part_start, length, &part_ctx)) {
+                free(buf);
+                return WASMIFY_ERROR_MEMORY;
+            }
+            part_start += length;
+            from = i + 1;
+        }
+        sha256_update(&part_ctx, buf + from, (size_t)got - from);
+        offset += got;
+    }
+    free(buf);
+    
+    if (part_start < file_size && !upload_part_add(session, part_start, file_size - part_start, &part_ctx)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    uint8_t digest[32];
+    sha256_final(&file_ctx, digest);
+    hex_encode(digest, sizeof(digest), session->sha256);
+    return WASMIFY_SUCCESS;
+}
+
+// Read up to want bytes of the chunk's file data into buffer
+static ssize_t upload_pread(upload_chunk_t* chunk, void* buffer, size_t want) {
+    curl_off_t left = chunk->length - chunk->sent;
+    if ((curl_off_t)want > left) want = (size_t)left;
+    if (want == 0) return 0;
+    
+    ssize_t got;
+    do {
+        got = pread(chunk->fd, buffer, want, (off_t)(chunk->start + chunk->sent));
+    } while (got < 0 && errno == EINTR);
+    // A file that shrank under the upload cannot fill its chunk
+    if (got <= 0) return -1;
+    
+    chunk->sent += got;
+    return got;
+}
+
+// Compress the chunk as curl asks for its body, staging file data in between
+static size_t upload_read_encoded(upload_chunk_t* chunk, uint8_t* buffer, size_t want) {
+    body_encoder_t* enc = &chunk->conn->encoder;
+    uint8_t* out = buffer;
+    size_t room = want;
+    while (room == want && !chunk->finished) {
+        if (chunk->stage_pos == chunk->stage_len && chunk->sent < chunk->length) {
+            ssize_t got = upload_pread(chunk, chunk->stage, UPLOAD_STAGE_SIZE);
+            if (got < 0) return CURL_READFUNC_ABORT;
+            chunk->stage_pos = 0;
+            chunk->stage_len = (size_t)got;
+        }
+        const uint8_t* in = chunk->stage + chunk->stage_pos;
+        size_t in_size = chunk->stage_len - chunk->stage_pos;
+        int rc = encoder_step(enc, &in, &in_size, &out, &room, chunk->sent == chunk->length);
+        if (rc < 0) return CURL_READFUNC_ABORT;
+        chunk->stage_pos = chunk->stage_len - in_size;
+        chunk->finished = rc;
+    }
+    return want - room;
+}
+
+static size_t upload_read(char* buffer, size_t size, size_t nitems, void* userp) {
+    upload_chunk_t* chunk = (upload_chunk_t*)userp;
+    if (chunk->encoding != WASMIFY_COMPRESSION_NONE) {
+        return upload_read_encoded(chunk, (uint8_t*)buffer, size * nitems);
+    }
+    ssize_t got = upload_pread(chunk, buffer, size * nitems);
+    return got < 0 ? CURL_READFUNC_ABORT : (size_t)got;
+}
+
+// Start a chunk's body over; a compressed one can only go back to the start
+static int upload_rewind(upload_chunk_t* chunk, curl_off_t offset) {
+    if (chunk->encoding != WASMIFY_COMPRESSION_NONE) {
+        if (offset != 0 || !encoder_start(&chunk->conn->encoder, (wasmify_compression_t)chunk->encoding)) {
+            return 0;
+        }
+        chunk->stage_pos = chunk->stage_len = 0;
+        chunk->finished = 0;
+    }
+    chunk->sent = offset;
+    return 1;
+}
+
+// Rewind a chunk when curl has to send it again, e.g. after a redirect
+static int upload_seek(void* userp, curl_off_t offset, int origin) {
+    upload_chunk_t* chunk = (upload_chunk_t*)userp;
+    if (origin != SEEK_SET || offset < 0 || offset > chunk->length || !upload_rewind(chunk, offset)) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    return CURL_SEEKFUNC_OK;
+}
+
+// Send a JSON request to an upload endpoint and take the "data" of its reply
+static wasmify_error_t upload_request(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* url,
+    cJSON** data
+) {
+    conn->content_type = NULL;
+    if (conn->body.failed) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    wasmify_error_t error = execute_request(client, conn, url, conn->body.data, conn->body.size, &conn->response);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    cJSON* reply = cJSON_ParseWithLength(conn->response.data, conn->response.size);
+    if (!reply) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    int success = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(reply, "success"));
+    *data = success ? cJSON_DetachItemFromObjectCaseSensitive(reply, "data") : NULL;
+    cJSON_Delete(reply);
+    
+    return *data ? WASMIFY_SUCCESS : WASMIFY_ERROR_PARSE;
+}
+
+// Announce the file to the server, which either already has the module or
+// opens a session for it and says which of its chunks it has
+static wasmify_error_t upload_start(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* file_path,
+    curl_off_t file_size,
+    const char* name,
+    const char* version,
+    upload_session_t* session
+) {
+    const char* file_name = strrchr(file_path, '/');
+    file_name = file_name ? file_name + 1 : file_path;
+    char number[32];
+    json_buf_t* body = &conn->body;
+    json_reset(body);
+    JSON_LITERAL(body, "{\"fileName\":");
+    json_string(body, file_name);
+    JSON_LITERAL(body, ",\"size\":");
+    json_raw(body, number, (size_t)snprintf(number, sizeof(number), "%lld", (long long)file_size));
+    JSON_LITERAL(body, ",\"sha256\":");
+    json_string(body, session->sha256);
+    JSON_LITERAL(body, ",\"chunks\":[");
+    for (long i = 0; i < session->part_count; i++) {
+        if (i > 0) JSON_LITERAL(body, ",");
+        JSON_LITERAL(body, "{\"hash\":");
+        json_string(body, session->parts[i].hash);
+        JSON_LITERAL(body, ",\"size\":");
+        json_raw(body, number, (size_t)snprintf(number, sizeof(number), "%lld", (long long)session->parts[i].length));
+        JSON_LITERAL(body, "}");
+    }
+    JSON_LITERAL(body, "],\"name\":");
+    json_string(body, name);
+    JSON_LITERAL(body, ",\"version\":");
+    json_string(body, version);
+    JSON_LITERAL(body, "}");
+    
+    char* url = endpoint_url(&client->config, "/upload/sessions");
+    if (!url) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    cJSON* data = NULL;
+    wasmify_error_t error = upload_request(client, conn, url, &data);
+    free(url);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    session->module = cJSON_DetachItemFromObjectCaseSensitive(data, "module");
+    if (session->module) {
+        cJSON_Delete(data);
+        return WASMIFY_SUCCESS;
+    }
+    cJSON* upload_id = cJSON_GetObjectItemCaseSensitive(data, "uploadId");
+    if (!cJSON_IsString(upload_id)) {
+        cJSON_Delete(data);
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    size_t path_size = strlen("/upload/sessions/") + strlen(upload_id->valuestring) + 1;
+    char* path = malloc(path_size);
+    if (path) snprintf(path, path_size, "/upload/sessions/%s", upload_id->valuestring);
+    session->url = path ? endpoint_url(&client->config, path) : NULL;
+    free(path);
+    session->received = calloc((size_t)session->part_count, 1);
+    if (!session->url || !session->received) {
+        cJSON_Delete(data);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    cJSON* item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(data, "received")) {
+        if (cJSON_IsNumber(item) && item->valuedouble >= 0 && item->valuedouble < session->part_count) {
+            session->received[(long)item->valuedouble] = 1;
+        }
+    }
+    cJSON_Delete(data);
+    
+    return WASMIFY_SUCCESS;
+}
+
+// Put a chunk on its connection and hand it to the multi handle. Compressed
+// chunks go out with chunked transfer encoding since their size is unknown.
+static wasmify_error_t upload_chunk_send(
+    wasmify_client_t* client,
+    CURLM* multi,
+    upload_chunk_t* chunk,
+    const char* session_url
+) {
+    CURL* curl = chunk->conn->curl;
+    char* url = malloc(strlen(session_url) + 32);
+    if (!url || !response_reset(&chunk->conn->response)) {
+        free(url);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    sprintf(url, "%s/chunks/%ld", session_url, chunk->index);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    if (chunk->attempts > 0) OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = url);
+    
+    chunk->encoding = __atomic_load_n(&client->pool->request_encoding, __ATOMIC_RELAXED);
+    if (chunk->encoding != WASMIFY_COMPRESSION_NONE && !chunk->stage) {
+        chunk->stage = malloc(UPLOAD_STAGE_SIZE);
+        if (!chunk->stage) return WASMIFY_ERROR_MEMORY;
+    }
+    if (!upload_rewind(chunk, 0)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    chunk->attempts++;
+    int encoded = chunk->encoding != WASMIFY_COMPRESSION_NONE;
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, encoded ? (curl_off_t)-1 : chunk->length);
+    set_request_headers(chunk->conn, client->pool->upload_headers[encoded]);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_read);
+    curl_easy_setopt(curl, CURLOPT_READDATA, chunk);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, upload_seek);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, chunk);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk->conn->response);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &chunk->conn->response);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*)chunk);
+    
+    wasmify_error_t error = curl_multi_add_handle(multi, curl) == CURLM_OK ? WASMIFY_SUCCESS : WASMIFY_ERROR_NETWORK;
+    if (error == WASMIFY_SUCCESS && observing()) {
+        chunk->sent_at = monotonic_ms();
+        OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = url, .traceparent = conn_traceparent(chunk->conn));
+    }
+    free(url);
+    return error;
+}
+
+// Take a chunk's connection off the multi handle and back to the pool
+static void upload_chunk_release(wasmify_client_t* client, CURLM* multi, upload_chunk_t* chunk) {
+    CURL* curl = chunk->conn->curl;
+    curl_multi_remove_handle(multi, curl);
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 0L);
+    curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, (curl_off_t)-1);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, NULL);
+    curl_easy_setopt(curl, CURLOPT_READDATA, NULL);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, NULL);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, NULL);
+    release_connection(client, chunk->conn);
+    chunk->conn = NULL;
+}
+
+// Send every chunk the server does not have yet, retrying failed ones
+static wasmify_error_t upload_chunks(wasmify_client_t* client, int fd, upload_session_t* session) {
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        return WASMIFY_ERROR_NETWORK;
+    }
+    int parallel = client->config.max_connections > 0 ? client->config.max_connections : UPLOAD_DEFAULT_PARALLEL;
+    if (parallel > UPLOAD_MAX_PARALLEL) parallel = UPLOAD_MAX_PARALLEL;
+    
+    upload_chunk_t chunks[UPLOAD_MAX_PARALLEL];
+    memset(chunks, 0, sizeof(chunks));
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    long next = 0;
+    int active = 0;
+    
+    for (;;) {
+        // Keep every slot busy with the next missing chunk
+        for (int i = 0; i < parallel && error == WASMIFY_SUCCESS; i++) {
+            while (next < session->part_count && session->received[next]) next++;
+            if (chunks[i].conn || next >= session->part_count) continue;
+            
+            upload_chunk_t* chunk = &chunks[i];
+            chunk->conn = acquire_connection(client);
+            if (!chunk->conn) {
+                error = WASMIFY_ERROR_MEMORY;
+                break;
+            }
+            chunk->fd = fd;
+            chunk->index = next++;
+            chunk->start = session->parts[chunk->index].start;
+            chunk->length = session->parts[chunk->index].length;
+            chunk->attempts = 0;
+            error = upload_chunk_send(client, multi, chunk, session->url);
+            active++;
+        }
+        if (error != WASMIFY_SUCCESS || active == 0) break;
+        
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &running);
+        if (mc == CURLM_OK && running) {
+            mc = curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+        if (mc != CURLM_OK) {
+            error = WASMIFY_ERROR_NETWORK;
+            break;
+        }
+        
+        int left;
+        CURLMsg* msg;
+        while ((msg = curl_multi_info_read(multi, &left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            upload_chunk_t* chunk = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&chunk);
+            CURLcode res = msg->data.result;
+            long response_code = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+            if (observing()) {
+                char* url = NULL;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_EFFECTIVE_URL, &url);
+                OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = url,
+                        .traceparent = conn_traceparent(chunk->conn), .status = response_code,
+                        .error = res == CURLE_OK && response_code == 200 ? WASMIFY_SUCCESS : WASMIFY_ERROR_NETWORK,
+                        .duration_ms = monotonic_ms() - chunk->sent_at);
+            }
+            
+            if (res == CURLE_OK && response_code == 200) {
+                session->received[chunk->index] = 1;
+                upload_chunk_release(client, multi, chunk);
+                active--;
+                continue;
+            }
+            
+            // Transport failures and server errors are worth another try, as is
+            // a compressed chunk the server cannot decode; a rejected chunk is not
+            int refused = res == CURLE_OK && response_code == 415 && chunk->encoding != WASMIFY_COMPRESSION_NONE;
+            if (refused) {
+                __atomic_store_n(&client->pool->request_encoding, WASMIFY_COMPRESSION_NONE, __ATOMIC_RELAXED);
+            }
+            int retry = (res != CURLE_OK || response_code >= 500 || refused) && chunk->attempts < UPLOAD_CHUNK_ATTEMPTS;
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            if (retry && error == WASMIFY_SUCCESS) {
+                error = upload_chunk_send(client, multi, chunk, session->url);
+            } else if (error == WASMIFY_SUCCESS) {
+                error = WASMIFY_ERROR_NETWORK;
+            }
+        }
+    }
+    
+    // Abandon whatever is still in flight after a failure
+    for (int i = 0; i < parallel; i++) {
+        if (chunks[i].conn) upload_chunk_release(client, multi, &chunks[i]);
+        free(chunks[i].stage);
+    }
+    curl_multi_cleanup(multi);
+    
+    return error;
+}
+
+// Upload a WebAssembly module
+wasmify_error_t wasmify_upload_module(
+    wasmify_client_t* client,
+    const char* file_path,
+    const char* name,
+    const char* version,
+    wasmify_module_t* module
+) {
+    if (!client || !file_path || !name || !version || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        close(fd);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    upload_session_t session = {0};
+    cJSON* data = NULL;
+    wasmify_error_t error = upload_scan(fd, (curl_off_t)st.st_size, &session);
+    if (error == WASMIFY_SUCCESS) {
+        error = upload_start(client, conn, file_path, (curl_off_t)st.st_size, name, version, &session);
+    }
+    if (error == WASMIFY_SUCCESS && session.module) {
+        // Nothing to send; the server already has this content
+        data = session.module;
+    } else if (error == WASMIFY_SUCCESS) {
+        error = upload_chunks(client, fd, &session);
+        char* url = error == WASMIFY_SUCCESS ? malloc(strlen(session.url) + sizeof("/complete")) : NULL;
+        if (url) {
+            sprintf(url, "%s/complete", session.url);
+            json_reset(&conn->body);
+            JSON_LITERAL(&conn->body, "{}");
+            error = upload_request(client, conn, url, &data);
+            free(url);
+        } else if (error == WASMIFY_SUCCESS) {
+            error = WASMIFY_ERROR_MEMORY;
+        }
+    }
+    release_connection(client, conn);
+    close(fd);
+    free(session.parts);
+    free(session.url);
+    free(session.received);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    // Module IDs are the leading digest digits, as for locally compiled modules
+    module->id = strndup(session.sha256, 16);
+    module->name = strdup(name);
+    module->version = strdup(version);
+    module->file_path = strdup(file_path);
+    module->metadata = data;
+    
+    return WASMIFY_SUCCESS;
+}
+
+// Compact binary framing of execute calls, used with WASMIFY_WIRE_BINARY.
+// Integers are little-endian and a string is a u32 length and its bytes.
+//   request:  "WMF1" moduleId functionName config u32:count value*
+//   response: "WMF1" u8:success f64:executionTime u64:memoryUsed error u32:count value*
+//   value:    u8:wasmify_valkind_t tag, then 4 bytes for i32/f32, 8 for
+//             i64/f64, 16 for v128 and a string for bytes
+#define FRAME_MAGIC "WMF1"
+#define FRAME_MAGIC_SIZE 4
+
+// Smallest encoded value, a tag and a length or 4 byte number
+#define FRAME_MIN_VALUE_SIZE 5
+
+static void frame_u8(json_buf_t* buf, uint8_t v) {
+    json_raw(buf, (const char*)&v, 1);
+}
+
+static void frame_u32(json_buf_t* buf, uint32_t v) {
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++) b[i] = (uint8_t)(v >> (8 * i));
+    json_raw(buf, (const char*)b, sizeof(b));
+}
+
+static void frame_u64(json_buf_t* buf, uint64_t v) {
+    uint8_t b[8];
+    for (int i = 0; i < 8; i++) b[i] = (uint8_t)(v >> (8 * i));
+    json_raw(buf, (const char*)b, sizeof(b));
+}
+
+static void frame_bytes(json_buf_t* buf, const char* data, size_t len) {
+    if (len > UINT32_MAX) {
+        buf->failed = 1;
+        return;
+    }
+    frame_u32(buf, (uint32_t)len);
+    json_raw(buf, data, len);
+}
+
+// Append a string argument as the narrowest value it spells: an integer as
+// i32 or i64, any other number as f64, and anything else as bytes
+static void frame_arg(json_buf_t* buf, const char* text) {
+    char* end = NULL;
+    errno = 0;
+    long long i = strtoll(text, &end, 10);
+    if (end != text && *end == '\0' && errno == 0) {
+        if (i >= INT32_MIN && i <= INT32_MAX) {
+            frame_u8(buf, WASMIFY_VAL_I32);
+            frame_u32(buf, (uint32_t)(int32_t)i);
+        } else {
+            frame_u8(buf, WASMIFY_VAL_I64);
+            frame_u64(buf, (uint64_t)i);
+        }
+        return;
+    }
+    
+    errno = 0;
+    double d = strtod(text, &end);
+    // Underflow still gives the nearest value, subnormal or zero; only overflow is out of range
+    if (errno == ERANGE && !isinf(d)) errno = 0;
+    if (end != text && *end == '\0' && errno == 0) {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        frame_u8(buf, WASMIFY_VAL_F64);
+        frame_u64(buf, bits);
+        return;
+    }
+    
+    frame_u8(buf, WASMIFY_VAL_BYTES);
+    frame_bytes(buf, text, strlen(text));
+}
+
+// Append a typed value
+static void frame_value(json_buf_t* buf, const wasmify_value_t* value) {
+    frame_u8(buf, (uint8_t)value->kind);
+    switch (value->kind) {
+        case WASMIFY_VAL_I32:
+            frame_u32(buf, (uint32_t)value->of.i32);
+            break;
+        case WASMIFY_VAL_I64:
+            frame_u64(buf, (uint64_t)value->of.i64);
+            break;
+        case WASMIFY_VAL_F32: {
+            uint32_t bits;
+            memcpy(&bits, &value->of.f32, sizeof(bits));
+            frame_u32(buf, bits);
+            break;
+        }
+        case WASMIFY_VAL_F64: {
+            uint64_t bits;
+            memcpy(&bits, &value->of.f64, sizeof(bits));
+            frame_u64(buf, bits);
+            break;
+        }
+        case WASMIFY_VAL_V128:
+            json_raw(buf, (const char*)value->of.v128, sizeof(value->of.v128));
+            break;
+        case WASMIFY_VAL_BYTES:
+            frame_bytes(buf, (const char*)value->of.bytes.data, value->of.bytes.size);
+            break;
+        default:
+            buf->failed = 1;
+            break;
+    }
+}
+
+// Append the part of an execute request that is the same for every call of
+// one function: in a frame everything up to the value count, in JSON
+// everything up to the arguments
+static void execute_prefix(
+    wasmify_client_t* client,
+    json_buf_t* body,
+    const char* module_id,
+    const char* function_name
+) {
+    if (client->config.wire_format == WASMIFY_WIRE_BINARY) {
+        // The frame carries the bare config object of the pre-rendered JSON tail
+        static const char config_prefix[] = ",\"config\":";
+        const json_buf_t* tail = &client->pool->config_json;
+        json_raw(body, FRAME_MAGIC, FRAME_MAGIC_SIZE);
+        frame_bytes(body, module_id, strlen(module_id));
+        frame_bytes(body, function_name, strlen(function_name));
+        frame_bytes(body, tail->data + sizeof(config_prefix) - 1, tail->size - sizeof(config_prefix));
+        return;
+    }
+    
+    JSON_LITERAL(body, "{\"moduleId\":");
+    json_string(body, module_id);
+    JSON_LITERAL(body, ",\"functionName\":");
+    json_string(body, function_name);
+    JSON_LITERAL(body, ",\"args\":");
+}
+
+// Start an execute request in the connection's buffer, copying a prepared
+// prefix when there is one
+static void execute_begin(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const json_buf_t* prefix,
+    const char* module_id,
+    const char* function_name
+) {
+    json_buf_t* body = &conn->body;
+    json_reset(body);
+    conn->content_type = client->config.wire_format == WASMIFY_WIRE_BINARY ? FRAME_CONTENT_TYPE : NULL;
+    request_idempotent(client, conn);
+    if (prefix) {
+        json_raw(body, prefix->data, prefix->size);
+    } else {
+        execute_prefix(client, body, module_id, function_name);
+    }
+}
+
+// Complete an execute request with string arguments
+static int execute_finish_args(wasmify_client_t* client, connection_t* conn, char** args, int args_count) {
+    json_buf_t* body = &conn->body;
+    if (conn->content_type) {
+        frame_u32(body, (uint32_t)args_count);
+        for (int i = 0; i < args_count; i++) {
+            frame_arg(body, args[i]);
+        }
+        return !body->failed;
+    }
+    
+    json_args(body, args, args_count);
+    json_raw(body, client->pool->config_json.data, client->pool->config_json.size);
+    return !body->failed;
+}
+
+// Append a typed value to a JSON body. Numbers are written as JSON numbers,
+// except i64 and non-finite floats which JSON numbers can't carry exactly.
+static int json_value(json_buf_t* buf, const wasmify_value_t* value) {
+    char number[40];
+    double d;
+    switch (value->kind) {
+        case WASMIFY_VAL_I32:
+            json_raw(buf, number, (size_t)snprintf(number, sizeof(number), "%d", value->of.i32));
+            return 1;
+        case WASMIFY_VAL_I64:
+            snprintf(number, sizeof(number), "%lld", (long long)value->of.i64);
+            json_string(buf, number);
+            return 1;
+        case WASMIFY_VAL_F32:
+        case WASMIFY_VAL_F64:
+            d = value->kind == WASMIFY_VAL_F32 ? (double)value->of.f32 : value->of.f64;
+            if (isnan(d)) {
+                JSON_LITERAL(buf, "\"NaN\"");
+            } else if (isinf(d)) {
+                if (d < 0) JSON_LITERAL(buf, "\"-Infinity\"");
+                else JSON_LITERAL(buf, "\"Infinity\"");
+            } else {
+                const char* format = value->kind == WASMIFY_VAL_F32 ? "%.9g" : "%.17g";
+                json_raw(buf, number, (size_t)snprintf(number, sizeof(number), format, d));
+            }
+            return 1;
+        case WASMIFY_VAL_BYTES:
+            json_string_n(buf, (const char*)value->of.bytes.data, value->of.bytes.size);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Complete an execute request with typed arguments
+static wasmify_error_t execute_finish_values(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const wasmify_value_t* args,
+    size_t args_count
+) {
+    json_buf_t* body = &conn->body;
+    if (conn->content_type) {
+        if (args_count > UINT32_MAX) {
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+        frame_u32(body, (uint32_t)args_count);
+        for (size_t i = 0; i < args_count; i++) {
+            frame_value(body, &args[i]);
+        }
+        return body->failed ? WASMIFY_ERROR_MEMORY : WASMIFY_SUCCESS;
+    }
+    
+    JSON_LITERAL(body, "[");
+    for (size_t i = 0; i < args_count; i++) {
+        if (i > 0) JSON_LITERAL(body, ",");
+        if (!json_value(body, &args[i])) {
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+    }
+    JSON_LITERAL(body, "]");
+    json_raw(body, client->pool->config_json.data, client->pool->config_json.size);
+    return body->failed ? WASMIFY_ERROR_MEMORY : WASMIFY_SUCCESS;
+}
+
+// Render the body of a batch execute request into the connection's buffer
+static int build_batch_request(
+    wasmify_client_t* client,
+    connection_t* conn,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n
+) {
+    json_buf_t* body = &conn->body;
+    json_reset(body);
+    conn->content_type = NULL;
+    request_idempotent(client, conn);
+    JSON_LITERAL(body, "{\"moduleId\":");
+    json_string(body, module_id);
+    JSON_LITERAL(body, ",\"functionName\":");
+    json_string(body, function_name);
+    JSON_LITERAL(body, ",\"invocations\":[");
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) JSON_LITERAL(body, ",");
+        json_args(body, batches[i].args, batches[i].args_count);
+    }
+    JSON_LITERAL(body, "]");
+    json_raw(body, client->pool->config_json.data, client->pool->config_json.size);
+    return !body->failed;
+}
+
+// In-place scanner over a response body. Values are located without building
+// a tree, so results can point straight into the response buffer.
+typedef struct {
+    char* p;
+    char* end;
+} json_scan_t;
+
+// Location of a scanned value; for strings, the raw text between the quotes
+typedef struct {
+    char* start;
+    size_t len;
+    char kind;      // '"' string, '{' object, '[' array, 'n' number, 't', 'f', 'z' null
+} json_span_t;
+
+static void scan_ws(json_scan_t* s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) s->p++;
+}
+
+static int scan_char(json_scan_t* s, char c) {
+    scan_ws(s);
+    if (s->p < s->end && *s->p == c) {
+        s->p++;
+        return 1;
+    }
+    return 0;
+}
+
+// Scan the rest of a string whose opening quote has been consumed
+static int scan_string(json_scan_t* s, json_span_t* v) {
+    v->kind = '"';
+    v->start = s->p;
+    while (s->p < s->end) {
+        unsigned char c = (unsigned char)*s->p;
+        if (c == '"') {
+            v->len = (size_t)(s->p - v->start);
+            s->p++;
+            return 1;
+        }
+        if (c < 0x20) return 0;
+        if (c == '\\') s->p++;
+        s->p++;
+    }
+    return 0;
+}
+
+// Scan any value, skipping over nested objects and arrays
+static int scan_value(json_scan_t* s, json_span_t* v) {
+    scan_ws(s);
+    if (s->p >= s->end) return 0;
+    
+    char c = *s->p;
+    if (c == '"') {
+        s->p++;
+        return scan_string(s, v);
+    }
+    
+    v->start = s->p;
+    if (c == '{' || c == '[') {
+        v->kind = c;
+        int depth = 0;
+        while (s->p < s->end) {
+            c = *s->p++;
+            if (c == '"') {
+                json_span_t skipped;
+                if (!scan_string(s, &skipped)) return 0;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                v->len = (size_t)(s->p - v->start);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    
+    while (s->p < s->end && *s->p != ',' && *s->p != '}' && *s->p != ']' &&
+           *s->p != ' ' && *s->p != '\t' && *s->p != '\n' && *s->p != '\r') {
+        s->p++;
+    }
+    v->len = (size_t)(s->p - v->start);
+    if (v->len == 4 && memcmp(v->start, "true", 4) == 0) v->kind = 't';
+    else if (v->len == 5 && memcmp(v->start, "false", 5) == 0) v->kind = 'f';
+    else if (v->len == 4 && memcmp(v->start, "null", 4) == 0) v->kind = 'z';
+    else if (v->len > 0 && (c == '-' || (c >= '0' && c <= '9'))) v->kind = 'n';
+    else return 0;
+    return 1;
+}
+
+// Advance to the next member of an object: 1 with its key read, 0 at the
+// end of the object, -1 on malformed input
+static int scan_member(json_scan_t* s, int* first, json_span_t* key) {
+    if (scan_char(s, '}')) return 0;
+    if (!*first && !scan_char(s, ',')) return -1;
+    *first = 0;
+    if (!scan_char(s, '"') || !scan_string(s, key) || !scan_char(s, ':')) return -1;
+    return 1;
+}
+
+// Advance to the next element of an array: 1 if one follows, 0 at the end,
+// -1 on malformed input
+static int scan_element(json_scan_t* s, int* first) {
+    if (scan_char(s, ']')) return 0;
+    if (!*first && !scan_char(s, ',')) return -1;
+    *first = 0;
+    return 1;
+}
+
+static int span_is(const json_span_t* v, const char* text) {
+    size_t len = strlen(text);
+    return v->len == len && memcmp(v->start, text, len) == 0;
+}
+
+static double span_number(const json_span_t* v) {
+    char digits[64];
+    if (v->kind != 'n' || v->len >= sizeof(digits)) return 0;
+    memcpy(digits, v->start, v->len);
+    digits[v->len] = '\0';
+    return strtod(digits, NULL);
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int read_hex4(const char* p, const char* end, uint32_t* code) {
+    if (end - p < 4) return 0;
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int d = hex_digit(p[i]);
+        if (d < 0) return 0;
+        v = v << 4 | (uint32_t)d;
+    }
+    *code = v;
+    return 1;
+}
+
+// Decode the escapes of a string span into out, which may alias the span
+// since decoding never lengthens it; returns the decoded length
+static size_t json_unescape(const char* in, size_t len, char* out) {
+    const char* end = in + len;
+    char* o = out;
+    while (in < end) {
+        char c = *in++;
+        if (c != '\\' || in >= end) {
+            *o++ = c;
+            continue;
+        }
+        c = *in++;
+        switch (c) {
+            case 'b': *o++ = '\b'; break;
+            case 'f': *o++ = '\f'; break;
+            case 'n': *o++ = '\n'; break;
+            case 'r': *o++ = '\r'; break;
+            case 't': *o++ = '\t'; break;
+            case 'u': {
+                uint32_t code;
+                if (!read_hex4(in, end, &code)) {
+                    *o++ = '?';
+                    break;
+                }
+                in += 4;
+                uint32_t low;
+                if (code >= 0xD800 && code <= 0xDBFF && end - in >= 6 && in[0] == '\\' && in[1] == 'u' &&
+                    read_hex4(in + 2, end, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                } else if (code >= 0xD800 && code <= 0xDFFF) {
+                    code = 0xFFFD;
+                }
+                if (code < 0x80) {
+                    *o++ = (char)code;
+                } else if (code < 0x800) {
+                    *o++ = (char)(0xC0 | code >> 6);
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    *o++ = (char)(0xE0 | code >> 12);
+                    *o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                } else {
+                    *o++ = (char)(0xF0 | code >> 18);
+                    *o++ = (char)(0x80 | ((code >> 12) & 0x3F));
+                    *o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: *o++ = c; break;
+        }
+    }
+    return (size_t)(o - out);
+}
+
+// Copy a span into a new string: strings decoded, anything else as raw JSON
+static char* span_copy(wasmify_arena_t* arena, const json_span_t* v) {
+    char* copy = result_alloc(arena, v->len + 1);
+    if (!copy) return NULL;
+    size_t len = v->len;
+    if (v->kind == '"') len = json_unescape(v->start, v->len, copy);
+    else memcpy(copy, v->start, v->len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static char* span_dup(const json_span_t* v) {
+    return span_copy(NULL, v);
+}
+
+// Turn a span into a NUL-terminated view where it lies. Only valid once the
+// scan is complete, as the terminator may overwrite a delimiter.
+static const char* span_view(json_span_t* v, size_t* len) {
+    *len = v->kind == '"' ? json_unescape(v->start, v->len, v->start) : v->len;
+    v->start[*len] = '\0';
+    return v->start;
+}
+
+// Fields of one execution result as located in the response
+typedef struct {
+    int has_result;
+    json_span_t result;
+    int has_error;
+    json_span_t error;
+    int success;
+    double execution_time;
+    double memory_used;
+} result_spans_t;
+
+// Scan an execution result object
+static wasmify_error_t scan_result_object(json_scan_t* s, result_spans_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (!scan_char(s, '{')) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    int first = 1, more;
+    json_span_t key, value;
+    while ((more = scan_member(s, &first, &key)) > 0) {
+        if (!scan_value(s, &value)) return WASMIFY_ERROR_PARSE;
+        if (span_is(&key, "result")) {
+            out->has_result = value.kind != 'z';
+            out->result = value;
+        } else if (span_is(&key, "error")) {
+            out->has_error = value.kind == '"';
+            out->error = value;
+        } else if (span_is(&key, "success")) {
+            out->success = value.kind == 't';
+        } else if (span_is(&key, "executionTime")) {
+            out->execution_time = span_number(&value);
+        } else if (span_is(&key, "memoryUsed")) {
+            out->memory_used = span_number(&value);
+        }
+    }
+    return more == 0 ? WASMIFY_SUCCESS : WASMIFY_ERROR_PARSE;
+}
+
+// Scan an API envelope {success, error, data:{...}}, handing data's members
+// to on_data. Returns WASMIFY_ERROR_EXECUTION with *error set when the API
+// reports failure.
+static wasmify_error_t scan_envelope(
+    json_scan_t* s,
+    wasmify_error_t (*on_data)(json_scan_t* s, const json_span_t* key, void* ctx),
+    void* ctx,
+    int* has_error,
+    json_span_t* error
+) {
+    *has_error = 0;
+    if (!scan_char(s, '{')) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    int success = 0;
+    int first = 1, more;
+    json_span_t key, value;
+    while ((more = scan_member(s, &first, &key)) > 0) {
+        if (span_is(&key, "data") && scan_char(s, '{')) {
+            int data_first = 1, data_more;
+            json_span_t data_key;
+            while ((data_more = scan_member(s, &data_first, &data_key)) > 0) {
+                wasmify_error_t e = on_data(s, &data_key, ctx);
+                if (e != WASMIFY_SUCCESS) return e;
+            }
+            if (data_more < 0) return WASMIFY_ERROR_PARSE;
+            continue;
+        }
+        if (!scan_value(s, &value)) return WASMIFY_ERROR_PARSE;
+        if (span_is(&key, "success")) {
+            success = value.kind == 't';
+        } else if (span_is(&key, "error") && value.kind == '"') {
+            *has_error = 1;
+            *error = value;
+        }
+    }
+    if (more < 0) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    return success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+// data member handler for execute responses
+static wasmify_error_t scan_execute_data(json_scan_t* s, const json_span_t* key, void* ctx) {
+    result_spans_t* spans = (result_spans_t*)ctx;
+    if (span_is(key, "result")) {
+        wasmify_error_t error = scan_result_object(s, spans);
+        if (error == WASMIFY_SUCCESS) spans->success |= 2;    // Result object seen
+        return error;
+    }
+    json_span_t skipped;
+    return scan_value(s, &skipped) ? WASMIFY_SUCCESS : WASMIFY_ERROR_PARSE;
+}
+
+// Locate the result of an execute response; *api_error is set when the API
+// itself reported failure
+static wasmify_error_t scan_execute_response(
+    wasmify_response_t* response,
+    result_spans_t* spans,
+    int* has_api_error,
+    json_span_t* api_error
+) {
+    json_scan_t s = { response->data, response->data + response->size };
+    memset(spans, 0, sizeof(*spans));
+    
+    wasmify_error_t error = scan_envelope(&s, scan_execute_data, spans, has_api_error, api_error);
+    if (error == WASMIFY_SUCCESS && !(spans->success & 2)) {
+        error = WASMIFY_ERROR_PARSE;
+    }
+    spans->success &= 1;
+    return error;
+}
+
+static void result_init(wasmify_result_t* result) {
+    result->success = 0;
+    result->result = NULL;
+    result->execution_time = 0;
+    result->memory_used = 0;
+    result->error = NULL;
+    memset(&result->timing, 0, sizeof(result->timing));
+    result->memory_peak_pages = 0;
+}
+
+// Copy located result fields into an owned result
+static wasmify_error_t result_from_spans(const result_spans_t* spans, wasmify_arena_t* arena, wasmify_result_t* result) {
+    result->success = spans->success;
+    result->execution_time = spans->execution_time;
+    result->memory_used = (size_t)spans->memory_used;
+    if (spans->has_result) result->result = span_copy(arena, &spans->result);
+    if (spans->has_error) result->error = span_copy(arena, &spans->error);
+    return result->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+// Parse the response of an execute request
+static wasmify_error_t parse_execute_response(wasmify_response_t* response, wasmify_arena_t* arena, wasmify_result_t* result) {
+    result_init(result);
+    
+    result_spans_t spans;
+    int has_api_error;
+    json_span_t api_error;
+    wasmify_error_t error = scan_execute_response(response, &spans, &has_api_error, &api_error);
+    if (error == WASMIFY_ERROR_EXECUTION) {
+        result->error = has_api_error ? span_copy(arena, &api_error) : result_strdup(arena, "execution failed");
+        return error;
+    }
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    return result_from_spans(&spans, arena, result);
+}
+
+// Bounds-checked reader over a binary frame
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    int failed;
+} frame_reader_t;
+
+static const uint8_t* frame_take(frame_reader_t* r, size_t n) {
+    if (r->failed || (size_t)(r->end - r->p) < n) {
+        r->failed = 1;
+        return NULL;
+    }
+    const uint8_t* p = r->p;
+    r->p += n;
+    return p;
+}
+
+static uint64_t frame_read_le(frame_reader_t* r, size_t n) {
+    const uint8_t* p = frame_take(r, n);
+    uint64_t v = 0;
+    if (p) {
+        for (size_t i = 0; i < n; i++) v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static const uint8_t* frame_read_bytes(frame_reader_t* r, uint32_t* len) {
+    *len = (uint32_t)frame_read_le(r, 4);
+    return frame_take(r, *len);
+}
+
+// Header fields of an execute response frame; values still to be read
+typedef struct {
+    int success;
+    double execution_time;
+    uint64_t memory_used;
+    const uint8_t* error;
+    uint32_t error_len;
+    uint32_t count;
+    frame_reader_t values;
+} frame_reply_t;
+
+static wasmify_error_t frame_scan_reply(const wasmify_response_t* response, frame_reply_t* reply) {
+    frame_reader_t r = { (const uint8_t*)response->data, (const uint8_t*)response->data + response->size, 0 };
+    const uint8_t* magic = frame_take(&r, FRAME_MAGIC_SIZE);
+    if (!magic || memcmp(magic, FRAME_MAGIC, FRAME_MAGIC_SIZE) != 0) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    reply->success = frame_read_le(&r, 1) != 0;
+    uint64_t bits = frame_read_le(&r, 8);
+    memcpy(&reply->execution_time, &bits, sizeof(bits));
+    reply->memory_used = frame_read_le(&r, 8);
+    reply->error = frame_read_bytes(&r, &reply->error_len);
+    reply->count = (uint32_t)frame_read_le(&r, 4);
+    reply->values = r;
+    return r.failed ? WASMIFY_ERROR_PARSE : WASMIFY_SUCCESS;
+}
+
+static int format_value(char* buf, size_t size, uint8_t type, uint64_t slot);
+static void hex_encode(const uint8_t* data, size_t size, char* out);
+
+// Largest text form of a frame's values relative to their encoded size;
+// e.g. a 9 byte f64 can print as 24 characters plus a separator
+#define FRAME_TEXT_RATIO 4
+
+// Write the text form of a reply's values, separated by spaces as local
+// results are, into out, which holds FRAME_TEXT_RATIO times the frame size;
+// returns the length or -1 on a malformed frame
+static long frame_write_values(frame_reply_t* reply, char* out) {
+    frame_reader_t* r = &reply->values;
+    char* o = out;
+    for (uint32_t i = 0; i < reply->count; i++) {
+        if (i > 0) *o++ = ' ';
+        uint8_t tag = (uint8_t)frame_read_le(r, 1);
+        if (tag == WASMIFY_VAL_BYTES) {
+            uint32_t len;
+            const uint8_t* data = frame_read_bytes(r, &len);
+            if (data) memcpy(o, data, len);
+            o += data ? len : 0;
+            continue;
+        }
+        if (tag == WASMIFY_VAL_V128) {
+            const uint8_t* data = frame_take(r, 16);
+            if (!data) return -1;
+            memcpy(o, "0x", 2);
+            hex_encode(data, 16, o + 2);
+            o += 34;
+            continue;
+        }
+        
+        uint64_t slot;
+        uint8_t type;
+        switch (tag) {
+            case WASMIFY_VAL_I32: type = WASMIFY_TYPE_I32; slot = frame_read_le(r, 4); break;
+            case WASMIFY_VAL_I64: type = WASMIFY_TYPE_I64; slot = frame_read_le(r, 8); break;
+            case WASMIFY_VAL_F32: type = WASMIFY_TYPE_F32; slot = frame_read_le(r, 4); break;
+            case WASMIFY_VAL_F64: type = WASMIFY_TYPE_F64; slot = frame_read_le(r, 8); break;
+            default: return -1;
+        }
+        if (r->failed) return -1;
+        o += format_value(o, 32, type, slot);
+    }
+    if (r->failed) return -1;
+    *o = '\0';
+    return (long)(o - out);
+}
+
+// Parse an execute response frame
+static wasmify_error_t parse_execute_frame(wasmify_response_t* response, wasmify_arena_t* arena, wasmify_result_t* result) {
+    result_init(result);
+    
+    frame_reply_t reply;
+    if (frame_scan_reply(response, &reply) != WASMIFY_SUCCESS) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    result->success = reply.success;
+    result->execution_time = reply.execution_time;
+    result->memory_used = (size_t)reply.memory_used;
+    if (reply.error_len > 0) {
+        result->error = result_alloc(arena, reply.error_len + 1);
+        if (!result->error) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        memcpy(result->error, reply.error, reply.error_len);
+        result->error[reply.error_len] = '\0';
+    }
+    if (reply.count > 0) {
+        size_t cap = FRAME_TEXT_RATIO * response->size + 1;
+        result->result = result_alloc(arena, cap);
+        if (!result->result) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        long len = frame_write_values(&reply, result->result);
+        if (len < 0) {
+            if (!arena) free(result->result);
+            result->result = NULL;
+            return WASMIFY_ERROR_PARSE;
+        }
+        if (arena) arena_trim(arena, result->result, (size_t)len + 1);
+    }
+    return result->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+static int response_is_frame(CURL* curl);
+
+// Allocate the values of a typed result with extra bytes for their payloads
+static uint8_t* values_alloc(wasmify_call_result_t* result, size_t count, size_t extra) {
+    result->values = malloc(count * sizeof(wasmify_value_t) + extra + 1);
+    if (!result->values) {
+        return NULL;
+    }
+    result->values_count = count;
+    return (uint8_t*)(result->values + count);
+}
+
+// Decode the values of a reply frame into a typed result
+static wasmify_error_t frame_read_values(frame_reply_t* reply, size_t frame_size, wasmify_call_result_t* result) {
+    frame_reader_t* r = &reply->values;
+    if (reply->count > (size_t)(r->end - r->p) / FRAME_MIN_VALUE_SIZE) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    if (reply->count == 0) {
+        return WASMIFY_SUCCESS;
+    }
+    uint8_t* payload = values_alloc(result, reply->count, frame_size);
+    if (!payload) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    for (uint32_t i = 0; i < reply->count; i++) {
+        wasmify_value_t* value = &result->values[i];
+        value->kind = (wasmify_valkind_t)frame_read_le(r, 1);
+        uint64_t bits;
+        switch (value->kind) {
+            case WASMIFY_VAL_I32:
+                value->of.i32 = (int32_t)(uint32_t)frame_read_le(r, 4);
+                break;
+            case WASMIFY_VAL_I64:
+                value->of.i64 = (int64_t)frame_read_le(r, 8);
+                break;
+            case WASMIFY_VAL_F32: {
+                uint32_t bits32 = (uint32_t)frame_read_le(r, 4);
+                memcpy(&value->of.f32, &bits32, sizeof(bits32));
+                break;
+            }
+            case WASMIFY_VAL_F64:
+                bits = frame_read_le(r, 8);
+                memcpy(&value->of.f64, &bits, sizeof(bits));
+                break;
+            case WASMIFY_VAL_V128: {
+                const uint8_t* data = frame_take(r, 16);
+                if (data) memcpy(value->of.v128, data, 16);
+                break;
+            }
+            case WASMIFY_VAL_BYTES: {
+                uint32_t len;
+                const uint8_t* data = frame_read_bytes(r, &len);
+                if (!data) break;
+                memcpy(payload, data, len);
+                payload[len] = 0;
+                value->of.bytes.data = payload;
+                value->of.bytes.size = len;
+                payload += len + 1;
+                break;
+            }
+            default:
+                r->failed = 1;
+                break;
+        }
+        if (r->failed) {
+            return WASMIFY_ERROR_PARSE;
+        }
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Convert one scanned JSON value: integers to i32 or i64, other numbers to
+// f64, booleans to i32, strings to their bytes and anything else to its JSON
+// text. Payloads are copied to *payload, which advances.
+static void span_to_value(json_span_t* v, wasmify_value_t* value, uint8_t** payload) {
+    if (v->kind == 'n') {
+        char digits[64];
+        size_t len = v->len < sizeof(digits) ? v->len : sizeof(digits) - 1;
+        memcpy(digits, v->start, len);
+        digits[len] = '\0';
+        char* end = NULL;
+        errno = 0;
+        long long i = strtoll(digits, &end, 10);
+        if (*end == '\0' && errno == 0) {
+            if (i >= INT32_MIN && i <= INT32_MAX) {
+                value->kind = WASMIFY_VAL_I32;
+                value->of.i32 = (int32_t)i;
+            } else {
+                value->kind = WASMIFY_VAL_I64;
+                value->of.i64 = i;
+            }
+        } else {
+            value->kind = WASMIFY_VAL_F64;
+            value->of.f64 = strtod(digits, NULL);
+        }
+        return;
+    }
+    if (v->kind == 't' || v->kind == 'f') {
+        value->kind = WASMIFY_VAL_I32;
+        value->of.i32 = v->kind == 't';
+        return;
+    }
+    
+    size_t len = 0;
+    if (v->kind == '"') len = json_unescape(v->start, v->len, (char*)*payload);
+    else if (v->kind != 'z') memcpy(*payload, v->start, len = v->len);
+    (*payload)[len] = 0;
+    value->kind = WASMIFY_VAL_BYTES;
+    value->of.bytes.data = *payload;
+    value->of.bytes.size = len;
+    *payload += len + 1;
+}
+
+// Decode the result of a JSON reply into values; arrays give one value per element
+static wasmify_error_t json_read_values(result_spans_t* spans, wasmify_call_result_t* result) {
+    if (!spans->has_result) {
+        return WASMIFY_SUCCESS;
+    }
+    json_span_t* v = &spans->result;
+    if (v->kind != '[') {
+        uint8_t* payload = values_alloc(result, 1, v->len + 1);
+        if (!payload) return WASMIFY_ERROR_MEMORY;
+        span_to_value(v, &result->values[0], &payload);
+        return WASMIFY_SUCCESS;
+    }
+    
+    // Count the elements first, then convert them into one allocation
+    size_t count = 0;
+    json_span_t element;
+    int first = 1, more;
+    json_scan_t s = { v->start + 1, v->start + v->len };
+    while ((more = scan_element(&s, &first)) > 0 && scan_value(&s, &element)) count++;
+    if (more != 0) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    if (count == 0) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    uint8_t* payload = values_alloc(result, count, v->len + count);
+    if (!payload) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    s.p = v->start + 1;
+    first = 1;
+    for (size_t i = 0; i < count && scan_element(&s, &first) > 0 && scan_value(&s, &element); i++) {
+        span_to_value(&element, &result->values[i], &payload);
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Parse an execute response into a typed result
+static wasmify_error_t parse_execute_values(int frame, wasmify_response_t* response, wasmify_call_result_t* result) {
+    if (frame) {
+        frame_reply_t reply;
+        if (frame_scan_reply(response, &reply) != WASMIFY_SUCCESS) {
+            return WASMIFY_ERROR_PARSE;
+        }
+        result->success = reply.success;
+        result->execution_time = reply.execution_time;
+        result->memory_used = (size_t)reply.memory_used;
+        if (reply.error_len > 0) {
+            result->error = malloc(reply.error_len + 1);
+            if (!result->error) {
+                return WASMIFY_ERROR_MEMORY;
+            }
+            memcpy(result->error, reply.error, reply.error_len);
+            result->error[reply.error_len] = '\0';
+        }
+        wasmify_error_t error = frame_read_values(&reply, response->size, result);
+        if (error != WASMIFY_SUCCESS) {
+            return error;
+        }
+        return result->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+    }
+    
+    result_spans_t spans;
+    int has_api_error;
+    json_span_t api_error;
+    wasmify_error_t error = scan_execute_response(response, &spans, &has_api_error, &api_error);
+    if (error == WASMIFY_ERROR_EXECUTION) {
+        result->error = has_api_error ? span_dup(&api_error) : strdup("execution failed");
+        return error;
+    }
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    result->success = spans.success;
+    result->execution_time = spans.execution_time;
+    result->memory_used = (size_t)spans.memory_used;
+    if (spans.has_error) result->error = span_dup(&spans.error);
+    error = json_read_values(&spans, result);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    return result->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+static void call_result_init(wasmify_call_result_t* result) {
+    result->success = 0;
+    result->values = NULL;
+    result->values_count = 0;
+    result->execution_time = 0;
+    result->memory_used = 0;
+    result->error = NULL;
+    memset(&result->timing, 0, sizeof(result->timing));
+    result->memory_peak_pages = 0;
+}
+
+// Whether the server answered a request with a binary frame
+static int response_is_frame(CURL* curl) {
+    char* type = NULL;
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &type);
+    return type && strncasecmp(type, FRAME_CONTENT_TYPE, sizeof(FRAME_CONTENT_TYPE) - 1) == 0;
+}
+
+// Parse an execute response in whichever format the server chose
+static wasmify_error_t parse_execute_reply(
+    int frame,
+    wasmify_response_t* response,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+) {
+    return frame
+        ? parse_execute_frame(response, arena, result)
+        : parse_execute_response(response, arena, result);
+}
+
+// Results of pure functions, spread over shards that each take reads
+// under a shared lock. Each shard holds its share of the budget and evicts
+// in insertion order, giving entries read since they were last passed over
+// a second chance.
+#define RESULT_CACHE_SHARDS 16
+#define RESULT_CACHE_BUCKETS 256    // Per shard
+
+typedef struct cached_result {
+    struct cached_result* next;     // In its bucket
+    struct cached_result* older;    // In insertion order
+    struct cached_result* newer;
+    uint64_t hash;
+    double expires_at;              // Monotonic ms, 0 = never
+    int referenced;                 // Read since eviction last passed it
+    int success;
+    double execution_time;
+    size_t memory_used;
+    size_t size;                    // Charged against the budget
+    size_t key_len;
+    const char* result;             // In data, after the key; NULL if absent
+    const char* error;
+    char data[];
+} cached_result_t;
+
+typedef struct {
+    pthread_rwlock_t lock;
+    cached_result_t* buckets[RESULT_CACHE_BUCKETS];
+    cached_result_t* oldest;
+    cached_result_t* newest;
+    size_t bytes;
+    size_t entries;
+} __attribute__((aligned(64))) result_shard_t;
+
+// A function declared pure, or with no name a whole module
+typedef struct pure_function {
+    struct pure_function* next;
+    const char* function_name;      // In key, after the module ID
+    char key[];
+} pure_function_t;
+
+struct result_cache {
+    result_shard_t shards[RESULT_CACHE_SHARDS];
+    size_t shard_budget;
+    double ttl_ms;
+    pthread_rwlock_t pure_lock;
+    pure_function_t* pure[ROUTE_BUCKETS];
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+static result_cache_t* result_cache_create(size_t budget, int ttl) {
+    result_cache_t* cache = aligned_alloc(64, sizeof(result_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(*cache));
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        pthread_rwlock_init(&cache->shards[i].lock, NULL);
+    }
+    pthread_rwlock_init(&cache->pure_lock, NULL);
+    cache->shard_budget = budget / RESULT_CACHE_SHARDS;
+    cache->ttl_ms = ttl > 0 ? ttl * 1000.0 : 0;
+    return cache;
+}
+
+static void result_shard_clear(result_shard_t* shard) {
+    cached_result_t* entry = shard->oldest;
+    while (entry) {
+        cached_result_t* newer = entry->newer;
+        free(entry);
+        entry = newer;
+    }
+    memset(shard->buckets, 0, sizeof(shard->buckets));
+    shard->oldest = shard->newest = NULL;
+    shard->bytes = 0;
+    shard->entries = 0;
+}
+
+static void result_cache_destroy(result_cache_t* cache) {
+    if (!cache) return;
+    
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        result_shard_clear(&cache->shards[i]);
+        pthread_rwlock_destroy(&cache->shards[i].lock);
+    }
+    for (int i = 0; i < ROUTE_BUCKETS; i++) {
+        while (cache->pure[i]) {
+            pure_function_t* next = cache->pure[i]->next;
+            free(cache->pure[i]);
+            cache->pure[i] = next;
+        }
+    }
+    pthread_rwlock_destroy(&cache->pure_lock);
+    free(cache);
+}
+
+// Whether a function, or its whole module, was declared pure
+static int result_cache_is_pure(result_cache_t* cache, const char* module_id, const char* function_name) {
+    int pure = 0;
+    pthread_rwlock_rdlock(&cache->pure_lock);
+    for (pure_function_t* fn = cache->pure[route_hash(module_id)]; fn && !pure; fn = fn->next) {
+        pure = strcmp(fn->key, module_id) == 0 &&
+            (!fn->function_name || strcmp(fn->function_name, function_name) == 0);
+    }
+    pthread_rwlock_unlock(&cache->pure_lock);
+    return pure;
+}
+
+// Key of a call: module ID and function name, then the arguments as they
+// go into a frame, so that numbers are compared by value
+static int result_key(json_buf_t* key, const char* module_id, const char* function_name, char** args, int args_count) {
+    json_reset(key);
+    json_raw(key, module_id, strlen(module_id) + 1);
+    json_raw(key, function_name, strlen(function_name) + 1);
+    for (int i = 0; i < args_count; i++) {
+        frame_arg(key, args[i]);
+    }
+    return !key->failed;
+}
+
+static uint64_t key_hash(const json_buf_t* key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key->size; i++) {
+        hash = (hash ^ (uint8_t)key->data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static result_shard_t* key_shard(result_cache_t* cache, uint64_t hash) {
+    return &cache->shards[hash % RESULT_CACHE_SHARDS];
+}
+
+static cached_result_t** key_bucket(result_shard_t* shard, uint64_t hash) {
+    return &shard->buckets[(hash / RESULT_CACHE_SHARDS) % RESULT_CACHE_BUCKETS];
+}
+
+// Answer a call from the cache; returns whether it was there
+static int result_cache_lookup(
+    result_cache_t* cache,
+    const json_buf_t* key,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+) {
+    uint64_t hash = key_hash(key);
+    result_shard_t* shard = key_shard(cache, hash);
+    double now = monotonic_ms();
+    int found = 0;
+    
+    pthread_rwlock_rdlock(&shard->lock);
+    for (cached_result_t* entry = *key_bucket(shard, hash); entry; entry = entry->next) {
+        if (entry->hash != hash || entry->key_len != key->size || memcmp(entry->data, key->data, key->size) != 0) {
+            continue;
+        }
+        if (entry->expires_at && now >= entry->expires_at) break;
+        
+        result->success = entry->success;
+        result->execution_time = entry->execution_time;
+        result->memory_used = entry->memory_used;
+        result->result = entry->result ? result_strdup(arena, entry->result) : NULL;
+        result->error = entry->error ? result_strdup(arena, entry->error) : NULL;
+        if ((entry->result && !result->result) || (entry->error && !result->error)) {
+            if (!arena) {
+                free(result->result);
+                free(result->error);
+            }
+            result_init(result);
+            break;
+        }
+        __atomic_store_n(&entry->referenced, 1, __ATOMIC_RELAXED);
+        found = 1;
+        break;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    
+    __atomic_add_fetch(found ? &cache->hits : &cache->misses, 1, __ATOMIC_RELAXED);
+    return found;
+}
+
+// Take an entry out of its shard; called with the shard's write lock held
+static void result_shard_unlink(result_shard_t* shard, cached_result_t* entry) {
+    cached_result_t** link = key_bucket(shard, entry->hash);
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    
+    if (entry->older) entry->older->newer = entry->newer;
+    else shard->oldest = entry->newer;
+    if (entry->newer) entry->newer->older = entry->older;
+    else shard->newest = entry->older;
+    
+    shard->bytes -= entry->size;
+    shard->entries--;
+}
+
+static void result_shard_push(result_shard_t* shard, cached_result_t* entry) {
+    cached_result_t** bucket = key_bucket(shard, entry->hash);
+    entry->next = *bucket;
+    *bucket = entry;
+    entry->older = shard->newest;
+    entry->newer = NULL;
+    if (shard->newest) shard->newest->newer = entry;
+    else shard->oldest = entry;
+    shard->newest = entry;
+    shard->bytes += entry->size;
+    shard->entries++;
+}
+
+// Keep a successful result for max_age seconds, or the configured TTL when
+// the server didn't say
+static void result_cache_store(
+    result_cache_t* cache,
+    const json_buf_t* key,
+    const wasmify_result_t* result,
+    long max_age
+) {
+    size_t result_len = result->result ? strlen(result->result) + 1 : 0;
+    size_t error_len = result->error ? strlen(result->error) + 1 : 0;
+    size_t size = sizeof(cached_result_t) + key->size + result_len + error_len;
+    if (size > cache->shard_budget) {
+        return;
+    }
+    
+    cached_result_t* entry = malloc(size);
+    if (!entry) {
+        return;
+    }
+    entry->hash = key_hash(key);
+    double ttl_ms = max_age > 0 ? max_age * 1000.0 : cache->ttl_ms;
+    entry->expires_at = ttl_ms > 0 ? monotonic_ms() + ttl_ms : 0;
+    entry->referenced = 0;
+    entry->success = result->success;
+    entry->execution_time = result->execution_time;
+    entry->memory_used = result->memory_used;
+    entry->size = size;
+    entry->key_len = key->size;
+    memcpy(entry->data, key->data, key->size);
+    char* text = entry->data + key->size;
+    entry->result = result->result ? memcpy(text, result->result, result_len) : NULL;
+    entry->error = result->error ? memcpy(text + result_len, result->error, error_len) : NULL;
+    
+    result_shard_t* shard = key_shard(cache, entry->hash);
+    cached_result_t* victims = NULL;
+    pthread_rwlock_wrlock(&shard->lock);
+    for (cached_result_t* old = *key_bucket(shard, entry->hash); old; old = old->next) {
+        if (old->hash == entry->hash && old->key_len == key->size && memcmp(old->data, key->data, key->size) == 0) {
+            result_shard_unlink(shard, old);
+            old->next = victims;
+            victims = old;
+            break;
+        }
+    }
+    result_shard_push(shard, entry);
+    
+    // Evict the oldest entries not read since they were last passed over
+    double now = monotonic_ms();
+    size_t passes = shard->entries;
+    while (shard->bytes > cache->shard_budget) {
+        cached_result_t* oldest = shard->oldest;
+        result_shard_unlink(shard, oldest);
+        int expired = oldest->expires_at && now >= oldest->expires_at;
+        if (oldest == entry || (oldest->referenced && !expired && passes > 0)) {
+            if (oldest != entry) passes--;
+            oldest->referenced = 0;
+            result_shard_push(shard, oldest);
+            continue;
+        }
+        oldest->next = victims;
+        victims = oldest;
+        __atomic_add_fetch(&cache->evictions, 1, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    
+    while (victims) {
+        cached_result_t* next = victims->next;
+        free(victims);
+        victims = next;
+    }
+}
+
+// Declare a function pure
+wasmify_error_t wasmify_declare_pure(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name
+) {
+    if (!client || !module_id) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    result_cache_t* cache = client->pool->results;
+    if (!cache) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    size_t module_len = strlen(module_id) + 1;
+    size_t function_len = function_name ? strlen(function_name) + 1 : 0;
+    pure_function_t* fn = malloc(sizeof(pure_function_t) + module_len + function_len);
+    if (!fn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    memcpy(fn->key, module_id, module_len);
+    fn->function_name = function_name ? memcpy(fn->key + module_len, function_name, function_len) : NULL;
+    
+    pthread_rwlock_wrlock(&cache->pure_lock);
+    pure_function_t** bucket = &cache->pure[route_hash(module_id)];
+    pure_function_t* held = *bucket;
+    while (held && (strcmp(held->key, module_id) != 0 || !held->function_name != !function_name ||
+                    (function_name && strcmp(held->function_name, function_name) != 0))) {
+        held = held->next;
+    }
+    if (!held) {
+        fn->next = *bucket;
+        *bucket = fn;
+    }
+    pthread_rwlock_unlock(&cache->pure_lock);
+    // Declaring a function again changes nothing
+    if (held) free(fn);
+    return WASMIFY_SUCCESS;
+}
+
+// Drop every cached result
+void wasmify_result_cache_clear(wasmify_client_t* client) {
+    result_cache_t* cache = client ? client->pool->results : NULL;
+    for (int i = 0; cache && i < RESULT_CACHE_SHARDS; i++) {
+        result_shard_t* shard = &cache->shards[i];
+        pthread_rwlock_wrlock(&shard->lock);
+        result_shard_clear(shard);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+
+// Read the result cache counters
+void wasmify_result_cache_stats(wasmify_client_t* client, wasmify_result_cache_stats_t* stats) {
+    if (!stats) return;
+    
+    memset(stats, 0, sizeof(*stats));
+    result_cache_t* cache = client ? client->pool->results : NULL;
+    if (!cache) return;
+    
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        result_shard_t* shard = &cache->shards[i];
+        pthread_rwlock_rdlock(&shard->lock);
+        stats->entries += shard->entries;
+        stats->bytes += shard->bytes;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    stats->budget = cache->shard_budget * RESULT_CACHE_SHARDS;
+    stats->hits = __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cache->misses, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&cache->evictions, __ATOMIC_RELAXED);
+}
+
+// Run an execute request with string arguments, from a prepared prefix or
+// from the module and function names
+static wasmify_error_t execute_text(
+    wasmify_client_t* client,
+    const json_buf_t* prefix,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+) {
+    double started = monotonic_ms();
+    result_init(result);
+    if (args_count < 0 || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    // Only successful results are cached
+    result_cache_t* cache = client->pool->results;
+    int keyed = cache && result_key(&conn->cache_key, module_id, function_name, args, args_count);
+    if (keyed && result_cache_lookup(cache, &conn->cache_key, arena, result)) {
+        release_connection(client, conn);
+        result->timing.total = monotonic_ms() - started;
+        OBSERVE(.kind = WASMIFY_EVENT_CACHE_HIT, .client = client, .module_id = module_id,
+                .function_name = function_name, .cache = "result");
+        return WASMIFY_SUCCESS;
+    }
+    if (keyed) {
+        OBSERVE(.kind = WASMIFY_EVENT_CACHE_MISS, .client = client, .module_id = module_id,
+                .function_name = function_name, .cache = "result");
+    }
+    
+    execute_begin(client, conn, prefix, module_id, function_name);
+    if (!execute_finish_args(client, conn, args, args_count)) {
+        release_connection(client, conn);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    reply_meta_t reply;
+    wasmify_error_t error = execute_routed(client, conn, module_id, &conn->response, &reply);
+    if (error == WASMIFY_SUCCESS) {
+        error = parse_execute_reply(reply.frame, &conn->response, arena, result);
+        reply_timing(&reply, started, result->execution_time, &result->timing);
+    }
+    if (error == WASMIFY_SUCCESS && result->success && keyed && reply.max_age != 0 &&
+        (reply.max_age > 0 || result_cache_is_pure(cache, module_id, function_name))) {
+        result_cache_store(cache, &conn->cache_key, result, reply.max_age);
+    }
+    
+    release_connection(client, conn);
+    return error;
+}
+
+// Execute a WebAssembly module function
+wasmify_error_t wasmify_execute_module(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+) {
+    if (!client || !module_id || !function_name || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_text(client, NULL, module_id, function_name, args, args_count, NULL, result);
+}
+
+wasmify_error_t wasmify_execute_module_arena(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+) {
+    if (!client || !module_id || !function_name || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_text(client, NULL, module_id, function_name, args, args_count, arena, result);
+}
+
+// Fill a view from the response frame in its buffer. The text form of the
+// values and the error are written behind the frame, in the same buffer.
+static wasmify_error_t view_from_frame(wasmify_result_view_t* view) {
+    wasmify_response_t* buffer = &view->buffer;
+    size_t frame_size = buffer->size;
+    if (!response_reserve(buffer, FRAME_TEXT_RATIO * frame_size + 1)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    frame_reply_t reply;
+    if (frame_scan_reply(buffer, &reply) != WASMIFY_SUCCESS) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    char* text = buffer->data + frame_size + 1;
+    long len = frame_write_values(&reply, text);
+    if (len < 0) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    if (reply.count > 0) {
+        view->result = text;
+        view->result_len = (size_t)len;
+    }
+    if (reply.error_len > 0) {
+        char* error = text + len + 1;
+        memcpy(error, reply.error, reply.error_len);
+        error[reply.error_len] = '\0';
+        view->error = error;
+        view->error_len = reply.error_len;
+    }
+    view->success = reply.success;
+    view->execution_time = reply.execution_time;
+    view->memory_used = (size_t)reply.memory_used;
+    return view->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+// Fill a view from the JSON response in its buffer, terminating its strings
+// where they lie
+static wasmify_error_t view_from_json(wasmify_result_view_t* view) {
+    result_spans_t spans;
+    int has_api_error;
+    json_span_t api_error;
+    wasmify_error_t error = scan_execute_response(&view->buffer, &spans, &has_api_error, &api_error);
+    if (error == WASMIFY_ERROR_EXECUTION && has_api_error) {
+        view->error = span_view(&api_error, &view->error_len);
+        return error;
+    }
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    view->success = spans.success;
+    view->execution_time = spans.execution_time;
+    view->memory_used = (size_t)spans.memory_used;
+    if (spans.has_result) view->result = span_view(&spans.result, &view->result_len);
+    if (spans.has_error) view->error = span_view(&spans.error, &view->error_len);
+    return view->success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+// Execute a WebAssembly module function without copying the result
+wasmify_error_t wasmify_execute_module_view(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_view_t* view
+) {
+    if (!client || !module_id || !function_name || !view || args_count < 0 || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    double started = monotonic_ms();
+    view->success = 0;
+    view->result = NULL;
+    view->result_len = 0;
+    view->execution_time = 0;
+    view->memory_used = 0;
+    view->error = NULL;
+    view->error_len = 0;
+    memset(&view->timing, 0, sizeof(view->timing));
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    execute_begin(client, conn, NULL, module_id, function_name);
+    if (!execute_finish_args(client, conn, args, args_count)) {
+        release_connection(client, conn);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    // The response lands directly in the view's own buffer
+    reply_meta_t reply;
+    wasmify_error_t error = execute_routed(client, conn, module_id, &view->buffer, &reply);
+    int frame = error == WASMIFY_SUCCESS && reply.frame;
+    release_connection(client, conn);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    error = frame ? view_from_frame(view) : view_from_json(view);
+    reply_timing(&reply, started, view->execution_time, &view->timing);
+    return error;
+}
+
+// Run an execute request with typed arguments, from a prepared prefix or
+// from the module and function names
+static wasmify_error_t execute_values(
+    wasmify_client_t* client,
+    const json_buf_t* prefix,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    double started = monotonic_ms();
+    call_result_init(result);
+    if (args_count > 0 && !args) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    execute_begin(client, conn, prefix, module_id, function_name);
+    wasmify_error_t error = execute_finish_values(client, conn, args, args_count);
+    if (error != WASMIFY_SUCCESS) {
+        release_connection(client, conn);
+        return error;
+    }
+    
+    reply_meta_t reply;
+    error = execute_routed(client, conn, module_id, &conn->response, &reply);
+    if (error == WASMIFY_SUCCESS) {
+        error = parse_execute_values(reply.frame, &conn->response, result);
+        reply_timing(&reply, started, result->execution_time, &result->timing);
+    }
+    
+    release_connection(client, conn);
+    return error;
+}
+
+// Execute a WebAssembly module function with typed values
+wasmify_error_t wasmify_execute_module_v(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    if (!client || !module_id || !function_name || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_values(client, NULL, module_id, function_name, args, args_count, result);
+}
+
+// Call of one function of one module with the request prefix pre-rendered
+struct wasmify_prepared_call {
+    wasmify_client_t* client;
+    char* module_id;            // For routing and result caching
+    char* function_name;
+    json_buf_t prefix;
+};
+
+// Prepare repeated calls of one module function
+wasmify_prepared_call_t* wasmify_prepare_call(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name
+) {
+    if (!client || !module_id || !function_name) {
+        return NULL;
+    }
+    
+    wasmify_prepared_call_t* prepared = calloc(1, sizeof(wasmify_prepared_call_t));
+    if (!prepared) {
+        return NULL;
+    }
+    prepared->client = client;
+    prepared->module_id = strdup(module_id);
+    prepared->function_name = strdup(function_name);
+    execute_prefix(client, &prepared->prefix, module_id, function_name);
+    if (!prepared->module_id || !prepared->function_name || prepared->prefix.failed) {
+        wasmify_prepared_call_free(prepared);
+        return NULL;
+    }
+    return prepared;
+}
+
+// Execute a prepared call with string arguments
+wasmify_error_t wasmify_prepared_execute(
+    wasmify_prepared_call_t* prepared,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+) {
+    if (!prepared || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_text(prepared->client, &prepared->prefix, prepared->module_id, prepared->function_name, args, args_count, NULL, result);
+}
+
+wasmify_error_t wasmify_prepared_execute_arena(
+    wasmify_prepared_call_t* prepared,
+    char** args,
+    int args_count,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+) {
+    if (!prepared || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_text(prepared->client, &prepared->prefix, prepared->module_id, prepared->function_name, args, args_count, arena, result);
+}
+
+// Execute a prepared call with typed arguments
+wasmify_error_t wasmify_prepared_execute_v(
+    wasmify_prepared_call_t* prepared,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    if (!prepared || !result) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return execute_values(prepared->client, &prepared->prefix, prepared->module_id, prepared->function_name, args, args_count, result);
+}
+
+// Free a prepared call
+void wasmify_prepared_call_free(wasmify_prepared_call_t* prepared) {
+    if (!prepared) return;
+    
+    free(prepared->module_id);
+    free(prepared->function_name);
+    free(prepared->prefix.data);
+    free(prepared);
+}
+
+// Release the values and error of a typed call result
+void wasmify_call_result_free(wasmify_call_result_t* result) {
+    if (!result) return;
+    
+    free(result->values);
+    free(result->error);
+    call_result_init(result);
+}
+
+// Release the buffer behind a result view
+void wasmify_result_view_free(wasmify_result_view_t* view) {
+    if (!view) return;
+    
+    free(view->buffer.data);
+    memset(view, 0, sizeof(*view));
+}
+
+// State of a batch response scan
+typedef struct {
+    wasmify_result_t* out;
+    size_t n;
+    size_t count;
+    wasmify_error_t first_error;
+    wasmify_arena_t* arena;
+} batch_scan_t;
+
+// data member handler for batch responses
+static wasmify_error_t scan_batch_data(json_scan_t* s, const json_span_t* key, void* ctx) {
+    batch_scan_t* batch = (batch_scan_t*)ctx;
+    json_span_t skipped;
+    if (!span_is(key, "results")) {
+        return scan_value(s, &skipped) ? WASMIFY_SUCCESS : WASMIFY_ERROR_PARSE;
+    }
+    if (!scan_char(s, '[')) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    
+    int first = 1, more;
+    while ((more = scan_element(s, &first)) > 0) {
+        if (batch->count == batch->n) return WASMIFY_ERROR_PARSE;
+        result_spans_t spans;
+        wasmify_error_t error = scan_result_object(s, &spans);
+        if (error != WASMIFY_SUCCESS) return error;
+        error = result_from_spans(&spans, batch->arena, &batch->out[batch->count++]);
+        if (batch->first_error == WASMIFY_SUCCESS) batch->first_error = error;
+    }
+    return more == 0 ? WASMIFY_SUCCESS : WASMIFY_ERROR_PARSE;
+}
+
+// Parse the response of a batch execute request
+static wasmify_error_t parse_batch_response(
+    wasmify_response_t* response,
+    wasmify_arena_t* arena,
+    wasmify_result_t* out,
+    size_t n
+) {
+    json_scan_t s = { response->data, response->data + response->size };
+    batch_scan_t batch = { out, n, 0, WASMIFY_SUCCESS, arena };
+    
+    int has_api_error;
+    json_span_t api_error;
+    wasmify_error_t error = scan_envelope(&s, scan_batch_data, &batch, &has_api_error, &api_error);
+    if (error == WASMIFY_SUCCESS && batch.count != n) {
+        error = WASMIFY_ERROR_PARSE;
+    }
+    return error != WASMIFY_SUCCESS ? error : batch.first_error;
+}
+
+// Execute many invocations of one function in a single request
+static wasmify_error_t execute_batch(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n,
+    wasmify_arena_t* arena,
+    wasmify_result_t* out
+) {
+    if (!client || !module_id || !function_name || (n > 0 && (!batches || !out))) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < n; i++) {
+        result_init(&out[i]);
+    }
+    if (n == 0) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    if (!build_batch_request(client, conn, module_id, function_name, batches, n)) {
+        release_connection(client, conn);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    wasmify_error_t error = execute_request(client, conn, client->pool->batch_url,
+                                            conn->body.data, conn->body.size, &conn->response);
+    if (error == WASMIFY_SUCCESS) {
+        error = parse_batch_response(&conn->response, arena, out, n);
+    }
+    
+    release_connection(client, conn);
+    return error;
+}
+
+wasmify_error_t wasmify_execute_batch(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n,
+    wasmify_result_t* out
+) {
+    return execute_batch(client, module_id, function_name, batches, n, NULL, out);
+}
+
+wasmify_error_t wasmify_execute_batch_arena(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n,
+    wasmify_arena_t* arena,
+    wasmify_result_t* out
+) {
+    return execute_batch(client, module_id, function_name, batches, n, arena, out);
+}
+
+// One asynchronous execution in flight, or waiting to be sent again
+typedef struct async_call {
+    connection_t* conn;
+    double started;
+    double sent_at;             // When its latest attempt went out
+    double retry_at;            // When it is due to be sent again, 0 while in flight
+    int attempts;               // Retries so far
+    wasmify_execute_callback_t callback;
+    void* user_data;
+    struct async_call* prev;
+    struct async_call* next;
+} async_call_t;
+
+// Event loop of a client's asynchronous calls. Sockets curl asks us to watch
+// are mirrored in fds for the built-in poll loop and forwarded to the
+// application's callbacks when it runs its own loop. Calls backing off stay
+// in calls, off the multi handle, and the one timer fires for whichever of
+// curl's timeout and the first retry comes first.
+struct wasmify_event_loop {
+    CURLM* multi;
+    async_call_t* calls;
+    struct pollfd* fds;
+    struct pollfd* ready;       // Entries of fds that polled ready, room for fds_cap
+    int nfds;
+    int fds_cap;
+    int timer_armed;
+    double timer_due;           // curl's timeout per monotonic_ms, while armed
+    int waiting;                // Calls backing off, which still count as running
+    int running;
+    wasmify_socket_callback_t socket_callback;
+    wasmify_timer_callback_t timer_callback;
+    void* callback_data;
+};
+
+static int loop_socket_callback(CURL* easy, curl_socket_t fd, int what, void* userp, void* socketp) {
+    (void)easy;
+    (void)socketp;
+    wasmify_event_loop_t* loop = (wasmify_event_loop_t*)userp;
+    
+    int slot = -1;
+    for (int i = 0; i < loop->nfds; i++) {
+        if (loop->fds[i].fd == fd) {
+            slot = i;
+            break;
+        }
+    }
+    
+    int events = 0;
+    if (what == CURL_POLL_REMOVE) {
+        if (slot >= 0) loop->fds[slot] = loop->fds[--loop->nfds];
+    } else {
+        if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) events |= WASMIFY_POLL_IN;
+        if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) events |= WASMIFY_POLL_OUT;
+        if (slot < 0) {
+            if (loop->nfds == loop->fds_cap) {
+                int cap = loop->fds_cap ? loop->fds_cap * 2 : 16;
+                struct pollfd* ready = realloc(loop->ready, (size_t)cap * sizeof(struct pollfd));
+                if (!ready) return -1;
+                loop->ready = ready;
+                struct pollfd* fds = realloc(loop->fds, (size_t)cap * sizeof(struct pollfd));
+                if (!fds) return -1;
+                loop->fds = fds;
+                loop->fds_cap = cap;
+            }
+            slot = loop->nfds++;
+            loop->fds[slot].fd = fd;
+        }
+        loop->fds[slot].events = (short)(((events & WASMIFY_POLL_IN) ? POLLIN : 0) |
+                                         ((events & WASMIFY_POLL_OUT) ? POLLOUT : 0));
+        loop->fds[slot].revents = 0;
+    }
+    
+    if (loop->socket_callback) {
+        loop->socket_callback(fd, what == CURL_POLL_REMOVE ? WASMIFY_POLL_REMOVE : events, loop->callback_data);
+    }
+    return 0;
+}
+
+// Milliseconds until the first call backing off is due to be sent again, -1
+// when none is waiting
+static double loop_retry_in(wasmify_event_loop_t* loop, double now) {
+    if (!loop->waiting) return -1;
+    
+    double due = -1;
+    for (async_call_t* call = loop->calls; call; call = call->next) {
+        if (call->retry_at > 0 && (due < 0 || call->retry_at < due)) due = call->retry_at;
+    }
+    return due < 0 ? -1 : due > now ? due - now : 0;
+}
+
+// Milliseconds until the loop next has to run: curl's timeout or the first
+// retry, whichever comes first, -1 for neither
+static double loop_next_in(wasmify_event_loop_t* loop, double now) {
+    double due = loop_retry_in(loop, now);
+    if (loop->timer_armed) {
+        double left = loop->timer_due > now ? loop->timer_due - now : 0;
+        if (due < 0 || left < due) due = left;
+    }
+    return due;
+}
+
+// Ask the application's loop to fire its timer when this loop next has to run
+static void loop_arm(wasmify_event_loop_t* loop) {
+    if (loop->timer_callback) {
+        double due = loop_next_in(loop, monotonic_ms());
+        loop->timer_callback(due < 0 ? -1 : (long)ceil(due), loop->callback_data);
+    }
+}
+
+static int loop_timer_callback(CURLM* multi, long timeout_ms, void* userp) {
+    (void)multi;
+    wasmify_event_loop_t* loop = (wasmify_event_loop_t*)userp;
+    
+    loop->timer_armed = timeout_ms >= 0;
+    if (loop->timer_armed) {
+        loop->timer_due = monotonic_ms() + (double)timeout_ms;
+    }
+    loop_arm(loop);
+    return 0;
+}
+
+static void async_call_free(wasmify_client_t* client, async_call_t* call) {
+    if (call->conn) {
+        release_connection(client, call->conn);
+    }
+    free(call);
+}
+
+static void loop_unlink(wasmify_event_loop_t* loop, async_call_t* call) {
+    if (call->prev) call->prev->next = call->next;
+    else loop->calls = call->next;
+    if (call->next) call->next->prev = call->prev;
+    loop->running--;
+}
+
+// Schedule a call's next attempt after its backoff, at least wait_ms from
+// now, unless it has used up its retries or that would be too long
+static int loop_backoff(wasmify_client_t* client, async_call_t* call, double wait_ms) {
+    if (call->attempts >= client->config.retries) return 0;
+    double delay = retry_delay(client, call->attempts, wait_ms);
+    if (delay < 0) return 0;
+    
+    call->attempts++;
+    call->retry_at = monotonic_ms() + delay;
+    client->loop->waiting++;
+    return 1;
+}
+
+// Hand a call's request to the multi handle. While the circuit of the
+// execute endpoint is open the call backs off instead if it may still be
+// retried, and fails with WASMIFY_ERROR_UNAVAILABLE if not.
+static wasmify_error_t async_send(wasmify_client_t* client, async_call_t* call, const char* module_id) {
+    wasmify_connection_pool_t* pool = client->pool;
+    double now = monotonic_ms();
+    if (pool->execute_endpoint >= 0) {
+        uint64_t mask = 1ULL << pool->execute_endpoint;
+        if (endpoint_pick(pool, mask, 0, 0, now) < 0) {
+            return loop_backoff(client, call, endpoint_reopen_in(pool, mask, now))
+                ? WASMIFY_SUCCESS : WASMIFY_ERROR_UNAVAILABLE;
+        }
+    }
+    
+    if (!response_reset(&call->conn->response)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    if (curl_multi_add_handle(client->loop->multi, call->conn->curl) != CURLM_OK) {
+        return WASMIFY_ERROR_NETWORK;
+    }
+    call->sent_at = now;
+    OBSERVE(.kind = WASMIFY_EVENT_REQUEST_START, .client = client, .url = pool->execute_url,
+            .traceparent = conn_traceparent(call->conn), .module_id = module_id);
+    return WASMIFY_SUCCESS;
+}
+
+// Deliver finished calls to their callbacks, or back off those that may go
+// through when sent again
+static void loop_dispatch(wasmify_client_t* client) {
+    wasmify_event_loop_t* loop = client->loop;
+    wasmify_connection_pool_t* pool = client->pool;
+    int left;
+    CURLMsg* msg;
+    while ((msg = curl_multi_info_read(loop->multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        
+        async_call_t* call = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&call);
+        CURLcode res = msg->data.result;
+        long response_code = 0;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+        curl_multi_remove_handle(loop->multi, msg->easy_handle);
+        
+        double finished = monotonic_ms();
+        wasmify_error_t error = request_error(res, response_code);
+        OBSERVE(.kind = WASMIFY_EVENT_REQUEST_END, .client = client, .url = pool->execute_url,
+                .traceparent = conn_traceparent(call->conn), .status = response_code,
+                .error = error, .duration_ms = finished - call->sent_at);
+        if (pool->execute_endpoint >= 0) {
+            int failed = res != CURLE_OK || response_code >= 500;
+            endpoint_record(&pool->endpoints[pool->execute_endpoint], finished - call->sent_at,
+                            failed ? REQUEST_FAILED : REQUEST_ANSWERED, finished);
+        }
+        if (error != WASMIFY_SUCCESS && request_retryable(res, response_code) &&
+            loop_backoff(client, call, res == CURLE_OK ? response_retry_after(call->conn->curl) : -1)) {
+            continue;
+        }
+        loop_unlink(loop, call);
+        
+        wasmify_result_t result;
+        int parsed = error == WASMIFY_SUCCESS;
+        if (parsed) {
+            reply_meta_t reply;
+            reply_measure(call->conn->curl, call->started, &reply);
+            error = parse_execute_reply(response_is_frame(call->conn->curl), &call->conn->response, NULL, &result);
+            reply_timing(&reply, call->started, result.execution_time, &result.timing);
+        }
+        wasmify_execute_callback_t callback = call->callback;
+        void* user_data = call->user_data;
+        async_call_free(client, call);
+        callback(error, parsed ? &result : NULL, user_data);
+    }
+}
+
+// Send again the calls whose backoff is over
+static void loop_resume(wasmify_client_t* client) {
+    wasmify_event_loop_t* loop = client->loop;
+    if (!loop->waiting) return;
+    
+    double now = monotonic_ms();
+    async_call_t* next;
+    for (async_call_t* call = loop->calls; call; call = next) {
+        next = call->next;
+        if (call->retry_at == 0 || call->retry_at > now) continue;
+        call->retry_at = 0;
+        loop->waiting--;
+        OBSERVE(.kind = WASMIFY_EVENT_RETRY, .client = client, .url = client->pool->execute_url);
+        
+        wasmify_error_t error = async_send(client, call, NULL);
+        if (error != WASMIFY_SUCCESS) {
+            loop_unlink(loop, call);
+            wasmify_execute_callback_t callback = call->callback;
+            void* user_data = call->user_data;
+            async_call_free(client, call);
+            callback(error, NULL, user_data);
+        }
+    }
+}
+
+static wasmify_event_loop_t* loop_get(wasmify_client_t* client) {
+    if (client->loop) {
+        return client->loop;
+    }
+    
+    wasmify_event_loop_t* loop = calloc(1, sizeof(wasmify_event_loop_t));
+    if (!loop) {
+        return NULL;
+    }
+    loop->multi = curl_multi_init();
+    if (!loop->multi) {
+        free(loop);
+        return NULL;
+    }
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETFUNCTION, loop_socket_callback);
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETDATA, loop);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERFUNCTION, loop_timer_callback);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERDATA, loop);
+    if (client->config.http2) {
+        curl_multi_setopt(loop->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(loop->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)client->config.max_connections);
+    }
+    
+    client->loop = loop;
+    return loop;
+}
+
+// Cancel every call in flight and free the event loop
+static void loop_destroy(wasmify_client_t* client) {
+    wasmify_event_loop_t* loop = client->loop;
+    if (!loop) return;
+    
+    while (loop->calls) {
+        async_call_t* call = loop->calls;
+        if (!call->retry_at) curl_multi_remove_handle(loop->multi, call->conn->curl);
+        loop_unlink(loop, call);
+        wasmify_execute_callback_t callback = call->callback;
+        void* user_data = call->user_data;
+        async_call_free(client, call);
+        callback(WASMIFY_ERROR_NETWORK, NULL, user_data);
+    }
+    
+    curl_multi_cleanup(loop->multi);
+    free(loop->fds);
+    free(loop->ready);
+    free(loop);
+    client->loop = NULL;
+}
+
+// Start executing a WebAssembly module function asynchronously
+wasmify_error_t wasmify_execute_module_async(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_execute_callback_t callback,
+    void* user_data
+) {
+    if (!client || !module_id || !function_name || !callback || args_count < 0 || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_event_loop_t* loop = loop_get(client);
+    async_call_t* call = calloc(1, sizeof(async_call_t));
+    if (!loop || !call) {
+        free(call);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    call->started = monotonic_ms();
+    call->callback = callback;
+    call->user_data = user_data;
+    call->conn = acquire_connection(client);
+    if (call->conn) {
+        execute_begin(client, call->conn, NULL, module_id, function_name);
+    }
+    if (!call->conn || !response_reset(&call->conn->response) ||
+        !execute_finish_args(client, call->conn, args, args_count)) {
+        async_call_free(client, call);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    CURL* curl = call->conn->curl;
+    wasmify_connection_pool_t* pool = client->pool;
+    curl_easy_setopt(curl, CURLOPT_URL, pool->execute_url);
+    if (set_request_body(client, call->conn, call->conn->body.data, call->conn->body.size) < 0) {
+        async_call_free(client, call);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &call->conn->response);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &call->conn->response);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*)call);
+    
+    wasmify_error_t error = async_send(client, call, module_id);
+    if (error != WASMIFY_SUCCESS) {
+        async_call_free(client, call);
+        return error;
+    }
+    call->next = loop->calls;
+    if (loop->calls) loop->calls->prev = call;
+    loop->calls = call;
+    loop->running++;
+    
+    // A call that starts out backing off needs the timer for its retry
+    if (call->retry_at) loop_arm(loop);
+    return WASMIFY_SUCCESS;
+}
+
+// Route the application's event loop callbacks for this client
+wasmify_error_t wasmify_client_set_event_callbacks(
+    wasmify_client_t* client,
+    wasmify_socket_callback_t socket_callback,
+    wasmify_timer_callback_t timer_callback,
+    void* user_data
+) {
+    if (!client) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_event_loop_t* loop = loop_get(client);
+    if (!loop) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    loop->socket_callback = socket_callback;
+    loop->timer_callback = timer_callback;
+    loop->callback_data = user_data;
+    
+    return WASMIFY_SUCCESS;
+}
+
+// Report socket readiness or a timer expiry from the application's event loop
+wasmify_error_t wasmify_client_socket_action(wasmify_client_t* client, curl_socket_t fd, int events) {
+    if (!client) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_event_loop_t* loop = loop_get(client);
+    if (!loop) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    int mask = 0;
+    if (events & WASMIFY_POLL_IN) mask |= CURL_CSELECT_IN;
+    if (events & WASMIFY_POLL_OUT) mask |= CURL_CSELECT_OUT;
+    if (events & WASMIFY_POLL_ERROR) mask |= CURL_CSELECT_ERR;
+    
+    // The timer may have fired for a retry before curl's own timeout
+    int timer = fd == WASMIFY_SOCKET_TIMEOUT;
+    if (timer && loop->timer_armed && monotonic_ms() >= loop->timer_due) loop->timer_armed = 0;
+    
+    int running;
+    CURLMcode mc = curl_multi_socket_action(loop->multi, fd, mask, &running);
+    loop_dispatch(client);
+    loop_resume(client);
+    if (timer || loop->waiting) loop_arm(loop);
+    
+    return mc == CURLM_OK ? WASMIFY_SUCCESS : WASMIFY_ERROR_NETWORK;
+}
+
+// Wait for activity on asynchronous calls and deliver completions
+wasmify_error_t wasmify_client_poll(wasmify_client_t* client, int timeout_ms, int* running) {
+    if (!client) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_event_loop_t* loop = client->loop;
+    if (!loop || loop->running == 0) {
+        if (running) *running = 0;
+        return WASMIFY_SUCCESS;
+    }
+    
+    // Sleep no longer than curl's own timer or the first retry
+    int wait_ms = timeout_ms;
+    double next = loop_next_in(loop, monotonic_ms());
+    if (next >= 0) {
+        int timer_ms = (int)ceil(next);
+        if (wait_ms < 0 || timer_ms < wait_ms) wait_ms = timer_ms;
+    }
+    
+    int ready = poll(loop->fds, (nfds_t)loop->nfds, wait_ms);
+    if (ready < 0 && errno != EINTR) {
+        return WASMIFY_ERROR_NETWORK;
+    }
+    
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    if (ready > 0) {
+        // Socket callbacks may rewrite fds while we walk it, and growing it
+        // gives the loop a new ready buffer rather than moving this one
+        struct pollfd* ready_fds = loop->ready;
+        loop->ready = NULL;
+        int n = 0;
+        for (int i = 0; i < loop->nfds; i++) {
+            if (loop->fds[i].revents) ready_fds[n++] = loop->fds[i];
+        }
+        for (int i = 0; i < n && error == WASMIFY_SUCCESS; i++) {
+            int events = 0;
+            if (ready_fds[i].revents & POLLIN) events |= WASMIFY_POLL_IN;
+            if (ready_fds[i].revents & POLLOUT) events |= WASMIFY_POLL_OUT;
+            if (ready_fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) events |= WASMIFY_POLL_ERROR;
+            error = wasmify_client_socket_action(client, ready_fds[i].fd, events);
+        }
+        if (loop->ready) free(ready_fds);
+        else loop->ready = ready_fds;
+    }
+    if (error == WASMIFY_SUCCESS && loop_next_in(loop, monotonic_ms()) == 0) {
+        error = wasmify_client_socket_action(client, WASMIFY_SOCKET_TIMEOUT, 0);
+    }
+    
+    if (running) *running = loop->running;
+    return error;
+}
+
+// Run the event loop until every asynchronous call has completed
+wasmify_error_t wasmify_client_run(wasmify_client_t* client) {
+    if (!client) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    int running = 1;
+    while (running > 0) {
+        wasmify_error_t error = wasmify_client_poll(client, 1000, &running);
+        if (error != WASMIFY_SUCCESS) {
+            return error;
+        }
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Read a whole file into a heap buffer
+static wasmify_error_t read_file(const char* file_path, uint8_t** data, size_t* size) {
+    FILE* f = fopen(file_path, "rb");
+    if (!f) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    uint8_t* buf = NULL;
+    size_t len = 0, cap = 0;
+    for (;;) {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 64 * 1024;
+            uint8_t* p = realloc(buf, cap);
+            if (!p) {
+                free(buf);
+                fclose(f);
+                return WASMIFY_ERROR_MEMORY;
+            }
+            buf = p;
+        }
+        size_t n = fread(buf + len, 1, cap - len, f);
+        len += n;
+        if (n == 0) break;
+    }
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) {
+        free(buf);
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    *data = buf;
+    *size = len;
+    return WASMIFY_SUCCESS;
+}
+
+// A module file, mapped read-only or, where it can't be, read into memory
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    int mapped;
+} file_bytes_t;
+
+static wasmify_error_t map_file(const char* file_path, file_bytes_t* file) {
+    file->mapped = 0;
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            file->data = data;
+            file->size = (size_t)st.st_size;
+            file->mapped = 1;
+            return WASMIFY_SUCCESS;
+        }
+    }
+    close(fd);
+    
+    // Pipes, empty files and file systems without mmap support
+    return read_file(file_path, &file->data, &file->size);
+}
+
+static void unmap_file(file_bytes_t* file) {
+    if (file->mapped) munmap(file->data, file->size);
+    else free(file->data);
+}
+
+// Parse a decimal or 0x-prefixed hex integer, optionally negative, whose
+// bits wide two's complement or unsigned form holds it: [-2^(bits-1), 2^bits-1].
+// Leading zeros are decimal, not octal.
+static int parse_integer(const char* text, int bits, uint64_t* slot) {
+    int negative = *text == '-';
+    const char* digits = negative || *text == '+' ? text + 1 : text;
+    int base = 10;
+    if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        base = 16;
+        digits += 2;
+    }
+    // strtoull would take a second sign or leading spaces
+    if (base == 16 ? hex_digit(*digits) < 0 : (*digits < '0' || *digits > '9')) return 0;
+    
+    char* end = NULL;
+    errno = 0;
+    unsigned long long magnitude = strtoull(digits, &end, base);
+    if (*end != '\0' || errno != 0) return 0;
+    
+    uint64_t max = bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+    uint64_t min_magnitude = UINT64_C(1) << (bits - 1);
+    if (negative ? magnitude > min_magnitude : magnitude > max) return 0;
+    uint64_t v = negative ? (uint64_t)0 - magnitude : magnitude;
+    *slot = bits == 64 ? v : (v & max);
+    return 1;
+}
+
+// Parse a string argument as a value of the given wasm type
+static int parse_arg(const char* text, uint8_t type, uint64_t* slot) {
+    char* end = NULL;
+    errno = 0;
+    switch (type) {
+        case WASMIFY_TYPE_I32:
+            return parse_integer(text, 32, slot);
+        case WASMIFY_TYPE_I64:
+            return parse_integer(text, 64, slot);
+        case WASMIFY_TYPE_F32: {
+            float f = strtof(text, &end);
+            // Underflow still gives the nearest value, subnormal or zero; only overflow is out of range
+            if (errno == ERANGE && !isinf(f)) errno = 0;
+            uint32_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            *slot = bits;
+            break;
+        }
+        case WASMIFY_TYPE_F64: {
+            double d = strtod(text, &end);
+            if (errno == ERANGE && !isinf(d)) errno = 0;
+            memcpy(slot, &d, sizeof(d));
+            break;
+        }
+        case WASMIFY_TYPE_V128: {
+            // "0x" and 32 hex digits, bytes in memory order; fills two slots
+            uint8_t bytes[16];
+            if (strncmp(text, "0x", 2) != 0 || strlen(text) != 34) return 0;
+            for (int i = 0; i < 16; i++) {
+                int high = hex_digit(text[2 + 2 * i]), low = hex_digit(text[3 + 2 * i]);
+                if (high < 0 || low < 0) return 0;
+                bytes[i] = (uint8_t)(high << 4 | low);
+            }
+            memcpy(slot, bytes, sizeof(bytes));
+            return 1;
+        }
+        default:
+            return 0;
+    }
+    return end != text && *end == '\0' && errno == 0;
+}
+
+// Append the text form of a result value to buf
+static int format_value(char* buf, size_t size, uint8_t type, uint64_t slot) {
+    switch (type) {
+        case WASMIFY_TYPE_I32:
+            return snprintf(buf, size, "%d", (int32_t)slot);
+        case WASMIFY_TYPE_I64:
+            return snprintf(buf, size, "%lld", (long long)(int64_t)slot);
+        case WASMIFY_TYPE_F32: {
+            uint32_t bits = (uint32_t)slot;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            return snprintf(buf, size, "%.9g", f);
+        }
+        case WASMIFY_TYPE_F64: {
+            double d;
+            memcpy(&d, &slot, sizeof(d));
+            return snprintf(buf, size, "%.17g", d);
+        }
+        default:
+            return snprintf(buf, size, slot ? "ref" : "null");
+    }
+}
+
+static void set_message(char* buf, size_t size, const char* message) {
+    if (buf && size > 0) snprintf(buf, size, "%s", message);
+}
+
+static wasmify_error_t local_fail(wasmify_result_t* result, wasmify_error_t error, const char* message) {
+    result->success = 0;
+    result->error = strdup(message);
+    return error;
+}
+
+// Compiled module handle; shared between the cache and its callers
+struct wasmify_compiled_module {
+    uint8_t hash[32];
+    char id[17];
+    wasmify_engine_module_t* engine;
+    wasmify_engine_image_t* image;  // Initialized state from wasmify_module_snapshot, set once
+    size_t size;
+    int refs;
+    int cached;
+    struct wasmify_compiled_module* lru_prev;
+    struct wasmify_compiled_module* lru_next;
+    struct wasmify_compiled_module* bucket_next;
+};
+
+#define MODULE_CACHE_BUCKETS 256
+#define MODULE_CACHE_DEFAULT_BUDGET ((size_t)64 * 1024 * 1024)
+
+// Process-wide compiled module cache, most recently used at lru_head
+static struct {
+    pthread_mutex_t lock;
+    wasmify_compiled_module_t* buckets[MODULE_CACHE_BUCKETS];
+    wasmify_compiled_module_t* lru_head;
+    wasmify_compiled_module_t* lru_tail;
+    size_t budget;
+    size_t bytes;
+    size_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    char* artifact_dir;     // On-disk cache of compiled modules, NULL when off
+    uint64_t disk_hits;
+    uint64_t disk_writes;
+} g_module_cache = { PTHREAD_MUTEX_INITIALIZER, {0}, NULL, NULL, MODULE_CACHE_DEFAULT_BUDGET, 0, 0, 0, 0, NULL, 0, 0 };
+
+static void compiled_module_destroy(wasmify_compiled_module_t* module) {
+    wasmify_engine_image_free(module->image);
+    wasmify_engine_module_free(module->engine);
+    free(module);
+}
+
+static void cache_lru_unlink(wasmify_compiled_module_t* module) {
+    if (module->lru_prev) module->lru_prev->lru_next = module->lru_next;
+    else g_module_cache.lru_head = module->lru_next;
+    if (module->lru_next) module->lru_next->lru_prev = module->lru_prev;
+    else g_module_cache.lru_tail = module->lru_prev;
+    module->lru_prev = module->lru_next = NULL;
+}
+
+static void cache_lru_push(wasmify_compiled_module_t* module) {
+    module->lru_prev = NULL;
+    module->lru_next = g_module_cache.lru_head;
+    if (g_module_cache.lru_head) g_module_cache.lru_head->lru_prev = module;
+    g_module_cache.lru_head = module;
+    if (!g_module_cache.lru_tail) g_module_cache.lru_tail = module;
+}
+
+static wasmify_compiled_module_t* cache_lookup_locked(const uint8_t hash[32]) {
+    wasmify_compiled_module_t* m = g_module_cache.buckets[hash[0]];
+    while (m && memcmp(m->hash, hash, 32) != 0) {
+        m = m->bucket_next;
+    }
+    return m;
+}
+
+// Drop the cache's reference; returns the module if it must be destroyed
+static wasmify_compiled_module_t* cache_remove_locked(wasmify_compiled_module_t* module) {
+    wasmify_compiled_module_t** link = &g_module_cache.buckets[module->hash[0]];
+    while (*link != module) {
+        link = &(*link)->bucket_next;
+    }
+    *link = module->bucket_next;
+    cache_lru_unlink(module);
+    g_module_cache.bytes -= module->size;
+    g_module_cache.entries--;
+    module->cached = 0;
+    return --module->refs == 0 ? module : NULL;
+}
+
+// Evict least recently used modules that no caller holds until the cache
+// fits in limit. Victims are chained through bucket_next for the caller to
+// destroy outside the lock.
+static wasmify_compiled_module_t* cache_evict_locked(size_t limit) {
+    wasmify_compiled_module_t* victims = NULL;
+    wasmify_compiled_module_t* m = g_module_cache.lru_tail;
+    while (m && g_module_cache.bytes > limit) {
+        wasmify_compiled_module_t* prev = m->lru_prev;
+        if (m->refs == 1) {
+            wasmify_compiled_module_t* dead = cache_remove_locked(m);
+            if (dead) {
+                dead->bucket_next = victims;
+                victims = dead;
+            }
+        }
+        m = prev;
+    }
+    return victims;
+}
+
+static void destroy_victims(wasmify_compiled_module_t* victims) {
+    while (victims) {
+        wasmify_compiled_module_t* next = victims->bucket_next;
+        compiled_module_destroy(victims);
+        victims = next;
+    }
+}
+
+// Artifact file of a module in the on-disk cache, with suffix ".wasmc", or of
+// its image, ".wasmi". Its name combines the content hash with the engine
+// build and host it was compiled for, so fleets with mixed CPUs or engine
+// versions share a directory safely.
+static char* artifact_path_locked(const uint8_t hash[32], const char* suffix) {
+    if (!g_module_cache.artifact_dir) return NULL;
+    
+    static const char engine[] = WASMIFY_ENGINE_NAME "/" WASMIFY_ENGINE_VERSION "|";
+    const char* target = wasmify_engine_target();
+    size_t tag_len = sizeof(engine) - 1 + strlen(target);
+    char tag_text[256];
+    if (tag_len >= sizeof(tag_text)) return NULL;
+    memcpy(tag_text, engine, sizeof(engine) - 1);
+    memcpy(tag_text + sizeof(engine) - 1, target, tag_len - (sizeof(engine) - 1));
+    uint8_t tag[32];
+    sha256((const uint8_t*)tag_text, tag_len, tag);
+    
+    char hash_hex[65], tag_hex[17];
+    hex_encode(hash, 32, hash_hex);
+    hex_encode(tag, 8, tag_hex);
+    size_t size = strlen(g_module_cache.artifact_dir) + sizeof(hash_hex) + sizeof(tag_hex) + strlen(suffix) + sizeof("/-");
+    char* path = malloc(size);
+    if (path) snprintf(path, size, "%s/%s-%s%s", g_module_cache.artifact_dir, hash_hex, tag_hex, suffix);
+    return path;
+}
+
+static void artifact_unmap(const uint8_t* bytes, size_t size) {
+    munmap((void*)bytes, size);
+}
+
+// Map a compiled module from the on-disk cache
+static int artifact_load(const char* path, wasmify_engine_module_t** engine) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    
+    if (wasmify_engine_deserialize(data, (size_t)st.st_size, artifact_unmap, engine, NULL, 0) != WASMIFY_SUCCESS) {
+        munmap(data, (size_t)st.st_size);
+        return 0;
+    }
+    return 1;
+}
+
+// Cache files are written aside and renamed into place, so readers never
+// see a partial file. Returns the descriptor to write, -1 on failure.
+static int aside_open(const char* path, char** tmp) {
+    size_t tmp_size = strlen(path) + 32;
+    *tmp = malloc(tmp_size);
+    if (!*tmp) return -1;
+    snprintf(*tmp, tmp_size, "%s.%ld.%lx.tmp", path, (long)getpid(), (unsigned long)pthread_self());
+    return open(*tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+}
+
+// Move a file written aside into place if writing it succeeded
+static int aside_commit(const char* path, char* tmp, int fd, int written) {
+    int stored = fd >= 0 && close(fd) == 0 && written && rename(tmp, path) == 0;
+    if (!stored && fd >= 0) unlink(tmp);
+    free(tmp);
+    return stored;
+}
+
+// Write a compiled module to the on-disk cache; failures only cost a recompile later
+static int artifact_store(const char* path, const wasmify_engine_module_t* engine) {
+    uint8_t* bytes = NULL;
+    size_t size = 0;
+    if (wasmify_engine_serialize(engine, &bytes, &size) != WASMIFY_SUCCESS) {
+        return 0;
+    }
+    
+    char* tmp;
+    int fd = aside_open(path, &tmp);
+    size_t written = 0;
+    while (fd >= 0 && written < size) {
+        ssize_t n = write(fd, bytes + written, size - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    int stored = aside_commit(path, tmp, fd, written == size);
+    free(bytes);
+    return stored;
+}
+
+// Map a module's image from the on-disk cache
+static int image_load(const char* path, const wasmify_engine_module_t* engine, wasmify_engine_image_t** image) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    int loaded = wasmify_engine_image_load(engine, fd, image, NULL, 0) == WASMIFY_SUCCESS;
+    close(fd);
+    return loaded;
+}
+
+// Write a module's image to the on-disk cache; failures only cost initializing again later
+static int image_store(const char* path, const wasmify_engine_image_t* image) {
+    char* tmp;
+    int fd = aside_open(path, &tmp);
+    return aside_commit(path, tmp, fd, fd >= 0 && wasmify_engine_image_save(image, fd) == WASMIFY_SUCCESS);
+}
+
+// Look a module up by content hash, compiling and caching it on a miss
+static wasmify_error_t module_acquire(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_compiled_module_t** out,
+    char* err,
+    size_t err_size
+) {
+    uint8_t hash[32];
+    sha256(bytes, size, hash);
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    wasmify_compiled_module_t* found = cache_lookup_locked(hash);
+    if (found) {
+        found->refs++;
+        cache_lru_unlink(found);
+        cache_lru_push(found);
+        g_module_cache.hits++;
+        pthread_mutex_unlock(&g_module_cache.lock);
+        OBSERVE(.kind = WASMIFY_EVENT_CACHE_HIT, .module_id = found->id, .cache = "module");
+        *out = found;
+        return WASMIFY_SUCCESS;
+    }
+    g_module_cache.misses++;
+    char* artifact = artifact_path_locked(hash, ".wasmc");
+    pthread_mutex_unlock(&g_module_cache.lock);
+    
+    char id[17] = "";
+    double started = 0;
+    if (observing()) {
+        hex_encode(hash, 8, id);
+        started = monotonic_ms();
+    }
+    OBSERVE(.kind = WASMIFY_EVENT_CACHE_MISS, .module_id = id, .cache = "module");
+    
+    // Compile outside the lock so one large module doesn't stall the others,
+    // unless an earlier process left the compiled module on disk
+    wasmify_compiled_module_t* module = calloc(1, sizeof(wasmify_compiled_module_t));
+    if (!module) {
+        free(artifact);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    int from_disk = artifact && artifact_load(artifact, &module->engine);
+    int to_disk = 0;
+    if (!from_disk) {
+        wasmify_error_t error = wasmify_engine_compile(bytes, size, &module->engine, err, err_size);
+        OBSERVE(.kind = WASMIFY_EVENT_COMPILE, .module_id = id, .error = error, .duration_ms = monotonic_ms() - started);
+        if (error != WASMIFY_SUCCESS) {
+            free(artifact);
+            free(module);
+            return error;
+        }
+        to_disk = artifact && artifact_store(artifact, module->engine);
+    } else {
+        OBSERVE(.kind = WASMIFY_EVENT_COMPILE, .module_id = id, .duration_ms = monotonic_ms() - started);
+    }
+    free(artifact);
+    memcpy(module->hash, hash, sizeof(hash));
+    hex_encode(hash, 8, module->id);
+    module->size = sizeof(*module) + wasmify_engine_module_size(module->engine);
+    module->refs = 1;
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    g_module_cache.disk_hits += (uint64_t)from_disk;
+    g_module_cache.disk_writes += (uint64_t)to_disk;
+    wasmify_compiled_module_t* victims = NULL;
+    found = cache_lookup_locked(hash);
+    if (found) {
+        // Another thread compiled the same bytes first
+        found->refs++;
+        cache_lru_unlink(found);
+        cache_lru_push(found);
+        pthread_mutex_unlock(&g_module_cache.lock);
+        compiled_module_destroy(module);
+        *out = found;
+        return WASMIFY_SUCCESS;
+    }
+    if (module->size <= g_module_cache.budget) {
+        module->refs++;
+        module->cached = 1;
+        module->bucket_next = g_module_cache.buckets[hash[0]];
+        g_module_cache.buckets[hash[0]] = module;
+        cache_lru_push(module);
+        g_module_cache.bytes += module->size;
+        g_module_cache.entries++;
+        victims = cache_evict_locked(g_module_cache.budget);
+    }
+    pthread_mutex_unlock(&g_module_cache.lock);
+    destroy_victims(victims);
+    
+    *out = module;
+    return WASMIFY_SUCCESS;
+}
+
+// Compile a WebAssembly module from memory
+wasmify_error_t wasmify_module_compile(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_compiled_module_t** module
+) {
+    if (!bytes || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return module_acquire(bytes, size, module, NULL, 0);
+}
+
+// Compile a WebAssembly module from a file
+wasmify_error_t wasmify_module_compile_file(
+    const char* file_path,
+    wasmify_compiled_module_t** module
+) {
+    if (!file_path || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    file_bytes_t file;
+    wasmify_error_t error = map_file(file_path, &file);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    error = module_acquire(file.data, file.size, module, NULL, 0);
+    unmap_file(&file);
+    return error;
+}
+
+// Content-derived module identifier
+const char* wasmify_module_id(const wasmify_compiled_module_t* module) {
+    return module ? module->id : NULL;
+}
+
+// Release a compiled module handle
+void wasmify_module_release(wasmify_compiled_module_t* module) {
+    if (!module) return;
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    int dead = --module->refs == 0;
+    pthread_mutex_unlock(&g_module_cache.lock);
+    
+    if (dead) {
+        compiled_module_destroy(module);
+    }
+}
+
+// Set the compiled module cache budget
+void wasmify_module_cache_set_budget(size_t bytes) {
+    pthread_mutex_lock(&g_module_cache.lock);
+    g_module_cache.budget = bytes;
+    wasmify_compiled_module_t* victims = cache_evict_locked(bytes);
+    pthread_mutex_unlock(&g_module_cache.lock);
+    destroy_victims(victims);
+}
+
+// Evict every compiled module no caller holds
+void wasmify_module_cache_clear(void) {
+    pthread_mutex_lock(&g_module_cache.lock);
+    wasmify_compiled_module_t* victims = cache_evict_locked(0);
+    pthread_mutex_unlock(&g_module_cache.lock);
+    destroy_victims(victims);
+}
+
+// Snapshot compiled module cache counters
+void wasmify_module_cache_stats(wasmify_module_cache_stats_t* stats) {
+    if (!stats) return;
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    stats->entries = g_module_cache.entries;
+    stats->bytes = g_module_cache.bytes;
+    stats->budget = g_module_cache.budget;
+    stats->hits = g_module_cache.hits;
+    stats->misses = g_module_cache.misses;
+    stats->disk_hits = g_module_cache.disk_hits;
+    stats->disk_writes = g_module_cache.disk_writes;
+    pthread_mutex_unlock(&g_module_cache.lock);
+}
+
+// Keep compiled modules in a directory shared across processes
+wasmify_error_t wasmify_module_cache_set_dir(const char* dir) {
+    char* copy = NULL;
+    if (dir) {
+        struct stat st;
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+        if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+        copy = strdup(dir);
+        if (!copy) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+    }
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    char* old = g_module_cache.artifact_dir;
+    g_module_cache.artifact_dir = copy;
+    pthread_mutex_unlock(&g_module_cache.lock);
+    free(old);
+    return WASMIFY_SUCCESS;
+}
+
+// Small signatures run on stack slots instead of a heap allocation
+#define CALL_STACK_SLOTS 16
+
+// A local call resolved against its module; slots hold the arguments
+// followed by room for the results, two slots for each v128
+typedef struct {
+    uint32_t func_index;
+    wasmify_engine_functype_t type;
+    uint64_t* slots;
+    uint64_t* results;          // Within slots, past the arguments
+    uint64_t stack_slots[CALL_STACK_SLOTS];
+    double started;             // Per monotonic_ms, as are the two below
+    double called_at;           // 0 until the function was entered
+    double returned_at;
+    size_t memory_used;
+    wasmify_limits_t limits;
+    char err[256];
+} local_call_t;
+
+// Limits of local calls made on this thread
+static __thread wasmify_limits_t t_limits = { 0 };
+
+// Limit local calls made on the calling thread
+void wasmify_set_local_limits(const wasmify_limits_t* limits) {
+    if (limits) {
+        t_limits = *limits;
+    } else {
+        memset(&t_limits, 0, sizeof(t_limits));
+    }
+}
+
+// Slots a list of values takes, two for each v128
+static size_t value_slots(const uint8_t* types, uint32_t count) {
+    size_t slots = count;
+    for (uint32_t i = 0; i < count; i++) slots += types[i] == WASMIFY_TYPE_V128;
+    return slots;
+}
+
+// Resolve an export and make room for its arguments and results
+static wasmify_error_t call_prepare(
+    local_call_t* call,
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    size_t args_count
+) {
+    call->started = monotonic_ms();
+    call->called_at = 0;
+    call->returned_at = 0;
+    call->slots = NULL;
+    call->results = NULL;
+    call->memory_used = 0;
+    call->limits = t_limits;
+    call->limits.slice_ms = 0;
+    
+    if (!wasmify_engine_find_func(module->engine, function_name, &call->func_index, &call->type)) {
+        set_message(call->err, sizeof(call->err), "function not exported by module");
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    if (args_count != call->type.param_count) {
+        set_message(call->err, sizeof(call->err), "argument count does not match function signature");
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    size_t param_slots = value_slots(call->type.params, call->type.param_count);
+    size_t count = param_slots + value_slots(call->type.results, call->type.result_count);
+    call->slots = count <= CALL_STACK_SLOTS ? call->stack_slots : calloc(count, sizeof(uint64_t));
+    if (!call->slots) {
+        set_message(call->err, sizeof(call->err), "out of memory");
+        return WASMIFY_ERROR_MEMORY;
+    }
+    call->results = call->slots + param_slots;
+    return WASMIFY_SUCCESS;
+}
+
+static void call_release(local_call_t* call) {
+    if (call->slots != call->stack_slots) free(call->slots);
+}
+
+// Parse string arguments into the call's slots
+static wasmify_error_t call_parse_args(local_call_t* call, char** args) {
+    uint64_t* slot = call->slots;
+    for (uint32_t i = 0; i < call->type.param_count; i++) {
+        if (!parse_arg(args[i], call->type.params[i], slot)) {
+            set_message(call->err, sizeof(call->err), "argument does not match parameter type");
+            return WASMIFY_ERROR_INVALID_PARAM;
+        }
+        slot += call->type.params[i] == WASMIFY_TYPE_V128 ? 2 : 1;
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Store typed arguments in the call's slots; kinds must match exactly
+static wasmify_error_t call_store_args(local_call_t* call, const wasmify_value_t* args) {
+    uint64_t* slot = call->slots;
+    for (uint32_t i = 0; i < call->type.param_count; i++, slot++) {
+        const wasmify_value_t* value = &args[i];
+        switch (call->type.params[i]) {
+            case WASMIFY_TYPE_I32:
+                if (value->kind != WASMIFY_VAL_I32) break;
+                *slot = (uint32_t)value->of.i32;
+                continue;
+            case WASMIFY_TYPE_I64:
+                if (value->kind != WASMIFY_VAL_I64) break;
+                *slot = (uint64_t)value->of.i64;
+                continue;
+            case WASMIFY_TYPE_F32: {
+                if (value->kind != WASMIFY_VAL_F32) break;
+                uint32_t bits;
+                memcpy(&bits, &value->of.f32, sizeof(bits));
+                *slot = bits;
+                continue;
+            }
+            case WASMIFY_TYPE_F64:
+                if (value->kind != WASMIFY_VAL_F64) break;
+                memcpy(slot, &value->of.f64, sizeof(*slot));
+                continue;
+            case WASMIFY_TYPE_V128:
+                if (value->kind != WASMIFY_VAL_V128) break;
+                memcpy(slot++, value->of.v128, sizeof(value->of.v128));
+                continue;
+            default:
+                break;
+        }
+        set_message(call->err, sizeof(call->err), "argument does not match parameter type");
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Split the time of a finished call between getting an instance ready,
+// running the function and converting its results
+static void call_timing(const local_call_t* call, wasmify_timing_t* timing) {
+    memset(timing, 0, sizeof(*timing));
+    timing->total = monotonic_ms() - call->started;
+    if (call->returned_at == 0) {
+        timing->queue = timing->total;
+        return;
+    }
+    timing->queue = call->called_at - call->started;
+    timing->execute = call->returned_at - call->called_at;
+    timing->receive = timing->total - timing->queue - timing->execute;
+}
+
+// Fill in the text result of a finished call
+static wasmify_error_t finish_call(local_call_t* call, wasmify_error_t error, wasmify_result_t* result) {
+    result->execution_time = monotonic_ms() - call->started;
+    result->memory_used = call->memory_used;
+    result->memory_peak_pages = (uint32_t)(call->memory_used / WASMIFY_ENGINE_PAGE_SIZE);
+    
+    if (error != WASMIFY_SUCCESS) {
+        result->error = strdup(call->err);
+        return error;
+    }
+    
+    const wasmify_engine_functype_t* type = &call->type;
+    const uint64_t* results = call->results;
+    size_t cap = 36 * (size_t)type->result_count + 1;
+    result->result = malloc(cap);
+    if (!result->result) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    size_t len = 0;
+    result->result[0] = '\0';
+    for (uint32_t i = 0; i < type->result_count; i++) {
+        if (i > 0) result->result[len++] = ' ';
+        if (type->results[i] == WASMIFY_TYPE_V128) {
+            // Bytes in memory order, as remote results print them
+            memcpy(result->result + len, "0x", 2);
+            hex_encode((const uint8_t*)results, 16, result->result + len + 2);
+            len += 34;
+            results += 2;
+            continue;
+        }
+        len += (size_t)format_value(result->result + len, cap - len, type->results[i], *results++);
+    }
+    result->success = 1;
+    return WASMIFY_SUCCESS;
+}
+
+// Fill in the typed result of a finished call
+static wasmify_error_t finish_call_values(local_call_t* call, wasmify_error_t error, wasmify_call_result_t* result) {
+    result->execution_time = monotonic_ms() - call->started;
+    result->memory_used = call->memory_used;
+    result->memory_peak_pages = (uint32_t)(call->memory_used / WASMIFY_ENGINE_PAGE_SIZE);
+    
+    if (error != WASMIFY_SUCCESS) {
+        result->error = strdup(call->err);
+        return error;
+    }
+    
+    const wasmify_engine_functype_t* type = &call->type;
+    const uint64_t* results = call->results;
+    if (type->result_count > 0 && !values_alloc(result, type->result_count, 0)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    for (uint32_t i = 0; i < type->result_count; i++) {
+        wasmify_value_t* value = &result->values[i];
+        uint64_t slot = *results++;
+        switch (type->results[i]) {
+            case WASMIFY_TYPE_I32:
+                value->kind = WASMIFY_VAL_I32;
+                value->of.i32 = (int32_t)(uint32_t)slot;
+                break;
+            case WASMIFY_TYPE_I64:
+                value->kind = WASMIFY_VAL_I64;
+                value->of.i64 = (int64_t)slot;
+                break;
+            case WASMIFY_TYPE_F32: {
+                uint32_t bits = (uint32_t)slot;
+                value->kind = WASMIFY_VAL_F32;
+                memcpy(&value->of.f32, &bits, sizeof(bits));
+                break;
+            }
+            case WASMIFY_TYPE_F64:
+                value->kind = WASMIFY_VAL_F64;
+                memcpy(&value->of.f64, &slot, sizeof(slot));
+                break;
+            case WASMIFY_TYPE_V128:
+                value->kind = WASMIFY_VAL_V128;
+                memcpy(value->of.v128, results - 1, sizeof(value->of.v128));
+                results++;
+                break;
+            default:
+                // References have no meaning outside the instance
+                value->kind = WASMIFY_VAL_BYTES;
+                value->of.bytes.data = NULL;
+                value->of.bytes.size = 0;
+                break;
+        }
+    }
+    result->success = 1;
+    return WASMIFY_SUCCESS;
+}
+
+// Instantiate a module and run its WASI reactor initializer, if any, or
+// start from the module's image where initialization already ran
+static wasmify_error_t instantiate_ready(
+    wasmify_compiled_module_t* module,
+    const wasmify_engine_config_t* config,
+    const char* function_name,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+) {
+    double started = observing() ? monotonic_ms() : 0;
+    int initialize = !function_name || strcmp(function_name, "_initialize") != 0;
+    const wasmify_engine_image_t* image = __atomic_load_n(&module->image, __ATOMIC_ACQUIRE);
+    if (image && initialize && !(config && config->memory)) {
+        wasmify_error_t error = wasmify_engine_instantiate_image(image, config, instance, err, err_size);
+        OBSERVE(.kind = WASMIFY_EVENT_INSTANTIATE, .module_id = module->id, .function_name = function_name,
+                .error = error, .duration_ms = monotonic_ms() - started);
+        return error;
+    }
+    wasmify_error_t error = wasmify_engine_instantiate(module->engine, config, instance, err, err_size);
+    
+    // WASI reactors expect _initialize to run before any other export
+    uint32_t init_index;
+    if (error == WASMIFY_SUCCESS && initialize &&
+        wasmify_engine_find_func(module->engine, "_initialize", &init_index, NULL)) {
+        error = wasmify_engine_call(*instance, init_index, NULL, NULL, err, err_size);
+        if (error != WASMIFY_SUCCESS) {
+            wasmify_engine_instance_free(*instance);
+            *instance = NULL;
+        }
+    }
+    OBSERVE(.kind = WASMIFY_EVENT_INSTANTIATE, .module_id = module->id, .function_name = function_name,
+            .error = error, .duration_ms = monotonic_ms() - started);
+    return error;
+}
+
+// Snapshot a module's initialized state for its instances to start from
+wasmify_error_t wasmify_module_snapshot(wasmify_compiled_module_t* module) {
+    if (!module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    if (__atomic_load_n(&module->image, __ATOMIC_ACQUIRE)) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    char* path = artifact_path_locked(module->hash, ".wasmi");
+    pthread_mutex_unlock(&g_module_cache.lock);
+    
+    wasmify_engine_image_t* image = NULL;
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    if (!path || !image_load(path, module->engine, &image)) {
+        wasmify_engine_instance_t* instance = NULL;
+        error = instantiate_ready(module, NULL, NULL, &instance, NULL, 0);
+        
+        // Modules prepared for Wizer export the initialization it snapshots
+        uint32_t init_index;
+        wasmify_engine_functype_t type;
+        if (error == WASMIFY_SUCCESS &&
+            wasmify_engine_find_func(module->engine, "wizer.initialize", &init_index, &type) &&
+            type.param_count == 0 && type.result_count == 0) {
+            error = wasmify_engine_call(instance, init_index, NULL, NULL, NULL, 0);
+        }
+        if (error == WASMIFY_SUCCESS) error = wasmify_engine_image_capture(instance, &image);
+        wasmify_engine_instance_free(instance);
+        if (error == WASMIFY_SUCCESS && path) image_store(path, image);
+    }
+    free(path);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    // Another thread may have snapshotted the module meanwhile; instances
+    // may already be running from its image, so the first one stays
+    pthread_mutex_lock(&g_module_cache.lock);
+    if (!module->image) {
+        __atomic_store_n(&module->image, image, __ATOMIC_RELEASE);
+        image = NULL;
+    }
+    pthread_mutex_unlock(&g_module_cache.lock);
+    wasmify_engine_image_free(image);
+    return WASMIFY_SUCCESS;
+}
+
+// Run a prepared call in a fresh instance of the module
+static wasmify_error_t call_fresh(local_call_t* call, wasmify_compiled_module_t* module, const char* function_name) {
+    wasmify_engine_instance_t* instance = NULL;
+    wasmify_error_t error = instantiate_ready(module, NULL, function_name, &instance, call->err, sizeof(call->err));
+    if (error == WASMIFY_SUCCESS) {
+        call->called_at = monotonic_ms();
+        error = wasmify_engine_call_limited(instance, call->func_index, call->slots, call->results,
+                                            &call->limits, call->err, sizeof(call->err));
+        call->returned_at = monotonic_ms();
+    }
+    // Linear memory never shrinks during a call, so its size now is its peak
+    call->memory_used = wasmify_engine_memory_size(instance);
+    wasmify_engine_instance_free(instance);
+    return error;
+}
+
+// Execute a function of a compiled module in a fresh instance
+wasmify_error_t wasmify_execute_compiled(
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+) {
+    if (!module || !function_name || !result || args_count < 0 || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    result_init(result);
+    
+    local_call_t call;
+    wasmify_error_t error = call_prepare(&call, module, function_name, (size_t)args_count);
+    if (error == WASMIFY_SUCCESS) error = call_parse_args(&call, args);
+    if (error == WASMIFY_SUCCESS) error = call_fresh(&call, module, function_name);
+    error = finish_call(&call, error, result);
+    call_timing(&call, &result->timing);
+    call_release(&call);
+    return error;
+}
+
+// Call a function of a compiled module in a fresh instance with typed values
+wasmify_error_t wasmify_call(
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    if (!module || !function_name || !result || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    call_result_init(result);
+    
+    local_call_t call;
+    wasmify_error_t error = call_prepare(&call, module, function_name, args_count);
+    if (error == WASMIFY_SUCCESS) error = call_store_args(&call, args);
+    if (error == WASMIFY_SUCCESS) error = call_fresh(&call, module, function_name);
+    error = finish_call_values(&call, error, result);
+    call_timing(&call, &result->timing);
+    call_release(&call);
+    return error;
+}
+
+// An argument of a pipeline stage: literal text, or a result of an earlier stage
+typedef struct {
+    char* text;             // NULL when taken from a stage
+    size_t stage;
+    uint32_t result;
+} pipeline_arg_t;
+
+typedef struct {
+    char* module_id;
+    wasmify_compiled_module_t* module;  // NULL for stages that only run remotely
+    char* function_name;
+    pipeline_arg_t* args;
+    size_t args_count;
+    size_t args_cap;
+    int consumed;           // Another stage takes one of its results
+} pipeline_stage_t;
+
+struct wasmify_pipeline {
+    pipeline_stage_t* stages;
+    size_t count;
+    size_t cap;
+};
+
+// Create an empty pipeline
+wasmify_pipeline_t* wasmify_pipeline_create(void) {
+    return calloc(1, sizeof(wasmify_pipeline_t));
+}
+
+static wasmify_error_t pipeline_push(
+    wasmify_pipeline_t* pipeline,
+    const char* module_id,
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    size_t* stage
+) {
+    if (pipeline->count == pipeline->cap) {
+        size_t cap = pipeline->cap ? pipeline->cap * 2 : 4;
+        pipeline_stage_t* stages = realloc(pipeline->stages, cap * sizeof(pipeline_stage_t));
+        if (!stages) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        pipeline->stages = stages;
+        pipeline->cap = cap;
+    }
+    
+    pipeline_stage_t* s = &pipeline->stages[pipeline->count];
+    memset(s, 0, sizeof(*s));
+    s->module_id = strdup(module_id);
+    s->function_name = strdup(function_name);
+    if (!s->module_id || !s->function_name) {
+        free(s->module_id);
+        free(s->function_name);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    if (module) {
+        pthread_mutex_lock(&g_module_cache.lock);
+        module->refs++;
+        pthread_mutex_unlock(&g_module_cache.lock);
+        s->module = module;
+    }
+    if (stage) *stage = pipeline->count;
+    pipeline->count++;
+    return WASMIFY_SUCCESS;
+}
+
+// Add a stage calling an uploaded module
+wasmify_error_t wasmify_pipeline_add(
+    wasmify_pipeline_t* pipeline,
+    const char* module_id,
+    const char* function_name,
+    size_t* stage
+) {
+    if (!pipeline || !module_id || !function_name) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return pipeline_push(pipeline, module_id, NULL, function_name, stage);
+}
+
+// Add a stage calling a compiled module
+wasmify_error_t wasmify_pipeline_add_compiled(
+    wasmify_pipeline_t* pipeline,
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    size_t* stage
+) {
+    if (!pipeline || !module || !function_name) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    return pipeline_push(pipeline, module->id, module, function_name, stage);
+}
+
+static wasmify_error_t pipeline_push_arg(pipeline_stage_t* s, const pipeline_arg_t* arg) {
+    if (s->args_count == s->args_cap) {
+        size_t cap = s->args_cap ? s->args_cap * 2 : 4;
+        pipeline_arg_t* args = realloc(s->args, cap * sizeof(pipeline_arg_t));
+        if (!args) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        s->args = args;
+        s->args_cap = cap;
+    }
+    s->args[s->args_count++] = *arg;
+    return WASMIFY_SUCCESS;
+}
+
+// Append a literal argument to a stage
+wasmify_error_t wasmify_pipeline_arg(wasmify_pipeline_t* pipeline, size_t stage, const char* value) {
+    if (!pipeline || stage >= pipeline->count || !value) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    pipeline_arg_t arg = { strdup(value), 0, 0 };
+    if (!arg.text) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    wasmify_error_t error = pipeline_push_arg(&pipeline->stages[stage], &arg);
+    if (error != WASMIFY_SUCCESS) free(arg.text);
+    return error;
+}
+
+// Append an argument taken from an earlier stage's result
+wasmify_error_t wasmify_pipeline_arg_from(
+    wasmify_pipeline_t* pipeline,
+    size_t stage,
+    size_t from_stage,
+    uint32_t result_index
+) {
+    // Inputs only come from earlier stages, which keeps the graph acyclic
+    if (!pipeline || stage >= pipeline->count || from_stage >= stage) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    pipeline_arg_t arg = { NULL, from_stage, result_index };
+    wasmify_error_t error = pipeline_push_arg(&pipeline->stages[stage], &arg);
+    if (error == WASMIFY_SUCCESS) pipeline->stages[from_stage].consumed = 1;
+    return error;
+}
+
+size_t wasmify_pipeline_stage_count(const wasmify_pipeline_t* pipeline) {
+    return pipeline ? pipeline->count : 0;
+}
+
+// Render the body of a pipeline request into the connection's buffer
+static int build_pipeline_request(wasmify_client_t* client, connection_t* conn, const wasmify_pipeline_t* pipeline) {
+    json_buf_t* body = &conn->body;
+    json_reset(body);
+    conn->content_type = NULL;
+    request_idempotent(client, conn);
+    JSON_LITERAL(body, "{\"stages\":[");
+    for (size_t i = 0; i < pipeline->count; i++) {
+        const pipeline_stage_t* s = &pipeline->stages[i];
+        if (i > 0) JSON_LITERAL(body, ",");
+        JSON_LITERAL(body, "{\"moduleId\":");
+        json_string(body, s->module_id);
+        JSON_LITERAL(body, ",\"functionName\":");
+        json_string(body, s->function_name);
+        JSON_LITERAL(body, ",\"args\":[");
+        for (size_t j = 0; j < s->args_count; j++) {
+            const pipeline_arg_t* arg = &s->args[j];
+            if (j > 0) JSON_LITERAL(body, ",");
+            if (arg->text) {
+                json_string(body, arg->text);
+                continue;
+            }
+            char input[64];
+            json_raw(body, input, (size_t)snprintf(input, sizeof(input), "{\"stage\":%zu,\"result\":%u}",
+                                                   arg->stage, arg->result));
+        }
+        JSON_LITERAL(body, "]}");
+    }
+    JSON_LITERAL(body, "]");
+    json_raw(body, client->pool->config_json.data, client->pool->config_json.size);
+    return !body->failed;
+}
+
+// Execute a pipeline in a single request
+wasmify_error_t wasmify_pipeline_execute(
+    wasmify_client_t* client,
+    const wasmify_pipeline_t* pipeline,
+    wasmify_result_t* results
+) {
+    if (!client || !pipeline || (pipeline->count > 0 && !results)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < pipeline->count; i++) {
+        result_init(&results[i]);
+    }
+    if (pipeline->count == 0) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    connection_t* conn = acquire_connection(client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    if (!build_pipeline_request(client, conn, pipeline)) {
+        release_connection(client, conn);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    
+    // The response lists a result per stage, as batch responses do per invocation
+    wasmify_error_t error = execute_request(client, conn, client->pool->pipeline_url,
+                                            conn->body.data, conn->body.size, &conn->response);
+    if (error == WASMIFY_SUCCESS) {
+        error = parse_batch_response(&conn->response, NULL, results, pipeline->count);
+    }
+    
+    release_connection(client, conn);
+    return error;
+}
+
+// Fill a stage's argument slots from literals and from the result slots of
+// the stages it takes inputs from
+static wasmify_error_t pipeline_store_args(
+    const wasmify_pipeline_t* pipeline,
+    local_call_t* calls,
+    const wasmify_result_t* results,
+    size_t stage
+) {
+    const pipeline_stage_t* s = &pipeline->stages[stage];
+    local_call_t* call = &calls[stage];
+    uint64_t* slot = call->slots;
+    for (uint32_t i = 0; i < call->type.param_count; i++) {
+        const pipeline_arg_t* arg = &s->args[i];
+        uint8_t type = call->type.params[i];
+        size_t width = type == WASMIFY_TYPE_V128 ? 2 : 1;
+        if (arg->text) {
+            if (!parse_arg(arg->text, type, slot)) {
+                set_message(call->err, sizeof(call->err), "argument does not match parameter type");
+                return WASMIFY_ERROR_INVALID_PARAM;
+            }
+        } else {
+            const local_call_t* from = &calls[arg->stage];
+            if (!results[arg->stage].success) {
+                snprintf(call->err, sizeof(call->err), "stage %zu failed", arg->stage);
+                return WASMIFY_ERROR_EXECUTION;
+            }
+            if (arg->result >= from->type.result_count || from->type.results[arg->result] != type) {
+                set_message(call->err, sizeof(call->err), "input does not match parameter type");
+                return WASMIFY_ERROR_INVALID_PARAM;
+            }
+            memcpy(slot, from->results + value_slots(from->type.results, arg->result), width * sizeof(uint64_t));
+        }
+        slot += width;
+    }
+    return WASMIFY_SUCCESS;
+}
+
+// Run a pipeline locally
+wasmify_error_t wasmify_pipeline_run_local(const wasmify_pipeline_t* pipeline, wasmify_result_t* results) {
+    if (!pipeline || (pipeline->count > 0 && !results)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < pipeline->count; i++) {
+        result_init(&results[i]);
+    }
+    for (size_t i = 0; i < pipeline->count; i++) {
+        if (!pipeline->stages[i].module) return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    if (pipeline->count == 0) {
+        return WASMIFY_SUCCESS;
+    }
+    
+    // Calls stay prepared until the end, so their result slots can feed later stages
+    local_call_t* calls = malloc(pipeline->count * sizeof(local_call_t));
+    if (!calls) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    wasmify_error_t first_error = WASMIFY_SUCCESS;
+    for (size_t i = 0; i < pipeline->count; i++) {
+        const pipeline_stage_t* s = &pipeline->stages[i];
+        local_call_t* call = &calls[i];
+        wasmify_result_t* result = &results[i];
+        wasmify_error_t error = call_prepare(call, s->module, s->function_name, s->args_count);
+        if (error == WASMIFY_SUCCESS) error = pipeline_store_args(pipeline, calls, results, i);
+        if (error == WASMIFY_SUCCESS) error = call_fresh(call, s->module, s->function_name);
+        if (error == WASMIFY_SUCCESS && s->consumed) {
+            // Results other stages take are left in their slots unformatted
+            result->execution_time = monotonic_ms() - call->started;
+            result->memory_used = call->memory_used;
+            result->memory_peak_pages = (uint32_t)(call->memory_used / WASMIFY_ENGINE_PAGE_SIZE);
+            result->success = 1;
+        } else {
+            error = finish_call(call, error, result);
+        }
+        call_timing(call, &result->timing);
+        if (first_error == WASMIFY_SUCCESS) first_error = error;
+    }
+    
+    for (size_t i = 0; i < pipeline->count; i++) {
+        call_release(&calls[i]);
+    }
+    free(calls);
+    return first_error;
+}
+
+// Free a pipeline
+void wasmify_pipeline_free(wasmify_pipeline_t* pipeline) {
+    if (!pipeline) return;
+    
+    for (size_t i = 0; i < pipeline->count; i++) {
+        pipeline_stage_t* s = &pipeline->stages[i];
+        for (size_t j = 0; j < s->args_count; j++) free(s->args[j].text);
+        free(s->args);
+        free(s->module_id);
+        free(s->function_name);
+        wasmify_module_release(s->module);
+    }
+    free(pipeline->stages);
+    free(pipeline);
+}
+
+// Linear memory shared by instances of one module
+struct wasmify_shared_memory {
+    wasmify_engine_memory_t* engine;
+};
+
+// Create a shared memory for instances of a module
+wasmify_error_t wasmify_shared_memory_create(wasmify_compiled_module_t* module, wasmify_shared_memory_t** memory) {
+    if (!module || !memory) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *memory = NULL;
+    
+    wasmify_shared_memory_t* mem = calloc(1, sizeof(wasmify_shared_memory_t));
+    if (!mem) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    wasmify_error_t error = wasmify_engine_memory_create(module->engine, NULL, &mem->engine, NULL, 0);
+    if (error != WASMIFY_SUCCESS) {
+        free(mem);
+        return error;
+    }
+    *memory = mem;
+    return WASMIFY_SUCCESS;
+}
+
+// Drop the caller's reference to a shared memory
+void wasmify_shared_memory_release(wasmify_shared_memory_t* memory) {
+    if (!memory) return;
+    
+    wasmify_engine_memory_release(memory->engine);
+    free(memory);
+}
+
+#define POOL_DEFAULT_SIZE 4
+
+// Pool of instantiated modules, each reset to its snapshot between uses
+struct wasmify_instance_pool {
+    wasmify_compiled_module_t* module;
+    wasmify_engine_config_t engine_config;
+    pthread_mutex_t lock;
+    wasmify_engine_instance_t** idle;
+    uint32_t idle_count;
+    uint32_t size;
+    wasmify_limits_t limits;
+};
+
+// Instantiate, initialize and snapshot a new pool instance
+static wasmify_error_t pool_new_instance(
+    wasmify_instance_pool_t* pool,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+) {
+    wasmify_error_t error = instantiate_ready(pool->module, &pool->engine_config, NULL, instance, err, err_size);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    error = wasmify_engine_instance_snapshot(*instance);
+    if (error != WASMIFY_SUCCESS) {
+        wasmify_engine_instance_free(*instance);
+        *instance = NULL;
+        set_message(err, err_size, "failed to snapshot instance");
+    }
+    return error;
+}
+
+// Create an instance pool for a compiled module
+wasmify_instance_pool_t* wasmify_instance_pool_create(
+    wasmify_compiled_module_t* module,
+    wasmify_pool_config_t config
+) {
+    if (!module) {
+        return NULL;
+    }
+    
+    wasmify_instance_pool_t* pool = calloc(1, sizeof(wasmify_instance_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pool->size = config.size > 0 ? config.size : POOL_DEFAULT_SIZE;
+    pool->engine_config.min_pages = config.memory_min;
+    pool->engine_config.max_pages = config.memory_max > 0 ? config.memory_max : WASMIFY_DEFAULT_MEMORY_MAX;
+    pool->limits = config.limits;
+    pool->idle = calloc(pool->size, sizeof(wasmify_engine_instance_t*));
+    if (!pool->idle) {
+        free(pool);
+        return NULL;
+    }
+    if (config.memory) {
+        pool->engine_config.memory = config.memory->engine;
+        wasmify_engine_memory_retain(pool->engine_config.memory);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    module->refs++;
+    pthread_mutex_unlock(&g_module_cache.lock);
+    pool->module = module;
+    
+    // Pre-warm so the first requests don't pay for instantiation
+    for (uint32_t i = 0; i < pool->size; i++) {
+        wasmify_engine_instance_t* instance = NULL;
+        if (pool_new_instance(pool, &instance, NULL, 0) != WASMIFY_SUCCESS) {
+            wasmify_instance_pool_destroy(pool);
+            return NULL;
+        }
+        pool->idle[pool->idle_count++] = instance;
+    }
+    
+    return pool;
+}
+
+// Destroy an instance pool
+void wasmify_instance_pool_destroy(wasmify_instance_pool_t* pool) {
+    if (!pool) return;
+    
+    for (uint32_t i = 0; i < pool->idle_count; i++) {
+        wasmify_engine_instance_free(pool->idle[i]);
+    }
+    free(pool->idle);
+    pthread_mutex_destroy(&pool->lock);
+    wasmify_engine_memory_release(pool->engine_config.memory);
+    wasmify_module_release(pool->module);
+    free(pool);
+}
+
+// Limits the pool was configured with win over the thread's
+static void pool_limits(local_call_t* call, const wasmify_instance_pool_t* pool) {
+    if (pool->limits.deadline_ms || pool->limits.fuel) {
+        call->limits = pool->limits;
+    }
+}
+
+// Take an instance from the pool, creating one if every instance is busy
+static wasmify_error_t pool_checkout(local_call_t* call, wasmify_instance_pool_t* pool, wasmify_engine_instance_t** instance) {
+    *instance = NULL;
+    double started = observing() ? monotonic_ms() : 0;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->idle_count > 0) {
+        *instance = pool->idle[--pool->idle_count];
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    // Grow past the pool size for this call only
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    int reused = *instance != NULL;
+    if (!*instance) {
+        error = pool_new_instance(pool, instance, call->err, sizeof(call->err));
+    }
+    OBSERVE(.kind = WASMIFY_EVENT_POOL_CHECKOUT, .module_id = pool->module->id, .error = error,
+            .duration_ms = monotonic_ms() - started, .reused = reused);
+    pool_limits(call, pool);
+    return error;
+}
+
+// Reset an instance after a call and give it back to the pool
+static void pool_checkin(local_call_t* call, wasmify_instance_pool_t* pool, wasmify_engine_instance_t* instance) {
+    // Linear memory never shrinks during a call, so its size now is its peak
+    call->memory_used = wasmify_engine_memory_size(instance);
+    
+    if (instance && wasmify_engine_instance_reset(instance) == WASMIFY_SUCCESS) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->idle_count < pool->size) {
+            pool->idle[pool->idle_count++] = instance;
+            instance = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    wasmify_engine_instance_free(instance);
+}
+
+// Run a prepared call on an instance taken from the pool
+static wasmify_error_t call_pooled(local_call_t* call, wasmify_instance_pool_t* pool) {
+    wasmify_engine_instance_t* instance;
+    wasmify_error_t error = pool_checkout(call, pool, &instance);
+    if (error == WASMIFY_SUCCESS) {
+        call->limits.slice_ms = 0;
+        call->called_at = monotonic_ms();
+        error = wasmify_engine_call_limited(instance, call->func_index, call->slots, call->results,
+                                            &call->limits, call->err, sizeof(call->err));
+        call->returned_at = monotonic_ms();
+    }
+    pool_checkin(call, pool, instance);
+    return error;
+}
+
+// Execute a function on a pooled instance
+wasmify_error_t wasmify_pool_execute(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+) {
+    if (!pool || !function_name || !result || args_count < 0 || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    result_init(result);
+    
+    local_call_t call;
+    wasmify_error_t error = call_prepare(&call, pool->module, function_name, (size_t)args_count);
+    if (error == WASMIFY_SUCCESS) error = call_parse_args(&call, args);
+    if (error == WASMIFY_SUCCESS) error = call_pooled(&call, pool);
+    error = finish_call(&call, error, result);
+    call_timing(&call, &result->timing);
+    call_release(&call);
+    return error;
+}
+
+// Call a function on a pooled instance with typed values
+wasmify_error_t wasmify_pool_call(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    if (!pool || !function_name || !result || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    call_result_init(result);
+    
+    local_call_t call;
+    wasmify_error_t error = call_prepare(&call, pool->module, function_name, args_count);
+    if (error == WASMIFY_SUCCESS) error = call_store_args(&call, args);
+    if (error == WASMIFY_SUCCESS) error = call_pooled(&call, pool);
+    error = finish_call_values(&call, error, result);
+    call_timing(&call, &result->timing);
+    call_release(&call);
+    return error;
+}
+
+// Instance handed to the application, so that buffers can be leased in its
+// linear memory and results read where the guest left them
+struct wasmify_instance {
+    wasmify_compiled_module_t* module;
+    wasmify_instance_pool_t* pool;      // NULL for a standalone instance
+    wasmify_engine_instance_t* engine;
+    int allocator;                      // INSTANCE_ALLOC_*
+    uint32_t alloc_index;
+    uint32_t arena_next;                // Free part of the pages grown for leases
+    uint32_t arena_end;
+};
+
+enum {
+    INSTANCE_ALLOC_PAGES = 0,           // Grow memory and lease from the new pages
+    INSTANCE_ALLOC_CABI_REALLOC = 1,    // cabi_realloc(0, 0, align, size)
+    INSTANCE_ALLOC_MALLOC = 2           // malloc(size)
+};
+
+#define LEASE_ALIGN 16
+
+// Pick the guest's own allocator when it exports one, so that leased
+// buffers are memory the guest itself may later free or grow
+static void instance_find_allocator(wasmify_instance_t* instance) {
+    const wasmify_engine_module_t* engine = instance->module->engine;
+    wasmify_engine_functype_t type;
+    if (wasmify_engine_find_func(engine, "cabi_realloc", &instance->alloc_index, &type) &&
+        type.param_count == 4 && type.result_count == 1 && type.results[0] == WASMIFY_TYPE_I32) {
+        instance->allocator = INSTANCE_ALLOC_CABI_REALLOC;
+    } else if (wasmify_engine_find_func(engine, "malloc", &instance->alloc_index, &type) &&
+               type.param_count == 1 && type.params[0] == WASMIFY_TYPE_I32 &&
+               type.result_count == 1 && type.results[0] == WASMIFY_TYPE_I32) {
+        instance->allocator = INSTANCE_ALLOC_MALLOC;
+    } else {
+        instance->allocator = INSTANCE_ALLOC_PAGES;
+    }
+}
+
+static wasmify_error_t instance_create(
+    wasmify_compiled_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_instance_t** instance
+) {
+    if (!module || !instance) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *instance = NULL;
+    
+    wasmify_instance_t* inst = calloc(1, sizeof(wasmify_instance_t));
+    if (!inst) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    wasmify_error_t error = instantiate_ready(module, config, NULL, &inst->engine, NULL, 0);
+    if (error != WASMIFY_SUCCESS) {
+        free(inst);
+        return error;
+    }
+    
+    pthread_mutex_lock(&g_module_cache.lock);
+    module->refs++;
+    pthread_mutex_unlock(&g_module_cache.lock);
+    inst->module = module;
+    instance_find_allocator(inst);
+    *instance = inst;
+    return WASMIFY_SUCCESS;
+}
+
+// Create a standalone instance of a compiled module
+wasmify_error_t wasmify_instance_create(wasmify_compiled_module_t* module, wasmify_instance_t** instance) {
+    return instance_create(module, NULL, instance);
+}
+
+// Create a standalone instance on a shared memory
+wasmify_error_t wasmify_instance_create_shared(
+    wasmify_compiled_module_t* module,
+    wasmify_shared_memory_t* memory,
+    wasmify_instance_t** instance
+) {
+    if (!memory) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    wasmify_engine_config_t config = { 0 };
+    config.memory = memory->engine;
+    return instance_create(module, &config, instance);
+}
+
+// Take an instance out of a pool until it is released
+wasmify_error_t wasmify_pool_acquire(wasmify_instance_pool_t* pool, wasmify_instance_t** instance) {
+    if (!pool || !instance) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *instance = NULL;
+    
+    wasmify_instance_t* inst = calloc(1, sizeof(wasmify_instance_t));
+    if (!inst) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    local_call_t call;
+    wasmify_error_t error = pool_checkout(&call, pool, &inst->engine);
+    if (error != WASMIFY_SUCCESS) {
+        free(inst);
+        return error;
+    }
+    inst->module = pool->module;
+    inst->pool = pool;
+    instance_find_allocator(inst);
+    *instance = inst;
+    return WASMIFY_SUCCESS;
+}
+
+// Give an instance back to its pool, or free a standalone one
+void wasmify_instance_release(wasmify_instance_t* instance) {
+    if (!instance) return;
+    
+    if (instance->pool) {
+        local_call_t call;
+        pool_checkin(&call, instance->pool, instance->engine);
+    } else {
+        wasmify_engine_instance_free(instance->engine);
+        wasmify_module_release(instance->module);
+    }
+    free(instance);
+}
+
+// Call a function on an instance, keeping its state for the next call
+wasmify_error_t wasmify_instance_call(
+    wasmify_instance_t* instance,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+) {
+    if (!instance || !function_name || !result || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    call_result_init(result);
+    
+    local_call_t call;
+    wasmify_error_t error = call_prepare(&call, instance->module, function_name, args_count);
+    if (error == WASMIFY_SUCCESS) error = call_store_args(&call, args);
+    if (error == WASMIFY_SUCCESS) {
+        if (instance->pool) pool_limits(&call, instance->pool);
+        call.called_at = monotonic_ms();
+        error = wasmify_engine_call_limited(instance->engine, call.func_index, call.slots, call.results,
+                                            &call.limits, call.err, sizeof(call.err));
+        call.returned_at = monotonic_ms();
+        call.memory_used = wasmify_engine_memory_size(instance->engine);
+    }
+    error = finish_call_values(&call, error, result);
+    call_timing(&call, &result->timing);
+    call_release(&call);
+    return error;
+}
+
+// Lease a buffer in an instance's linear memory
+wasmify_error_t wasmify_instance_alloc(wasmify_instance_t* instance, uint32_t size, uint32_t* offset, void** data) {
+    if (!instance || !offset) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    wasmify_engine_instance_t* engine = instance->engine;
+    uint8_t* memory = wasmify_engine_memory(engine);
+    if (!memory) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    uint32_t at;
+    if (instance->allocator != INSTANCE_ALLOC_PAGES) {
+        uint64_t slots[4] = { 0, 0, LEASE_ALIGN, size };
+        uint64_t* argv = instance->allocator == INSTANCE_ALLOC_MALLOC ? &slots[3] : slots;
+        char err[128];
+        if (wasmify_engine_call(engine, instance->alloc_index, argv, slots, err, sizeof(err)) != WASMIFY_SUCCESS ||
+            slots[0] == 0) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        at = (uint32_t)slots[0];
+    } else {
+        // Pages grown by the host are never handed out by the guest's own
+        // allocator, which only knows of the ones it grew itself
+        size_t memory_size = wasmify_engine_memory_size(engine);
+        uint64_t start = ((uint64_t)instance->arena_next + LEASE_ALIGN - 1) & ~(uint64_t)(LEASE_ALIGN - 1);
+        if (instance->arena_end != memory_size || start > instance->arena_end) {
+            start = memory_size;
+        }
+        uint64_t end = start + size;
+        uint64_t arena_end = memory_size;
+        if (end > memory_size) {
+            uint64_t pages = (end - memory_size + WASMIFY_ENGINE_PAGE_SIZE - 1) / WASMIFY_ENGINE_PAGE_SIZE;
+            uint32_t old = pages > UINT32_MAX ? UINT32_MAX : wasmify_engine_memory_grow(engine, (uint32_t)pages);
+            if (old == UINT32_MAX) {
+                return WASMIFY_ERROR_MEMORY;
+            }
+            // Another instance on a shared memory may have grown it first;
+            // only the pages this growth added are the arena's
+            arena_end = ((uint64_t)old + pages) * WASMIFY_ENGINE_PAGE_SIZE;
+            if ((uint64_t)old * WASMIFY_ENGINE_PAGE_SIZE != memory_size) {
+                start = (uint64_t)old * WASMIFY_ENGINE_PAGE_SIZE;
+                end = start + size;
+                if (end > arena_end) return WASMIFY_ERROR_MEMORY;
+            }
+        }
+        instance->arena_next = (uint32_t)end;
+        instance->arena_end = (uint32_t)arena_end;
+        at = (uint32_t)start;
+    }
+    
+    if ((uint64_t)at + size > wasmify_engine_memory_size(engine)) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    *offset = at;
+    if (data) *data = memory + at;
+    return WASMIFY_SUCCESS;
+}
+
+// Borrow a range of an instance's linear memory
+wasmify_error_t wasmify_instance_view(wasmify_instance_t* instance, uint32_t offset, uint32_t size, const void** data) {
+    if (!instance || !data) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    uint8_t* memory = wasmify_engine_memory(instance->engine);
+    if (!memory || (uint64_t)offset + size > wasmify_engine_memory_size(instance->engine)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *data = memory + offset;
+    return WASMIFY_SUCCESS;
+}
+
+// A pooled call run a time slice at a time
+struct wasmify_task {
+    wasmify_instance_pool_t* pool;
+    wasmify_engine_instance_t* instance;
+    local_call_t call;
+    wasmify_error_t error;
+    int done;
+};
+
+// Start a sliced call on a pooled instance
+wasmify_error_t wasmify_pool_spawn(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_task_t** task
+) {
+    if (!pool || !function_name || !task || (args_count > 0 && !args)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *task = NULL;
+    
+    wasmify_task_t* t = calloc(1, sizeof(wasmify_task_t));
+    if (!t) {
+        return WASMIFY_ERROR_MEMORY;
     }
+    t->pool = pool;
     
-    response->data = new_data;
-    memcpy(&(response->data[response->size]), contents, realsize);
-    response->size += realsize;
-    response->data[response->size] = 0;
+    local_call_t* call = &t->call;
+    wasmify_error_t error = call_prepare(call, pool->module, function_name, args_count);
+    if (error == WASMIFY_SUCCESS) error = call_store_args(call, args);
+    if (error == WASMIFY_SUCCESS) error = pool_checkout(call, pool, &t->instance);
+    if (error != WASMIFY_SUCCESS) {
+        if (t->instance) pool_checkin(call, pool, t->instance);
+        call_release(call);
+        free(t);
+        return error;
+    }
     
-    return realsize;
+    if (call->limits.slice_ms == 0) {
+        call->limits.slice_ms = pool->limits.slice_ms ? pool->limits.slice_ms
+            : t_limits.slice_ms ? t_limits.slice_ms : WASMIFY_DEFAULT_SLICE_MS;
+    }
+    *task = t;
+    return WASMIFY_SUCCESS;
 }
 
-// Initialize Wasmify SDK
-wasmify_error_t wasmify_init(void) {
-    if (g_initialized) {
-        return WASMIFY_SUCCESS;
+// Run a task for one time slice
+wasmify_error_t wasmify_task_step(wasmify_task_t* task, int* done) {
+    if (!task) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    
+    local_call_t* call = &task->call;
+    if (!task->done) {
+        if (call->called_at == 0) {
+            call->called_at = monotonic_ms();
+            task->error = wasmify_engine_call_limited(task->instance, call->func_index, call->slots,
+                                                      call->results, &call->limits,
+                                                      call->err, sizeof(call->err));
+        } else {
+            task->error = wasmify_engine_resume(task->instance, call->results,
+                                                call->err, sizeof(call->err));
+        }
+        if (task->error != WASMIFY_SUCCESS || !wasmify_engine_suspended(task->instance)) {
+            call->returned_at = monotonic_ms();
+            task->done = 1;
+        }
+    }
+    if (done) *done = task->done;
+    return task->done ? task->error : WASMIFY_SUCCESS;
+}
+
+// Collect the result of a task, cancelling it if it has not finished
+wasmify_error_t wasmify_task_finish(wasmify_task_t* task, wasmify_call_result_t* result) {
+    if (!task) {
+        return WASMIFY_ERROR_INVALID_PARAM;
     }
     
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    g_initialized = 1;
+    local_call_t* call = &task->call;
+    wasmify_error_t error = task->error;
+    if (!task->done) {
+        set_message(call->err, sizeof(call->err), "task cancelled");
+        error = WASMIFY_ERROR_EXECUTION;
+    }
+    pool_checkin(call, task->pool, task->instance);
     
-    return WASMIFY_SUCCESS;
+    if (result) {
+        call_result_init(result);
+        error = finish_call_values(call, error, result);
+        call_timing(call, &result->timing);
+    }
+    call_release(call);
+    free(task);
+    return error;
 }
 
-// Cleanup Wasmify SDK
-void wasmify_cleanup(void) {
-    if (g_initialized) {
-        curl_global_cleanup();
-        g_initialized = 0;
+#define EXECUTOR_DEFAULT_INSTANCES 2
+#define EXECUTOR_MAX_WORKERS 256
+#define DEQUE_MIN_CAPACITY 64
+
+// Result of a submitted call, handed over to whoever waits for it
+struct wasmify_future {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+    wasmify_error_t error;
+    wasmify_call_result_t result;
+};
+
+// Call submitted to an executor, run a time slice at a time; its arguments
+// and function name are stored behind it
+typedef struct {
+    char* function_name;
+    wasmify_value_t* args;
+    size_t args_count;
+    wasmify_task_t* task;       // NULL until the call first runs
+    wasmify_call_callback_t callback;
+    void* user_data;
+    wasmify_future_t* future;   // Set when no callback is
+} executor_job_t;
+
+// Ring of jobs; its owner takes from the head and thieves from the tail
+typedef struct {
+    pthread_mutex_t lock;
+    executor_job_t** jobs;
+    uint32_t capacity;          // Power of two
+    uint32_t head;
+    uint32_t tail;
+} job_deque_t;
+
+typedef struct {
+    wasmify_executor_t* executor;
+    uint32_t index;
+    pthread_t thread;
+    wasmify_instance_pool_t* pool;
+    job_deque_t deque;
+} executor_worker_t;
+
+struct wasmify_executor {
+    wasmify_compiled_module_t* module;
+    wasmify_pool_config_t pool_config;
+    executor_worker_t* workers;
+    uint32_t worker_count;
+    uint32_t thread_count;      // Workers whose thread was started
+    uint32_t next;              // Round-robin target of outside submissions
+    uint32_t queued;            // Jobs sitting in deques
+    uint32_t idle;              // Workers asleep on cond
+    int stopping;
+    uint32_t started;           // Workers that got as far as their pool
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+// Worker the calling thread is, when it is one
+static __thread executor_worker_t* t_worker = NULL;
+
+static int deque_push(job_deque_t* deque, executor_job_t* job) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail - deque->head == deque->capacity) {
+        uint32_t capacity = deque->capacity ? deque->capacity * 2 : DEQUE_MIN_CAPACITY;
+        executor_job_t** jobs = malloc(capacity * sizeof(executor_job_t*));
+        if (!jobs) {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+        for (uint32_t i = deque->head; i != deque->tail; i++) {
+            jobs[i & (capacity - 1)] = deque->jobs[i & (deque->capacity - 1)];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->capacity = capacity;
     }
+    deque->jobs[deque->tail++ & (deque->capacity - 1)] = job;
+    pthread_mutex_unlock(&deque->lock);
+    return 1;
 }
 
-// Create a new Wasmify client
-wasmify_client_t* wasmify_client_create(wasmify_config_t config) {
-    wasmify_client_t* client = malloc(sizeof(wasmify_client_t));
-    if (!client) {
-        return NULL;
+static executor_job_t* deque_take(job_deque_t* deque, int steal) {
+    executor_job_t* job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head != deque->tail) {
+        job = steal ? deque->jobs[--deque->tail & (deque->capacity - 1)]
+                    : deque->jobs[deque->head++ & (deque->capacity - 1)];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+// Queue a job and wake a worker if any is asleep. Jobs pushed by a worker
+// stay on its own deque; the others are spread round-robin.
+static int executor_enqueue(wasmify_executor_t* executor, executor_job_t* job) {
+    executor_worker_t* worker = t_worker && t_worker->executor == executor ? t_worker
+        : &executor->workers[__atomic_fetch_add(&executor->next, 1, __ATOMIC_RELAXED) % executor->worker_count];
+    if (!deque_push(&worker->deque, job)) {
+        return 0;
     }
     
-    // Copy configuration
-    client->config.api_url = config.api_url ? strdup(config.api_url) : strdup("http://localhost:3000/api");
-    client->config.api_key = config.api_key ? strdup(config.api_key) : NULL;
-    client->config.timeout = config.timeout > 0 ? config.timeout : 30;
+    // Sequentially consistent against the idle count a worker bumps before
+    // it looks at the queue one last time, so no wakeup is lost
+    __atomic_add_fetch(&executor->queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&executor->idle, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_signal(&executor->cond);
+        pthread_mutex_unlock(&executor->lock);
+    }
+    return 1;
+}
+
+// Next job for a worker: its own oldest, else the newest of another worker
+static executor_job_t* executor_next(executor_worker_t* worker) {
+    wasmify_executor_t* executor = worker->executor;
+    executor_job_t* job = deque_take(&worker->deque, 0);
+    if (!job && executor->worker_count > 1) {
+        uint32_t start = (uint32_t)(thread_random() % executor->worker_count);
+        for (uint32_t i = 0; i < executor->worker_count && !job; i++) {
+            uint32_t victim = (start + i) % executor->worker_count;
+            if (victim != worker->index) job = deque_take(&executor->workers[victim].deque, 1);
+        }
+    }
+    if (job) __atomic_sub_fetch(&executor->queued, 1, __ATOMIC_SEQ_CST);
+    return job;
+}
+
+static void future_free(wasmify_future_t* future) {
+    if (!future) return;
     
-    // Initialize CURL
-    client->curl = curl_easy_init();
-    if (!client->curl) {
-        free(client->config.api_url);
-        if (client->config.api_key) free(client->config.api_key);
-        free(client);
-        return NULL;
+    pthread_cond_destroy(&future->cond);
+    pthread_mutex_destroy(&future->lock);
+    free(future);
+}
+
+// Hand the outcome of a job to its callback or future
+static void job_complete(executor_job_t* job, wasmify_error_t error, wasmify_call_result_t* result) {
+    if (job->callback) {
+        job->callback(error, result, job->user_data);
+    } else {
+        wasmify_future_t* future = job->future;
+        pthread_mutex_lock(&future->lock);
+        future->error = error;
+        if (result) future->result = *result;
+        future->done = 1;
+        pthread_cond_signal(&future->cond);
+        pthread_mutex_unlock(&future->lock);
+    }
+    free(job);
+}
+
+// Run one slice of a job, queueing it again if it is not done
+static void executor_run(executor_worker_t* worker, executor_job_t* job) {
+    wasmify_error_t error = WASMIFY_SUCCESS;
+    if (!job->task) {
+        error = wasmify_pool_spawn(worker->pool, job->function_name, job->args, job->args_count, &job->task);
+        if (error != WASMIFY_SUCCESS) {
+            job_complete(job, error, NULL);
+            return;
+        }
     }
     
-    // Set common CURL options
-    curl_easy_setopt(client->curl, CURLOPT_TIMEOUT, client->config.timeout);
-    curl_easy_setopt(client->curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, write_callback);
+    int done = 0;
+    wasmify_task_step(job->task, &done);
+    if (!done && executor_enqueue(worker->executor, job)) {
+        return;
+    }
     
-    return client;
+    // A task that could not be queued again is cancelled
+    wasmify_call_result_t result;
+    error = wasmify_task_finish(job->task, &result);
+    job_complete(job, error, &result);
 }
 
-// Destroy a Wasmify client
-void wasmify_client_destroy(wasmify_client_t* client) {
-    if (!client) return;
-    
-    if (client->curl) {
-        curl_easy_cleanup(client->curl);
+// Pin a worker to a core of its own while there are enough, so that the instances it creates are
+// backed by memory of that core's node
+static void executor_pin(uint32_t index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
     }
-    if (client->config.api_url) {
-        free(client->config.api_url);
+    index %= (uint32_t)CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || index-- > 0) continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        return;
     }
-    if (client->config.api_key) {
-        free(client->config.api_key);
+#else
+    (void)index;
+#endif
+}
+
+static void* executor_worker(void* arg) {
+    executor_worker_t* worker = arg;
+    wasmify_executor_t* executor = worker->executor;
+    t_worker = worker;
+    if (executor->worker_count > 1) executor_pin(worker->index);
+    
+    // Created on the pinned thread so that first touch places its memory
+    worker->pool = wasmify_instance_pool_create(executor->module, executor->pool_config);
+    pthread_mutex_lock(&executor->lock);
+    executor->started++;
+    if (!worker->pool) executor->failed = 1;
+    pthread_cond_broadcast(&executor->cond);
+    pthread_mutex_unlock(&executor->lock);
+    if (!worker->pool) {
+        return NULL;
     }
-    free(client);
+    
+    for (;;) {
+        executor_job_t* job = executor_next(worker);
+        if (job) {
+            executor_run(worker, job);
+            continue;
+        }
+        
+        pthread_mutex_lock(&executor->lock);
+        __atomic_add_fetch(&executor->idle, 1, __ATOMIC_SEQ_CST);
+        int stop = 0;
+        if (__atomic_load_n(&executor->queued, __ATOMIC_SEQ_CST) == 0) {
+            if (executor->stopping) {
+                stop = 1;
+            } else {
+                pthread_cond_wait(&executor->cond, &executor->lock);
+            }
+        }
+        __atomic_sub_fetch(&executor->idle, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&executor->lock);
+        if (stop) break;
+    }
+    return NULL;
 }
 
-// Execute HTTP request
-static wasmify_error_t execute_request(
-    wasmify_client_t* client,
-    const char* url,
-    const char* post_data,
-    wasmify_response_t* response
+// Create a work-stealing executor for a compiled module
+wasmify_executor_t* wasmify_executor_create(
+    wasmify_compiled_module_t* module,
+    wasmify_executor_config_t config
 ) {
-    if (!client || !url || !response) {
-        return WASMIFY_ERROR_INVALID_PARAM;
+    if (!module) {
+        return NULL;
     }
     
-    // Initialize response
-    response->data = malloc(1);
-    response->data[0] = '\0';
-    response->size = 0;
-    
-    // Set URL
-    curl_easy_setopt(client->curl, CURLOPT_URL, url);
-    
-    // Set POST data if provided
-    if (post_data) {
-        curl_easy_setopt(client->curl, CURLOPT_POSTFIELDS, post_data);
-        curl_easy_setopt(client->curl, CURLOPT_POSTFIELDSIZE, strlen(post_data));
+    wasmify_executor_t* executor = calloc(1, sizeof(wasmify_executor_t));
+    if (!executor) {
+        return NULL;
     }
     
-    // Set response callback
-    curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, response);
-    
-    // Set headers
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    if (client->config.api_key) {
-        char auth_header[256];
-        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", client->config.api_key);
-        headers = curl_slist_append(headers, auth_header);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t count = config.workers > 0 ? config.workers : cores > 0 ? (uint32_t)cores : 1;
+    if (count > EXECUTOR_MAX_WORKERS) count = EXECUTOR_MAX_WORKERS;
+    executor->module = module;
+    executor->pool_config = config.pool;
+    if (executor->pool_config.size == 0) executor->pool_config.size = EXECUTOR_DEFAULT_INSTANCES;
+    executor->workers = calloc(count, sizeof(executor_worker_t));
+    if (!executor->workers) {
+        free(executor);
+        return NULL;
+    }
+    pthread_mutex_init(&executor->lock, NULL);
+    pthread_cond_init(&executor->cond, NULL);
+    executor->worker_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        executor_worker_t* worker = &executor->workers[i];
+        worker->executor = executor;
+        worker->index = i;
+        pthread_mutex_init(&worker->deque.lock, NULL);
     }
-    curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
     
-    // Execute request
-    CURLcode res = curl_easy_perform(client->curl);
+    // Every deque exists before the first worker goes looking for work
+    for (uint32_t i = 0; i < count; i++) {
+        if (pthread_create(&executor->workers[i].thread, NULL, executor_worker, &executor->workers[i]) != 0) {
+            pthread_mutex_lock(&executor->lock);
+            executor->failed = 1;
+            pthread_mutex_unlock(&executor->lock);
+            break;
+        }
+        executor->thread_count = i + 1;
+    }
     
-    // Cleanup headers
-    curl_slist_free_all(headers);
+    // Wait for every pool, so that the first calls find them warm
+    pthread_mutex_lock(&executor->lock);
+    while (executor->started < executor->thread_count) {
+        pthread_cond_wait(&executor->cond, &executor->lock);
+    }
+    int failed = executor->failed;
+    pthread_mutex_unlock(&executor->lock);
+    if (failed) {
+        wasmify_executor_destroy(executor);
+        return NULL;
+    }
+    return executor;
+}
+
+// Finish every submitted call and destroy the executor
+void wasmify_executor_destroy(wasmify_executor_t* executor) {
+    if (!executor) return;
     
-    if (res != CURLE_OK) {
-        free(response->data);
-        return WASMIFY_ERROR_NETWORK;
+    pthread_mutex_lock(&executor->lock);
+    executor->stopping = 1;
+    pthread_cond_broadcast(&executor->cond);
+    pthread_mutex_unlock(&executor->lock);
+    for (uint32_t i = 0; i < executor->thread_count; i++) {
+        pthread_join(executor->workers[i].thread, NULL);
     }
     
-    // Check HTTP response code
-    long response_code;
-    curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    for (uint32_t i = 0; i < executor->worker_count; i++) {
+        executor_worker_t* worker = &executor->workers[i];
+        wasmify_instance_pool_destroy(worker->pool);
+        free(worker->deque.jobs);
+        pthread_mutex_destroy(&worker->deque.lock);
+    }
+    free(executor->workers);
+    pthread_cond_destroy(&executor->cond);
+    pthread_mutex_destroy(&executor->lock);
+    free(executor);
+}
+
+// Submit a call to an executor
+wasmify_error_t wasmify_executor_submit(
+    wasmify_executor_t* executor,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_callback_t callback,
+    void* user_data,
+    wasmify_future_t** future
+) {
+    if (!executor || !function_name || (args_count > 0 && !args) || !callback == !future) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    if (future) *future = NULL;
     
-    if (response_code != 200) {
-        free(response->data);
-        return WASMIFY_ERROR_NETWORK;
+    size_t name_size = strlen(function_name) + 1;
+    executor_job_t* job = malloc(sizeof(executor_job_t) + args_count * sizeof(wasmify_value_t) + name_size);
+    if (!job) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    job->args = (wasmify_value_t*)(job + 1);
+    job->args_count = args_count;
+    job->function_name = (char*)(job->args + args_count);
+    if (args_count > 0) memcpy(job->args, args, args_count * sizeof(wasmify_value_t));
+    memcpy(job->function_name, function_name, name_size);
+    job->task = NULL;
+    job->callback = callback;
+    job->user_data = user_data;
+    job->future = NULL;
+    if (future) {
+        job->future = calloc(1, sizeof(wasmify_future_t));
+        if (!job->future) {
+            free(job);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        pthread_mutex_init(&job->future->lock, NULL);
+        pthread_cond_init(&job->future->cond, NULL);
+        call_result_init(&job->future->result);
     }
     
+    wasmify_future_t* handle = job->future;
+    if (!executor_enqueue(executor, job)) {
+        future_free(handle);
+        free(job);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    if (future) *future = handle;
     return WASMIFY_SUCCESS;
 }
 
-// Upload a WebAssembly module
-wasmify_error_t wasmify_upload_module(
-    wasmify_client_t* client,
-    const char* file_path,
-    const char* name,
-    const char* version,
-    wasmify_module_t* module
-) {
-    if (!client || !file_path || !name || !version || !module) {
+// Whether the call behind a future has finished
+int wasmify_future_ready(wasmify_future_t* future) {
+    if (!future) return 0;
+    
+    pthread_mutex_lock(&future->lock);
+    int done = future->done;
+    pthread_mutex_unlock(&future->lock);
+    return done;
+}
+
+// Wait for the call behind a future and release the future
+wasmify_error_t wasmify_future_wait(wasmify_future_t* future, wasmify_call_result_t* result) {
+    if (!future) {
         return WASMIFY_ERROR_INVALID_PARAM;
     }
     
-    // For now, simulate upload
-    module->id = strdup("simulated-module-id");
-    module->name = strdup(name);
-    module->version = strdup(version);
-    module->file_path = strdup(file_path);
-    module->metadata = cJSON_CreateObject();
+    pthread_mutex_lock(&future->lock);
+    while (!future->done) {
+        pthread_cond_wait(&future->cond, &future->lock);
+    }
+    pthread_mutex_unlock(&future->lock);
     
-    return WASMIFY_SUCCESS;
+    wasmify_error_t error = future->error;
+    if (result) {
+        *result = future->result;
+    } else {
+        wasmify_call_result_free(&future->result);
+    }
+    future_free(future);
+    return error;
 }
 
-// Execute a WebAssembly module function
-wasmify_error_t wasmify_execute_module(
-    wasmify_client_t* client,
-    const char* module_id,
+// Execute WebAssembly module locally
+wasmify_error_t wasmify_execute_local(
+    const char* file_path,
     const char* function_name,
     char** args,
     int args_count,
     wasmify_result_t* result
 ) {
-    if (!client || !module_id || !function_name || !result) {
+    if (!file_path || !function_name || !result || args_count < 0 || (args_count > 0 && !args)) {
         return WASMIFY_ERROR_INVALID_PARAM;
     }
     
-    // Create JSON request
-    cJSON* request = cJSON_CreateObject();
-    cJSON* config = cJSON_CreateObject();
-    cJSON* memory = cJSON_CreateObject();
+    result_init(result);
     
-    cJSON_AddStringToObject(request, "moduleId", module_id);
-    cJSON_AddStringToObject(request, "functionName", function_name);
-    
-    // Add args array
-    cJSON* args_array = cJSON_CreateArray();
-    for (int i = 0; i < args_count; i++) {
-        cJSON_AddItemToArray(args_array, cJSON_CreateString(args[i]));
+    file_bytes_t file;
+    wasmify_error_t error = map_file(file_path, &file);
+    if (error != WASMIFY_SUCCESS) {
+        return local_fail(result, error, "failed to read module file");
     }
-    cJSON_AddItemToObject(request, "args", args_array);
-    
-    // Add config
-    cJSON_AddNumberToObject(memory, "min", 64);
-    cJSON_AddNumberToObject(memory, "max", 512);
-    cJSON_AddItemToObject(config, "memory", memory);
-    cJSON_AddNumberToObject(config, "maxExecutionTime", 30000);
-    cJSON_AddBoolToObject(config, "enableWasi", 1);
-    cJSON_AddItemToObject(request, "config", config);
     
-    char* json_data = cJSON_Print(request);
-    
-    // Build URL
-    char url[512];
-    snprintf(url, sizeof(url), "%s/wasm/execute", client->config.api_url);
+    char err[256];
+    wasmify_compiled_module_t* module = NULL;
+    error = module_acquire(file.data, file.size, &module, err, sizeof(err));
+    unmap_file(&file);
+    if (error != WASMIFY_SUCCESS) {
+        return local_fail(result, error, err);
+    }
     
-    // Execute request
-    wasmify_response_t response;
-    wasmify_error_t error = execute_request(client, url, json_data, NULL);
+    error = wasmify_execute_compiled(module, function_name, args, args_count, result);
+    wasmify_module_release(module);
+    return error;
+}
+
+// A page of a module listing as located in the response
+typedef struct {
+    int has_modules;
+    json_span_t modules;
+    json_span_t next_cursor;
+} module_page_spans_t;
+
+// Scan a listing page {success, error, data:[...], pagination:{nextCursor}};
+// errors are reported as by scan_envelope
+static wasmify_error_t scan_module_page(json_scan_t* s, module_page_spans_t* page, int* has_error, json_span_t* error) {
+    *has_error = 0;
+    if (!scan_char(s, '{')) {
+        return WASMIFY_ERROR_PARSE;
+    }
     
-    free(json_data);
-    cJSON_Delete(request);
+    int success = 0;
+    int first = 1, more;
+    json_span_t key, value;
+    while ((more = scan_member(s, &first, &key)) > 0) {
+        if (span_is(&key, "pagination") && scan_char(s, '{')) {
+            int pagination_first = 1, pagination_more;
+            json_span_t member;
+            while ((pagination_more = scan_member(s, &pagination_first, &member)) > 0) {
+                if (!scan_value(s, &value)) return WASMIFY_ERROR_PARSE;
+                if (span_is(&member, "nextCursor")) page->next_cursor = value;
+            }
+            if (pagination_more < 0) return WASMIFY_ERROR_PARSE;
+            continue;
+        }
+        if (!scan_value(s, &value)) return WASMIFY_ERROR_PARSE;
+        if (span_is(&key, "success")) {
+            success = value.kind == 't';
+        } else if (span_is(&key, "error") && value.kind == '"') {
+            *has_error = 1;
+            *error = value;
+        } else if (span_is(&key, "data") && value.kind == '[') {
+            page->has_modules = 1;
+            page->modules = value;
+        }
+    }
+    if (more < 0) {
+        return WASMIFY_ERROR_PARSE;
+    }
+    return success ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+// Scan one module of a listing into views of its fields
+static wasmify_error_t scan_module_info(json_scan_t* s, wasmify_module_info_t* info) {
+    static const char* const names[] = { "id", "name", "version", "description", "language", "hash", "createdAt" };
+    const char** fields[] = {
+        &info->id, &info->name, &info->version, &info->description, &info->language, &info->hash, &info->created_at
+    };
+    enum { FIELD_COUNT = sizeof(names) / sizeof(names[0]) };
     
-    if (error != WASMIFY_SUCCESS) {
-        return error;
+    memset(info, 0, sizeof(*info));
+    if (!scan_char(s, '{')) {
+        return WASMIFY_ERROR_PARSE;
     }
     
-    // Simulate result
-    result->success = 1;
-    result->result = strdup("simulated execution result");
-    result->execution_time = 42.5;
-    result->memory_used = 1024 * 1024;
-    result->error = NULL;
+    json_span_t spans[FIELD_COUNT];
+    int present[FIELD_COUNT] = {0};
+    int first = 1, more;
+    json_span_t key, value;
+    while ((more = scan_member(s, &first, &key)) > 0) {
+        if (!scan_value(s, &value)) return WASMIFY_ERROR_PARSE;
+        if (span_is(&key, "size")) {
+            double size = span_number(&value);
+            info->size = size > 0 ? (uint64_t)size : 0;
+        } else if (span_is(&key, "isPublic")) {
+            info->is_public = value.kind == 't';
+        } else if (value.kind == '"') {
+            for (int i = 0; i < FIELD_COUNT; i++) {
+                if (span_is(&key, names[i])) {
+                    spans[i] = value;
+                    present[i] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    if (more < 0 || !present[0]) {
+        return WASMIFY_ERROR_PARSE;
+    }
     
+    // The module has been scanned past, so its strings can be terminated in place
+    size_t len;
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if (present[i]) *fields[i] = span_view(&spans[i], &len);
+    }
     return WASMIFY_SUCCESS;
 }
 
-// Execute WebAssembly module locally
-wasmify_error_t wasmify_execute_local(
-    const char* file_path,
-    const char* function_name,
-    char** args,
-    int args_count,
-    wasmify_result_t* result
+// Modules per listing request when the filter leaves it to the SDK
+#define MODULE_PAGE_SIZE 100
+
+struct wasmify_module_iter {
+    wasmify_client_t* client;
+    char* query;                // Listing endpoint with the filter, without the cursor
+    char* cursor;               // Where the next page starts, NULL for the first
+    int last_page;              // No page follows the current one
+    int in_page;                // Modules of the current page are being walked
+    int first;                  // Next element is the page's first
+    json_scan_t scan;           // Position within the current page's modules
+    wasmify_response_t page;
+    wasmify_module_info_t info;
+};
+
+// Append name=value to a URL ending in its query string, unless value is empty
+static int query_param(json_buf_t* buf, const char* name, const char* value) {
+    if (buf->failed) return 0;
+    if (!value || !*value) return 1;
+    char* escaped = curl_easy_escape(NULL, value, 0);
+    if (!escaped) return 0;
+    if (buf->data[buf->size - 1] != '?') JSON_LITERAL(buf, "&");
+    json_raw(buf, name, strlen(name));
+    JSON_LITERAL(buf, "=");
+    json_raw(buf, escaped, strlen(escaped));
+    curl_free(escaped);
+    return !buf->failed;
+}
+
+wasmify_error_t wasmify_module_iter_create(
+    wasmify_client_t* client,
+    const wasmify_module_filter_t* filter,
+    wasmify_module_iter_t** iter
 ) {
-    if (!file_path || !function_name || !result) {
+    if (!client || !iter) {
         return WASMIFY_ERROR_INVALID_PARAM;
     }
+    static const wasmify_module_filter_t all = { NULL, NULL, NULL, 0 };
+    if (!filter) filter = &all;
     
-    // Simulate local execution
-    clock_t start = clock();
+    wasmify_module_iter_t* it = calloc(1, sizeof(wasmify_module_iter_t));
+    if (!it) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    it->client = client;
     
-    // Simulate execution time
-    for (volatile int i = 0; i < 1000000; i++);
+    json_buf_t query = {0};
+    json_raw(&query, client->config.api_url, strlen(client->config.api_url));
+    JSON_LITERAL(&query, "/modules?");
+    // A limit is always sent, since without one the server lists everything at once
+    char number[32];
+    snprintf(number, sizeof(number), "%d", filter->page_size > 0 ? filter->page_size : MODULE_PAGE_SIZE);
+    int ok = !query.failed && query_param(&query, "limit", number);
+    ok = ok && query_param(&query, "name", filter->name_prefix) &&
+         query_param(&query, "version", filter->version_prefix);
+    it->query = query.data;
+    if (ok && filter->after && *filter->after) {
+        it->cursor = strdup(filter->after);
+        ok = it->cursor != NULL;
+    }
+    if (!ok) {
+        wasmify_module_iter_free(it);
+        return WASMIFY_ERROR_MEMORY;
+    }
     
-    double execution_time = ((double)(clock() - start)) / CLOCKS_PER_SEC * 1000;
+    *iter = it;
+    return WASMIFY_SUCCESS;
+}
+
+// Fetch the page at the iterator's cursor and position it on the first module
+static wasmify_error_t module_iter_fetch(wasmify_module_iter_t* it) {
+    connection_t* conn = acquire_connection(it->client);
+    if (!conn) {
+        return WASMIFY_ERROR_MEMORY;
+    }
     
-    // Create result
-    result->success = 1;
-    result->result = malloc(256);
-    snprintf(result->result, 256, "Executed %s with %d args", function_name, args_count);
-    result->execution_time = execution_time;
-    result->memory_used = 1024 * 1024; // 1MB
-    result->error = NULL;
+    json_buf_t url = {0};
+    json_raw(&url, it->query, strlen(it->query));
+    wasmify_error_t error = query_param(&url, "cursor", it->cursor) ? WASMIFY_SUCCESS : WASMIFY_ERROR_MEMORY;
+    if (error == WASMIFY_SUCCESS) {
+        error = execute_request(it->client, conn, url.data, NULL, 0, &it->page);
+    }
+    release_connection(it->client, conn);
+    free(url.data);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    // One pass over the page locates its modules and cursor without parsing them
+    module_page_spans_t spans = {0};
+    json_scan_t s = { it->page.data, it->page.data + it->page.size };
+    int has_api_error;
+    json_span_t api_error;
+    error = scan_module_page(&s, &spans, &has_api_error, &api_error);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    if (!spans.has_modules) {
+        return WASMIFY_ERROR_PARSE;
+    }
     
+    char* cursor = spans.next_cursor.kind == '"' ? span_dup(&spans.next_cursor) : NULL;
+    if (spans.next_cursor.kind == '"' && !cursor) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    free(it->cursor);
+    it->cursor = cursor;
+    it->last_page = cursor == NULL;
+    it->scan.p = spans.modules.start + 1;
+    it->scan.end = spans.modules.start + spans.modules.len;
+    it->first = 1;
+    it->in_page = 1;
     return WASMIFY_SUCCESS;
 }
 
-// List all available modules
-wasmify_error_t wasmify_list_modules(
+wasmify_error_t wasmify_module_iter_next(wasmify_module_iter_t* iter, const wasmify_module_info_t** module) {
+    if (!iter || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *module = NULL;
+    
+    for (;;) {
+        if (iter->in_page) {
+            int more = scan_element(&iter->scan, &iter->first);
+            if (more < 0) {
+                return WASMIFY_ERROR_PARSE;
+            }
+            if (more > 0) {
+                wasmify_error_t error = scan_module_info(&iter->scan, &iter->info);
+                if (error != WASMIFY_SUCCESS) {
+                    return error;
+                }
+                *module = &iter->info;
+                return WASMIFY_SUCCESS;
+            }
+            iter->in_page = 0;
+            if (iter->last_page) {
+                return WASMIFY_SUCCESS;
+            }
+        } else if (iter->last_page) {
+            return WASMIFY_SUCCESS;
+        }
+        
+        wasmify_error_t error = module_iter_fetch(iter);
+        if (error != WASMIFY_SUCCESS) {
+            return error;
+        }
+    }
+}
+
+void wasmify_module_iter_free(wasmify_module_iter_t* iter) {
+    if (!iter) return;
+    
+    free(iter->query);
+    free(iter->cursor);
+    free(iter->page.data);
+    free(iter);
+}
+
+// Copy a listing into an array of modules, from the arena if there is one. An
+// arena cannot grow allocations, so the array is copied as it doubles and
+// the old copies stay in the arena, at most as much again as the final one.
+static wasmify_error_t list_modules(
     wasmify_client_t* client,
+    wasmify_arena_t* arena,
     wasmify_module_t** modules,
     int* modules_count
 ) {
     if (!client || !modules || !modules_count) {
         return WASMIFY_ERROR_INVALID_PARAM;
     }
-    
-    // For now, return empty list
     *modules = NULL;
     *modules_count = 0;
     
+    wasmify_module_iter_t* iter;
+    wasmify_error_t error = wasmify_module_iter_create(client, NULL, &iter);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    wasmify_module_t* list = NULL;
+    int count = 0, cap = 0;
+    const wasmify_module_info_t* info;
+    while ((error = wasmify_module_iter_next(iter, &info)) == WASMIFY_SUCCESS && info) {
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : 64;
+            size_t size = sizeof(wasmify_module_t) * (size_t)new_cap;
+            wasmify_module_t* grown = arena ? arena_alloc(arena, size) : realloc(list, size);
+            if (!grown) {
+                error = WASMIFY_ERROR_MEMORY;
+                break;
+            }
+            if (arena && count > 0) memcpy(grown, list, sizeof(wasmify_module_t) * (size_t)count);
+            list = grown;
+            cap = new_cap;
+        }
+        wasmify_module_t* module = &list[count++];
+        memset(module, 0, sizeof(*module));
+        module->id = result_strdup(arena, info->id);
+        module->name = info->name ? result_strdup(arena, info->name) : NULL;
+        module->version = info->version ? result_strdup(arena, info->version) : NULL;
+        if (!module->id || (info->name && !module->name) || (info->version && !module->version)) {
+            error = WASMIFY_ERROR_MEMORY;
+            break;
+        }
+    }
+    wasmify_module_iter_free(iter);
+    if (error != WASMIFY_SUCCESS) {
+        if (!arena) wasmify_module_list_free(list, count);
+        return error;
+    }
+    
+    *modules = list;
+    *modules_count = count;
+    
     return WASMIFY_SUCCESS;
 }
 
+// List all available modules
+wasmify_error_t wasmify_list_modules(
+    wasmify_client_t* client,
+    wasmify_module_t** modules,
+    int* modules_count
+) {
+    return list_modules(client, NULL, modules, modules_count);
+}
+
+wasmify_error_t wasmify_list_modules_arena(
+    wasmify_client_t* client,
+    wasmify_arena_t* arena,
+    wasmify_module_t** modules,
+    int* modules_count
+) {
+    return list_modules(client, arena, modules, modules_count);
+}
+
+// Free an array of modules from wasmify_list_modules
+void wasmify_module_list_free(wasmify_module_t* modules, int modules_count) {
+    if (!modules) return;
+    
+    for (int i = 0; i < modules_count; i++) {
+        wasmify_module_free(&modules[i]);
+    }
+    free(modules);
+}
+
 // Deploy module to edge locations
 wasmify_error_t wasmify_deploy_to_edge(
     wasmify_client_t* client,
@@ -293,35 +7533,83 @@ wasmify_error_t wasmify_deploy_to_edge(
     int regions_count,
     char** deployment_id
 ) {
-    if (!client || !module_id || !deployment_id) {
+    if (!client || !module_id || !deployment_id || regions_count < 0 || (regions_count > 0 && !regions)) {
         return WASMIFY_ERROR_INVALID_PARAM;
     }
+    *deployment_id = NULL;
     
-    // Simulate deployment
-    *deployment_id = strdup("simulated-deployment-id");
+    char* url = endpoint_url(&client->config, "/edge");
+    connection_t* conn = url ? acquire_connection(client) : NULL;
+    if (!conn) {
+        free(url);
+        return WASMIFY_ERROR_MEMORY;
+    }
     
-    return WASMIFY_SUCCESS;
+    json_buf_t* body = &conn->body;
+    json_reset(body);
+    JSON_LITERAL(body, "{\"action\":\"deploy\",\"moduleId\":");
+    json_string(body, module_id);
+    JSON_LITERAL(body, ",\"regions\":[");
+    for (int i = 0; i < regions_count; i++) {
+        if (i > 0) JSON_LITERAL(body, ",");
+        json_string(body, regions[i] ? regions[i] : "");
+    }
+    JSON_LITERAL(body, "]}");
+    
+    cJSON* data = NULL;
+    wasmify_error_t error = upload_request(client, conn, url, &data);
+    release_connection(client, conn);
+    free(url);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+    
+    // The server answers with the regions it deployed to
+    cJSON* deployment = cJSON_GetObjectItemCaseSensitive(data, "deployment");
+    cJSON* id = cJSON_GetObjectItemCaseSensitive(deployment, "id");
+    cJSON* deployed = cJSON_GetObjectItemCaseSensitive(data, "regions");
+    int deployed_count = cJSON_GetArraySize(deployed);
+    char** names = deployed_count > 0 ? calloc((size_t)deployed_count, sizeof(char*)) : NULL;
+    for (int i = 0; names && i < deployed_count; i++) {
+        cJSON* region = cJSON_GetArrayItem(deployed, i);
+        names[i] = cJSON_IsString(region) ? region->valuestring : NULL;
+    }
+    
+    if (!cJSON_IsString(id)) {
+        error = WASMIFY_ERROR_PARSE;
+    } else if (!(*deployment_id = strdup(id->valuestring)) || (deployed_count > 0 && !names)) {
+        error = WASMIFY_ERROR_MEMORY;
+    } else {
+        error = wasmify_set_module_regions(client, module_id, names, deployed_count);
+    }
+    if (error != WASMIFY_SUCCESS) {
+        free(*deployment_id);
+        *deployment_id = NULL;
+    }
+    free(names);
+    cJSON_Delete(data);
+    return error;
 }
 
-// Free module structure
+// Free the contents of a module structure
 void wasmify_module_free(wasmify_module_t* module) {
     if (!module) return;
     
-    if (module->id) free(module->id);
-    if (module->name) free(module->name);
-    if (module->version) free(module->version);
-    if (module->file_path) free(module->file_path);
+    free(module->id);
+    free(module->name);
+    free(module->version);
+    free(module->file_path);
     if (module->metadata) cJSON_Delete(module->metadata);
-    free(module);
+    memset(module, 0, sizeof(*module));
 }
 
-// Free result structure
+// Free the contents of a result structure
 void wasmify_result_free(wasmify_result_t* result) {
     if (!result) return;
     
-    if (result->result) free(result->result);
-    if (result->error) free(result->error);
-    free(result);
+    free(result->result);
+    free(result->error);
+    result_init(result);
 }
 
 // Convenience function to run WASM quickly
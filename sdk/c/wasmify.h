@@ -6,6 +6,7 @@
 #ifndef WASMIFY_H
 #define WASMIFY_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +24,11 @@ typedef enum {
     WASMIFY_ERROR_NETWORK = -2,
     WASMIFY_ERROR_PARSE = -3,
     WASMIFY_ERROR_EXECUTION = -4,
-    WASMIFY_ERROR_MEMORY = -5
+    WASMIFY_ERROR_MEMORY = -5,
+    WASMIFY_ERROR_RATE_LIMITED = -6,    // The server answered 429
+    WASMIFY_ERROR_SERVER = -7,          // The server answered with a 5xx
+    WASMIFY_ERROR_TIMEOUT = -8,         // No answer within the configured timeout
+    WASMIFY_ERROR_UNAVAILABLE = -9      // Every endpoint's circuit is open; nothing was sent
 } wasmify_error_t;
 
 // WebAssembly module structure
@@ -35,6 +40,46 @@ typedef struct {
     cJSON* metadata;
 } wasmify_module_t;
 
+// One module of a listing. The strings belong to the iterator and stay valid
+// until its next call; those the server left out are NULL.
+typedef struct {
+    const char* id;
+    const char* name;
+    const char* version;
+    const char* description;
+    const char* language;
+    const char* hash;
+    const char* created_at;     // ISO 8601
+    uint64_t size;              // Bytes
+    int is_public;
+} wasmify_module_info_t;
+
+// Which modules a listing returns, newest first
+typedef struct {
+    const char* name_prefix;    // NULL or "" for any name
+    const char* version_prefix; // NULL or "" for any version
+    const char* after;          // Start after the module with this ID, e.g. the last one seen before
+    int page_size;              // Modules per request, 0 = 100; the server caps it at 1000
+} wasmify_module_filter_t;
+
+// Listing of the registry's modules, fetched a page at a time
+typedef struct wasmify_module_iter wasmify_module_iter_t;
+
+// Where the wall-clock time of a call went, in milliseconds on the
+// monotonic clock. Remote phases come from libcurl's timings of the request
+// that was answered and the server's Server-Timing header. Phases a call
+// skipped, e.g. connecting on a reused connection, are 0, and together the
+// phases add up to total.
+typedef struct {
+    double total;
+    double queue;               // Until the request went out: waiting for a connection, earlier attempts; locally, instantiating
+    double connect;             // Name lookup and TCP connect
+    double tls;                 // TLS handshake
+    double send;                // Sending the request and waiting for the answer, less execute
+    double execute;             // Running the function, as the server reports it for remote calls
+    double receive;             // Receiving and parsing the response; locally, converting the results
+} wasmify_timing_t;
+
 // Execution result structure
 typedef struct {
     int success;
@@ -42,31 +87,343 @@ typedef struct {
     double execution_time;
     size_t memory_used;
     char* error;
+    wasmify_timing_t timing;
+    uint32_t memory_peak_pages; // Largest linear memory size the call reached, local runs only
 } wasmify_result_t;
 
+// Kinds of typed values; the numbering doubles as the binary wire format tag
+typedef enum {
+    WASMIFY_VAL_I32 = 1,
+    WASMIFY_VAL_I64 = 2,
+    WASMIFY_VAL_F32 = 3,
+    WASMIFY_VAL_F64 = 4,
+    WASMIFY_VAL_BYTES = 5,      // Opaque bytes, passed by reference like an externref
+    WASMIFY_VAL_V128 = 6
+} wasmify_valkind_t;
+
+// Typed argument or result value
+typedef struct {
+    wasmify_valkind_t kind;
+    union {
+        int32_t i32;
+        int64_t i64;
+        float f32;
+        double f64;
+        uint8_t v128[16];
+        struct {
+            const uint8_t* data;
+            size_t size;
+        } bytes;
+    } of;
+} wasmify_value_t;
+
+// Result of a typed call
+typedef struct {
+    int success;
+    wasmify_value_t* values;    // Result values, byte payloads stored alongside
+    size_t values_count;
+    double execution_time;
+    size_t memory_used;
+    char* error;
+    wasmify_timing_t timing;
+    uint32_t memory_peak_pages; // Largest linear memory size the call reached, local runs only
+} wasmify_call_result_t;
+
+// Arguments of one invocation in a batch
+typedef struct {
+    char** args;
+    int args_count;
+} wasmify_args_t;
+
+// Compiled module handle for local execution
+typedef struct wasmify_compiled_module wasmify_compiled_module_t;
+
+// Compiled module cache counters
+typedef struct {
+    size_t entries;
+    size_t bytes;
+    size_t budget;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t disk_hits;     // Misses served from the on-disk cache
+    uint64_t disk_writes;   // Compiled modules written to the on-disk cache
+} wasmify_module_cache_stats_t;
+
+// Default linear memory limits, in 64 KiB pages
+#define WASMIFY_DEFAULT_MEMORY_MIN 64
+#define WASMIFY_DEFAULT_MEMORY_MAX 512
+
+// Time slice of a task when none is configured, in milliseconds
+#define WASMIFY_DEFAULT_SLICE_MS 10
+
+// Execution limits of local calls. Fuel stands in for instructions: each
+// loop iteration burns the length of its body and each call one unit, so
+// a call that outlives its fuel traps with "out of fuel" and one that
+// outlives its deadline fails with WASMIFY_ERROR_TIMEOUT. Both are checked
+// without a per-instruction cost, at loop back-edges and calls.
+typedef struct {
+    uint32_t deadline_ms;   // Wall-clock limit, 0 = none
+    uint64_t fuel;          // Fuel units, 0 = unlimited
+    uint32_t slice_ms;      // Time slice of tasks, 0 = WASMIFY_DEFAULT_SLICE_MS
+} wasmify_limits_t;
+
+// Local call run a time slice at a time
+typedef struct wasmify_task wasmify_task_t;
+
+// Instance held by the application across calls, for buffers in its memory
+typedef struct wasmify_instance wasmify_instance_t;
+
+// Worker threads running local calls of one compiled module
+typedef struct wasmify_executor wasmify_executor_t;
+
+// Pending result of a call submitted to an executor
+typedef struct wasmify_future wasmify_future_t;
+
+// Pool of ready instances of one compiled module
+typedef struct wasmify_instance_pool wasmify_instance_pool_t;
+
+// Linear memory that instances of a module declaring it shared use at once
+typedef struct wasmify_shared_memory wasmify_shared_memory_t;
+
+// Stages of module functions, each fed by literal arguments and the results
+// of earlier stages, run as one request or in one process
+typedef struct wasmify_pipeline wasmify_pipeline_t;
+
+// Instance pool configuration
+typedef struct {
+    uint32_t size;          // Ready instances kept, 0 = default
+    uint32_t memory_min;    // Initial memory pages, 0 = the module's minimum, like fresh instances
+    uint32_t memory_max;    // Maximum memory pages, 0 = WASMIFY_DEFAULT_MEMORY_MAX
+    wasmify_limits_t limits;    // Limits of calls on the pool, all 0 = those of the calling thread
+    wasmify_shared_memory_t* memory;    // Memory every instance shares, NULL = one each
+} wasmify_pool_config_t;
+
+// Executor configuration
+typedef struct {
+    uint32_t workers;           // Worker threads, 0 = one per online core
+    wasmify_pool_config_t pool; // Instance pool of each worker, size 0 = 2
+} wasmify_executor_config_t;
+
+// Encoding of execute requests and results on the wire
+typedef enum {
+    WASMIFY_WIRE_JSON = 0,      // JSON with arguments and results as text
+    WASMIFY_WIRE_BINARY = 1     // Length-prefixed frames of typed i32/i64/f32/f64/bytes values
+} wasmify_wire_format_t;
+
+// Compression of request and response bodies. Responses are decoded as they
+// arrive; request bodies of at least 1KB, and upload chunks, are sent
+// Content-Encoded. zstd request bodies need the SDK built with
+// WASMIFY_WITH_ZSTD and fall back to gzip otherwise; a server that refuses an
+// encoding with 415 gets uncompressed requests from then on.
+typedef enum {
+    WASMIFY_COMPRESSION_NONE = 0,
+    WASMIFY_COMPRESSION_GZIP = 1,
+    WASMIFY_COMPRESSION_ZSTD = 2    // Preferred, with gzip for whatever cannot use zstd
+} wasmify_compression_t;
+
+// Regional API endpoint
+typedef struct {
+    const char* region;     // Region ID as passed to wasmify_deploy_to_edge, e.g. "eu-west-1"
+    const char* api_url;
+} wasmify_endpoint_t;
+
 // Client configuration
 typedef struct {
     char* api_url;
     char* api_key;
     int timeout;
+    int max_connections;    // Pooled connections per host, 0 = one connection, no pooling
+    int http2;              // Multiplex pooled requests over HTTP/2
+    wasmify_wire_format_t wire_format;  // Execute request encoding; results come back as the server chooses
+    wasmify_compression_t compression;  // Body compression, off by default
+    // Regions executions are routed over, at most 64; NULL = api_url only.
+    // api_url, which defaults to the first of them, serves everything else.
+    const wasmify_endpoint_t* endpoints;
+    int endpoints_count;
+    int hedge;              // Repeat executions still unanswered after their endpoint's p95
+    size_t result_cache_bytes;  // Budget for results of pure functions, 0 = no result cache
+    int result_cache_ttl;   // Seconds cached results are reused, 0 = until evicted
+    // Retries of calls that failed to connect, timed out or got a 429 or 5xx,
+    // 0 = none. Each waits a random time up to retry_backoff_ms, doubling per
+    // retry up to retry_max_ms, or as long as Retry-After asks if that is
+    // longer; calls asked to wait longer than retry_max_ms fail instead.
+    int retries;
+    int retry_backoff_ms;   // 0 = 100
+    int retry_max_ms;       // 0 = 10000
 } wasmify_config_t;
 
+// What requests to one endpoint have measured
+typedef struct {
+    const char* region;     // NULL for api_url when no endpoints are configured
+    const char* api_url;
+    double rtt_ms;          // Moving average of request times
+    double p95_ms;          // Over recent requests, 0 until there are enough of them
+    double error_rate;      // Moving average of the share of requests that failed
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t hedges;        // Repeated requests sent here
+    int healthy;            // Neither failing often nor taken out of rotation
+    int circuit_open;       // Taken out of rotation until its next probe
+} wasmify_endpoint_stats_t;
+
+// Result cache counters
+typedef struct {
+    size_t entries;
+    size_t bytes;
+    size_t budget;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} wasmify_result_cache_stats_t;
+
+// Shared connection state of a pooled client
+typedef struct wasmify_connection_pool wasmify_connection_pool_t;
+
+// Event loop driving a client's asynchronous calls
+typedef struct wasmify_event_loop wasmify_event_loop_t;
+
+// Repeated call of one module function with its request setup done once
+typedef struct wasmify_prepared_call wasmify_prepared_call_t;
+
+// Bump allocator that results can be taken from and released all at once
+typedef struct wasmify_arena wasmify_arena_t;
+
 // Client structure
 typedef struct {
     wasmify_config_t config;
-    CURL* curl;
+    CURL* curl;                     // Single handle, NULL in pooled mode
+    wasmify_connection_pool_t* pool;
+    wasmify_event_loop_t* loop;
 } wasmify_client_t;
 
+// Socket events exchanged with an application event loop
+#define WASMIFY_POLL_IN 1
+#define WASMIFY_POLL_OUT 2
+#define WASMIFY_POLL_ERROR 4
+#define WASMIFY_POLL_REMOVE 8
+
+// Pass as fd to wasmify_client_socket_action when the timer expires
+#define WASMIFY_SOCKET_TIMEOUT CURL_SOCKET_TIMEOUT
+
+/**
+ * Completion of an asynchronous execution
+ * @param error Error code of the call
+ * @param result Result valid during the callback whose contents the callback
+ *        owns, release them with wasmify_result_free; NULL when the request
+ *        itself failed
+ * @param user_data Value passed when the call was started
+ */
+typedef void (*wasmify_execute_callback_t)(wasmify_error_t error, wasmify_result_t* result, void* user_data);
+
+/**
+ * Completion of a call submitted to an executor
+ * @param error Error code of the call
+ * @param result Result valid during the callback whose contents the callback
+ *        owns, release them with wasmify_call_result_free; NULL when the
+ *        call could not be started
+ * @param user_data Value passed when the call was submitted
+ */
+typedef void (*wasmify_call_callback_t)(wasmify_error_t error, wasmify_call_result_t* result, void* user_data);
+
+/**
+ * Request to watch a socket, or stop watching it with WASMIFY_POLL_REMOVE
+ * @param fd Socket
+ * @param events WASMIFY_POLL_* flags
+ * @param user_data Value passed to wasmify_client_set_event_callbacks
+ */
+typedef void (*wasmify_socket_callback_t)(curl_socket_t fd, int events, void* user_data);
+
+/**
+ * Request to (re)arm the single timer, or disarm it when timeout_ms is -1
+ * @param timeout_ms Milliseconds until wasmify_client_socket_action must be
+ *        called with WASMIFY_SOCKET_TIMEOUT
+ * @param user_data Value passed to wasmify_client_set_event_callbacks
+ */
+typedef void (*wasmify_timer_callback_t)(long timeout_ms, void* user_data);
+
+// Kinds of events reported to an observer
+typedef enum {
+    WASMIFY_EVENT_REQUEST_START = 1,    // An API request is going out
+    WASMIFY_EVENT_REQUEST_END,          // It was answered, failed or, with status 0 and no error, abandoned for its hedge
+    WASMIFY_EVENT_RETRY,                // One goes out again: failover, a hedge or a re-send uncompressed
+    WASMIFY_EVENT_CACHE_HIT,            // A call answered from the result cache, or a module found compiled
+    WASMIFY_EVENT_CACHE_MISS,
+    WASMIFY_EVENT_COMPILE,              // A module was compiled, or mapped from the cache directory
+    WASMIFY_EVENT_INSTANTIATE,          // A local instance was created
+    WASMIFY_EVENT_POOL_CHECKOUT         // A call took an instance from an instance pool
+} wasmify_event_kind_t;
+
+// Event reported to an observer; its strings are only valid during the call
+typedef struct {
+    wasmify_event_kind_t kind;
+    wasmify_client_t* client;   // NULL for local events
+    const char* url;            // Of requests and retries
+    const char* traceparent;    // Header the request carries, NULL when no trace is propagated
+    const char* module_id;      // When known
+    const char* function_name;
+    const char* cache;          // "result" or "module" for cache events
+    long status;                // HTTP status of REQUEST_END, 0 when none was received
+    wasmify_error_t error;      // Outcome of REQUEST_END, COMPILE, INSTANTIATE and POOL_CHECKOUT
+    double duration_ms;         // Of REQUEST_END, COMPILE, INSTANTIATE and POOL_CHECKOUT
+    int reused;                 // POOL_CHECKOUT found an idle instance rather than creating one
+} wasmify_event_t;
+
+/**
+ * Observer of SDK events, e.g. to export metrics or trace spans
+ * Called on the thread where the event happened, possibly from several
+ * threads at once, so it must be thread-safe and quick.
+ * @param event What happened
+ * @param user_data Value passed to wasmify_set_observer
+ */
+typedef void (*wasmify_observer_t)(const wasmify_event_t* event, void* user_data);
+
 // Memory response structure for HTTP requests
 typedef struct {
     char* data;
     size_t size;
+    size_t capacity;
 } wasmify_response_t;
 
+// Execution result whose strings point into the view's own response buffer.
+// Zero-initialise before first use and reuse it across calls: the strings
+// stay valid until the view is passed to the next call or freed.
+typedef struct {
+    int success;
+    const char* result;
+    size_t result_len;
+    double execution_time;
+    size_t memory_used;
+    const char* error;
+    size_t error_len;
+    wasmify_timing_t timing;
+    wasmify_response_t buffer;
+} wasmify_result_view_t;
+
 // Function declarations
 
 /**
  * Create a new Wasmify client
+ * The client is thread-safe: any number of threads may call it at once
+ * without external locking. Each thread draws its connections from its own
+ * shard of the idle list. With max_connections set the shards split that
+ * budget and share DNS, TLS sessions and warm connections. With http2 set,
+ * requests are also multiplexed over those connections.
+ * Executions go to the fastest healthy endpoint among the regions their
+ * module is deployed to, and fail over to the next when an endpoint can't
+ * be reached or answers with a 5xx. Every request is timed: endpoints whose
+ * times are older than 30 seconds get the next request to measure them
+ * again. Three failures in a row open an endpoint's circuit: it is skipped
+ * for five seconds, then a single request probes it, closing the circuit if
+ * it succeeds and reopening it for twice as long, up to a minute, if not.
+ * Calls for which every circuit is open fail with WASMIFY_ERROR_UNAVAILABLE
+ * unless retries lets them wait for a probe. With hedge set an execution still unanswered after its
+ * endpoint's p95 is sent once more, to the next best region or the same one,
+ * and the first answer wins; functions called this way must be safe to run
+ * twice. Whenever an execution may be sent more than once, with retries or
+ * hedge set or with several endpoints to fail over to, it carries an
+ * Idempotency-Key that every attempt repeats, so a server that saw the
+ * first attempt answers the others without running the function again;
+ * batches do the same. Other POST requests are not retried.
  * @param config Client configuration
  * @return Client instance or NULL on error
  */
@@ -79,7 +436,41 @@ wasmify_client_t* wasmify_client_create(wasmify_config_t config);
 void wasmify_client_destroy(wasmify_client_t* client);
 
 /**
- * Upload a WebAssembly module
+ * Measurements of one of the client's endpoints
+ * @param client Client instance
+ * @param index Endpoint index, in configuration order
+ * @param stats Output measurements; the strings belong to the client
+ * @return Error code, WASMIFY_ERROR_INVALID_PARAM past the last endpoint
+ */
+wasmify_error_t wasmify_client_endpoint_stats(
+    wasmify_client_t* client,
+    int index,
+    wasmify_endpoint_stats_t* stats
+);
+
+/**
+ * Record which regions a module is deployed to, so that its executions are
+ * only routed to those. wasmify_deploy_to_edge records it too. Modules
+ * without regions, or none the client has an endpoint for, may go anywhere.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param regions Region IDs
+ * @param regions_count Number of regions, 0 to forget the module's regions
+ * @return Error code
+ */
+wasmify_error_t wasmify_set_module_regions(
+    wasmify_client_t* client,
+    const char* module_id,
+    char** regions,
+    int regions_count
+);
+
+/**
+ * Upload a WebAssembly module. The file is hashed first and not sent at all
+ * if the server already has its content; otherwise it is streamed in
+ * content-defined chunks, several at a time over the client's connections,
+ * and only the chunks the server does not have from this or any earlier
+ * upload are sent. The module ID is derived from the content hash.
  * @param client Client instance
  * @param file_path Path to .wasm file
  * @param name Module name
@@ -115,11 +506,378 @@ wasmify_error_t wasmify_execute_module(
 );
 
 /**
- * Execute WebAssembly module locally
- * @param file_path Path to .wasm file
+ * Execute a WebAssembly module function with the result taken from an arena
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param arena Arena holding the result strings until its next reset;
+ *        NULL for the heap as with wasmify_execute_module
+ * @param result Output result structure, not to be passed to wasmify_result_free
+ *        when it comes from an arena
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_module_arena(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+);
+
+/**
+ * Execute a WebAssembly module function, returning views instead of copies
+ * Nothing is allocated once the view's buffer has grown to fit the
+ * responses it sees.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param view Result view, reused across calls
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_module_view(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_view_t* view
+);
+
+/**
+ * Execute a WebAssembly module function with typed arguments and results
+ * With the binary wire format values travel as they are; with JSON they
+ * are sent as JSON numbers and strings, and v128 values are rejected.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param result Output result, release with wasmify_call_result_free
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_module_v(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+);
+
+/**
+ * Release the values and error of a typed call result
+ * The result structure itself belongs to the caller.
+ * @param result Typed call result
+ */
+void wasmify_call_result_free(wasmify_call_result_t* result);
+
+/**
+ * Prepare repeated calls of one module function
+ * The fixed part of the request is rendered once, so each call only adds
+ * its arguments. A prepared call may be used from any thread, like its
+ * client, and must be freed before the client is destroyed.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @return Prepared call or NULL on error
+ */
+wasmify_prepared_call_t* wasmify_prepare_call(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name
+);
+
+/**
+ * Execute a prepared call with string arguments
+ * @param prepared Prepared call
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param result Output result structure
+ * @return Error code
+ */
+wasmify_error_t wasmify_prepared_execute(
+    wasmify_prepared_call_t* prepared,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+);
+
+/**
+ * Execute a prepared call with string arguments and the result taken from an arena
+ * @param prepared Prepared call
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param arena Arena holding the result strings until its next reset, NULL for the heap
+ * @param result Output result structure
+ * @return Error code
+ */
+wasmify_error_t wasmify_prepared_execute_arena(
+    wasmify_prepared_call_t* prepared,
+    char** args,
+    int args_count,
+    wasmify_arena_t* arena,
+    wasmify_result_t* result
+);
+
+/**
+ * Execute a prepared call with typed arguments
+ * @param prepared Prepared call
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param result Output result, release with wasmify_call_result_free
+ * @return Error code
+ */
+wasmify_error_t wasmify_prepared_execute_v(
+    wasmify_prepared_call_t* prepared,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+);
+
+/**
+ * Free a prepared call
+ * @param prepared Prepared call
+ */
+void wasmify_prepared_call_free(wasmify_prepared_call_t* prepared);
+
+/**
+ * Free the buffer behind a result view
+ * @param view Result view
+ */
+void wasmify_result_view_free(wasmify_result_view_t* view);
+
+/**
+ * Execute many invocations of one function in a single request
+ * Every invocation gets its own result; the call returns
+ * WASMIFY_ERROR_EXECUTION if any of them failed.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @param batches Arguments of each invocation
+ * @param n Number of invocations
+ * @param out Output results, one per invocation
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_batch(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n,
+    wasmify_result_t* out
+);
+
+/**
+ * Execute many invocations of one function with the results taken from an arena
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function to execute
+ * @param batches Arguments of each invocation
+ * @param n Number of invocations
+ * @param arena Arena holding the result strings until its next reset, NULL for the heap
+ * @param out Output results, one per invocation
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_batch_arena(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    const wasmify_args_t* batches,
+    size_t n,
+    wasmify_arena_t* arena,
+    wasmify_result_t* out
+);
+
+/**
+ * Create an empty pipeline
+ * Stages are added in the order they run and take inputs only from stages
+ * added before them, so a pipeline is a DAG: one stage may feed several
+ * and take inputs from several.
+ * @return Pipeline, free with wasmify_pipeline_free; NULL when out of memory
+ */
+wasmify_pipeline_t* wasmify_pipeline_create(void);
+
+/**
+ * Add a stage calling a function of an uploaded module
+ * Such stages only run remotely.
+ * @param pipeline Pipeline
+ * @param module_id Module identifier
+ * @param function_name Function to call
+ * @param stage Output index of the stage, may be NULL
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_add(
+    wasmify_pipeline_t* pipeline,
+    const char* module_id,
+    const char* function_name,
+    size_t* stage
+);
+
+/**
+ * Add a stage calling a function of a compiled module
+ * Remotely the stage runs the uploaded module with the same ID.
+ * @param pipeline Pipeline, which holds a reference to the module
+ * @param module Compiled module
+ * @param function_name Function to call
+ * @param stage Output index of the stage, may be NULL
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_add_compiled(
+    wasmify_pipeline_t* pipeline,
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    size_t* stage
+);
+
+/**
+ * Append a literal argument to a stage, in the text form execute arguments take
+ * @param pipeline Pipeline
+ * @param stage Stage index
+ * @param value Argument text
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_arg(wasmify_pipeline_t* pipeline, size_t stage, const char* value);
+
+/**
+ * Append an argument taken from a result of an earlier stage
+ * The value passes between the stages as it is, without being formatted or
+ * sent back; locally its type must match the parameter exactly.
+ * @param pipeline Pipeline
+ * @param stage Stage index
+ * @param from_stage Index of an earlier stage
+ * @param result_index Which of its results to take
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_arg_from(
+    wasmify_pipeline_t* pipeline,
+    size_t stage,
+    size_t from_stage,
+    uint32_t result_index
+);
+
+/**
+ * Get the number of stages of a pipeline
+ * @param pipeline Pipeline
+ * @return Number of stages
+ */
+size_t wasmify_pipeline_stage_count(const wasmify_pipeline_t* pipeline);
+
+/**
+ * Execute a pipeline in a single request
+ * Every stage gets a result. Stages whose results feed other stages report
+ * success and timing but no result text; a stage whose input failed is not
+ * run. The call returns WASMIFY_ERROR_EXECUTION if any stage failed.
+ * @param client Client instance
+ * @param pipeline Pipeline
+ * @param results Output results, one per stage
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_execute(
+    wasmify_client_t* client,
+    const wasmify_pipeline_t* pipeline,
+    wasmify_result_t* results
+);
+
+/**
+ * Run a pipeline locally, every stage in a fresh instance of its module
+ * Results pass between stages in the engine's own representation. Results
+ * are reported as by wasmify_pipeline_execute, and every stage must have
+ * been added with wasmify_pipeline_add_compiled.
+ * @param pipeline Pipeline
+ * @param results Output results, one per stage
+ * @return Error code
+ */
+wasmify_error_t wasmify_pipeline_run_local(const wasmify_pipeline_t* pipeline, wasmify_result_t* results);
+
+/**
+ * Free a pipeline, releasing its modules
+ * @param pipeline Pipeline
+ */
+void wasmify_pipeline_free(wasmify_pipeline_t* pipeline);
+
+/**
+ * Start executing a WebAssembly module function asynchronously
+ * The call makes progress in wasmify_client_poll/wasmify_client_run, or in
+ * wasmify_client_socket_action when the client is attached to an
+ * application event loop. Asynchronous calls of one client must all be
+ * driven from the same thread. Retries wait on the loop's timer rather than
+ * a thread, and the call counts as running until its last attempt is done.
+ * @param client Client instance
+ * @param module_id Module identifier
  * @param function_name Function to execute
  * @param args Arguments array
  * @param args_count Number of arguments
+ * @param callback Completion callback, called exactly once
+ * @param user_data Value passed to the callback
+ * @return Error code; on error the callback is not called
+ */
+wasmify_error_t wasmify_execute_module_async(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_execute_callback_t callback,
+    void* user_data
+);
+
+/**
+ * Wait for activity on asynchronous calls and run completed callbacks
+ * @param client Client instance
+ * @param timeout_ms Longest time to wait, -1 to wait for activity
+ * @param running Output number of calls still in flight, may be NULL
+ * @return Error code
+ */
+wasmify_error_t wasmify_client_poll(wasmify_client_t* client, int timeout_ms, int* running);
+
+/**
+ * Drive asynchronous calls until all of them have completed
+ * @param client Client instance
+ * @return Error code
+ */
+wasmify_error_t wasmify_client_run(wasmify_client_t* client);
+
+/**
+ * Attach the client to an application event loop
+ * The callbacks report which sockets to watch and when the timer must fire;
+ * the application then reports readiness with wasmify_client_socket_action
+ * instead of calling wasmify_client_poll.
+ * @param client Client instance
+ * @param socket_callback Socket watch requests
+ * @param timer_callback Timer requests
+ * @param user_data Value passed to both callbacks
+ * @return Error code
+ */
+wasmify_error_t wasmify_client_set_event_callbacks(
+    wasmify_client_t* client,
+    wasmify_socket_callback_t socket_callback,
+    wasmify_timer_callback_t timer_callback,
+    void* user_data
+);
+
+/**
+ * Report socket readiness or timer expiry and run completed callbacks
+ * @param client Client instance
+ * @param fd Ready socket, or WASMIFY_SOCKET_TIMEOUT when the timer fired
+ * @param events WASMIFY_POLL_* flags observed on the socket
+ * @return Error code
+ */
+wasmify_error_t wasmify_client_socket_action(wasmify_client_t* client, curl_socket_t fd, int events);
+
+/**
+ * Execute WebAssembly module locally in the embedded engine
+ * Arguments are parsed according to the function's parameter types and
+ * results are returned as space-separated text.
+ * @param file_path Path to .wasm file
+ * @param function_name Exported function to execute
+ * @param args Arguments array
+ * @param args_count Number of arguments
  * @param result Output result structure
  * @return Error code
  */
@@ -131,10 +889,404 @@ wasmify_error_t wasmify_execute_local(
     wasmify_result_t* result
 );
 
+/**
+ * Compile a WebAssembly module for local execution
+ * Modules are cached process-wide by content hash, so compiling the same
+ * bytes again returns the already-compiled module.
+ * @param bytes Module binary
+ * @param size Size of the binary in bytes
+ * @param module Output handle, release with wasmify_module_release
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_compile(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_compiled_module_t** module
+);
+
+/**
+ * Compile a WebAssembly module file for local execution
+ * The file is mapped rather than read into memory while it is compiled.
+ * @param file_path Path to .wasm file
+ * @param module Output handle, release with wasmify_module_release
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_compile_file(
+    const char* file_path,
+    wasmify_compiled_module_t** module
+);
+
+/**
+ * Get the content-derived identifier of a compiled module
+ * Matches the module ID the server assigns to the same bytes.
+ * @param module Compiled module
+ * @return 16 hex character identifier owned by the module
+ */
+const char* wasmify_module_id(const wasmify_compiled_module_t* module);
+
+/**
+ * Release a compiled module handle
+ * @param module Compiled module
+ */
+void wasmify_module_release(wasmify_compiled_module_t* module);
+
+/**
+ * Run a module's initialization once and start its instances from the result
+ * Instantiates the module, runs its start function, its WASI _initialize and
+ * any "wizer.initialize" export, and keeps the memory, globals and tables
+ * they leave. Fresh-instance calls, pools and held instances of the module
+ * then map that memory copy-on-write instead of initializing again, except
+ * those given a shared memory. With a cache directory set the image is
+ * stored there next to the compiled module, and later processes load it
+ * instead (see wasmify_module_cache_set_dir).
+ * Initialization must give the same result every time: state it derives
+ * from the clock, random numbers or the environment is frozen into the
+ * snapshot. Modules with shared memory cannot be snapshotted.
+ * @param module Compiled module, kept for as long as its instances should
+ *               benefit, since the module cache may evict unheld modules
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_snapshot(wasmify_compiled_module_t* module);
+
+/**
+ * Execute a function of a compiled module in a fresh instance
+ * @param module Compiled module
+ * @param function_name Exported function to execute
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param result Output result structure
+ * @return Error code
+ */
+wasmify_error_t wasmify_execute_compiled(
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+);
+
+/**
+ * Call a function of a compiled module in a fresh instance with typed values
+ * Argument kinds must match the parameter types exactly; no conversion
+ * takes place. Reference results come back as empty bytes values.
+ * @param module Compiled module
+ * @param function_name Exported function to call
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param result Output result, release with wasmify_call_result_free
+ * @return Error code
+ */
+wasmify_error_t wasmify_call(
+    wasmify_compiled_module_t* module,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+);
+
+/**
+ * Limit the local calls made on the calling thread
+ * Applies to every fresh-instance call and to pooled calls whose pool was
+ * created without limits of its own.
+ * @param limits Execution limits, NULL for none
+ */
+void wasmify_set_local_limits(const wasmify_limits_t* limits);
+
+/**
+ * Set the byte budget of the compiled module cache
+ * Least recently used modules beyond the budget are evicted once no
+ * handle refers to them. A budget of 0 disables caching.
+ * @param bytes Budget in bytes
+ */
+void wasmify_module_cache_set_budget(size_t bytes);
+
+/**
+ * Evict every cached module that no handle refers to
+ */
+void wasmify_module_cache_clear(void);
+
+/**
+ * Keep compiled modules in a directory shared across processes
+ * Modules compiled while a directory is set are written there, keyed by
+ * content hash, engine version and CPU features, and processes that start
+ * later map them instead of compiling again. The directory is created if
+ * missing and must be as trusted as the modules themselves.
+ * @param dir Directory path, NULL to stop using one
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_cache_set_dir(const char* dir);
+
+/**
+ * Get compiled module cache counters
+ * @param stats Output counters
+ */
+void wasmify_module_cache_stats(wasmify_module_cache_stats_t* stats);
+
+/**
+ * Create a pool of pre-warmed instances of a compiled module
+ * Each instance is snapshotted after instantiation and reset to that
+ * snapshot after every call, so calls stay isolated without paying for
+ * a fresh instantiation.
+ * @param module Compiled module, the pool keeps its own reference
+ * @param config Pool configuration
+ * @return Pool or NULL on failure
+ */
+wasmify_instance_pool_t* wasmify_instance_pool_create(
+    wasmify_compiled_module_t* module,
+    wasmify_pool_config_t config
+);
+
+/**
+ * Destroy an instance pool
+ * @param pool Instance pool
+ */
+void wasmify_instance_pool_destroy(wasmify_instance_pool_t* pool);
+
+/**
+ * Execute a function on an instance taken from the pool
+ * The call blocks no other caller; if every instance is busy a temporary
+ * one is created for it.
+ * @param pool Instance pool
+ * @param function_name Exported function to execute
+ * @param args Arguments array
+ * @param args_count Number of arguments
+ * @param result Output result structure
+ * @return Error code
+ */
+wasmify_error_t wasmify_pool_execute(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    char** args,
+    int args_count,
+    wasmify_result_t* result
+);
+
+/**
+ * Call a function on an instance taken from the pool with typed values
+ * @param pool Instance pool
+ * @param function_name Exported function to call
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param result Output result, release with wasmify_call_result_free
+ * @return Error code
+ */
+wasmify_error_t wasmify_pool_call(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+);
+
+/**
+ * Create an instance of a compiled module for the application to hold
+ * The instance keeps its state from one call to the next, so inputs can be
+ * written straight into its linear memory before a call and outputs read
+ * from there after it, with no copy on either side.
+ * @param module Compiled module, the instance keeps its own reference
+ * @param instance Output instance, release with wasmify_instance_release
+ * @return Error code
+ */
+wasmify_error_t wasmify_instance_create(wasmify_compiled_module_t* module, wasmify_instance_t** instance);
+
+/**
+ * Create a shared linear memory for a module that declares one
+ * Instances created on it, and pools configured with it, all see the same
+ * memory, so threads calling into each at once can cooperate through the
+ * module's atomics and its memory.atomic.wait and notify. Whatever holds
+ * the memory keeps its own reference, so it may be released right away.
+ * Shared memory is never reset between pooled calls.
+ * @param module Compiled module with a shared memory
+ * @param memory Output memory, release with wasmify_shared_memory_release
+ * @return Error code; WASMIFY_ERROR_INVALID_PARAM if the memory isn't shared
+ */
+wasmify_error_t wasmify_shared_memory_create(wasmify_compiled_module_t* module, wasmify_shared_memory_t** memory);
+
+/**
+ * Release a shared memory; it is freed once no instance uses it
+ * @param memory Shared memory
+ */
+void wasmify_shared_memory_release(wasmify_shared_memory_t* memory);
+
+/**
+ * Create an instance of a compiled module on a shared memory
+ * @param module Compiled module, the instance keeps its own reference
+ * @param memory Shared memory from wasmify_shared_memory_create
+ * @param instance Output instance, release with wasmify_instance_release
+ * @return Error code
+ */
+wasmify_error_t wasmify_instance_create_shared(
+    wasmify_compiled_module_t* module,
+    wasmify_shared_memory_t* memory,
+    wasmify_instance_t** instance
+);
+
+/**
+ * Take an instance out of a pool and hold it across calls
+ * It is reset to its snapshot only when released.
+ * @param pool Instance pool
+ * @param instance Output instance, release with wasmify_instance_release
+ * @return Error code
+ */
+wasmify_error_t wasmify_pool_acquire(wasmify_instance_pool_t* pool, wasmify_instance_t** instance);
+
+/**
+ * Give an instance back to its pool, or free it if it has none
+ * Every buffer leased in it and every view of its memory becomes invalid.
+ * @param instance Instance
+ */
+void wasmify_instance_release(wasmify_instance_t* instance);
+
+/**
+ * Call a function on a held instance with typed values
+ * @param instance Instance
+ * @param function_name Exported function to call
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param result Output result, release with wasmify_call_result_free
+ * @return Error code
+ */
+wasmify_error_t wasmify_instance_call(
+    wasmify_instance_t* instance,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_result_t* result
+);
+
+/**
+ * Lease a buffer in an instance's linear memory
+ * The buffer comes from the module's exported cabi_realloc or malloc when
+ * it has one, and otherwise from pages grown for the purpose, which the
+ * guest's allocator never hands out. Pass the offset to the guest as an
+ * i32 argument and write the input through data beforehand. Linear memory
+ * never moves, so data stays valid until the instance is released.
+ * @param instance Instance
+ * @param size Size in bytes
+ * @param offset Output offset of the buffer in linear memory
+ * @param data Output host address of the buffer, may be NULL
+ * @return Error code
+ */
+wasmify_error_t wasmify_instance_alloc(wasmify_instance_t* instance, uint32_t size, uint32_t* offset, void** data);
+
+/**
+ * Borrow a range of an instance's linear memory, such as an output the
+ * guest returned as an offset and length
+ * @param instance Instance
+ * @param offset Offset in linear memory
+ * @param size Size in bytes
+ * @param data Output host address, valid until the instance is released
+ * @return Error code; WASMIFY_ERROR_INVALID_PARAM if the range is out of bounds
+ */
+wasmify_error_t wasmify_instance_view(wasmify_instance_t* instance, uint32_t offset, uint32_t size, const void** data);
+
+/**
+ * Start a call on a pooled instance that runs a time slice at a time
+ * Nothing runs until the first wasmify_task_step, so a fixed set of worker
+ * threads can share long calls between them instead of each one pinning
+ * a core. A call gives up its slice when the slice runs out or when the
+ * guest calls sched_yield; it may be stepped from any thread, one at a time.
+ * @param pool Instance pool, the instance stays checked out until finish
+ * @param function_name Exported function to call
+ * @param args Argument values
+ * @param args_count Number of arguments
+ * @param task Output task, release with wasmify_task_finish
+ * @return Error code
+ */
+wasmify_error_t wasmify_pool_spawn(
+    wasmify_instance_pool_t* pool,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_task_t** task
+);
+
+/**
+ * Run a task for one time slice
+ * @param task Task
+ * @param done Set to 1 once the call has returned or failed, may be NULL
+ * @return Error code of the call once done, success before
+ */
+wasmify_error_t wasmify_task_step(wasmify_task_t* task, int* done);
+
+/**
+ * Collect the result of a task and release it
+ * A task that is not done yet is cancelled and fails with "task cancelled".
+ * @param task Task
+ * @param result Output result, release with wasmify_call_result_free; may be NULL
+ * @return Error code of the call
+ */
+wasmify_error_t wasmify_task_finish(wasmify_task_t* task, wasmify_call_result_t* result);
+
+/**
+ * Create an executor that spreads calls over a set of worker threads
+ * Each worker is pinned to a core of its own while there are enough, and
+ * keeps its own instance pool, created on that core so its memory is local
+ * to it. Workers run their own calls oldest first, a time slice at a time,
+ * and steal from the others once they run out.
+ * @param module Compiled module, each pool keeps its own reference
+ * @param config Executor configuration; pool limits apply to every call
+ * @return Executor or NULL on failure
+ */
+wasmify_executor_t* wasmify_executor_create(
+    wasmify_compiled_module_t* module,
+    wasmify_executor_config_t config
+);
+
+/**
+ * Run every call still submitted to an executor, then destroy it
+ * Calls may no longer be submitted from outside the executor once this
+ * is called; callbacks may still submit follow-up calls.
+ * @param executor Executor
+ */
+void wasmify_executor_destroy(wasmify_executor_t* executor);
+
+/**
+ * Submit a call to an executor
+ * Submitting never blocks on running calls. A call submitted from a
+ * callback stays on the worker that ran the callback.
+ * @param executor Executor
+ * @param function_name Exported function to call
+ * @param args Argument values, copied
+ * @param args_count Number of arguments
+ * @param callback Completion callback, run on a worker thread; NULL to
+ *        collect the result through a future instead
+ * @param user_data Value passed to the callback
+ * @param future Output future when there is no callback, NULL otherwise;
+ *        release with wasmify_future_wait
+ * @return Error code; on error the callback is not called
+ */
+wasmify_error_t wasmify_executor_submit(
+    wasmify_executor_t* executor,
+    const char* function_name,
+    const wasmify_value_t* args,
+    size_t args_count,
+    wasmify_call_callback_t callback,
+    void* user_data,
+    wasmify_future_t** future
+);
+
+/**
+ * Check whether the call behind a future has finished
+ * @param future Future
+ * @return 1 if finished, 0 otherwise
+ */
+int wasmify_future_ready(wasmify_future_t* future);
+
+/**
+ * Wait for the call behind a future and release the future
+ * @param future Future
+ * @param result Output result, release with wasmify_call_result_free; may be NULL
+ * @return Error code of the call
+ */
+wasmify_error_t wasmify_future_wait(wasmify_future_t* future, wasmify_call_result_t* result);
+
 /**
  * List all available modules
+ * Holds the whole registry in memory; large ones are better walked with
+ * wasmify_module_iter_create.
  * @param client Client instance
- * @param modules Output array of modules
+ * @param modules Output array of modules, release with wasmify_module_list_free
  * @param modules_count Output number of modules
  * @return Error code
  */
@@ -145,12 +1297,100 @@ wasmify_error_t wasmify_list_modules(
 );
 
 /**
- * Deploy module to edge locations
+ * List all available modules into an arena
+ * @param client Client instance
+ * @param arena Arena holding the array and its strings until its next reset,
+ *        NULL for the heap as with wasmify_list_modules
+ * @param modules Output array of modules
+ * @param modules_count Output number of modules
+ * @return Error code
+ */
+wasmify_error_t wasmify_list_modules_arena(
+    wasmify_client_t* client,
+    wasmify_arena_t* arena,
+    wasmify_module_t** modules,
+    int* modules_count
+);
+
+/**
+ * Free an array of modules from wasmify_list_modules
+ * @param modules Array of modules
+ * @param modules_count Number of modules
+ */
+void wasmify_module_list_free(wasmify_module_t* modules, int modules_count);
+
+/**
+ * Start listing modules
+ * The server filters the modules and pages are fetched as the listing
+ * reaches them; only the current page is held in memory and its modules
+ * are parsed one at a time. The iterator is used by one thread at a time
+ * and must be freed before its client is destroyed.
+ * @param client Client instance
+ * @param filter Modules to list, NULL for all
+ * @param iter Output iterator
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_iter_create(
+    wasmify_client_t* client,
+    const wasmify_module_filter_t* filter,
+    wasmify_module_iter_t** iter
+);
+
+/**
+ * Move to the next module of a listing
+ * After a network error the same call may be repeated to retry.
+ * @param iter Iterator
+ * @param module Output module, NULL once the listing is complete
+ * @return Error code
+ */
+wasmify_error_t wasmify_module_iter_next(wasmify_module_iter_t* iter, const wasmify_module_info_t** module);
+
+/**
+ * Free a module iterator
+ * @param iter Iterator
+ */
+void wasmify_module_iter_free(wasmify_module_iter_t* iter);
+
+/**
+ * Declare a function pure: its result depends on its arguments alone, so
+ * with a result cache configured wasmify_execute_module and the prepared
+ * calls answer repeated calls from the cache without a request. Results the
+ * server marks cacheable with Cache-Control max-age are cached for that
+ * long whether declared or not, and no-store keeps a result out. Results are
+ * keyed by module ID, which is the hash of the module's content, function
+ * name and arguments, with numeric arguments compared by value. Only
+ * successful results are kept.
+ * @param client Client instance
+ * @param module_id Module identifier
+ * @param function_name Function name, NULL for every function of the module
+ * @return Error code
+ */
+wasmify_error_t wasmify_declare_pure(
+    wasmify_client_t* client,
+    const char* module_id,
+    const char* function_name
+);
+
+/**
+ * Drop every cached result
+ * @param client Client instance
+ */
+void wasmify_result_cache_clear(wasmify_client_t* client);
+
+/**
+ * Read the result cache counters
+ * @param client Client instance
+ * @param stats Output counters, all zero without a result cache
+ */
+void wasmify_result_cache_stats(wasmify_client_t* client, wasmify_result_cache_stats_t* stats);
+
+/**
+ * Deploy module to edge locations, then route its executions to them
  * @param client Client instance
  * @param module_id Module identifier
  * @param regions Array of regions
- * @param regions_count Number of regions
- * @param deployment_id Output deployment ID
+ * @param regions_count Number of regions, 0 to let the server choose
+ * @param deployment_id Output deployment ID, release it with free()
  * @return Error code
  */
 wasmify_error_t wasmify_deploy_to_edge(
@@ -162,25 +1402,71 @@ wasmify_error_t wasmify_deploy_to_edge(
 );
 
 /**
- * Free module structure
+ * Free the contents of a module structure, leaving it empty
  * @param module Module structure
  */
 void wasmify_module_free(wasmify_module_t* module);
 
 /**
- * Free result structure
+ * Free the contents of a result structure, leaving it empty
  * @param result Result structure
  */
 void wasmify_result_free(wasmify_result_t* result);
 
+/**
+ * Create an arena for results
+ * Allocation is a pointer bump and a reset releases everything at once,
+ * keeping the memory for the next round. An arena is used by one thread
+ * at a time.
+ * @param block_size Bytes reserved at a time, 0 = 64KB
+ * @return Arena, or NULL when out of memory
+ */
+wasmify_arena_t* wasmify_arena_create(size_t block_size);
+
+/**
+ * Release everything allocated from an arena
+ * @param arena Arena
+ */
+void wasmify_arena_reset(wasmify_arena_t* arena);
+
+/**
+ * Free an arena and its memory
+ * @param arena Arena
+ */
+void wasmify_arena_destroy(wasmify_arena_t* arena);
+
+/**
+ * Install the observer told about events of every client and of local
+ * execution
+ * Without an observer events cost a single load of it. Install or remove
+ * it while no calls are in flight.
+ * @param observer Observer, NULL to remove it
+ * @param user_data Value passed to the observer
+ */
+void wasmify_set_observer(wasmify_observer_t observer, void* user_data);
+
+/**
+ * Set the W3C trace context of requests made by the calling thread
+ * Every execute request the thread starts then carries a traceparent
+ * header with this trace ID and flags and a parent ID of its own, which
+ * observers see at REQUEST_START.
+ * @param traceparent Trace context as in a traceparent header, NULL to
+ *        stop propagating one
+ * @return Error code; WASMIFY_ERROR_INVALID_PARAM if it is malformed
+ */
+wasmify_error_t wasmify_set_trace_context(const char* traceparent);
+
 /**
  * Initialize Wasmify SDK
+ * Safe to call from several threads and more than once; every successful
+ * call must be balanced by a wasmify_cleanup.
  * @return Error code
  */
 wasmify_error_t wasmify_init(void);
 
 /**
  * Cleanup Wasmify SDK
+ * Global state is released by the call balancing the first wasmify_init.
  */
 void wasmify_cleanup(void);
 
@@ -0,0 +1,594 @@
+/*
+ * Wasmify C SDK benchmarks
+ * Times the SDK's hot paths and reports p50/p99/p999 latencies and the SDK's
+ * own allocations per call; libcurl's and cJSON's allocations are not
+ * counted. The SDK source is compiled into the benchmark so that its
+ * internal paths can be timed directly. Build from sdk/c with
+ *
+ *   cc -O2 -o wasmify_bench wasmify_bench.c wasmify_engine.c -lcurl -lcjson -lz -lm -lpthread
+ *
+ * Usage: wasmify_bench [-s scale] [-c concurrency,...] [name-prefix ...]
+ *   -s  Multiply every benchmark's iteration count, default 1
+ *   -c  Concurrency levels of the remote benchmarks, default 1,4,16
+ * Remote benchmarks run against a mock server inside the process, on a
+ * loopback port, which answers every request with the same small result.
+ */
+
+#define _GNU_SOURCE
+#include "wasmify.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef WASMIFY_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Allocations made by the SDK itself
+static uint64_t g_allocs = 0;
+
+static void* bench_malloc(size_t size) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+static void* bench_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return calloc(count, size);
+}
+
+static void* bench_realloc(void* p, size_t size) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return realloc(p, size);
+}
+
+static void* bench_aligned_alloc(size_t alignment, size_t size) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return aligned_alloc(alignment, size);
+}
+
+static char* bench_strdup(const char* text) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return strdup(text);
+}
+
+static char* bench_strndup(const char* text, size_t size) {
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return strndup(text, size);
+}
+
+// Every header the SDK includes is already in, so only its own calls are redirected
+#undef strdup
+#undef strndup
+#define malloc(size) bench_malloc(size)
+#define calloc(count, size) bench_calloc(count, size)
+#define realloc(p, size) bench_realloc(p, size)
+#define aligned_alloc(alignment, size) bench_aligned_alloc(alignment, size)
+#define strdup(text) bench_strdup(text)
+#define strndup(text, size) bench_strndup(text, size)
+
+#include "wasmify.c"
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef aligned_alloc
+#undef strdup
+#undef strndup
+
+static double g_scale = 1.0;
+static int g_concurrency[8] = { 1, 4, 16 };
+static int g_concurrency_count = 3;
+static char** g_filters = NULL;
+static int g_filter_count = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int bench_selected(const char* name) {
+    for (int i = 0; i < g_filter_count; i++) {
+        if (strncmp(name, g_filters[i], strlen(g_filters[i])) == 0) return 1;
+    }
+    return g_filter_count == 0;
+}
+
+static size_t bench_iterations(size_t base) {
+    double n = (double)base * g_scale;
+    return n < 1 ? 1 : (size_t)n;
+}
+
+// Per-call times of one benchmark
+typedef struct {
+    uint64_t* ns;
+    size_t count;
+    size_t failures;        // Calls that failed, left out of count and the times
+    uint64_t allocs_before;
+    uint64_t started;
+} bench_run_t;
+
+static int bench_begin(bench_run_t* run, size_t count) {
+    run->ns = malloc(count * sizeof(uint64_t));
+    run->count = count;
+    run->failures = 0;
+    run->allocs_before = __atomic_load_n(&g_allocs, __ATOMIC_RELAXED);
+    run->started = now_ns();
+    return run->ns != NULL;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void format_ns(char* buf, size_t size, uint64_t ns) {
+    if (ns < 10000) snprintf(buf, size, "%" PRIu64 " ns", ns);
+    else if (ns < 10000000) snprintf(buf, size, "%.1f us", ns / 1e3);
+    else snprintf(buf, size, "%.1f ms", ns / 1e6);
+}
+
+// Print the percentiles of a finished run; with throughput set, also calls per second.
+// Failed calls are only counted, never timed.
+static void bench_end(bench_run_t* run, const char* name, int throughput) {
+    uint64_t wall = now_ns() - run->started;
+    uint64_t allocs = __atomic_load_n(&g_allocs, __ATOMIC_RELAXED) - run->allocs_before;
+    if (run->count == 0) {
+        printf("%-40s %9zu  all %zu calls failed\n", name, run->count, run->failures);
+        fflush(stdout);
+        free(run->ns);
+        return;
+    }
+    qsort(run->ns, run->count, sizeof(uint64_t), compare_u64);
+
+    char p50[32], p99[32], p999[32];
+    format_ns(p50, sizeof(p50), run->ns[(run->count - 1) / 2]);
+    format_ns(p99, sizeof(p99), run->ns[(run->count * 99 + 99) / 100 - 1]);
+    format_ns(p999, sizeof(p999), run->ns[(run->count * 999 + 999) / 1000 - 1]);
+    printf("%-40s %9zu %11s %11s %11s %9.2f", name, run->count, p50, p99, p999, (double)allocs / (double)run->count);
+    if (throughput) printf("  %.0f calls/s", (double)run->count / (wall / 1e9));
+    if (run->failures > 0) printf("  %zu failed", run->failures);
+    printf("\n");
+    fflush(stdout);
+    free(run->ns);
+}
+
+// Request serialization: the body wasmify_execute_module builds for a call
+static void bench_serialize(const char* name, wasmify_wire_format_t wire, char** args, int args_count, int prepared) {
+    if (!bench_selected(name)) return;
+
+    wasmify_config_t config = { .api_url = "http://127.0.0.1:9/api", .timeout = 30, .wire_format = wire };
+    wasmify_client_t* client = wasmify_client_create(config);
+    connection_t* conn = client ? acquire_connection(client) : NULL;
+    json_buf_t prefix = { 0 };
+    if (prepared) execute_prefix(client, &prefix, "0123456789abcdef", "add");
+
+    bench_run_t run;
+    size_t n = bench_iterations(200000);
+    if (conn && bench_begin(&run, n)) {
+        for (size_t i = 0; i < n; i++) {
+            uint64_t start = now_ns();
+            execute_begin(client, conn, prepared ? &prefix : NULL, "0123456789abcdef", "add");
+            execute_finish_args(client, conn, args, args_count);
+            run.ns[i] = now_ns() - start;
+        }
+        bench_end(&run, name, 0);
+    }
+
+    free(prefix.data);
+    if (conn) release_connection(client, conn);
+    wasmify_client_destroy(client);
+}
+
+// Response parsing of a JSON execute result
+static void bench_parse(const char* name) {
+    if (!bench_selected(name)) return;
+
+    static const char body[] =
+        "{\"success\":true,\"data\":{\"result\":{\"success\":true,\"result\":\"12345\","
+        "\"executionTime\":1.5,\"memoryUsed\":65536,\"instructions\":120}}}";
+    wasmify_response_t response = { 0 };
+    response_reserve(&response, sizeof(body));
+    memcpy(response.data, body, sizeof(body));
+    response.size = sizeof(body) - 1;
+
+    bench_run_t run;
+    size_t n = bench_iterations(200000);
+    if (bench_begin(&run, n)) {
+        for (size_t i = 0; i < n; i++) {
+            wasmify_result_t result;
+            uint64_t start = now_ns();
+            parse_execute_reply(0, &response, NULL, &result);
+            wasmify_result_free(&result);
+            run.ns[i] = now_ns() - start;
+        }
+        bench_end(&run, name, 0);
+    }
+    free(response.data);
+}
+
+// Response accumulation through write_callback, in the 16KB pieces libcurl
+// hands over. A pooled connection reuses its buffer and learns the size from
+// Content-Length; a fresh one grows as the body arrives.
+static void bench_write_callback(size_t payload, int reuse) {
+    char name[64];
+    snprintf(name, sizeof(name), "write_callback/%zuKB/%s", payload / 1024, reuse ? "reused+hint" : "fresh");
+    if (!bench_selected(name)) return;
+
+    enum { PIECE = 16 * 1024 };
+    static char piece[PIECE];
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "Content-Length: %zu\r\n", payload);
+
+    size_t base = (size_t)(256 * 1024 * 1024) / payload;
+    size_t n = bench_iterations(base < 20 ? 20 : base > 50000 ? 50000 : base);
+    wasmify_response_t kept = { 0 };
+    bench_run_t run;
+    if (!bench_begin(&run, n)) return;
+    for (size_t i = 0; i < n; i++) {
+        wasmify_response_t fresh = { 0 };
+        wasmify_response_t* response = reuse ? &kept : &fresh;
+        uint64_t start = now_ns();
+        response_reset(response);
+        if (reuse) header_callback(header, 1, (size_t)header_len, response);
+        for (size_t sent = 0; sent < payload; sent += PIECE) {
+            size_t len = payload - sent < PIECE ? payload - sent : PIECE;
+            write_callback(piece, 1, len, response);
+        }
+        run.ns[i] = now_ns() - start;
+        if (!reuse) free(fresh.data);
+    }
+    bench_end(&run, name, 0);
+    free(kept.data);
+}
+
+// A module exporting add(i32, i32) -> i32
+static const uint8_t ADD_MODULE[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+    0x01, 0x07, 0x01, 0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f,
+    0x03, 0x02, 0x01, 0x00,
+    0x07, 0x07, 0x01, 0x03, 'a', 'd', 'd', 0x00, 0x00,
+    0x0a, 0x09, 0x01, 0x07, 0x00, 0x20, 0x00, 0x20, 0x01, 0x6a, 0x0b
+};
+
+// Submission times of executor calls, turned into latencies as they complete
+static uint64_t* g_executor_ns = NULL;
+static size_t g_executor_left = 0;
+
+static void executor_done(wasmify_error_t error, wasmify_call_result_t* result, void* user_data) {
+    (void)error;
+    uint64_t* ns = &g_executor_ns[(size_t)(uintptr_t)user_data];
+    *ns = now_ns() - *ns;
+    wasmify_call_result_free(result);
+    __atomic_sub_fetch(&g_executor_left, 1, __ATOMIC_RELEASE);
+}
+
+// Local execution: compiling, calling in a fresh instance, in a pooled one
+// and through an executor with a worker per core
+static void bench_local(void) {
+    char* args[] = { "20", "22" };
+    wasmify_value_t values[2] = { { .kind = WASMIFY_VAL_I32, .of.i32 = 20 }, { .kind = WASMIFY_VAL_I32, .of.i32 = 22 } };
+    bench_run_t run;
+
+    if (bench_selected("local/compile/cold") && bench_begin(&run, bench_iterations(2000))) {
+        for (size_t i = 0; i < run.count; i++) {
+            wasmify_module_cache_clear();
+            wasmify_compiled_module_t* module = NULL;
+            uint64_t start = now_ns();
+            wasmify_module_compile(ADD_MODULE, sizeof(ADD_MODULE), &module);
+            run.ns[i] = now_ns() - start;
+            wasmify_module_release(module);
+        }
+        bench_end(&run, "local/compile/cold", 0);
+    }
+
+    wasmify_compiled_module_t* module = NULL;
+    if (wasmify_module_compile(ADD_MODULE, sizeof(ADD_MODULE), &module) != WASMIFY_SUCCESS) {
+        fprintf(stderr, "wasmify_bench: local benchmarks need the engine to compile the add module\n");
+        return;
+    }
+
+    if (bench_selected("local/compile/cached") && bench_begin(&run, bench_iterations(200000))) {
+        for (size_t i = 0; i < run.count; i++) {
+            wasmify_compiled_module_t* cached = NULL;
+            uint64_t start = now_ns();
+            wasmify_module_compile(ADD_MODULE, sizeof(ADD_MODULE), &cached);
+            run.ns[i] = now_ns() - start;
+            wasmify_module_release(cached);
+        }
+        bench_end(&run, "local/compile/cached", 0);
+    }
+
+    if (bench_selected("local/instantiate+call") && bench_begin(&run, bench_iterations(100000))) {
+        for (size_t i = 0; i < run.count; i++) {
+            wasmify_result_t result;
+            uint64_t start = now_ns();
+            wasmify_execute_compiled(module, "add", args, 2, &result);
+            wasmify_result_free(&result);
+            run.ns[i] = now_ns() - start;
+        }
+        bench_end(&run, "local/instantiate+call", 0);
+    }
+
+    wasmify_pool_config_t pool_config = { 0 };
+    wasmify_instance_pool_t* pool = wasmify_instance_pool_create(module, pool_config);
+    if (pool && bench_selected("local/pooled/text") && bench_begin(&run, bench_iterations(200000))) {
+        for (size_t i = 0; i < run.count; i++) {
+            wasmify_result_t result;
+            uint64_t start = now_ns();
+            wasmify_pool_execute(pool, "add", args, 2, &result);
+            wasmify_result_free(&result);
+            run.ns[i] = now_ns() - start;
+        }
+        bench_end(&run, "local/pooled/text", 0);
+    }
+    if (pool && bench_selected("local/pooled/typed") && bench_begin(&run, bench_iterations(200000))) {
+        for (size_t i = 0; i < run.count; i++) {
+            wasmify_call_result_t result;
+            uint64_t start = now_ns();
+            wasmify_pool_call(pool, "add", values, 2, &result);
+            wasmify_call_result_free(&result);
+            run.ns[i] = now_ns() - start;
+        }
+        bench_end(&run, "local/pooled/typed", 0);
+    }
+
+    wasmify_executor_config_t executor_config = { 0 };
+    wasmify_executor_t* executor = NULL;
+    if (bench_selected("local/executor") && bench_begin(&run, bench_iterations(200000)) &&
+        (executor = wasmify_executor_create(module, executor_config)) != NULL) {
+        g_executor_ns = run.ns;
+        g_executor_left = run.count;
+        run.started = now_ns();
+        for (size_t i = 0; i < run.count; i++) {
+            run.ns[i] = now_ns();
+            if (wasmify_executor_submit(executor, "add", values, 2, executor_done, (void*)(uintptr_t)i, NULL) != WASMIFY_SUCCESS) {
+                run.ns[i] = 0;
+                __atomic_sub_fetch(&g_executor_left, 1, __ATOMIC_RELEASE);
+            }
+        }
+        while (__atomic_load_n(&g_executor_left, __ATOMIC_ACQUIRE) > 0) sched_yield();
+        bench_end(&run, "local/executor", 1);
+        wasmify_executor_destroy(executor);
+    }
+
+    wasmify_instance_pool_destroy(pool);
+    wasmify_module_release(module);
+}
+
+// Mock server answering every request on a keep-alive connection with one result
+static const char MOCK_REPLY_BODY[] =
+    "{\"success\":true,\"data\":{\"result\":{\"success\":true,\"result\":\"42\","
+    "\"executionTime\":0.1,\"memoryUsed\":65536}}}";
+
+// End of the request headers in buf, or NULL while they are incomplete
+static char* headers_end(char* buf, size_t size) {
+    for (size_t i = 3; i < size; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') return buf + i - 3;
+    }
+    return NULL;
+}
+
+static void* mock_connection(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    char reply[256];
+    int reply_len = snprintf(reply, sizeof(reply),
+        "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+        sizeof(MOCK_REPLY_BODY) - 1, MOCK_REPLY_BODY);
+
+    char buf[64 * 1024];
+    size_t have = 0;
+    for (;;) {
+        // Headers, then as much body as they announce
+        char* end = NULL;
+        while (!(end = headers_end(buf, have))) {
+            if (have == sizeof(buf)) goto done;
+            ssize_t got = recv(fd, buf + have, sizeof(buf) - have, 0);
+            if (got <= 0) goto done;
+            have += (size_t)got;
+        }
+        size_t head = (size_t)(end - buf) + 4;
+        size_t body = 0;
+        for (char* line = buf; line < end; line = memchr(line, '\n', (size_t)(end - line + 2)) + 1) {
+            if (strncasecmp(line, "content-length:", 15) == 0) body = strtoul(line + 15, NULL, 10);
+        }
+        size_t total = head + body;
+        if (total > sizeof(buf)) goto done;
+        while (have < total) {
+            ssize_t got = recv(fd, buf + have, sizeof(buf) - have, 0);
+            if (got <= 0) goto done;
+            have += (size_t)got;
+        }
+        if (send(fd, reply, (size_t)reply_len, MSG_NOSIGNAL) != reply_len) goto done;
+        memmove(buf, buf + total, have - total);
+        have -= total;
+    }
+done:
+    close(fd);
+    return NULL;
+}
+
+static void* mock_accept(void* arg) {
+    int listener = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return NULL;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, mock_connection, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+// Start the mock server; returns its port or 0
+static int mock_start(void) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) return 0;
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0 ||
+        getsockname(listener, (struct sockaddr*)&addr, &len) != 0) {
+        close(listener);
+        return 0;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, mock_accept, (void*)(intptr_t)listener) != 0) {
+        close(listener);
+        return 0;
+    }
+    pthread_detach(thread);
+    return ntohs(addr.sin_port);
+}
+
+typedef struct {
+    wasmify_client_t* client;
+    uint64_t* ns;           // Times of the successful calls, packed from the start
+    size_t count;
+    size_t succeeded;
+    size_t failures;
+} remote_worker_t;
+
+static void* remote_worker(void* arg) {
+    remote_worker_t* worker = (remote_worker_t*)arg;
+    char* args[] = { "20", "22" };
+    for (size_t i = 0; i < worker->count; i++) {
+        wasmify_result_t result;
+        uint64_t start = now_ns();
+        if (wasmify_execute_module(worker->client, "0123456789abcdef", "add", args, 2, &result) == WASMIFY_SUCCESS) {
+            worker->ns[worker->succeeded++] = now_ns() - start;
+        } else {
+            worker->failures++;
+        }
+        wasmify_result_free(&result);
+    }
+    return NULL;
+}
+
+// Remote latency and throughput of wasmify_execute_module at each concurrency
+static void bench_remote(int port, wasmify_wire_format_t wire) {
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+
+    for (int c = 0; c < g_concurrency_count; c++) {
+        int threads = g_concurrency[c];
+        char name[64];
+        snprintf(name, sizeof(name), "remote/%s/c%d", wire == WASMIFY_WIRE_BINARY ? "binary" : "json", threads);
+        if (!bench_selected(name)) continue;
+
+        wasmify_config_t config = { .api_url = url, .timeout = 30, .max_connections = threads, .wire_format = wire };
+        wasmify_client_t* client = wasmify_client_create(config);
+        if (!client) continue;
+
+        // Warm the connections up before anything is timed
+        uint64_t warm_ns[64];
+        remote_worker_t warm = { .client = client, .ns = warm_ns, .count = 64 };
+        remote_worker(&warm);
+
+        size_t per_thread = bench_iterations(20000) / (size_t)threads;
+        if (per_thread == 0) per_thread = 1;
+        bench_run_t run;
+        remote_worker_t workers[64];
+        pthread_t ids[64];
+        if (!bench_begin(&run, per_thread * (size_t)threads)) {
+            wasmify_client_destroy(client);
+            continue;
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t] = (remote_worker_t){ .client = client, .ns = run.ns + (size_t)t * per_thread, .count = per_thread };
+            pthread_create(&ids[t], NULL, remote_worker, &workers[t]);
+        }
+        run.count = 0;
+        for (int t = 0; t < threads; t++) {
+            pthread_join(ids[t], NULL);
+            memmove(run.ns + run.count, workers[t].ns, workers[t].succeeded * sizeof(uint64_t));
+            run.count += workers[t].succeeded;
+            run.failures += workers[t].failures;
+        }
+        bench_end(&run, name, 1);
+        wasmify_client_destroy(client);
+    }
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:")) != -1) {
+        if (opt == 's') {
+            g_scale = atof(optarg);
+            if (g_scale <= 0) g_scale = 1.0;
+        } else if (opt == 'c') {
+            g_concurrency_count = 0;
+            for (char* level = strtok(optarg, ","); level && g_concurrency_count < 8; level = strtok(NULL, ",")) {
+                int threads = atoi(level);
+                if (threads > 0 && threads <= 64) g_concurrency[g_concurrency_count++] = threads;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [-s scale] [-c concurrency,...] [name-prefix ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    g_filters = argv + optind;
+    g_filter_count = argc - optind;
+
+    if (wasmify_init() != WASMIFY_SUCCESS) {
+        fprintf(stderr, "wasmify_bench: wasmify_init failed\n");
+        return 1;
+    }
+    printf("%-40s %9s %11s %11s %11s %9s\n", "benchmark", "calls", "p50", "p99", "p999", "allocs");
+
+    char* small[] = { "20", "22" };
+    char* mixed[] = { "1", "-7", "9000000000", "2.5", "hello", "1e300", "0", "65535" };
+    char text[1024];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    char* large[] = { text };
+
+    bench_serialize("serialize/json/2 ints", WASMIFY_WIRE_JSON, small, 2, 0);
+    bench_serialize("serialize/json/8 mixed", WASMIFY_WIRE_JSON, mixed, 8, 0);
+    bench_serialize("serialize/json/1KB string", WASMIFY_WIRE_JSON, large, 1, 0);
+    bench_serialize("serialize/json/prepared", WASMIFY_WIRE_JSON, small, 2, 1);
+    bench_serialize("serialize/binary/2 ints", WASMIFY_WIRE_BINARY, small, 2, 0);
+    bench_serialize("serialize/binary/8 mixed", WASMIFY_WIRE_BINARY, mixed, 8, 0);
+    bench_parse("parse/json");
+
+    static const size_t payloads[] = { 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        bench_write_callback(payloads[i], 0);
+        bench_write_callback(payloads[i], 1);
+    }
+
+    bench_local();
+
+    int port = mock_start();
+    if (!port) {
+        fprintf(stderr, "wasmify_bench: could not start the mock server\n");
+    } else {
+        bench_remote(port, WASMIFY_WIRE_JSON);
+    }
+
+    wasmify_cleanup();
+    return 0;
+}
@@ -0,0 +1,4924 @@
+/*
+ * Wasmify C SDK - Embedded execution engine
+ *
+ * A validating interpreter for WebAssembly modules. Function bodies are
+ * validated once at compile time and lowered into a flat instruction array
+ * with branch targets and operand stack heights already resolved, so the
+ * interpreter loop never tracks block labels at run time. The SIMD128 and
+ * threads proposals are supported; v128 values take two stack slots.
+ */
+
+#define _GNU_SOURCE
+#include "wasmify_engine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_STACK_SLOTS (128u * 1024u)
+#define DEFAULT_CALL_DEPTH 4096u
+#define MAX_LOCALS 50000u
+#define NO_INDEX UINT32_MAX
+#define BRANCH_TABLE_REF 0x80000000u
+
+// Section identifiers
+enum {
+    SECTION_CUSTOM = 0,
+    SECTION_TYPE = 1,
+    SECTION_IMPORT = 2,
+    SECTION_FUNCTION = 3,
+    SECTION_TABLE = 4,
+    SECTION_MEMORY = 5,
+    SECTION_GLOBAL = 6,
+    SECTION_EXPORT = 7,
+    SECTION_START = 8,
+    SECTION_ELEMENT = 9,
+    SECTION_CODE = 10,
+    SECTION_DATA = 11,
+    SECTION_DATA_COUNT = 12
+};
+
+// Internal opcodes. Single-byte wasm opcodes keep their encoding; prefixed
+// opcodes are folded into ranges above 0xFF.
+enum {
+    OP_UNREACHABLE = 0x00,
+    OP_IF = 0x04,
+    OP_BR = 0x0C,
+    OP_BR_IF = 0x0D,
+    OP_BR_TABLE = 0x0E,
+    OP_RETURN = 0x0F,
+    OP_CALL = 0x10,
+    OP_CALL_INDIRECT = 0x11,
+    OP_DROP = 0x1A,
+    OP_SELECT = 0x1B,
+    OP_LOCAL_GET = 0x20,
+    OP_LOCAL_SET = 0x21,
+    OP_LOCAL_TEE = 0x22,
+    OP_GLOBAL_GET = 0x23,
+    OP_GLOBAL_SET = 0x24,
+    OP_TABLE_GET = 0x25,
+    OP_TABLE_SET = 0x26,
+    OP_MEMORY_SIZE = 0x3F,
+    OP_MEMORY_GROW = 0x40,
+    OP_CONST = 0x41,
+    OP_REF_IS_NULL = 0xD1,
+    OP_JMP = 0x100,
+    // v128 local and global access, 0x100 above the single-slot opcodes
+    OP_LOCAL_GET_V128 = 0x120,
+    OP_LOCAL_SET_V128 = 0x121,
+    OP_LOCAL_TEE_V128 = 0x122,
+    OP_GLOBAL_GET_V128 = 0x123,
+    OP_GLOBAL_SET_V128 = 0x124,
+    OP_IMM = 0x1FF,          // Upper half of the preceding insn's 128-bit immediate
+    OP_PREFIX_FC = 0x200,
+    OP_PREFIX_FD = 0x300,
+    OP_PREFIX_FE = 0x400
+};
+
+// Const expression kinds
+enum {
+    CONST_VALUE = 0,
+    CONST_GLOBAL = 1,
+    CONST_FUNC = 2
+};
+
+// Segment modes
+enum {
+    SEGMENT_ACTIVE = 0,
+    SEGMENT_PASSIVE = 1,
+    SEGMENT_DECLARATIVE = 2
+};
+
+// Control frame kinds used by the validator
+enum {
+    CTRL_BLOCK = 0x02,
+    CTRL_LOOP = 0x03,
+    CTRL_IF = 0x04,
+    CTRL_FUNC = 0xFF
+};
+
+#define TYPE_UNKNOWN 0x00
+
+static const char* const TRAP_OOB_MEMORY = "out of bounds memory access";
+static const char* const TRAP_OOB_TABLE = "out of bounds table access";
+static const char* const TRAP_DIV_ZERO = "integer divide by zero";
+static const char* const TRAP_OVERFLOW = "integer overflow";
+static const char* const TRAP_INVALID_CONV = "invalid conversion to integer";
+static const char* const TRAP_STACK = "call stack exhausted";
+static const char* const TRAP_FUEL = "out of fuel";
+static const char* const TRAP_DEADLINE = "deadline exceeded";
+static const char* const TRAP_UNALIGNED = "unaligned atomic";
+static const char* const TRAP_UNSHARED = "expected shared memory";
+
+typedef struct {
+    uint32_t param_count;
+    uint32_t result_count;
+    uint8_t* types;          // Params followed by results
+    uint32_t param_slots;
+    uint32_t result_slots;
+    uint32_t canon;          // First structurally equal type index
+} functype_t;
+
+typedef struct {
+    uint32_t op;
+    uint32_t a;
+    uint64_t b;
+} insn_t;
+
+// br_table entry: jump target and the stack adjustment to apply
+typedef struct {
+    uint32_t target;
+    uint32_t base;
+    uint32_t keep;
+} branch_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t local_slots;    // Parameters plus declared locals
+    uint32_t max_slots;      // Locals plus deepest operand stack
+    insn_t* code;
+    uint32_t code_len;
+    branch_t* branches;
+    uint32_t branch_count;
+    char* import_module;     // Set for imported functions only
+    char* import_name;
+} func_t;
+
+typedef struct {
+    uint8_t kind;
+    uint64_t value;
+    uint64_t high;           // Upper half of a v128 value
+} const_expr_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t mutable_;
+    uint32_t slot;
+    const_expr_t init;
+} global_t;
+
+typedef struct {
+    uint8_t elem_type;
+    uint32_t min;
+    uint32_t max;
+} table_t;
+
+typedef struct {
+    char* name;
+    uint8_t kind;
+    uint32_t index;
+} export_t;
+
+typedef struct {
+    uint8_t mode;
+    uint8_t type;
+    uint32_t table;
+    const_expr_t offset;
+    uint32_t count;
+    const_expr_t* items;
+} elem_t;
+
+typedef struct {
+    uint8_t mode;
+    const_expr_t offset;
+    uint8_t* bytes;
+    uint32_t size;
+} data_t;
+
+struct wasmify_engine_module {
+    functype_t* types;
+    uint32_t type_count;
+    func_t* funcs;
+    uint32_t func_count;
+    uint32_t import_func_count;
+    uint32_t declared_func_count;
+    table_t* tables;
+    uint32_t table_count;
+    int has_memory;
+    int memory_shared;
+    uint32_t memory_min;
+    uint32_t memory_max;
+    global_t* globals;
+    uint32_t global_count;
+    uint32_t global_slots;
+    export_t* exports;
+    uint32_t export_count;
+    elem_t* elems;
+    uint32_t elem_count;
+    data_t* datas;
+    uint32_t data_count;
+    int has_data_count;
+    uint32_t declared_data_count;
+    uint32_t start;
+    // Set when loaded from an artifact; instruction streams, branch tables
+    // and data segments then point into it instead of owning their memory
+    const uint8_t* artifact;
+    size_t artifact_size;
+    wasmify_engine_release_t release;
+};
+
+typedef struct {
+    uint64_t* elems;
+    uint32_t size;
+    uint32_t max;
+} table_inst_t;
+
+typedef struct {
+    const func_t* func;
+    const insn_t* ip;
+    uint64_t* fp;
+} frame_t;
+
+typedef int (*host_func_t)(wasmify_engine_instance_t* instance, uint64_t* slots);
+
+// Linear memory declared shared, used in place by every instance given it
+struct wasmify_engine_memory {
+    uint8_t* base;
+    size_t reserved;
+    size_t committed;
+    uint64_t size;           // Read and written atomically, grown under lock
+    uint32_t max_pages;
+    int refs;
+    pthread_mutex_t lock;
+};
+
+struct wasmify_engine_instance {
+    const wasmify_engine_module_t* module;
+    uint8_t* memory;
+    uint64_t memory_size;    // Of a shared memory, as last seen by this instance
+    uint32_t memory_pages;
+    uint32_t memory_max_pages;
+    size_t memory_reserved;
+    size_t memory_committed;     // Leading bytes of the reservation already read-write
+    wasmify_engine_memory_t* shared;
+    uint64_t* globals;
+    table_inst_t* tables;
+    host_func_t* host_funcs;
+    uint8_t* data_dropped;
+    uint8_t* elem_dropped;
+    uint64_t* stack;
+    uint32_t stack_slots;
+    frame_t* frames;
+    uint32_t frame_cap;
+    int exited;
+    int exit_code;
+    char trap[128];
+    // Limits of the current call, and where it stopped when its slice ran out
+    int64_t fuel;
+    double deadline_at;      // Per epoch_now_ms, 0 = none
+    double slice_ms;
+    double slice_end;
+    uint64_t epoch_deadline; // Epoch at which the clock is next looked at
+    int timed_out;
+    int suspended;
+    uint32_t call_index;
+    const func_t* suspended_func;
+    const insn_t* suspended_ip;
+    uint64_t* suspended_fp;
+    uint64_t* suspended_sp;
+    uint32_t suspended_depth;
+    // Reset point recorded by wasmify_engine_instance_snapshot
+    int has_snapshot;
+    uint32_t snap_pages;
+    uint8_t* snap_memory;    // Copy used when the memory isn't file-backed
+    uint64_t* snap_globals;
+    table_inst_t* snap_tables;
+    uint8_t* snap_data_dropped;
+    uint8_t* snap_elem_dropped;
+    int memory_from_image;   // Memory is an image's private mapping no call has touched yet
+};
+
+static void set_error(char* err, size_t err_size, const char* fmt, ...) {
+    if (!err || err_size == 0) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(err, err_size, fmt, ap);
+    va_end(ap);
+}
+
+static int grow_array(void** items, uint32_t* cap, uint32_t need, size_t item_size) {
+    if (need <= *cap) return 1;
+    uint32_t new_cap = *cap ? *cap : 16;
+    while (new_cap < need) new_cap *= 2;
+    void* p = realloc(*items, (size_t)new_cap * item_size);
+    if (!p) return 0;
+    *items = p;
+    *cap = new_cap;
+    return 1;
+}
+
+static uint32_t slot_count(uint8_t type) {
+    return type == WASMIFY_TYPE_V128 ? 2 : 1;
+}
+
+static uint32_t types_slots(const uint8_t* types, uint32_t count) {
+    uint32_t slots = 0;
+    for (uint32_t i = 0; i < count; i++) slots += slot_count(types[i]);
+    return slots;
+}
+
+static int is_ref_type(uint8_t type) {
+    return type == WASMIFY_TYPE_FUNCREF || type == WASMIFY_TYPE_EXTERNREF;
+}
+
+// ---------------------------------------------------------------------------
+// Binary reader. Errors are sticky: once set, every read returns zero and
+// callers check r->error before trusting a value.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    const char* error;
+} reader_t;
+
+static void reader_fail(reader_t* r, const char* msg) {
+    if (!r->error) r->error = msg;
+    r->p = r->end;
+}
+
+static uint8_t read_u8(reader_t* r) {
+    if (r->p >= r->end) {
+        reader_fail(r, "unexpected end");
+        return 0;
+    }
+    return *r->p++;
+}
+
+static uint64_t read_leb(reader_t* r, unsigned bits, int is_signed) {
+    uint64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        if (shift >= bits || r->p >= r->end) {
+            reader_fail(r, shift >= bits ? "integer representation too long" : "unexpected end");
+            return 0;
+        }
+        byte = *r->p++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    if (is_signed && shift < 64 && (byte & 0x40)) {
+        result |= ~0ULL << shift;
+    }
+    return result;
+}
+
+static uint32_t read_u32(reader_t* r) {
+    return (uint32_t)read_leb(r, 32, 0);
+}
+
+static int32_t read_s32(reader_t* r) {
+    return (int32_t)read_leb(r, 32, 1);
+}
+
+static int64_t read_s64(reader_t* r) {
+    return (int64_t)read_leb(r, 64, 1);
+}
+
+static uint64_t read_fixed(reader_t* r, size_t n) {
+    if ((size_t)(r->end - r->p) < n) {
+        reader_fail(r, "unexpected end");
+        return 0;
+    }
+    uint64_t v = 0;
+    memcpy(&v, r->p, n);
+    r->p += n;
+    return v;
+}
+
+static char* read_name(reader_t* r) {
+    uint32_t len = read_u32(r);
+    if (r->error) return NULL;
+    if (len > (size_t)(r->end - r->p)) {
+        reader_fail(r, "unexpected end");
+        return NULL;
+    }
+    char* name = malloc((size_t)len + 1);
+    if (!name) {
+        reader_fail(r, "out of memory");
+        return NULL;
+    }
+    memcpy(name, r->p, len);
+    name[len] = '\0';
+    r->p += len;
+    return name;
+}
+
+static uint8_t read_valtype(reader_t* r) {
+    uint8_t t = read_u8(r);
+    switch (t) {
+        case WASMIFY_TYPE_I32:
+        case WASMIFY_TYPE_I64:
+        case WASMIFY_TYPE_F32:
+        case WASMIFY_TYPE_F64:
+        case WASMIFY_TYPE_V128:
+        case WASMIFY_TYPE_FUNCREF:
+        case WASMIFY_TYPE_EXTERNREF:
+            return t;
+        default:
+            reader_fail(r, "invalid value type");
+            return 0;
+    }
+}
+
+static uint8_t read_reftype(reader_t* r) {
+    uint8_t t = read_u8(r);
+    if (!is_ref_type(t)) reader_fail(r, "invalid reference type");
+    return t;
+}
+
+// Limits of a table, or of a memory when shared is given; only memories may
+// be shared
+static void read_limits(reader_t* r, uint32_t* min, uint32_t* max, uint32_t cap, int* shared) {
+    uint8_t flags = read_u8(r);
+    if (flags > 3 || (flags & 2 && !shared)) {
+        reader_fail(r, flags & 4 ? "64-bit limits are not supported" : "malformed limits flags");
+        return;
+    }
+    if (flags == 2) {
+        reader_fail(r, "shared memory must have maximum");
+        return;
+    }
+    if (shared) *shared = flags == 3;
+    *min = read_u32(r);
+    *max = flags & 1 ? read_u32(r) : cap;
+    if (!r->error && (*min > cap || *max > cap)) reader_fail(r, "limits exceed maximum");
+    if (!r->error && *min > *max) reader_fail(r, "size minimum must not be greater than maximum");
+}
+
+static void read_const_expr(reader_t* r, const wasmify_engine_module_t* m, uint8_t type, const_expr_t* expr) {
+    uint8_t op = read_u8(r);
+    uint8_t actual = 0;
+    expr->kind = CONST_VALUE;
+    expr->value = 0;
+    expr->high = 0;
+    switch (op) {
+        case 0x41: expr->value = (uint32_t)read_s32(r); actual = WASMIFY_TYPE_I32; break;
+        case 0x42: expr->value = (uint64_t)read_s64(r); actual = WASMIFY_TYPE_I64; break;
+        case 0x43: expr->value = read_fixed(r, 4); actual = WASMIFY_TYPE_F32; break;
+        case 0x44: expr->value = read_fixed(r, 8); actual = WASMIFY_TYPE_F64; break;
+        case 0xFD:
+            if (read_u32(r) != 0x0C) {
+                reader_fail(r, "constant expression required");
+                return;
+            }
+            expr->value = read_fixed(r, 8);
+            expr->high = read_fixed(r, 8);
+            actual = WASMIFY_TYPE_V128;
+            break;
+        case 0xD0: actual = read_reftype(r); break;
+        case 0xD2: {
+            uint32_t idx = read_u32(r);
+            if (!r->error && idx >= m->func_count) reader_fail(r, "unknown function");
+            expr->kind = CONST_FUNC;
+            expr->value = idx;
+            actual = WASMIFY_TYPE_FUNCREF;
+            break;
+        }
+        case 0x23: {
+            uint32_t idx = read_u32(r);
+            if (!r->error && idx >= m->global_count) {
+                reader_fail(r, "unknown global");
+                return;
+            }
+            expr->kind = CONST_GLOBAL;
+            expr->value = idx;
+            actual = r->error ? 0 : m->globals[idx].type;
+            break;
+        }
+        default:
+            reader_fail(r, "constant expression required");
+            return;
+    }
+    if (read_u8(r) != 0x0B) reader_fail(r, "constant expression required");
+    if (!r->error && actual != type) reader_fail(r, "type mismatch in constant expression");
+}
+
+// ---------------------------------------------------------------------------
+// Function validation and lowering
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t kind;
+    uint8_t unreachable;
+    uint8_t single;          // Result type of a single-value block type
+    uint8_t has_else;
+    int32_t type_index;      // Multi-value block type, -1 otherwise
+    uint32_t height;         // Operand stack depth at entry, in values
+    uint32_t slot_height;    // Operand stack depth at entry, in slots
+    uint32_t start;          // Loop: first body insn; if: the IF insn
+    uint32_t fixups;         // Head of the pending forward-branch list
+} ctrl_t;
+
+typedef struct {
+    uint32_t ref;
+    uint32_t next;
+} fixup_t;
+
+typedef struct {
+    const wasmify_engine_module_t* module;
+    func_t* func;
+    reader_t* r;
+    uint8_t* local_types;
+    uint32_t* local_offsets;
+    uint32_t local_count;
+    uint8_t* vals;
+    uint32_t nvals;
+    uint32_t vals_cap;
+    uint32_t slots;
+    uint32_t max_slots;
+    ctrl_t* ctrls;
+    uint32_t nctrls;
+    uint32_t ctrls_cap;
+    fixup_t* fixups;
+    uint32_t nfixups;
+    uint32_t fixups_cap;
+    insn_t* code;
+    uint32_t code_len;
+    uint32_t code_cap;
+    branch_t* branches;
+    uint32_t nbranches;
+    uint32_t branches_cap;
+    const char* error;
+} compiler_t;
+
+#define FAIL(c, msg) do { (c)->error = (msg); return 0; } while (0)
+
+static void block_params(const compiler_t* c, const ctrl_t* ctl, const uint8_t** types, uint32_t* count) {
+    if (ctl->kind != CTRL_FUNC && ctl->type_index >= 0) {
+        const functype_t* ft = &c->module->types[ctl->type_index];
+        *types = ft->types;
+        *count = ft->param_count;
+    } else {
+        *types = NULL;
+        *count = 0;
+    }
+}
+
+static void block_results(const compiler_t* c, const ctrl_t* ctl, const uint8_t** types, uint32_t* count) {
+    if (ctl->type_index >= 0) {
+        const functype_t* ft = &c->module->types[ctl->type_index];
+        *types = ft->types + ft->param_count;
+        *count = ft->result_count;
+    } else {
+        *types = &ctl->single;
+        *count = ctl->single ? 1 : 0;
+    }
+}
+
+static void label_types(const compiler_t* c, const ctrl_t* ctl, const uint8_t** types, uint32_t* count) {
+    if (ctl->kind == CTRL_LOOP) {
+        block_params(c, ctl, types, count);
+    } else {
+        block_results(c, ctl, types, count);
+    }
+}
+
+static int push_val(compiler_t* c, uint8_t type) {
+    if (!grow_array((void**)&c->vals, &c->vals_cap, c->nvals + 1, 1)) FAIL(c, "out of memory");
+    c->vals[c->nvals++] = type;
+    c->slots += slot_count(type);
+    if (c->slots > c->max_slots) c->max_slots = c->slots;
+    return 1;
+}
+
+// Pops one operand, checking it against expect unless expect is unknown.
+// Returns the popped type, TYPE_UNKNOWN in unreachable code, or 0xFF.
+static uint8_t pop_val(compiler_t* c, uint8_t expect) {
+    ctrl_t* ctl = &c->ctrls[c->nctrls - 1];
+    if (c->nvals == ctl->height) {
+        if (ctl->unreachable) return expect;
+        c->error = "type mismatch: operand stack underflow";
+        return 0xFF;
+    }
+    uint8_t actual = c->vals[--c->nvals];
+    c->slots -= slot_count(actual);
+    if (expect != TYPE_UNKNOWN && actual != TYPE_UNKNOWN && actual != expect) {
+        c->error = "type mismatch";
+        return 0xFF;
+    }
+    return actual != TYPE_UNKNOWN ? actual : expect;
+}
+
+#define POP(c, t) do { if (pop_val((c), (t)) == 0xFF) return 0; } while (0)
+#define PUSH(c, t) do { if (!push_val((c), (t))) return 0; } while (0)
+
+static int pop_vals(compiler_t* c, const uint8_t* types, uint32_t count) {
+    for (uint32_t i = count; i > 0; i--) POP(c, types[i - 1]);
+    return 1;
+}
+
+static int push_vals(compiler_t* c, const uint8_t* types, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) PUSH(c, types[i]);
+    return 1;
+}
+
+static int emit(compiler_t* c, uint32_t op, uint32_t a, uint64_t b) {
+    if (!grow_array((void**)&c->code, &c->code_cap, c->code_len + 1, sizeof(insn_t))) FAIL(c, "out of memory");
+    insn_t* in = &c->code[c->code_len++];
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    return 1;
+}
+
+static int add_fixup(compiler_t* c, ctrl_t* ctl, uint32_t ref) {
+    if (!grow_array((void**)&c->fixups, &c->fixups_cap, c->nfixups + 1, sizeof(fixup_t))) FAIL(c, "out of memory");
+    c->fixups[c->nfixups].ref = ref;
+    c->fixups[c->nfixups].next = ctl->fixups;
+    ctl->fixups = c->nfixups++;
+    return 1;
+}
+
+static void patch_fixups(compiler_t* c, ctrl_t* ctl, uint32_t target) {
+    for (uint32_t i = ctl->fixups; i != NO_INDEX; i = c->fixups[i].next) {
+        uint32_t ref = c->fixups[i].ref;
+        if (ref & BRANCH_TABLE_REF) {
+            c->branches[ref & ~BRANCH_TABLE_REF].target = target;
+        } else {
+            c->code[ref].a = target;
+        }
+    }
+    ctl->fixups = NO_INDEX;
+}
+
+static void set_unreachable(compiler_t* c) {
+    ctrl_t* ctl = &c->ctrls[c->nctrls - 1];
+    c->nvals = ctl->height;
+    c->slots = ctl->slot_height;
+    ctl->unreachable = 1;
+}
+
+static int read_block_type(compiler_t* c, uint8_t* single, int32_t* type_index) {
+    reader_t* r = c->r;
+    if (r->p >= r->end) FAIL(c, "unexpected end");
+    uint8_t b = *r->p;
+    *single = 0;
+    *type_index = -1;
+    if (b == 0x40) {
+        r->p++;
+        return 1;
+    }
+    if (b & 0x40) {
+        *single = read_valtype(r);
+        if (r->error) FAIL(c, r->error);
+        return 1;
+    }
+    int64_t idx = (int64_t)read_leb(r, 33, 1);
+    if (r->error) FAIL(c, r->error);
+    if (idx < 0 || (uint64_t)idx >= c->module->type_count) FAIL(c, "unknown type");
+    *type_index = (int32_t)idx;
+    return 1;
+}
+
+static int push_ctrl(compiler_t* c, uint8_t kind, uint8_t single, int32_t type_index) {
+    if (!grow_array((void**)&c->ctrls, &c->ctrls_cap, c->nctrls + 1, sizeof(ctrl_t))) FAIL(c, "out of memory");
+    ctrl_t tmp = {0};
+    tmp.kind = kind;
+    tmp.single = single;
+    tmp.type_index = type_index;
+    tmp.fixups = NO_INDEX;
+    tmp.start = c->code_len;
+
+    const uint8_t* params;
+    uint32_t nparams;
+    block_params(c, &tmp, &params, &nparams);
+    if (c->nctrls > 0 && !pop_vals(c, params, nparams)) return 0;
+
+    tmp.height = c->nvals;
+    tmp.slot_height = c->slots;
+    c->ctrls[c->nctrls++] = tmp;
+    return push_vals(c, params, nparams);
+}
+
+static int check_block_end(compiler_t* c) {
+    ctrl_t* ctl = &c->ctrls[c->nctrls - 1];
+    const uint8_t* results;
+    uint32_t nresults;
+    block_results(c, ctl, &results, &nresults);
+    if (!pop_vals(c, results, nresults)) return 0;
+    if (c->nvals != ctl->height) FAIL(c, "type mismatch: values remaining on stack at end of block");
+    return 1;
+}
+
+static int emit_branch(compiler_t* c, uint32_t op, uint32_t depth) {
+    if (depth >= c->nctrls) FAIL(c, "unknown label");
+    ctrl_t* ctl = &c->ctrls[c->nctrls - 1 - depth];
+    const uint8_t* types;
+    uint32_t count;
+    label_types(c, ctl, &types, &count);
+    uint32_t keep = types_slots(types, count);
+    uint32_t base = c->func->local_slots + ctl->slot_height;
+    uint32_t target = ctl->kind == CTRL_LOOP ? ctl->start : NO_INDEX;
+    if (!emit(c, op, target, ((uint64_t)base << 32) | keep)) return 0;
+    if (ctl->kind != CTRL_LOOP) return add_fixup(c, ctl, c->code_len - 1);
+    return 1;
+}
+
+static int check_label(compiler_t* c, uint32_t depth, int keep_values) {
+    if (depth >= c->nctrls) FAIL(c, "unknown label");
+    const uint8_t* types;
+    uint32_t count;
+    label_types(c, &c->ctrls[c->nctrls - 1 - depth], &types, &count);
+    if (!pop_vals(c, types, count)) return 0;
+    if (keep_values) return push_vals(c, types, count);
+    return 1;
+}
+
+static int memarg(compiler_t* c, uint32_t natural_align, uint32_t* offset) {
+    reader_t* r = c->r;
+    uint32_t align = read_u32(r);
+    *offset = read_u32(r);
+    if (r->error) FAIL(c, r->error);
+    if (!c->module->has_memory) FAIL(c, "unknown memory");
+    if (align > natural_align) FAIL(c, "alignment must not be larger than natural");
+    return 1;
+}
+
+// Operand and result types of the plain numeric opcodes 0x45..0xC4
+static int numeric_sig(uint8_t op, uint8_t* in1, uint8_t* in2, uint8_t* out) {
+    const uint8_t I32 = WASMIFY_TYPE_I32, I64 = WASMIFY_TYPE_I64;
+    const uint8_t F32 = WASMIFY_TYPE_F32, F64 = WASMIFY_TYPE_F64;
+    *in2 = 0;
+    if (op == 0x45) { *in1 = I32; *out = I32; }
+    else if (op <= 0x4F) { *in1 = *in2 = I32; *out = I32; }
+    else if (op == 0x50) { *in1 = I64; *out = I32; }
+    else if (op <= 0x5A) { *in1 = *in2 = I64; *out = I32; }
+    else if (op <= 0x60) { *in1 = *in2 = F32; *out = I32; }
+    else if (op <= 0x66) { *in1 = *in2 = F64; *out = I32; }
+    else if (op <= 0x69) { *in1 = I32; *out = I32; }
+    else if (op <= 0x78) { *in1 = *in2 = I32; *out = I32; }
+    else if (op <= 0x7B) { *in1 = I64; *out = I64; }
+    else if (op <= 0x8A) { *in1 = *in2 = I64; *out = I64; }
+    else if (op <= 0x91) { *in1 = F32; *out = F32; }
+    else if (op <= 0x98) { *in1 = *in2 = F32; *out = F32; }
+    else if (op <= 0x9F) { *in1 = F64; *out = F64; }
+    else if (op <= 0xA6) { *in1 = *in2 = F64; *out = F64; }
+    else {
+        static const uint8_t conv[][2] = {
+            {0x7E, 0x7F},                                            // A7 i32.wrap_i64
+            {0x7D, 0x7F}, {0x7D, 0x7F}, {0x7C, 0x7F}, {0x7C, 0x7F},  // A8-AB i32.trunc
+            {0x7F, 0x7E}, {0x7F, 0x7E},                              // AC-AD i64.extend_i32
+            {0x7D, 0x7E}, {0x7D, 0x7E}, {0x7C, 0x7E}, {0x7C, 0x7E},  // AE-B1 i64.trunc
+            {0x7F, 0x7D}, {0x7F, 0x7D}, {0x7E, 0x7D}, {0x7E, 0x7D},  // B2-B5 f32.convert
+            {0x7C, 0x7D},                                            // B6 f32.demote_f64
+            {0x7F, 0x7C}, {0x7F, 0x7C}, {0x7E, 0x7C}, {0x7E, 0x7C},  // B7-BA f64.convert
+            {0x7D, 0x7C},                                            // BB f64.promote_f32
+            {0x7D, 0x7F}, {0x7C, 0x7E}, {0x7F, 0x7D}, {0x7E, 0x7C},  // BC-BF reinterpret
+            {0x7F, 0x7F}, {0x7F, 0x7F},                              // C0-C1 i32.extend
+            {0x7E, 0x7E}, {0x7E, 0x7E}, {0x7E, 0x7E}                 // C2-C4 i64.extend
+        };
+        if (op < 0xA7 || op > 0xC4) return 0;
+        *in1 = conv[op - 0xA7][0];
+        *out = conv[op - 0xA7][1];
+    }
+    return 1;
+}
+
+static int compile_prefix_fc(compiler_t* c) {
+    const wasmify_engine_module_t* m = c->module;
+    reader_t* r = c->r;
+    const uint8_t I32 = WASMIFY_TYPE_I32;
+    uint32_t sub = read_u32(r);
+    if (r->error) FAIL(c, r->error);
+
+    if (sub <= 7) {
+        static const uint8_t in_types[] = {0x7D, 0x7D, 0x7C, 0x7C, 0x7D, 0x7D, 0x7C, 0x7C};
+        POP(c, in_types[sub]);
+        PUSH(c, sub < 4 ? WASMIFY_TYPE_I32 : WASMIFY_TYPE_I64);
+        return emit(c, OP_PREFIX_FC + sub, 0, 0);
+    }
+
+    uint32_t a = 0, b = 0;
+    switch (sub) {
+        case 8:   // memory.init
+            a = read_u32(r);
+            if (read_u8(r) != 0) FAIL(c, "zero byte expected");
+            if (!m->has_memory) FAIL(c, "unknown memory");
+            if (!m->has_data_count) FAIL(c, "data count section required");
+            if (a >= m->declared_data_count) FAIL(c, "unknown data segment");
+            POP(c, I32); POP(c, I32); POP(c, I32);
+            break;
+        case 9:   // data.drop
+            a = read_u32(r);
+            if (!m->has_data_count) FAIL(c, "data count section required");
+            if (a >= m->declared_data_count) FAIL(c, "unknown data segment");
+            break;
+        case 10:  // memory.copy
+            if (read_u8(r) != 0 || read_u8(r) != 0) FAIL(c, "zero byte expected");
+            if (!m->has_memory) FAIL(c, "unknown memory");
+            POP(c, I32); POP(c, I32); POP(c, I32);
+            break;
+        case 11:  // memory.fill
+            if (read_u8(r) != 0) FAIL(c, "zero byte expected");
+            if (!m->has_memory) FAIL(c, "unknown memory");
+            POP(c, I32); POP(c, I32); POP(c, I32);
+            break;
+        case 12:  // table.init
+            a = read_u32(r);
+            b = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= m->elem_count) FAIL(c, "unknown elem segment");
+            if (b >= m->table_count) FAIL(c, "unknown table");
+            if (m->elems[a].type != m->tables[b].elem_type) FAIL(c, "type mismatch");
+            POP(c, I32); POP(c, I32); POP(c, I32);
+            break;
+        case 13:  // elem.drop
+            a = read_u32(r);
+            if (!r->error && a >= m->elem_count) FAIL(c, "unknown elem segment");
+            break;
+        case 14:  // table.copy
+            a = read_u32(r);
+            b = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= m->table_count || b >= m->table_count) FAIL(c, "unknown table");
+            if (m->tables[a].elem_type != m->tables[b].elem_type) FAIL(c, "type mismatch");
+            POP(c, I32); POP(c, I32); POP(c, I32);
+            break;
+        case 15:  // table.grow
+            a = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= m->table_count) FAIL(c, "unknown table");
+            POP(c, I32);
+            POP(c, m->tables[a].elem_type);
+            PUSH(c, I32);
+            break;
+        case 16:  // table.size
+            a = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= m->table_count) FAIL(c, "unknown table");
+            PUSH(c, I32);
+            break;
+        case 17:  // table.fill
+            a = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= m->table_count) FAIL(c, "unknown table");
+            POP(c, I32);
+            POP(c, m->tables[a].elem_type);
+            POP(c, I32);
+            break;
+        default:
+            FAIL(c, "unsupported opcode");
+    }
+    if (r->error) FAIL(c, r->error);
+    return emit(c, OP_PREFIX_FC + sub, a, b);
+}
+
+// Operands and immediates of the SIMD opcodes 0xFD 0x00..0xFF
+enum {
+    SIMD_NONE = 0,
+    SIMD_LOAD,          // memarg; i32 -> v128
+    SIMD_STORE,         // memarg; i32 v128 ->
+    SIMD_LOAD_LANE,     // memarg lane; i32 v128 -> v128
+    SIMD_STORE_LANE,    // memarg lane; i32 v128 ->
+    SIMD_CONST,         // 16 bytes; -> v128
+    SIMD_SHUFFLE,       // 16 lanes; v128 v128 -> v128
+    SIMD_SPLAT,         // scalar -> v128
+    SIMD_EXTRACT,       // lane; v128 -> scalar
+    SIMD_REPLACE,       // lane; v128 scalar -> v128
+    SIMD_UNARY,         // v128 -> v128
+    SIMD_BINARY,        // v128 v128 -> v128
+    SIMD_TERNARY,       // v128 v128 v128 -> v128
+    SIMD_TEST,          // v128 -> i32
+    SIMD_SHIFT          // v128 i32 -> v128
+};
+
+static const uint8_t SIMD_SHAPES[256] = {
+    [0x00 ... 0x0A] = SIMD_LOAD, [0x0B] = SIMD_STORE, [0x0C] = SIMD_CONST, [0x0D] = SIMD_SHUFFLE,
+    [0x0E] = SIMD_BINARY, [0x0F ... 0x14] = SIMD_SPLAT,
+    [0x15] = SIMD_EXTRACT, [0x16] = SIMD_EXTRACT, [0x17] = SIMD_REPLACE,
+    [0x18] = SIMD_EXTRACT, [0x19] = SIMD_EXTRACT, [0x1A] = SIMD_REPLACE,
+    [0x1B] = SIMD_EXTRACT, [0x1C] = SIMD_REPLACE, [0x1D] = SIMD_EXTRACT, [0x1E] = SIMD_REPLACE,
+    [0x1F] = SIMD_EXTRACT, [0x20] = SIMD_REPLACE, [0x21] = SIMD_EXTRACT, [0x22] = SIMD_REPLACE,
+    [0x23 ... 0x4C] = SIMD_BINARY, [0x4D] = SIMD_UNARY, [0x4E ... 0x51] = SIMD_BINARY,
+    [0x52] = SIMD_TERNARY, [0x53] = SIMD_TEST, [0x54 ... 0x57] = SIMD_LOAD_LANE,
+    [0x58 ... 0x5B] = SIMD_STORE_LANE, [0x5C ... 0x5D] = SIMD_LOAD, [0x5E ... 0x62] = SIMD_UNARY,
+    [0x63 ... 0x64] = SIMD_TEST, [0x65 ... 0x66] = SIMD_BINARY, [0x67 ... 0x6A] = SIMD_UNARY,
+    [0x6B ... 0x6D] = SIMD_SHIFT, [0x6E ... 0x73] = SIMD_BINARY, [0x74 ... 0x75] = SIMD_UNARY,
+    [0x76 ... 0x79] = SIMD_BINARY, [0x7A] = SIMD_UNARY, [0x7B] = SIMD_BINARY, [0x7C ... 0x81] = SIMD_UNARY,
+    [0x82] = SIMD_BINARY, [0x83 ... 0x84] = SIMD_TEST, [0x85 ... 0x86] = SIMD_BINARY,
+    [0x87 ... 0x8A] = SIMD_UNARY, [0x8B ... 0x8D] = SIMD_SHIFT, [0x8E ... 0x93] = SIMD_BINARY,
+    [0x94] = SIMD_UNARY, [0x95 ... 0x99] = SIMD_BINARY, [0x9B ... 0x9F] = SIMD_BINARY,
+    [0xA0 ... 0xA1] = SIMD_UNARY, [0xA3 ... 0xA4] = SIMD_TEST, [0xA7 ... 0xAA] = SIMD_UNARY,
+    [0xAB ... 0xAD] = SIMD_SHIFT, [0xAE] = SIMD_BINARY, [0xB1] = SIMD_BINARY, [0xB5 ... 0xBA] = SIMD_BINARY,
+    [0xBC ... 0xBF] = SIMD_BINARY, [0xC0 ... 0xC1] = SIMD_UNARY, [0xC3 ... 0xC4] = SIMD_TEST,
+    [0xC7 ... 0xCA] = SIMD_UNARY, [0xCB ... 0xCD] = SIMD_SHIFT, [0xCE] = SIMD_BINARY, [0xD1] = SIMD_BINARY,
+    [0xD5 ... 0xDF] = SIMD_BINARY, [0xE0 ... 0xE1] = SIMD_UNARY, [0xE3] = SIMD_UNARY,
+    [0xE4 ... 0xEB] = SIMD_BINARY, [0xEC ... 0xED] = SIMD_UNARY, [0xEF] = SIMD_UNARY,
+    [0xF0 ... 0xF7] = SIMD_BINARY, [0xF8 ... 0xFF] = SIMD_UNARY
+};
+
+// Scalar type and lane count of the splat (0x0F..0x14) and lane access
+// (0x15..0x22) opcodes, by shape i8x16, i16x8, i32x4, i64x2, f32x4, f64x2
+static const struct {
+    uint8_t type;
+    uint8_t lanes;
+} SIMD_LANE_SHAPES[6] = {
+    {WASMIFY_TYPE_I32, 16}, {WASMIFY_TYPE_I32, 8}, {WASMIFY_TYPE_I32, 4},
+    {WASMIFY_TYPE_I64, 2}, {WASMIFY_TYPE_F32, 4}, {WASMIFY_TYPE_F64, 2}
+};
+static const uint8_t SIMD_LANE_OPS[14] = {0, 0, 0, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+
+// log2 of the bytes a SIMD load or store accesses, its natural alignment
+static uint32_t simd_access_log2(uint32_t sub) {
+    if (sub == 0x00 || sub == 0x0B) return 4;
+    if (sub <= 0x06) return 3;
+    if (sub <= 0x0A) return sub - 0x07;
+    if (sub >= 0x5C) return sub == 0x5C ? 2 : 3;
+    return (sub - 0x54) & 3;
+}
+
+static int compile_prefix_fd(compiler_t* c) {
+    reader_t* r = c->r;
+    const uint8_t I32 = WASMIFY_TYPE_I32, V128 = WASMIFY_TYPE_V128;
+    uint32_t sub = read_u32(r);
+    if (r->error) FAIL(c, r->error);
+    uint8_t shape = sub < 256 ? SIMD_SHAPES[sub] : SIMD_NONE;
+
+    uint32_t a = 0;
+    uint64_t b = 0;
+    switch (shape) {
+        case SIMD_LOAD:
+        case SIMD_STORE:
+        case SIMD_LOAD_LANE:
+        case SIMD_STORE_LANE: {
+            uint32_t size_log2 = simd_access_log2(sub);
+            if (!memarg(c, size_log2, &a)) return 0;
+            if (shape == SIMD_LOAD_LANE || shape == SIMD_STORE_LANE) {
+                b = read_u8(r);
+                if (r->error) FAIL(c, r->error);
+                if (b >= 16u >> size_log2) FAIL(c, "invalid lane index");
+            }
+            if (shape != SIMD_LOAD) POP(c, V128);
+            POP(c, I32);
+            if (shape == SIMD_LOAD || shape == SIMD_LOAD_LANE) PUSH(c, V128);
+            break;
+        }
+        case SIMD_CONST:
+        case SIMD_SHUFFLE: {
+            // 128-bit immediates don't fit an insn; the upper half follows in one
+            uint64_t low = read_fixed(r, 8);
+            uint64_t high = read_fixed(r, 8);
+            if (r->error) FAIL(c, r->error);
+            if (shape == SIMD_SHUFFLE) {
+                for (int i = 0; i < 64; i += 8) {
+                    if (((low >> i) & 0xFF) >= 32 || ((high >> i) & 0xFF) >= 32) FAIL(c, "invalid lane index");
+                }
+                POP(c, V128);
+                POP(c, V128);
+            }
+            PUSH(c, V128);
+            return emit(c, OP_PREFIX_FD + sub, 0, low) && emit(c, OP_IMM, 0, high);
+        }
+        case SIMD_SPLAT:
+            POP(c, SIMD_LANE_SHAPES[sub - 0x0F].type);
+            PUSH(c, V128);
+            break;
+        case SIMD_EXTRACT:
+        case SIMD_REPLACE: {
+            uint8_t type = SIMD_LANE_SHAPES[SIMD_LANE_OPS[sub - 0x15]].type;
+            a = read_u8(r);
+            if (r->error) FAIL(c, r->error);
+            if (a >= SIMD_LANE_SHAPES[SIMD_LANE_OPS[sub - 0x15]].lanes) FAIL(c, "invalid lane index");
+            if (shape == SIMD_REPLACE) POP(c, type);
+            POP(c, V128);
+            PUSH(c, shape == SIMD_REPLACE ? V128 : type);
+            break;
+        }
+        case SIMD_TERNARY:
+            POP(c, V128);
+            // fallthrough
+        case SIMD_BINARY:
+            POP(c, V128);
+            // fallthrough
+        case SIMD_UNARY:
+            POP(c, V128);
+            PUSH(c, V128);
+            break;
+        case SIMD_TEST:
+            POP(c, V128);
+            PUSH(c, I32);
+            break;
+        case SIMD_SHIFT:
+            POP(c, I32);
+            POP(c, V128);
+            PUSH(c, V128);
+            break;
+        default:
+            FAIL(c, "unsupported opcode");
+    }
+    return emit(c, OP_PREFIX_FD + sub, a, b);
+}
+
+// Value type and log2 of the width of atomic accesses, by (opcode - 0x10) % 7
+// for the loads, stores and read-modify-writes 0xFE 0x10..0x4E
+static const uint8_t ATOMIC_TYPES[7] = {0x7F, 0x7E, 0x7F, 0x7F, 0x7E, 0x7E, 0x7E};
+static const uint8_t ATOMIC_SIZES_LOG2[7] = {2, 3, 0, 1, 0, 1, 2};
+
+// Operations of the atomic accesses, by (opcode - 0x10) / 7
+enum {
+    ATOMIC_LOAD = 0,
+    ATOMIC_STORE,
+    ATOMIC_ADD,
+    ATOMIC_SUB,
+    ATOMIC_AND,
+    ATOMIC_OR,
+    ATOMIC_XOR,
+    ATOMIC_XCHG,
+    ATOMIC_CMPXCHG
+};
+
+static int atomic_memarg(compiler_t* c, uint32_t natural_align, uint32_t* offset) {
+    reader_t* r = c->r;
+    uint32_t align = read_u32(r);
+    *offset = read_u32(r);
+    if (r->error) FAIL(c, r->error);
+    if (!c->module->has_memory) FAIL(c, "unknown memory");
+    if (align != natural_align) FAIL(c, "alignment must be natural for atomics");
+    return 1;
+}
+
+static int compile_prefix_fe(compiler_t* c) {
+    reader_t* r = c->r;
+    const uint8_t I32 = WASMIFY_TYPE_I32, I64 = WASMIFY_TYPE_I64;
+    uint32_t sub = read_u32(r);
+    if (r->error) FAIL(c, r->error);
+
+    uint32_t offset;
+    switch (sub) {
+        case 0x00:  // memory.atomic.notify
+            if (!atomic_memarg(c, 2, &offset)) return 0;
+            POP(c, I32);
+            POP(c, I32);
+            PUSH(c, I32);
+            return emit(c, OP_PREFIX_FE + sub, offset, 0);
+        case 0x01:
+        case 0x02:  // memory.atomic.wait32, memory.atomic.wait64
+            if (!atomic_memarg(c, sub + 1, &offset)) return 0;
+            POP(c, I64);
+            POP(c, sub == 0x01 ? I32 : I64);
+            POP(c, I32);
+            PUSH(c, I32);
+            return emit(c, OP_PREFIX_FE + sub, offset, 0);
+        case 0x03:  // atomic.fence
+            if (read_u8(r) != 0) FAIL(c, "zero byte expected");
+            return emit(c, OP_PREFIX_FE + sub, 0, 0);
+        default:
+            break;
+    }
+    if (sub < 0x10 || sub > 0x4E) FAIL(c, "unsupported opcode");
+
+    uint32_t group = (sub - 0x10) / 7;
+    uint32_t width = (sub - 0x10) % 7;
+    uint8_t type = ATOMIC_TYPES[width];
+    if (!atomic_memarg(c, ATOMIC_SIZES_LOG2[width], &offset)) return 0;
+    if (group == ATOMIC_CMPXCHG) POP(c, type);
+    if (group != ATOMIC_LOAD) POP(c, type);
+    POP(c, I32);
+    if (group != ATOMIC_STORE) PUSH(c, type);
+    // The operation and width are decoded here rather than on every access
+    return emit(c, OP_PREFIX_FE + sub, offset, ((uint64_t)group << 8) | ATOMIC_SIZES_LOG2[width]);
+}
+
+static int compile_instr(compiler_t* c, uint8_t op) {
+    const wasmify_engine_module_t* m = c->module;
+    reader_t* r = c->r;
+    const uint8_t I32 = WASMIFY_TYPE_I32, I64 = WASMIFY_TYPE_I64;
+    const uint8_t F32 = WASMIFY_TYPE_F32, F64 = WASMIFY_TYPE_F64;
+
+    switch (op) {
+        case 0x00:  // unreachable
+            if (!emit(c, OP_UNREACHABLE, 0, 0)) return 0;
+            set_unreachable(c);
+            return 1;
+        case 0x01:  // nop
+            return 1;
+        case 0x02:
+        case 0x03: {
+            uint8_t single;
+            int32_t type_index;
+            if (!read_block_type(c, &single, &type_index)) return 0;
+            return push_ctrl(c, op, single, type_index);
+        }
+        case 0x04: {
+            uint8_t single;
+            int32_t type_index;
+            if (!read_block_type(c, &single, &type_index)) return 0;
+            POP(c, I32);
+            if (!emit(c, OP_IF, NO_INDEX, 0)) return 0;
+            if (!push_ctrl(c, CTRL_IF, single, type_index)) return 0;
+            c->ctrls[c->nctrls - 1].start = c->code_len - 1;
+            return 1;
+        }
+        case 0x05: {  // else
+            ctrl_t* ctl = &c->ctrls[c->nctrls - 1];
+            if (ctl->kind != CTRL_IF || ctl->has_else) FAIL(c, "else without matching if");
+            if (!check_block_end(c)) return 0;
+            ctl = &c->ctrls[c->nctrls - 1];
+            if (!emit(c, OP_JMP, NO_INDEX, 0)) return 0;
+            if (!add_fixup(c, ctl, c->code_len - 1)) return 0;
+            c->code[ctl->start].a = c->code_len;
+            ctl->has_else = 1;
+            ctl->unreachable = 0;
+            const uint8_t* params;
+            uint32_t nparams;
+            block_params(c, ctl, &params, &nparams);
+            return push_vals(c, params, nparams);
+        }
+        case 0x0B: {  // end
+            ctrl_t* ctl = &c->ctrls[c->nctrls - 1];
+            if (ctl->kind == CTRL_IF && !ctl->has_else) {
+                const uint8_t* params;
+                const uint8_t* results;
+                uint32_t nparams, nresults;
+                block_params(c, ctl, &params, &nparams);
+                block_results(c, ctl, &results, &nresults);
+                if (nparams != nresults || (nparams && memcmp(params, results, nparams) != 0)) {
+                    FAIL(c, "type mismatch: if without else must not change the stack");
+                }
+            }
+            if (!check_block_end(c)) return 0;
+            ctl = &c->ctrls[c->nctrls - 1];
+            uint32_t target = c->code_len;
+            if (ctl->kind == CTRL_FUNC) {
+                const functype_t* ft = &m->types[c->func->type];
+                if (!emit(c, OP_RETURN, 0, ft->result_slots)) return 0;
+            }
+            patch_fixups(c, ctl, target);
+            if (ctl->kind == CTRL_IF && !ctl->has_else) c->code[ctl->start].a = target;
+            ctrl_t done = *ctl;
+            c->nctrls--;
+            if (c->nctrls == 0) return 1;
+            const uint8_t* results;
+            uint32_t nresults;
+            block_results(c, &done, &results, &nresults);
+            return push_vals(c, results, nresults);
+        }
+        case 0x0C: {  // br
+            uint32_t depth = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (!check_label(c, depth, 0)) return 0;
+            if (!emit_branch(c, OP_BR, depth)) return 0;
+            set_unreachable(c);
+            return 1;
+        }
+        case 0x0D: {  // br_if
+            uint32_t depth = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            POP(c, I32);
+            if (!check_label(c, depth, 1)) return 0;
+            return emit_branch(c, OP_BR_IF, depth);
+        }
+        case 0x0E: {  // br_table
+            uint32_t count = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (count > (size_t)(r->end - r->p)) FAIL(c, "unexpected end");
+            POP(c, I32);
+            uint32_t first = c->nbranches;
+            if (!grow_array((void**)&c->branches, &c->branches_cap, c->nbranches + count + 1, sizeof(branch_t))) {
+                FAIL(c, "out of memory");
+            }
+            uint32_t arity = NO_INDEX;
+            for (uint32_t i = 0; i <= count; i++) {
+                uint32_t depth = read_u32(r);
+                if (r->error) FAIL(c, r->error);
+                if (depth >= c->nctrls) FAIL(c, "unknown label");
+                ctrl_t* ctl = &c->ctrls[c->nctrls - 1 - depth];
+                const uint8_t* types;
+                uint32_t ntypes;
+                label_types(c, ctl, &types, &ntypes);
+                if (arity != NO_INDEX && ntypes != arity) FAIL(c, "type mismatch: br_table arity");
+                arity = ntypes;
+                if (!check_label(c, depth, i < count)) return 0;
+                branch_t* br = &c->branches[c->nbranches++];
+                br->keep = types_slots(types, ntypes);
+                br->base = c->func->local_slots + ctl->slot_height;
+                br->target = ctl->kind == CTRL_LOOP ? ctl->start : NO_INDEX;
+                if (ctl->kind != CTRL_LOOP && !add_fixup(c, ctl, (c->nbranches - 1) | BRANCH_TABLE_REF)) return 0;
+            }
+            if (!emit(c, OP_BR_TABLE, first, count)) return 0;
+            set_unreachable(c);
+            return 1;
+        }
+        case 0x0F: {  // return
+            const functype_t* ft = &m->types[c->func->type];
+            if (!pop_vals(c, ft->types + ft->param_count, ft->result_count)) return 0;
+            if (!emit(c, OP_RETURN, 0, ft->result_slots)) return 0;
+            set_unreachable(c);
+            return 1;
+        }
+        case 0x10: {  // call
+            uint32_t idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (idx >= m->func_count) FAIL(c, "unknown function");
+            const functype_t* ft = &m->types[m->funcs[idx].type];
+            if (!pop_vals(c, ft->types, ft->param_count)) return 0;
+            if (!push_vals(c, ft->types + ft->param_count, ft->result_count)) return 0;
+            return emit(c, OP_CALL, idx, 0);
+        }
+        case 0x11: {  // call_indirect
+            uint32_t type_idx = read_u32(r);
+            uint32_t table_idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (type_idx >= m->type_count) FAIL(c, "unknown type");
+            if (table_idx >= m->table_count) FAIL(c, "unknown table");
+            if (m->tables[table_idx].elem_type != WASMIFY_TYPE_FUNCREF) FAIL(c, "type mismatch");
+            const functype_t* ft = &m->types[type_idx];
+            POP(c, I32);
+            if (!pop_vals(c, ft->types, ft->param_count)) return 0;
+            if (!push_vals(c, ft->types + ft->param_count, ft->result_count)) return 0;
+            return emit(c, OP_CALL_INDIRECT, type_idx, table_idx);
+        }
+        case 0x1A: {  // drop
+            uint8_t t = pop_val(c, TYPE_UNKNOWN);
+            if (t == 0xFF) return 0;
+            return emit(c, OP_DROP, 0, slot_count(t));
+        }
+        case 0x1B:
+        case 0x1C: {  // select, select t
+            uint8_t t = TYPE_UNKNOWN;
+            if (op == 0x1C) {
+                if (read_u32(r) != 1) FAIL(c, "invalid result arity");
+                t = read_valtype(r);
+                if (r->error) FAIL(c, r->error);
+            }
+            POP(c, I32);
+            uint8_t t1 = pop_val(c, op == 0x1C ? t : TYPE_UNKNOWN);
+            if (t1 == 0xFF) return 0;
+            uint8_t t2 = pop_val(c, t1);
+            if (t2 == 0xFF) return 0;
+            if (op == 0x1B) {
+                t = t1 != TYPE_UNKNOWN ? t1 : t2;
+                if (is_ref_type(t)) FAIL(c, "type mismatch: select on references needs a type");
+            }
+            PUSH(c, t);
+            return emit(c, OP_SELECT, 0, slot_count(t));
+        }
+        case 0x20:
+        case 0x21:
+        case 0x22: {  // local.get, local.set, local.tee
+            uint32_t idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (idx >= c->local_count) FAIL(c, "unknown local");
+            uint8_t t = c->local_types[idx];
+            if (op != 0x20) POP(c, t);
+            if (op != 0x21) PUSH(c, t);
+            return emit(c, t == WASMIFY_TYPE_V128 ? op + 0x100u : op, c->local_offsets[idx], 0);
+        }
+        case 0x23:
+        case 0x24: {  // global.get, global.set
+            uint32_t idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (idx >= m->global_count) FAIL(c, "unknown global");
+            const global_t* g = &m->globals[idx];
+            if (op == 0x24) {
+                if (!g->mutable_) FAIL(c, "global is immutable");
+                POP(c, g->type);
+            } else {
+                PUSH(c, g->type);
+            }
+            return emit(c, g->type == WASMIFY_TYPE_V128 ? op + 0x100u : op, g->slot, 0);
+        }
+        case 0x25:
+        case 0x26: {  // table.get, table.set
+            uint32_t idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (idx >= m->table_count) FAIL(c, "unknown table");
+            if (op == 0x26) POP(c, m->tables[idx].elem_type);
+            POP(c, I32);
+            if (op == 0x25) PUSH(c, m->tables[idx].elem_type);
+            return emit(c, op, idx, 0);
+        }
+        case 0x3F:
+        case 0x40: {  // memory.size, memory.grow
+            if (read_u8(r) != 0) FAIL(c, "zero byte expected");
+            if (!m->has_memory) FAIL(c, "unknown memory");
+            if (op == 0x40) POP(c, I32);
+            PUSH(c, I32);
+            return emit(c, op, 0, 0);
+        }
+        case 0x41:
+            PUSH(c, I32);
+            return emit(c, OP_CONST, 0, (uint32_t)read_s32(r));
+        case 0x42:
+            PUSH(c, I64);
+            return emit(c, OP_CONST, 0, (uint64_t)read_s64(r));
+        case 0x43:
+            PUSH(c, F32);
+            return emit(c, OP_CONST, 0, read_fixed(r, 4));
+        case 0x44:
+            PUSH(c, F64);
+            return emit(c, OP_CONST, 0, read_fixed(r, 8));
+        case 0xD0: {  // ref.null
+            uint8_t t = read_reftype(r);
+            if (r->error) FAIL(c, r->error);
+            PUSH(c, t);
+            return emit(c, OP_CONST, 0, 0);
+        }
+        case 0xD1: {  // ref.is_null
+            uint8_t t = pop_val(c, TYPE_UNKNOWN);
+            if (t == 0xFF) return 0;
+            if (t != TYPE_UNKNOWN && !is_ref_type(t)) FAIL(c, "type mismatch");
+            PUSH(c, I32);
+            return emit(c, OP_REF_IS_NULL, 0, 0);
+        }
+        case 0xD2: {  // ref.func
+            uint32_t idx = read_u32(r);
+            if (r->error) FAIL(c, r->error);
+            if (idx >= m->func_count) FAIL(c, "unknown function");
+            PUSH(c, WASMIFY_TYPE_FUNCREF);
+            return emit(c, OP_CONST, 0, (uint64_t)idx + 1);
+        }
+        case 0xFC:
+            return compile_prefix_fc(c);
+        case 0xFD:
+            return compile_prefix_fd(c);
+        case 0xFE:
+            return compile_prefix_fe(c);
+        default:
+            break;
+    }
+
+    if (op >= 0x28 && op <= 0x35) {  // loads
+        static const uint8_t types[] = {0x7F, 0x7E, 0x7D, 0x7C, 0x7F, 0x7F, 0x7F, 0x7F,
+                                        0x7E, 0x7E, 0x7E, 0x7E, 0x7E, 0x7E};
+        static const uint8_t aligns[] = {2, 3, 2, 3, 0, 0, 1, 1, 0, 0, 1, 1, 2, 2};
+        uint32_t offset;
+        if (!memarg(c, aligns[op - 0x28], &offset)) return 0;
+        POP(c, I32);
+        PUSH(c, types[op - 0x28]);
+        return emit(c, op, offset, 0);
+    }
+    if (op >= 0x36 && op <= 0x3E) {  // stores
+        static const uint8_t types[] = {0x7F, 0x7E, 0x7D, 0x7C, 0x7F, 0x7F, 0x7E, 0x7E, 0x7E};
+        static const uint8_t aligns[] = {2, 3, 2, 3, 0, 1, 0, 1, 2};
+        uint32_t offset;
+        if (!memarg(c, aligns[op - 0x36], &offset)) return 0;
+        POP(c, types[op - 0x36]);
+        POP(c, I32);
+        return emit(c, op, offset, 0);
+    }
+
+    uint8_t in1, in2, out;
+    if (op < 0x45 || !numeric_sig(op, &in1, &in2, &out)) FAIL(c, "unsupported opcode");
+    if (in2) POP(c, in2);
+    POP(c, in1);
+    PUSH(c, out);
+    return emit(c, op, 0, 0);
+}
+
+static void compiler_free(compiler_t* c) {
+    free(c->local_types);
+    free(c->local_offsets);
+    free(c->vals);
+    free(c->ctrls);
+    free(c->fixups);
+    free(c->code);
+    free(c->branches);
+}
+
+static int compile_func(wasmify_engine_module_t* m, func_t* func, reader_t* body, const char** error) {
+    compiler_t c;
+    memset(&c, 0, sizeof(c));
+    c.module = m;
+    c.func = func;
+    c.r = body;
+
+    const functype_t* ft = &m->types[func->type];
+
+    // Locals: parameters first, then the declared groups
+    uint32_t groups = read_u32(body);
+    uint64_t total = ft->param_count;
+    const uint8_t* groups_start = body->p;
+    for (uint32_t i = 0; i < groups && !body->error; i++) {
+        total += read_u32(body);
+        read_valtype(body);
+        if (total > MAX_LOCALS) reader_fail(body, "too many locals");
+    }
+    if (body->error) {
+        *error = body->error;
+        return 0;
+    }
+    c.local_count = (uint32_t)total;
+    c.local_types = malloc(total ? total : 1);
+    c.local_offsets = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (!c.local_types || !c.local_offsets) {
+        compiler_free(&c);
+        *error = "out of memory";
+        return 0;
+    }
+    uint32_t n = 0, slots = 0;
+    for (uint32_t i = 0; i < ft->param_count; i++, n++) {
+        c.local_types[n] = ft->types[i];
+        c.local_offsets[n] = slots;
+        slots += slot_count(ft->types[i]);
+    }
+    reader_t again = {groups_start, body->end, NULL};
+    for (uint32_t i = 0; i < groups; i++) {
+        uint32_t count = read_u32(&again);
+        uint8_t t = read_valtype(&again);
+        for (uint32_t j = 0; j < count; j++, n++) {
+            c.local_types[n] = t;
+            c.local_offsets[n] = slots;
+            slots += slot_count(t);
+        }
+    }
+    func->local_slots = slots;
+
+    int ok = push_ctrl(&c, CTRL_FUNC, 0, (int32_t)func->type);
+    while (ok && c.nctrls > 0) {
+        uint8_t op = read_u8(body);
+        if (body->error) {
+            c.error = body->error;
+            ok = 0;
+            break;
+        }
+        ok = compile_instr(&c, op);
+        if (ok && body->error) {
+            c.error = body->error;
+            ok = 0;
+        }
+    }
+    if (ok && body->p != body->end) {
+        c.error = "section size mismatch";
+        ok = 0;
+    }
+    if (!ok) {
+        *error = c.error ? c.error : "invalid function body";
+        compiler_free(&c);
+        return 0;
+    }
+
+    func->code = c.code;
+    func->code_len = c.code_len;
+    func->branches = c.branches;
+    func->branch_count = c.nbranches;
+    func->max_slots = func->local_slots + c.max_slots;
+    c.code = NULL;
+    c.branches = NULL;
+    compiler_free(&c);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Module decoding
+// ---------------------------------------------------------------------------
+
+static int parse_types(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (r->error) return 0;
+    if (count > (size_t)(r->end - r->p)) {
+        reader_fail(r, "unexpected end");
+        return 0;
+    }
+    m->types = calloc(count ? count : 1, sizeof(functype_t));
+    if (!m->types) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        functype_t* ft = &m->types[i];
+        if (read_u8(r) != 0x60) {
+            reader_fail(r, "malformed function type");
+            break;
+        }
+        uint32_t np = read_u32(r);
+        if (r->error || np > (size_t)(r->end - r->p)) {
+            reader_fail(r, "unexpected end");
+            break;
+        }
+        const uint8_t* params = r->p;
+        r->p += np;
+        uint32_t nr = read_u32(r);
+        if (r->error || nr > (size_t)(r->end - r->p)) {
+            reader_fail(r, "unexpected end");
+            break;
+        }
+        ft->types = malloc((size_t)np + nr + 1);
+        if (!ft->types) {
+            reader_fail(r, "out of memory");
+            break;
+        }
+        m->type_count = i + 1;
+        ft->param_count = np;
+        ft->result_count = nr;
+        reader_t pr = {params, params + np, NULL};
+        for (uint32_t j = 0; j < np; j++) ft->types[j] = read_valtype(&pr);
+        for (uint32_t j = 0; j < nr; j++) ft->types[np + j] = read_valtype(r);
+        if (pr.error) reader_fail(r, pr.error);
+        ft->param_slots = types_slots(ft->types, np);
+        ft->result_slots = types_slots(ft->types + np, nr);
+        ft->canon = i;
+        for (uint32_t j = 0; j < i; j++) {
+            const functype_t* other = &m->types[j];
+            if (other->param_count == np && other->result_count == nr &&
+                memcmp(other->types, ft->types, (size_t)np + nr) == 0) {
+                ft->canon = other->canon;
+                break;
+            }
+        }
+    }
+    return !r->error;
+}
+
+static int add_func(reader_t* r, wasmify_engine_module_t* m, uint32_t type_idx, uint32_t* cap) {
+    if (type_idx >= m->type_count) {
+        reader_fail(r, "unknown type");
+        return 0;
+    }
+    if (!grow_array((void**)&m->funcs, cap, m->func_count + 1, sizeof(func_t))) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    func_t* f = &m->funcs[m->func_count++];
+    memset(f, 0, sizeof(*f));
+    f->type = type_idx;
+    return 1;
+}
+
+static int parse_imports(reader_t* r, wasmify_engine_module_t* m, uint32_t* func_cap) {
+    uint32_t count = read_u32(r);
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        char* module_name = read_name(r);
+        char* field = read_name(r);
+        uint8_t kind = read_u8(r);
+        if (r->error) {
+            free(module_name);
+            free(field);
+            break;
+        }
+        switch (kind) {
+            case 0x00: {
+                uint32_t type_idx = read_u32(r);
+                if (!r->error && add_func(r, m, type_idx, func_cap)) {
+                    func_t* f = &m->funcs[m->func_count - 1];
+                    f->import_module = module_name;
+                    f->import_name = field;
+                    m->import_func_count++;
+                    continue;
+                }
+                break;
+            }
+            case 0x02:
+                // The engine owns the single linear memory; an imported one is
+                // created to the declared limits unless it is shared and the
+                // instance is given a shared memory to use.
+                if (m->has_memory) {
+                    reader_fail(r, "multiple memories");
+                    break;
+                }
+                read_limits(r, &m->memory_min, &m->memory_max, WASMIFY_ENGINE_MAX_PAGES, &m->memory_shared);
+                m->has_memory = 1;
+                break;
+            default:
+                reader_fail(r, "unsupported import kind");
+                break;
+        }
+        free(module_name);
+        free(field);
+    }
+    return !r->error;
+}
+
+static int parse_functions(reader_t* r, wasmify_engine_module_t* m, uint32_t* func_cap) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        uint32_t type_idx = read_u32(r);
+        if (!r->error) add_func(r, m, type_idx, func_cap);
+    }
+    m->declared_func_count = count;
+    return !r->error;
+}
+
+static int parse_tables(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    if (r->error) return 0;
+    m->tables = calloc(count ? count : 1, sizeof(table_t));
+    if (!m->tables) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        table_t* t = &m->tables[i];
+        t->elem_type = read_reftype(r);
+        read_limits(r, &t->min, &t->max, UINT32_MAX, NULL);
+        m->table_count = i + 1;
+    }
+    return !r->error;
+}
+
+static int parse_memory(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (r->error) return 0;
+    if (count > 1 || (count == 1 && m->has_memory)) {
+        reader_fail(r, "multiple memories");
+        return 0;
+    }
+    if (count == 1) {
+        read_limits(r, &m->memory_min, &m->memory_max, WASMIFY_ENGINE_MAX_PAGES, &m->memory_shared);
+        m->has_memory = 1;
+    }
+    return !r->error;
+}
+
+static int parse_globals(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    if (r->error) return 0;
+    m->globals = calloc(count ? count : 1, sizeof(global_t));
+    if (!m->globals) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        global_t* g = &m->globals[i];
+        g->type = read_valtype(r);
+        uint8_t mut = read_u8(r);
+        if (mut > 1) reader_fail(r, "malformed mutability");
+        g->mutable_ = mut;
+        g->slot = m->global_slots;
+        read_const_expr(r, m, g->type, &g->init);
+        m->global_slots += slot_count(g->type);
+        m->global_count = i + 1;
+    }
+    return !r->error;
+}
+
+static int parse_exports(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    if (r->error) return 0;
+    m->exports = calloc(count ? count : 1, sizeof(export_t));
+    if (!m->exports) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        export_t* e = &m->exports[i];
+        e->name = read_name(r);
+        m->export_count = i + 1;
+        e->kind = read_u8(r);
+        e->index = read_u32(r);
+        if (r->error) break;
+        uint32_t limit;
+        switch (e->kind) {
+            case 0x00: limit = m->func_count; break;
+            case 0x01: limit = m->table_count; break;
+            case 0x02: limit = m->has_memory ? 1 : 0; break;
+            case 0x03: limit = m->global_count; break;
+            default: reader_fail(r, "malformed export kind"); return 0;
+        }
+        if (e->index >= limit) reader_fail(r, "unknown export index");
+        for (uint32_t j = 0; j < i && !r->error; j++) {
+            if (strcmp(m->exports[j].name, e->name) == 0) reader_fail(r, "duplicate export name");
+        }
+    }
+    return !r->error;
+}
+
+static int parse_elements(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    if (r->error) return 0;
+    m->elems = calloc(count ? count : 1, sizeof(elem_t));
+    if (!m->elems) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        elem_t* e = &m->elems[i];
+        m->elem_count = i + 1;
+        uint32_t flags = read_u32(r);
+        if (flags > 7) {
+            reader_fail(r, "malformed elements segment kind");
+            break;
+        }
+        e->type = WASMIFY_TYPE_FUNCREF;
+        e->mode = (flags & 1) ? ((flags & 2) ? SEGMENT_DECLARATIVE : SEGMENT_PASSIVE) : SEGMENT_ACTIVE;
+        if (e->mode == SEGMENT_ACTIVE) {
+            e->table = (flags & 2) ? read_u32(r) : 0;
+            if (!r->error && e->table >= m->table_count) {
+                reader_fail(r, "unknown table");
+                break;
+            }
+            read_const_expr(r, m, WASMIFY_TYPE_I32, &e->offset);
+        }
+        int uses_exprs = flags & 4;
+        if (flags & 3) {
+            if (uses_exprs) {
+                e->type = read_reftype(r);
+            } else if (read_u8(r) != 0x00) {
+                reader_fail(r, "malformed element kind");
+            }
+        }
+        e->count = read_u32(r);
+        if (r->error) break;
+        if (e->count > (size_t)(r->end - r->p)) {
+            reader_fail(r, "unexpected end");
+            break;
+        }
+        e->items = calloc(e->count ? e->count : 1, sizeof(const_expr_t));
+        if (!e->items) {
+            reader_fail(r, "out of memory");
+            break;
+        }
+        for (uint32_t j = 0; j < e->count && !r->error; j++) {
+            if (uses_exprs) {
+                read_const_expr(r, m, e->type, &e->items[j]);
+            } else {
+                uint32_t idx = read_u32(r);
+                if (!r->error && idx >= m->func_count) reader_fail(r, "unknown function");
+                e->items[j].kind = CONST_FUNC;
+                e->items[j].value = idx;
+            }
+        }
+        if (!r->error && e->mode == SEGMENT_ACTIVE && m->tables[e->table].elem_type != e->type) {
+            reader_fail(r, "type mismatch");
+        }
+    }
+    return !r->error;
+}
+
+static int parse_code(reader_t* r, wasmify_engine_module_t* m, const char** error) {
+    uint32_t count = read_u32(r);
+    if (r->error) return 0;
+    if (count != m->declared_func_count) {
+        reader_fail(r, "function and code section have inconsistent lengths");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t size = read_u32(r);
+        if (r->error || size > (size_t)(r->end - r->p)) {
+            reader_fail(r, "unexpected end");
+            return 0;
+        }
+        reader_t body = {r->p, r->p + size, NULL};
+        r->p += size;
+        if (!compile_func(m, &m->funcs[m->import_func_count + i], &body, error)) return 0;
+    }
+    return 1;
+}
+
+static int parse_data(reader_t* r, wasmify_engine_module_t* m) {
+    uint32_t count = read_u32(r);
+    if (!r->error && count > (size_t)(r->end - r->p)) reader_fail(r, "unexpected end");
+    if (r->error) return 0;
+    if (m->has_data_count && count != m->declared_data_count) {
+        reader_fail(r, "data count and data section have inconsistent lengths");
+        return 0;
+    }
+    m->datas = calloc(count ? count : 1, sizeof(data_t));
+    if (!m->datas) {
+        reader_fail(r, "out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        data_t* d = &m->datas[i];
+        m->data_count = i + 1;
+        uint32_t flags = read_u32(r);
+        if (flags > 2) {
+            reader_fail(r, "malformed data segment kind");
+            break;
+        }
+        d->mode = flags == 1 ? SEGMENT_PASSIVE : SEGMENT_ACTIVE;
+        if (d->mode == SEGMENT_ACTIVE) {
+            if (flags == 2 && read_u32(r) != 0) {
+                reader_fail(r, "unknown memory");
+                break;
+            }
+            if (!m->has_memory) {
+                reader_fail(r, "unknown memory");
+                break;
+            }
+            read_const_expr(r, m, WASMIFY_TYPE_I32, &d->offset);
+        }
+        d->size = read_u32(r);
+        if (r->error) break;
+        if (d->size > (size_t)(r->end - r->p)) {
+            reader_fail(r, "unexpected end");
+            break;
+        }
+        d->bytes = malloc(d->size ? d->size : 1);
+        if (!d->bytes) {
+            reader_fail(r, "out of memory");
+            break;
+        }
+        memcpy(d->bytes, r->p, d->size);
+        r->p += d->size;
+    }
+    return !r->error;
+}
+
+// Position of each known section in the required order
+static int section_rank(uint8_t id) {
+    static const int ranks[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 10};
+    return id < sizeof(ranks) / sizeof(ranks[0]) ? ranks[id] : -1;
+}
+
+wasmify_error_t wasmify_engine_compile(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_engine_module_t** module,
+    char* err,
+    size_t err_size
+) {
+    if (!bytes || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *module = NULL;
+
+    static const uint8_t header[8] = {0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00};
+    if (size < 8 || memcmp(bytes, header, 4) != 0) {
+        set_error(err, err_size, "invalid WebAssembly binary: wrong magic number");
+        return WASMIFY_ERROR_PARSE;
+    }
+    if (memcmp(bytes + 4, header + 4, 4) != 0) {
+        set_error(err, err_size, "unsupported WebAssembly version");
+        return WASMIFY_ERROR_PARSE;
+    }
+
+    wasmify_engine_module_t* m = calloc(1, sizeof(wasmify_engine_module_t));
+    if (!m) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    m->start = NO_INDEX;
+
+    reader_t r = {bytes + 8, bytes + size, NULL};
+    const char* error = NULL;
+    uint32_t func_cap = 0;
+    int last_rank = 0;
+    int has_code = 0;
+
+    while (r.p < r.end && !error) {
+        uint8_t id = read_u8(&r);
+        uint32_t len = read_u32(&r);
+        if (r.error) {
+            error = r.error;
+            break;
+        }
+        if (len > (size_t)(r.end - r.p)) {
+            error = "section size mismatch";
+            break;
+        }
+        reader_t s = {r.p, r.p + len, NULL};
+        r.p += len;
+
+        int rank = section_rank(id);
+        if (rank < 0) {
+            error = "malformed section id";
+            break;
+        }
+        if (id != SECTION_CUSTOM) {
+            if (rank <= last_rank) {
+                error = "unexpected section order";
+                break;
+            }
+            last_rank = rank;
+        }
+
+        switch (id) {
+            case SECTION_CUSTOM:
+                s.p = s.end;
+                break;
+            case SECTION_TYPE: parse_types(&s, m); break;
+            case SECTION_IMPORT: parse_imports(&s, m, &func_cap); break;
+            case SECTION_FUNCTION: parse_functions(&s, m, &func_cap); break;
+            case SECTION_TABLE: parse_tables(&s, m); break;
+            case SECTION_MEMORY: parse_memory(&s, m); break;
+            case SECTION_GLOBAL: parse_globals(&s, m); break;
+            case SECTION_EXPORT: parse_exports(&s, m); break;
+            case SECTION_START:
+                m->start = read_u32(&s);
+                if (!s.error && m->start >= m->func_count) reader_fail(&s, "unknown function");
+                if (!s.error) {
+                    const functype_t* ft = &m->types[m->funcs[m->start].type];
+                    if (ft->param_count || ft->result_count) reader_fail(&s, "start function must have type [] -> []");
+                }
+                break;
+            case SECTION_ELEMENT: parse_elements(&s, m); break;
+            case SECTION_DATA_COUNT:
+                m->declared_data_count = read_u32(&s);
+                m->has_data_count = 1;
+                break;
+            case SECTION_CODE:
+                has_code = 1;
+                if (!parse_code(&s, m, &error) && !error) error = s.error;
+                break;
+            case SECTION_DATA: parse_data(&s, m); break;
+        }
+        if (!error && s.error) error = s.error;
+        if (!error && s.p != s.end) error = "section size mismatch";
+    }
+    if (!error && !has_code && m->declared_func_count != 0) {
+        error = "function and code section have inconsistent lengths";
+    }
+    if (!error && m->has_data_count && m->data_count != m->declared_data_count) {
+        error = "data count and data section have inconsistent lengths";
+    }
+
+    if (error) {
+        set_error(err, err_size, "invalid module: %s", error);
+        wasmify_engine_module_free(m);
+        return WASMIFY_ERROR_PARSE;
+    }
+
+    *module = m;
+    return WASMIFY_SUCCESS;
+}
+
+void wasmify_engine_module_free(wasmify_engine_module_t* module) {
+    if (!module) return;
+
+    for (uint32_t i = 0; i < module->type_count; i++) free(module->types[i].types);
+    free(module->types);
+    int owned = module->artifact == NULL;
+    for (uint32_t i = 0; i < module->func_count; i++) {
+        if (owned) {
+            free(module->funcs[i].code);
+            free(module->funcs[i].branches);
+        }
+        free(module->funcs[i].import_module);
+        free(module->funcs[i].import_name);
+    }
+    free(module->funcs);
+    free(module->tables);
+    free(module->globals);
+    for (uint32_t i = 0; i < module->export_count; i++) free(module->exports[i].name);
+    free(module->exports);
+    for (uint32_t i = 0; i < module->elem_count; i++) free(module->elems[i].items);
+    free(module->elems);
+    for (uint32_t i = 0; owned && i < module->data_count; i++) free(module->datas[i].bytes);
+    free(module->datas);
+    if (module->release) module->release(module->artifact, module->artifact_size);
+    free(module);
+}
+
+int wasmify_engine_find_func(
+    const wasmify_engine_module_t* module,
+    const char* name,
+    uint32_t* func_index,
+    wasmify_engine_functype_t* type
+) {
+    if (!module || !name) return 0;
+
+    for (uint32_t i = 0; i < module->export_count; i++) {
+        const export_t* e = &module->exports[i];
+        if (e->kind != 0x00 || strcmp(e->name, name) != 0) continue;
+        if (func_index) *func_index = e->index;
+        if (type) {
+            const functype_t* ft = &module->types[module->funcs[e->index].type];
+            type->param_count = ft->param_count;
+            type->result_count = ft->result_count;
+            type->params = ft->types;
+            type->results = ft->types + ft->param_count;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Artifacts: a compiled module serialized for reuse by later processes. The
+// layout is the in-memory one (native endianness and struct layout), so an
+// artifact only loads on the engine build and host kind that wrote it; both
+// are recorded in it and checked. Instruction streams, branch tables and data
+// segments are 8-byte aligned in the artifact and used in place when loaded.
+// ---------------------------------------------------------------------------
+
+#define ARTIFACT_MAGIC "WMFYAOT1"
+#define ARTIFACT_ABSENT UINT32_MAX
+
+static char g_target[128];
+static pthread_once_t g_target_once = PTHREAD_ONCE_INIT;
+
+#define TARGET_FEATURE(name, len) \
+    if (__builtin_cpu_supports(name)) len += snprintf(g_target + len, sizeof(g_target) - len, "+" name)
+
+static void target_init(void) {
+#if defined(__x86_64__)
+    const char* arch = "x86_64";
+#elif defined(__aarch64__)
+    const char* arch = "aarch64";
+#elif defined(__i386__)
+    const char* arch = "i386";
+#else
+    const char* arch = "unknown";
+#endif
+    const uint16_t probe = 1;
+    size_t len = (size_t)snprintf(g_target, sizeof(g_target), "%s-%s-p%zu", arch,
+                                  *(const uint8_t*)&probe ? "le" : "be", sizeof(void*) * 8);
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    __builtin_cpu_init();
+    TARGET_FEATURE("sse4.2", len);
+    TARGET_FEATURE("popcnt", len);
+    TARGET_FEATURE("avx", len);
+    TARGET_FEATURE("avx2", len);
+    TARGET_FEATURE("bmi2", len);
+    TARGET_FEATURE("avx512f", len);
+#endif
+    (void)len;
+}
+
+const char* wasmify_engine_target(void) {
+    pthread_once(&g_target_once, target_init);
+    return g_target;
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t cap;
+    int failed;
+} art_writer_t;
+
+static void art_put(art_writer_t* w, const void* data, size_t size) {
+    if (w->failed) return;
+    if (w->size + size > w->cap) {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap < w->size + size) cap *= 2;
+        uint8_t* p = realloc(w->data, cap);
+        if (!p) {
+            w->failed = 1;
+            return;
+        }
+        w->data = p;
+        w->cap = cap;
+    }
+    if (size) memcpy(w->data + w->size, data, size);
+    w->size += size;
+}
+
+static void art_u8(art_writer_t* w, uint8_t v) { art_put(w, &v, 1); }
+static void art_u32(art_writer_t* w, uint32_t v) { art_put(w, &v, 4); }
+static void art_u64(art_writer_t* w, uint64_t v) { art_put(w, &v, 8); }
+
+static void art_align(art_writer_t* w) {
+    static const uint8_t zeros[8] = {0};
+    art_put(w, zeros, (8 - w->size % 8) % 8);
+}
+
+static void art_string(art_writer_t* w, const char* s) {
+    if (!s) {
+        art_u32(w, ARTIFACT_ABSENT);
+        return;
+    }
+    uint32_t len = (uint32_t)strlen(s);
+    art_u32(w, len);
+    art_put(w, s, len);
+}
+
+// An array used in place on load
+static void art_array(art_writer_t* w, const void* items, uint32_t count, size_t item_size) {
+    art_u32(w, count);
+    art_align(w);
+    art_put(w, items, (size_t)count * item_size);
+}
+
+static void art_const(art_writer_t* w, const const_expr_t* e) {
+    art_u8(w, e->kind);
+    art_u64(w, e->value);
+    art_u64(w, e->high);
+}
+
+wasmify_error_t wasmify_engine_serialize(
+    const wasmify_engine_module_t* module,
+    uint8_t** bytes,
+    size_t* size
+) {
+    if (!module || !bytes || !size) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    const wasmify_engine_module_t* m = module;
+    art_writer_t w = {0};
+
+    art_put(&w, ARTIFACT_MAGIC, 8);
+    art_string(&w, WASMIFY_ENGINE_NAME "/" WASMIFY_ENGINE_VERSION);
+    art_string(&w, wasmify_engine_target());
+
+    art_u32(&w, m->type_count);
+    for (uint32_t i = 0; i < m->type_count; i++) {
+        const functype_t* t = &m->types[i];
+        art_u32(&w, t->param_count);
+        art_u32(&w, t->result_count);
+        art_put(&w, t->types, t->param_count + t->result_count);
+        art_u32(&w, t->param_slots);
+        art_u32(&w, t->result_slots);
+        art_u32(&w, t->canon);
+    }
+
+    art_u32(&w, m->func_count);
+    art_u32(&w, m->import_func_count);
+    art_u32(&w, m->declared_func_count);
+    for (uint32_t i = 0; i < m->func_count; i++) {
+        const func_t* f = &m->funcs[i];
+        art_u32(&w, f->type);
+        art_u32(&w, f->local_slots);
+        art_u32(&w, f->max_slots);
+        art_string(&w, f->import_module);
+        art_string(&w, f->import_name);
+        art_array(&w, f->code, f->code_len, sizeof(insn_t));
+        art_array(&w, f->branches, f->branch_count, sizeof(branch_t));
+    }
+
+    art_u32(&w, m->table_count);
+    for (uint32_t i = 0; i < m->table_count; i++) {
+        art_u8(&w, m->tables[i].elem_type);
+        art_u32(&w, m->tables[i].min);
+        art_u32(&w, m->tables[i].max);
+    }
+
+    art_u8(&w, (uint8_t)m->has_memory);
+    art_u8(&w, (uint8_t)m->memory_shared);
+    art_u32(&w, m->memory_min);
+    art_u32(&w, m->memory_max);
+
+    art_u32(&w, m->global_count);
+    art_u32(&w, m->global_slots);
+    for (uint32_t i = 0; i < m->global_count; i++) {
+        const global_t* g = &m->globals[i];
+        art_u8(&w, g->type);
+        art_u8(&w, g->mutable_);
+        art_u32(&w, g->slot);
+        art_const(&w, &g->init);
+    }
+
+    art_u32(&w, m->export_count);
+    for (uint32_t i = 0; i < m->export_count; i++) {
+        art_string(&w, m->exports[i].name);
+        art_u8(&w, m->exports[i].kind);
+        art_u32(&w, m->exports[i].index);
+    }
+
+    art_u32(&w, m->elem_count);
+    for (uint32_t i = 0; i < m->elem_count; i++) {
+        const elem_t* e = &m->elems[i];
+        art_u8(&w, e->mode);
+        art_u8(&w, e->type);
+        art_u32(&w, e->table);
+        art_const(&w, &e->offset);
+        art_u32(&w, e->count);
+        for (uint32_t j = 0; j < e->count; j++) art_const(&w, &e->items[j]);
+    }
+
+    art_u32(&w, m->data_count);
+    art_u8(&w, (uint8_t)m->has_data_count);
+    art_u32(&w, m->declared_data_count);
+    for (uint32_t i = 0; i < m->data_count; i++) {
+        const data_t* d = &m->datas[i];
+        art_u8(&w, d->mode);
+        art_const(&w, &d->offset);
+        art_array(&w, d->bytes, d->size, 1);
+    }
+
+    art_u32(&w, m->start);
+
+    if (w.failed) {
+        free(w.data);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    *bytes = w.data;
+    *size = w.size;
+    return WASMIFY_SUCCESS;
+}
+
+// Artifact reader; every read is bounds-checked and failures are sticky
+typedef struct {
+    const uint8_t* base;
+    const uint8_t* p;
+    const uint8_t* end;
+    int failed;
+} art_reader_t;
+
+static const void* art_take(art_reader_t* r, size_t size) {
+    if (r->failed || size > (size_t)(r->end - r->p)) {
+        r->failed = 1;
+        return NULL;
+    }
+    const void* at = r->p;
+    r->p += size;
+    return at;
+}
+
+static uint8_t art_read_u8(art_reader_t* r) {
+    const uint8_t* p = art_take(r, 1);
+    return p ? *p : 0;
+}
+
+static uint32_t art_read_u32(art_reader_t* r) {
+    uint32_t v = 0;
+    const void* p = art_take(r, 4);
+    if (p) memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t art_read_u64(art_reader_t* r) {
+    uint64_t v = 0;
+    const void* p = art_take(r, 8);
+    if (p) memcpy(&v, p, 8);
+    return v;
+}
+
+static char* art_read_string(art_reader_t* r) {
+    uint32_t len = art_read_u32(r);
+    if (r->failed || len == ARTIFACT_ABSENT) return NULL;
+    const char* p = art_take(r, len);
+    char* s = p ? malloc((size_t)len + 1) : NULL;
+    if (!s) {
+        r->failed = 1;
+        return NULL;
+    }
+    memcpy(s, p, len);
+    s[len] = '\0';
+    return s;
+}
+
+static int art_read_matches(art_reader_t* r, const char* expected) {
+    uint32_t len = art_read_u32(r);
+    const char* p = art_take(r, len);
+    return p && len == strlen(expected) && memcmp(p, expected, len) == 0;
+}
+
+static const void* art_read_array(art_reader_t* r, uint32_t* count, size_t item_size) {
+    *count = art_read_u32(r);
+    art_take(r, (8 - (size_t)(r->p - r->base) % 8) % 8);
+    if (r->failed || *count > (size_t)(r->end - r->p) / item_size) {
+        r->failed = 1;
+        return NULL;
+    }
+    return art_take(r, (size_t)*count * item_size);
+}
+
+static void art_read_const(art_reader_t* r, const_expr_t* e) {
+    e->kind = art_read_u8(r);
+    e->value = art_read_u64(r);
+    e->high = art_read_u64(r);
+}
+
+static void* art_calloc(art_reader_t* r, uint32_t count, size_t item_size) {
+    // Every entry takes at least a byte, so a count beyond the rest is bogus
+    if (r->failed || count > (size_t)(r->end - r->p)) {
+        r->failed = 1;
+        return NULL;
+    }
+    void* p = calloc(count ? count : 1, item_size);
+    if (!p) r->failed = 1;
+    return p;
+}
+
+wasmify_error_t wasmify_engine_deserialize(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_engine_release_t release,
+    wasmify_engine_module_t** module,
+    char* err,
+    size_t err_size
+) {
+    if (!bytes || !module) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *module = NULL;
+    if ((uintptr_t)bytes % 8 != 0) {
+        set_error(err, err_size, "artifact is not 8-byte aligned");
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    art_reader_t r = {bytes, bytes, bytes + size, 0};
+    const void* magic = art_take(&r, 8);
+    if (!magic || memcmp(magic, ARTIFACT_MAGIC, 8) != 0 ||
+        !art_read_matches(&r, WASMIFY_ENGINE_NAME "/" WASMIFY_ENGINE_VERSION) ||
+        !art_read_matches(&r, wasmify_engine_target())) {
+        set_error(err, err_size, "artifact is from another engine build or host");
+        return WASMIFY_ERROR_PARSE;
+    }
+
+    wasmify_engine_module_t* m = calloc(1, sizeof(wasmify_engine_module_t));
+    if (!m) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+
+    uint32_t count = art_read_u32(&r);
+    m->types = art_calloc(&r, count, sizeof(functype_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        functype_t* t = &m->types[i];
+        m->type_count = i + 1;
+        t->param_count = art_read_u32(&r);
+        t->result_count = art_read_u32(&r);
+        size_t arity = (size_t)t->param_count + t->result_count;
+        const void* types = art_take(&r, arity);
+        t->types = types ? malloc(arity ? arity : 1) : NULL;
+        if (!t->types) {
+            r.failed = 1;
+            break;
+        }
+        memcpy(t->types, types, arity);
+        t->param_slots = art_read_u32(&r);
+        t->result_slots = art_read_u32(&r);
+        t->canon = art_read_u32(&r);
+    }
+
+    count = art_read_u32(&r);
+    m->import_func_count = art_read_u32(&r);
+    m->declared_func_count = art_read_u32(&r);
+    m->funcs = art_calloc(&r, count, sizeof(func_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        func_t* f = &m->funcs[i];
+        m->func_count = i + 1;
+        f->type = art_read_u32(&r);
+        f->local_slots = art_read_u32(&r);
+        f->max_slots = art_read_u32(&r);
+        f->import_module = art_read_string(&r);
+        f->import_name = art_read_string(&r);
+        f->code = (insn_t*)art_read_array(&r, &f->code_len, sizeof(insn_t));
+        f->branches = (branch_t*)art_read_array(&r, &f->branch_count, sizeof(branch_t));
+        if (f->type >= m->type_count) r.failed = 1;
+    }
+
+    count = art_read_u32(&r);
+    m->tables = art_calloc(&r, count, sizeof(table_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        m->table_count = i + 1;
+        m->tables[i].elem_type = art_read_u8(&r);
+        m->tables[i].min = art_read_u32(&r);
+        m->tables[i].max = art_read_u32(&r);
+    }
+
+    m->has_memory = art_read_u8(&r);
+    m->memory_shared = art_read_u8(&r);
+    m->memory_min = art_read_u32(&r);
+    m->memory_max = art_read_u32(&r);
+
+    count = art_read_u32(&r);
+    m->global_slots = art_read_u32(&r);
+    m->globals = art_calloc(&r, count, sizeof(global_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        global_t* g = &m->globals[i];
+        m->global_count = i + 1;
+        g->type = art_read_u8(&r);
+        g->mutable_ = art_read_u8(&r);
+        g->slot = art_read_u32(&r);
+        art_read_const(&r, &g->init);
+    }
+
+    count = art_read_u32(&r);
+    m->exports = art_calloc(&r, count, sizeof(export_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        export_t* e = &m->exports[i];
+        m->export_count = i + 1;
+        e->name = art_read_string(&r);
+        e->kind = art_read_u8(&r);
+        e->index = art_read_u32(&r);
+        if (!e->name || (e->kind == 0x00 && e->index >= m->func_count)) r.failed = 1;
+    }
+
+    count = art_read_u32(&r);
+    m->elems = art_calloc(&r, count, sizeof(elem_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        elem_t* e = &m->elems[i];
+        m->elem_count = i + 1;
+        e->mode = art_read_u8(&r);
+        e->type = art_read_u8(&r);
+        e->table = art_read_u32(&r);
+        art_read_const(&r, &e->offset);
+        e->count = art_read_u32(&r);
+        e->items = art_calloc(&r, e->count, sizeof(const_expr_t));
+        for (uint32_t j = 0; j < e->count && !r.failed; j++) art_read_const(&r, &e->items[j]);
+    }
+
+    count = art_read_u32(&r);
+    m->has_data_count = art_read_u8(&r);
+    m->declared_data_count = art_read_u32(&r);
+    m->datas = art_calloc(&r, count, sizeof(data_t));
+    for (uint32_t i = 0; i < count && !r.failed; i++) {
+        data_t* d = &m->datas[i];
+        m->data_count = i + 1;
+        d->mode = art_read_u8(&r);
+        art_read_const(&r, &d->offset);
+        d->bytes = (uint8_t*)art_read_array(&r, &d->size, 1);
+    }
+
+    m->start = art_read_u32(&r);
+    if (m->start != NO_INDEX && m->start >= m->func_count) r.failed = 1;
+
+    // The borrowed arrays now belong to the artifact, whatever happens next
+    m->artifact = bytes;
+    m->artifact_size = size;
+    if (r.failed || r.p != r.end) {
+        set_error(err, err_size, "artifact is truncated or corrupt");
+        wasmify_engine_module_free(m);
+        return WASMIFY_ERROR_PARSE;
+    }
+    m->release = release;
+
+    *module = m;
+    return WASMIFY_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Host functions: a minimal WASI preview1 surface so toolchain output that
+// only prints, reads the clock or asks for entropy runs unmodified.
+// ---------------------------------------------------------------------------
+
+enum {
+    WASI_ESUCCESS = 0,
+    WASI_EBADF = 8,
+    WASI_EINVAL = 28,
+    WASI_ENOSYS = 52,
+    WASI_ESPIPE = 70
+};
+
+// Pick up the growth of a shared memory by other instances. Returns 0 for a
+// memory only this instance uses, whose size it always knows.
+static int memory_sync(wasmify_engine_instance_t* inst, uint64_t* mem_size) {
+    if (!inst->shared) return 0;
+    uint64_t size = __atomic_load_n(&inst->shared->size, __ATOMIC_ACQUIRE);
+    inst->memory_size = size;
+    inst->memory_pages = (uint32_t)(size / WASMIFY_ENGINE_PAGE_SIZE);
+    if (mem_size) *mem_size = size;
+    return 1;
+}
+
+static int host_trap(wasmify_engine_instance_t* inst, const char* msg) {
+    snprintf(inst->trap, sizeof(inst->trap), "%s", msg);
+    return 1;
+}
+
+static uint8_t* host_mem(wasmify_engine_instance_t* inst, uint64_t ptr, uint64_t len) {
+    uint32_t p = (uint32_t)ptr;
+    uint64_t end = (uint64_t)p + (uint32_t)len;
+    if (end > inst->memory_size && !(memory_sync(inst, NULL) && end <= inst->memory_size)) return NULL;
+    return inst->memory + p;
+}
+
+static int wasi_fd_write(wasmify_engine_instance_t* inst, uint64_t* s) {
+    uint32_t fd = (uint32_t)s[0];
+    uint32_t iovs = (uint32_t)s[1];
+    uint32_t iovs_len = (uint32_t)s[2];
+    uint8_t* nwritten = host_mem(inst, s[3], 4);
+    FILE* out = fd == 1 ? stdout : fd == 2 ? stderr : NULL;
+    if (!out) {
+        s[0] = WASI_EBADF;
+        return 0;
+    }
+    uint8_t* iov = host_mem(inst, iovs, (uint64_t)iovs_len * 8);
+    if (!iov || !nwritten) return host_trap(inst, TRAP_OOB_MEMORY);
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        uint32_t buf, len;
+        memcpy(&buf, iov + i * 8, 4);
+        memcpy(&len, iov + i * 8 + 4, 4);
+        uint8_t* data = host_mem(inst, buf, len);
+        if (!data) return host_trap(inst, TRAP_OOB_MEMORY);
+        total += (uint32_t)fwrite(data, 1, len, out);
+    }
+    memcpy(nwritten, &total, 4);
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+static int wasi_fd_read(wasmify_engine_instance_t* inst, uint64_t* s) {
+    uint8_t* nread = host_mem(inst, s[3], 4);
+    if (!nread) return host_trap(inst, TRAP_OOB_MEMORY);
+    memset(nread, 0, 4);
+    s[0] = (uint32_t)s[0] == 0 ? WASI_ESUCCESS : WASI_EBADF;
+    return 0;
+}
+
+static int wasi_fd_close(wasmify_engine_instance_t* inst, uint64_t* s) {
+    (void)inst;
+    s[0] = (uint32_t)s[0] <= 2 ? WASI_ESUCCESS : WASI_EBADF;
+    return 0;
+}
+
+static int wasi_fd_seek(wasmify_engine_instance_t* inst, uint64_t* s) {
+    (void)inst;
+    s[0] = (uint32_t)s[0] <= 2 ? WASI_ESPIPE : WASI_EBADF;
+    return 0;
+}
+
+static int wasi_fd_fdstat_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    if ((uint32_t)s[0] > 2) {
+        s[0] = WASI_EBADF;
+        return 0;
+    }
+    uint8_t* stat = host_mem(inst, s[1], 24);
+    if (!stat) return host_trap(inst, TRAP_OOB_MEMORY);
+    memset(stat, 0, 24);
+    stat[0] = 2;  // character device
+    memset(stat + 8, 0xFF, 16);
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+static int wasi_fd_prestat_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    (void)inst;
+    s[0] = WASI_EBADF;
+    return 0;
+}
+
+static int wasi_sizes_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    uint8_t* count = host_mem(inst, s[0], 4);
+    uint8_t* size = host_mem(inst, s[1], 4);
+    if (!count || !size) return host_trap(inst, TRAP_OOB_MEMORY);
+    memset(count, 0, 4);
+    memset(size, 0, 4);
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+static int wasi_strings_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    (void)inst;
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+static int wasi_clock_time_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    uint8_t* out = host_mem(inst, s[2], 8);
+    if (!out) return host_trap(inst, TRAP_OOB_MEMORY);
+    clockid_t id;
+    switch ((uint32_t)s[0]) {
+        case 0: id = CLOCK_REALTIME; break;
+        case 1: id = CLOCK_MONOTONIC; break;
+        case 2: id = CLOCK_PROCESS_CPUTIME_ID; break;
+        case 3: id = CLOCK_THREAD_CPUTIME_ID; break;
+        default: s[0] = WASI_EINVAL; return 0;
+    }
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    memcpy(out, &ns, 8);
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+static int wasi_random_get(wasmify_engine_instance_t* inst, uint64_t* s) {
+    uint8_t* buf = host_mem(inst, s[0], s[1]);
+    if (!buf) return host_trap(inst, TRAP_OOB_MEMORY);
+    size_t len = (uint32_t)s[1], done = 0;
+    while (done < len) {
+        ssize_t n = getrandom(buf + done, len - done, 0);
+        if (n <= 0) {
+            s[0] = WASI_ENOSYS;
+            return 0;
+        }
+        done += (size_t)n;
+    }
+    s[0] = WASI_ESUCCESS;
+    return 0;
+}
+
+// Ends the slice of a sliced call, which is how guests yield cooperatively
+static int wasi_sched_yield(wasmify_engine_instance_t* inst, uint64_t* s) {
+    s[0] = WASI_ESUCCESS;
+    return inst->slice_ms > 0 ? 2 : 0;
+}
+
+static int wasi_proc_exit(wasmify_engine_instance_t* inst, uint64_t* s) {
+    inst->exited = 1;
+    inst->exit_code = (int)(uint32_t)s[0];
+    return host_trap(inst, "exit");
+}
+
+static int host_unresolved(wasmify_engine_instance_t* inst, uint64_t* s) {
+    (void)s;
+    return host_trap(inst, "called an unresolved import");
+}
+
+// Signatures use i/I/f/F for i32/i64/f32/f64, params before the colon
+static const struct {
+    const char* name;
+    const char* sig;
+    host_func_t fn;
+} WASI_FUNCS[] = {
+    {"fd_write", "iiii:i", wasi_fd_write},
+    {"fd_read", "iiii:i", wasi_fd_read},
+    {"fd_close", "i:i", wasi_fd_close},
+    {"fd_seek", "iIii:i", wasi_fd_seek},
+    {"fd_fdstat_get", "ii:i", wasi_fd_fdstat_get},
+    {"fd_prestat_get", "ii:i", wasi_fd_prestat_get},
+    {"args_sizes_get", "ii:i", wasi_sizes_get},
+    {"args_get", "ii:i", wasi_strings_get},
+    {"environ_sizes_get", "ii:i", wasi_sizes_get},
+    {"environ_get", "ii:i", wasi_strings_get},
+    {"clock_time_get", "iIi:i", wasi_clock_time_get},
+    {"random_get", "ii:i", wasi_random_get},
+    {"sched_yield", ":i", wasi_sched_yield},
+    {"proc_exit", "i:", wasi_proc_exit}
+};
+
+static int signature_matches(const functype_t* ft, const char* sig) {
+    uint32_t n = 0;
+    const char* p = sig;
+    for (; *p && *p != ':'; p++, n++) {
+        if (n >= ft->param_count) return 0;
+        uint8_t t = *p == 'i' ? 0x7F : *p == 'I' ? 0x7E : *p == 'f' ? 0x7D : 0x7C;
+        if (ft->types[n] != t) return 0;
+    }
+    if (n != ft->param_count || *p != ':') return 0;
+    uint32_t r = 0;
+    for (p++; *p; p++, r++) {
+        if (r >= ft->result_count) return 0;
+        uint8_t t = *p == 'i' ? 0x7F : *p == 'I' ? 0x7E : *p == 'f' ? 0x7D : 0x7C;
+        if (ft->types[ft->param_count + r] != t) return 0;
+    }
+    return r == ft->result_count;
+}
+
+static host_func_t resolve_import(const wasmify_engine_module_t* m, const func_t* f) {
+    if (strcmp(f->import_module, "wasi_snapshot_preview1") != 0 &&
+        strcmp(f->import_module, "wasi_unstable") != 0) {
+        return host_unresolved;
+    }
+    for (size_t i = 0; i < sizeof(WASI_FUNCS) / sizeof(WASI_FUNCS[0]); i++) {
+        if (strcmp(WASI_FUNCS[i].name, f->import_name) == 0) {
+            return signature_matches(&m->types[f->type], WASI_FUNCS[i].sig) ? WASI_FUNCS[i].fn : host_unresolved;
+        }
+    }
+    return host_unresolved;
+}
+
+// ---------------------------------------------------------------------------
+// Interpreter
+// ---------------------------------------------------------------------------
+
+static inline float f32_of(uint64_t v) {
+    uint32_t u = (uint32_t)v;
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+static inline double f64_of(uint64_t v) {
+    double d;
+    memcpy(&d, &v, 8);
+    return d;
+}
+
+static inline uint64_t bits_f32(float f) {
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    return u;
+}
+
+static inline uint64_t bits_f64(double d) {
+    uint64_t u;
+    memcpy(&u, &d, 8);
+    return u;
+}
+
+static inline float min_f32(float a, float b) {
+    if (isnan(a) || isnan(b)) return NAN;
+    if (a == 0 && b == 0) return signbit(a) ? a : b;
+    return a < b ? a : b;
+}
+
+static inline float max_f32(float a, float b) {
+    if (isnan(a) || isnan(b)) return NAN;
+    if (a == 0 && b == 0) return signbit(a) ? b : a;
+    return a > b ? a : b;
+}
+
+static inline double min_f64(double a, double b) {
+    if (isnan(a) || isnan(b)) return NAN;
+    if (a == 0 && b == 0) return signbit(a) ? a : b;
+    return a < b ? a : b;
+}
+
+static inline double max_f64(double a, double b) {
+    if (isnan(a) || isnan(b)) return NAN;
+    if (a == 0 && b == 0) return signbit(a) ? b : a;
+    return a > b ? a : b;
+}
+
+// Exclusive bounds for float -> integer truncation, indexed by
+// i32_s, i32_u, i64_s, i64_u
+static const double TRUNC_LO[4] = {-2147483649.0, -1.0, -9223372036854777856.0, -1.0};
+static const double TRUNC_HI[4] = {2147483648.0, 4294967296.0, 9223372036854775808.0, 18446744073709551616.0};
+
+static inline uint64_t trunc_sat(double x, int kind) {
+    if (isnan(x)) return 0;
+    switch (kind) {
+        case 0:
+            if (x <= TRUNC_LO[0]) return (uint32_t)INT32_MIN;
+            if (x >= TRUNC_HI[0]) return (uint32_t)INT32_MAX;
+            return (uint32_t)(int32_t)x;
+        case 1:
+            if (x <= TRUNC_LO[1]) return 0;
+            if (x >= TRUNC_HI[1]) return UINT32_MAX;
+            return (uint32_t)x;
+        case 2:
+            if (x <= TRUNC_LO[2]) return (uint64_t)INT64_MIN;
+            if (x >= TRUNC_HI[2]) return (uint64_t)INT64_MAX;
+            return (uint64_t)(int64_t)x;
+        default:
+            if (x <= TRUNC_LO[3]) return 0;
+            if (x >= TRUNC_HI[3]) return UINT64_MAX;
+            return (uint64_t)x;
+    }
+}
+
+static uint64_t eval_const(const wasmify_engine_instance_t* inst, const const_expr_t* expr) {
+    switch (expr->kind) {
+        case CONST_GLOBAL: return inst->globals[inst->module->globals[expr->value].slot];
+        case CONST_FUNC: return expr->value + 1;
+        default: return expr->value;
+    }
+}
+
+// Make the first size bytes of a reservation read-write
+static int memory_commit(uint8_t* base, size_t* committed, uint64_t size) {
+    if (size > *committed) {
+        if (mprotect(base + *committed, size - *committed, PROT_READ | PROT_WRITE) != 0) return 0;
+        *committed = size;
+    }
+    return 1;
+}
+
+// Returns the previous size in pages, UINT32_MAX if memory could not grow
+static uint32_t memory_grow(wasmify_engine_instance_t* inst, uint32_t delta) {
+    wasmify_engine_memory_t* shared = inst->shared;
+    if (shared) {
+        pthread_mutex_lock(&shared->lock);
+        uint32_t old = (uint32_t)(shared->size / WASMIFY_ENGINE_PAGE_SIZE);
+        uint64_t new_size = ((uint64_t)old + delta) * WASMIFY_ENGINE_PAGE_SIZE;
+        if ((uint64_t)old + delta > shared->max_pages || !memory_commit(shared->base, &shared->committed, new_size)) {
+            old = UINT32_MAX;
+        } else {
+            __atomic_store_n(&shared->size, new_size, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&shared->lock);
+        memory_sync(inst, NULL);
+        return old;
+    }
+
+    uint32_t old = inst->memory_pages;
+    uint64_t pages = (uint64_t)old + delta;
+    if (pages > inst->memory_max_pages) return UINT32_MAX;
+    if (delta == 0) return old;
+    uint64_t new_size = pages * WASMIFY_ENGINE_PAGE_SIZE;
+    if (!memory_commit(inst->memory, &inst->memory_committed, new_size)) return UINT32_MAX;
+    inst->memory_pages = (uint32_t)pages;
+    inst->memory_size = new_size;
+    return old;
+}
+
+static int table_grow(table_inst_t* t, uint32_t delta, uint64_t init) {
+    uint64_t size = (uint64_t)t->size + delta;
+    if (size > t->max) return 0;
+    if (delta == 0) return 1;
+    uint64_t* elems = realloc(t->elems, size * sizeof(uint64_t));
+    if (!elems) return 0;
+    for (uint64_t i = t->size; i < size; i++) elems[i] = init;
+    t->elems = elems;
+    t->size = (uint32_t)size;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// SIMD128
+// ---------------------------------------------------------------------------
+
+// Operations are written with the compiler's vector extensions, which lower
+// to NEON on aarch64 and SSE2 on x86_64. x86_64 hosts with AVX2 run a second
+// copy of the same kernels built for it, which has the SSSE3 and SSE4.1
+// shuffles, blends, rounding and 32-bit multiplies SSE2 lacks.
+typedef int8_t i8x16_t __attribute__((vector_size(16)));
+typedef uint8_t u8x16_t __attribute__((vector_size(16)));
+typedef int16_t i16x8_t __attribute__((vector_size(16)));
+typedef uint16_t u16x8_t __attribute__((vector_size(16)));
+typedef int32_t i32x4_t __attribute__((vector_size(16)));
+typedef uint32_t u32x4_t __attribute__((vector_size(16)));
+typedef int64_t i64x2_t __attribute__((vector_size(16)));
+typedef uint64_t u64x2_t __attribute__((vector_size(16)));
+typedef float f32x4_t __attribute__((vector_size(16)));
+typedef double f64x2_t __attribute__((vector_size(16)));
+
+static inline u64x2_t v128_get(const uint64_t* p) {
+    u64x2_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void v128_set(uint64_t* p, u64x2_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline int64_t clamp_i64(int64_t x, int64_t lo, int64_t hi) {
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+// Lanes of a and b picked by idx, each below 32
+static inline u8x16_t shuffle_u8(u8x16_t a, u8x16_t b, u8x16_t idx) {
+#if defined(__clang__)
+    u8x16_t r;
+    for (int i = 0; i < 16; i++) r[i] = idx[i] < 16 ? a[idx[i]] : b[idx[i] & 15];
+    return r;
+#else
+    return __builtin_shuffle(a, b, idx);
+#endif
+}
+
+// x where mask lanes are set, y elsewhere; masks are what comparisons give
+#define VSELECT(mask, x, y) (((u64x2_t)(mask) & (u64x2_t)(x)) | (~(u64x2_t)(mask) & (u64x2_t)(y)))
+
+#define SIMD_UN(T, expr) { T a = (T)v128_get(sp - 2); v128_set(sp - 2, (u64x2_t)(expr)); return sp; }
+#define SIMD_BIN(T, expr) { \
+    T b = (T)v128_get(sp - 2); T a = (T)v128_get(sp - 4); \
+    v128_set(sp - 4, (u64x2_t)(expr)); return sp - 2; }
+// Lane by lane into R, for what vector arithmetic doesn't express
+#define SIMD_MAP(T, R, n, expr) { \
+    T a = (T)v128_get(sp - 2); R r; \
+    for (int i = 0; i < (n); i++) r[i] = (expr); \
+    v128_set(sp - 2, (u64x2_t)r); return sp; }
+#define SIMD_ZIP(T, R, n, expr) { \
+    T b = (T)v128_get(sp - 2); T a = (T)v128_get(sp - 4); R r; \
+    for (int i = 0; i < (n); i++) r[i] = (expr); \
+    v128_set(sp - 4, (u64x2_t)r); return sp - 2; }
+#define SIMD_SHIFT(T, op, bits) { \
+    uint32_t n = (uint32_t)sp[-1] & ((bits) - 1); T a = (T)v128_get(sp - 3); \
+    v128_set(sp - 3, (u64x2_t)(a op n)); return sp - 1; }
+#define SIMD_ALL_TRUE(T, n) { \
+    T a = (T)v128_get(sp - 2); uint32_t r = 1; \
+    for (int i = 0; i < (n); i++) r &= a[i] != 0; \
+    sp[-2] = r; return sp - 1; }
+#define SIMD_BITMASK(T, n) { \
+    T a = (T)v128_get(sp - 2); uint32_t r = 0; \
+    for (int i = 0; i < (n); i++) r |= (uint32_t)(a[i] < 0) << i; \
+    sp[-2] = r; return sp - 1; }
+#define SIMD_SPLAT(T, n, value) { \
+    T r; for (int i = 0; i < (n); i++) r[i] = (value); \
+    v128_set(sp - 1, (u64x2_t)r); return sp + 1; }
+#define SIMD_EXTRACT(T, conv) { T a = (T)v128_get(sp - 2); sp[-2] = conv(a[in->a]); return sp - 1; }
+#define SIMD_REPLACE(T, E) { \
+    T a = (T)v128_get(sp - 3); a[in->a] = (E)sp[-1]; \
+    v128_set(sp - 3, (u64x2_t)a); return sp - 1; }
+
+// Memory accesses return NULL when out of bounds, before touching anything
+#define SIMD_ADDR(slot, size) \
+    uint64_t ea = (uint64_t)(uint32_t)(slot) + in->a; \
+    if (ea + (size) > mem_size) return NULL;
+#define SIMD_LOAD_EXTEND(S, T, n) { \
+    SIMD_ADDR(sp[-1], 8); S v[n]; memcpy(v, mem + ea, 8); T r; \
+    for (int i = 0; i < (n); i++) r[i] = v[i]; \
+    v128_set(sp - 1, (u64x2_t)r); return sp + 1; }
+#define SIMD_LOAD_SPLAT(S, T, n) { \
+    SIMD_ADDR(sp[-1], sizeof(S)); S v; memcpy(&v, mem + ea, sizeof(v)); T r; \
+    for (int i = 0; i < (n); i++) r[i] = v; \
+    v128_set(sp - 1, (u64x2_t)r); return sp + 1; }
+#define SIMD_LOAD_ZERO(size) { \
+    SIMD_ADDR(sp[-1], size); uint64_t v = 0; memcpy(&v, mem + ea, size); \
+    sp[-1] = v; sp[0] = 0; return sp + 1; }
+#define SIMD_LOAD_LANE(size) { \
+    SIMD_ADDR(sp[-3], size); memcpy((uint8_t*)(sp - 2) + in->b * (size), mem + ea, size); \
+    memmove(sp - 3, sp - 2, 16); return sp - 1; }
+#define SIMD_STORE_LANE(size) { \
+    SIMD_ADDR(sp[-3], size); memcpy(mem + ea, (const uint8_t*)(sp - 2) + in->b * (size), size); \
+    return sp - 3; }
+
+
+// Run one SIMD insn on the operand stack; returns the new stack top, or NULL
+// for a memory access out of bounds
+static inline __attribute__((always_inline)) uint64_t* simd_exec(const insn_t* in, uint64_t* sp, uint8_t* mem, uint64_t mem_size) {
+    switch (in->op - OP_PREFIX_FD) {
+        case 0x00: { SIMD_ADDR(sp[-1], 16); memcpy(sp - 1, mem + ea, 16); return sp + 1; }
+        case 0x01: SIMD_LOAD_EXTEND(int8_t, i16x8_t, 8)
+        case 0x02: SIMD_LOAD_EXTEND(uint8_t, u16x8_t, 8)
+        case 0x03: SIMD_LOAD_EXTEND(int16_t, i32x4_t, 4)
+        case 0x04: SIMD_LOAD_EXTEND(uint16_t, u32x4_t, 4)
+        case 0x05: SIMD_LOAD_EXTEND(int32_t, i64x2_t, 2)
+        case 0x06: SIMD_LOAD_EXTEND(uint32_t, u64x2_t, 2)
+        case 0x07: SIMD_LOAD_SPLAT(uint8_t, u8x16_t, 16)
+        case 0x08: SIMD_LOAD_SPLAT(uint16_t, u16x8_t, 8)
+        case 0x09: SIMD_LOAD_SPLAT(uint32_t, u32x4_t, 4)
+        case 0x0A: SIMD_LOAD_SPLAT(uint64_t, u64x2_t, 2)
+        case 0x0B: { SIMD_ADDR(sp[-3], 16); memcpy(mem + ea, sp - 2, 16); return sp - 3; }
+        case 0x0D: {
+            u8x16_t idx;
+            const uint64_t lanes[2] = { in->b, in[1].b };
+            memcpy(&idx, lanes, sizeof(idx));
+            SIMD_BIN(u8x16_t, shuffle_u8(a, b, idx))
+        }
+        case 0x0E: SIMD_BIN(u8x16_t, shuffle_u8(a, (u8x16_t){0}, (u8x16_t)VSELECT(b < 16, b, (u8x16_t){0} + 16)))
+        case 0x0F: SIMD_SPLAT(u8x16_t, 16, (uint8_t)sp[-1])
+        case 0x10: SIMD_SPLAT(u16x8_t, 8, (uint16_t)sp[-1])
+        case 0x11:
+        case 0x13: SIMD_SPLAT(u32x4_t, 4, (uint32_t)sp[-1])
+        case 0x12:
+        case 0x14: SIMD_SPLAT(u64x2_t, 2, sp[-1])
+        case 0x15: SIMD_EXTRACT(i8x16_t, (uint32_t)(int32_t))
+        case 0x16: SIMD_EXTRACT(u8x16_t, (uint32_t))
+        case 0x17: SIMD_REPLACE(u8x16_t, uint8_t)
+        case 0x18: SIMD_EXTRACT(i16x8_t, (uint32_t)(int32_t))
+        case 0x19: SIMD_EXTRACT(u16x8_t, (uint32_t))
+        case 0x1A: SIMD_REPLACE(u16x8_t, uint16_t)
+        case 0x1B:
+        case 0x1F: SIMD_EXTRACT(u32x4_t, (uint64_t))
+        case 0x1C:
+        case 0x20: SIMD_REPLACE(u32x4_t, uint32_t)
+        case 0x1D:
+        case 0x21: SIMD_EXTRACT(u64x2_t, (uint64_t))
+        case 0x1E:
+        case 0x22: SIMD_REPLACE(u64x2_t, uint64_t)
+
+        case 0x23: SIMD_BIN(u8x16_t, a == b)
+        case 0x24: SIMD_BIN(u8x16_t, a != b)
+        case 0x25: SIMD_BIN(i8x16_t, a < b)
+        case 0x26: SIMD_BIN(u8x16_t, a < b)
+        case 0x27: SIMD_BIN(i8x16_t, a > b)
+        case 0x28: SIMD_BIN(u8x16_t, a > b)
+        case 0x29: SIMD_BIN(i8x16_t, a <= b)
+        case 0x2A: SIMD_BIN(u8x16_t, a <= b)
+        case 0x2B: SIMD_BIN(i8x16_t, a >= b)
+        case 0x2C: SIMD_BIN(u8x16_t, a >= b)
+        case 0x2D: SIMD_BIN(u16x8_t, a == b)
+        case 0x2E: SIMD_BIN(u16x8_t, a != b)
+        case 0x2F: SIMD_BIN(i16x8_t, a < b)
+        case 0x30: SIMD_BIN(u16x8_t, a < b)
+        case 0x31: SIMD_BIN(i16x8_t, a > b)
+        case 0x32: SIMD_BIN(u16x8_t, a > b)
+        case 0x33: SIMD_BIN(i16x8_t, a <= b)
+        case 0x34: SIMD_BIN(u16x8_t, a <= b)
+        case 0x35: SIMD_BIN(i16x8_t, a >= b)
+        case 0x36: SIMD_BIN(u16x8_t, a >= b)
+        case 0x37: SIMD_BIN(u32x4_t, a == b)
+        case 0x38: SIMD_BIN(u32x4_t, a != b)
+        case 0x39: SIMD_BIN(i32x4_t, a < b)
+        case 0x3A: SIMD_BIN(u32x4_t, a < b)
+        case 0x3B: SIMD_BIN(i32x4_t, a > b)
+        case 0x3C: SIMD_BIN(u32x4_t, a > b)
+        case 0x3D: SIMD_BIN(i32x4_t, a <= b)
+        case 0x3E: SIMD_BIN(u32x4_t, a <= b)
+        case 0x3F: SIMD_BIN(i32x4_t, a >= b)
+        case 0x40: SIMD_BIN(u32x4_t, a >= b)
+        case 0x41: SIMD_BIN(f32x4_t, a == b)
+        case 0x42: SIMD_BIN(f32x4_t, a != b)
+        case 0x43: SIMD_BIN(f32x4_t, a < b)
+        case 0x44: SIMD_BIN(f32x4_t, a > b)
+        case 0x45: SIMD_BIN(f32x4_t, a <= b)
+        case 0x46: SIMD_BIN(f32x4_t, a >= b)
+        case 0x47: SIMD_BIN(f64x2_t, a == b)
+        case 0x48: SIMD_BIN(f64x2_t, a != b)
+        case 0x49: SIMD_BIN(f64x2_t, a < b)
+        case 0x4A: SIMD_BIN(f64x2_t, a > b)
+        case 0x4B: SIMD_BIN(f64x2_t, a <= b)
+        case 0x4C: SIMD_BIN(f64x2_t, a >= b)
+
+        case 0x4D: SIMD_UN(u64x2_t, ~a)
+        case 0x4E: SIMD_BIN(u64x2_t, a & b)
+        case 0x4F: SIMD_BIN(u64x2_t, a & ~b)
+        case 0x50: SIMD_BIN(u64x2_t, a | b)
+        case 0x51: SIMD_BIN(u64x2_t, a ^ b)
+        case 0x52: {  // v128.bitselect
+            u64x2_t mask = v128_get(sp - 2), b = v128_get(sp - 4), a = v128_get(sp - 6);
+            v128_set(sp - 6, VSELECT(mask, a, b));
+            return sp - 4;
+        }
+        case 0x53: {  // v128.any_true
+            u64x2_t a = v128_get(sp - 2);
+            sp[-2] = (a[0] | a[1]) != 0;
+            return sp - 1;
+        }
+        case 0x54: SIMD_LOAD_LANE(1)
+        case 0x55: SIMD_LOAD_LANE(2)
+        case 0x56: SIMD_LOAD_LANE(4)
+        case 0x57: SIMD_LOAD_LANE(8)
+        case 0x58: SIMD_STORE_LANE(1)
+        case 0x59: SIMD_STORE_LANE(2)
+        case 0x5A: SIMD_STORE_LANE(4)
+        case 0x5B: SIMD_STORE_LANE(8)
+        case 0x5C: SIMD_LOAD_ZERO(4)
+        case 0x5D: SIMD_LOAD_ZERO(8)
+        case 0x5E: SIMD_MAP(f64x2_t, f32x4_t, 4, i < 2 ? (float)a[i & 1] : 0.0f)
+        case 0x5F: SIMD_MAP(f32x4_t, f64x2_t, 2, (double)a[i])
+
+        case 0x60: SIMD_UN(i8x16_t, VSELECT(a < 0, -(u8x16_t)a, a))
+        case 0x61: SIMD_UN(u8x16_t, -a)
+        case 0x62: SIMD_MAP(u8x16_t, u8x16_t, 16, (uint8_t)__builtin_popcount(a[i]))
+        case 0x63: SIMD_ALL_TRUE(i8x16_t, 16)
+        case 0x64: SIMD_BITMASK(i8x16_t, 16)
+        case 0x65: SIMD_ZIP(i16x8_t, i8x16_t, 16, (int8_t)clamp_i64(i < 8 ? a[i & 7] : b[i & 7], INT8_MIN, INT8_MAX))
+        case 0x66: SIMD_ZIP(i16x8_t, u8x16_t, 16, (uint8_t)clamp_i64(i < 8 ? a[i & 7] : b[i & 7], 0, UINT8_MAX))
+        case 0x67: SIMD_MAP(f32x4_t, f32x4_t, 4, ceilf(a[i]))
+        case 0x68: SIMD_MAP(f32x4_t, f32x4_t, 4, floorf(a[i]))
+        case 0x69: SIMD_MAP(f32x4_t, f32x4_t, 4, truncf(a[i]))
+        case 0x6A: SIMD_MAP(f32x4_t, f32x4_t, 4, rintf(a[i]))
+        case 0x6B: SIMD_SHIFT(u8x16_t, <<, 8)
+        case 0x6C: SIMD_SHIFT(i8x16_t, >>, 8)
+        case 0x6D: SIMD_SHIFT(u8x16_t, >>, 8)
+        case 0x6E: SIMD_BIN(u8x16_t, a + b)
+        case 0x6F: SIMD_ZIP(i8x16_t, i8x16_t, 16, (int8_t)clamp_i64(a[i] + b[i], INT8_MIN, INT8_MAX))
+        case 0x70: SIMD_ZIP(u8x16_t, u8x16_t, 16, (uint8_t)clamp_i64(a[i] + b[i], 0, UINT8_MAX))
+        case 0x71: SIMD_BIN(u8x16_t, a - b)
+        case 0x72: SIMD_ZIP(i8x16_t, i8x16_t, 16, (int8_t)clamp_i64(a[i] - b[i], INT8_MIN, INT8_MAX))
+        case 0x73: SIMD_ZIP(u8x16_t, u8x16_t, 16, (uint8_t)clamp_i64(a[i] - b[i], 0, UINT8_MAX))
+        case 0x74: SIMD_MAP(f64x2_t, f64x2_t, 2, ceil(a[i]))
+        case 0x75: SIMD_MAP(f64x2_t, f64x2_t, 2, floor(a[i]))
+        case 0x76: SIMD_BIN(i8x16_t, VSELECT(a < b, a, b))
+        case 0x77: SIMD_BIN(u8x16_t, VSELECT(a < b, a, b))
+        case 0x78: SIMD_BIN(i8x16_t, VSELECT(a > b, a, b))
+        case 0x79: SIMD_BIN(u8x16_t, VSELECT(a > b, a, b))
+        case 0x7A: SIMD_MAP(f64x2_t, f64x2_t, 2, trunc(a[i]))
+        case 0x7B: SIMD_ZIP(u8x16_t, u8x16_t, 16, (uint8_t)((a[i] + b[i] + 1) >> 1))
+        case 0x7C: SIMD_MAP(i8x16_t, i16x8_t, 8, (int16_t)(a[2 * i] + a[2 * i + 1]))
+        case 0x7D: SIMD_MAP(u8x16_t, u16x8_t, 8, (uint16_t)(a[2 * i] + a[2 * i + 1]))
+        case 0x7E: SIMD_MAP(i16x8_t, i32x4_t, 4, (int32_t)a[2 * i] + a[2 * i + 1])
+        case 0x7F: SIMD_MAP(u16x8_t, u32x4_t, 4, (uint32_t)a[2 * i] + a[2 * i + 1])
+
+        case 0x80: SIMD_UN(i16x8_t, VSELECT(a < 0, -(u16x8_t)a, a))
+        case 0x81: SIMD_UN(u16x8_t, -a)
+        case 0x82: SIMD_ZIP(i16x8_t, i16x8_t, 8, (int16_t)clamp_i64(((int32_t)a[i] * b[i] + 0x4000) >> 15, INT16_MIN, INT16_MAX))
+        case 0x83: SIMD_ALL_TRUE(i16x8_t, 8)
+        case 0x84: SIMD_BITMASK(i16x8_t, 8)
+        case 0x85: SIMD_ZIP(i32x4_t, i16x8_t, 8, (int16_t)clamp_i64(i < 4 ? a[i & 3] : b[i & 3], INT16_MIN, INT16_MAX))
+        case 0x86: SIMD_ZIP(i32x4_t, u16x8_t, 8, (uint16_t)clamp_i64(i < 4 ? a[i & 3] : b[i & 3], 0, UINT16_MAX))
+        case 0x87: SIMD_MAP(i8x16_t, i16x8_t, 8, a[i])
+        case 0x88: SIMD_MAP(i8x16_t, i16x8_t, 8, a[i + 8])
+        case 0x89: SIMD_MAP(u8x16_t, u16x8_t, 8, a[i])
+        case 0x8A: SIMD_MAP(u8x16_t, u16x8_t, 8, a[i + 8])
+        case 0x8B: SIMD_SHIFT(u16x8_t, <<, 16)
+        case 0x8C: SIMD_SHIFT(i16x8_t, >>, 16)
+        case 0x8D: SIMD_SHIFT(u16x8_t, >>, 16)
+        case 0x8E: SIMD_BIN(u16x8_t, a + b)
+        case 0x8F: SIMD_ZIP(i16x8_t, i16x8_t, 8, (int16_t)clamp_i64(a[i] + b[i], INT16_MIN, INT16_MAX))
+        case 0x90: SIMD_ZIP(u16x8_t, u16x8_t, 8, (uint16_t)clamp_i64(a[i] + b[i], 0, UINT16_MAX))
+        case 0x91: SIMD_BIN(u16x8_t, a - b)
+        case 0x92: SIMD_ZIP(i16x8_t, i16x8_t, 8, (int16_t)clamp_i64(a[i] - b[i], INT16_MIN, INT16_MAX))
+        case 0x93: SIMD_ZIP(u16x8_t, u16x8_t, 8, (uint16_t)clamp_i64(a[i] - b[i], 0, UINT16_MAX))
+        case 0x94: SIMD_MAP(f64x2_t, f64x2_t, 2, rint(a[i]))
+        case 0x95: SIMD_BIN(u16x8_t, a * b)
+        case 0x96: SIMD_BIN(i16x8_t, VSELECT(a < b, a, b))
+        case 0x97: SIMD_BIN(u16x8_t, VSELECT(a < b, a, b))
+        case 0x98: SIMD_BIN(i16x8_t, VSELECT(a > b, a, b))
+        case 0x99: SIMD_BIN(u16x8_t, VSELECT(a > b, a, b))
+        case 0x9B: SIMD_ZIP(u16x8_t, u16x8_t, 8, (uint16_t)(((uint32_t)a[i] + b[i] + 1) >> 1))
+        case 0x9C: SIMD_ZIP(i8x16_t, i16x8_t, 8, (int16_t)(a[i] * b[i]))
+        case 0x9D: SIMD_ZIP(i8x16_t, i16x8_t, 8, (int16_t)(a[i + 8] * b[i + 8]))
+        case 0x9E: SIMD_ZIP(u8x16_t, u16x8_t, 8, (uint16_t)(a[i] * b[i]))
+        case 0x9F: SIMD_ZIP(u8x16_t, u16x8_t, 8, (uint16_t)(a[i + 8] * b[i + 8]))
+
+        case 0xA0: SIMD_UN(i32x4_t, VSELECT(a < 0, -(u32x4_t)a, a))
+        case 0xA1: SIMD_UN(u32x4_t, -a)
+        case 0xA3: SIMD_ALL_TRUE(i32x4_t, 4)
+        case 0xA4: SIMD_BITMASK(i32x4_t, 4)
+        case 0xA7: SIMD_MAP(i16x8_t, i32x4_t, 4, a[i])
+        case 0xA8: SIMD_MAP(i16x8_t, i32x4_t, 4, a[i + 4])
+        case 0xA9: SIMD_MAP(u16x8_t, u32x4_t, 4, a[i])
+        case 0xAA: SIMD_MAP(u16x8_t, u32x4_t, 4, a[i + 4])
+        case 0xAB: SIMD_SHIFT(u32x4_t, <<, 32)
+        case 0xAC: SIMD_SHIFT(i32x4_t, >>, 32)
+        case 0xAD: SIMD_SHIFT(u32x4_t, >>, 32)
+        case 0xAE: SIMD_BIN(u32x4_t, a + b)
+        case 0xB1: SIMD_BIN(u32x4_t, a - b)
+        case 0xB5: SIMD_BIN(u32x4_t, a * b)
+        case 0xB6: SIMD_BIN(i32x4_t, VSELECT(a < b, a, b))
+        case 0xB7: SIMD_BIN(u32x4_t, VSELECT(a < b, a, b))
+        case 0xB8: SIMD_BIN(i32x4_t, VSELECT(a > b, a, b))
+        case 0xB9: SIMD_BIN(u32x4_t, VSELECT(a > b, a, b))
+        case 0xBA: SIMD_ZIP(i16x8_t, u32x4_t, 4, (uint32_t)((int64_t)a[2 * i] * b[2 * i] + (int64_t)a[2 * i + 1] * b[2 * i + 1]))
+        case 0xBC: SIMD_ZIP(i16x8_t, i32x4_t, 4, (int32_t)a[i] * b[i])
+        case 0xBD: SIMD_ZIP(i16x8_t, i32x4_t, 4, (int32_t)a[i + 4] * b[i + 4])
+        case 0xBE: SIMD_ZIP(u16x8_t, u32x4_t, 4, (uint32_t)a[i] * b[i])
+        case 0xBF: SIMD_ZIP(u16x8_t, u32x4_t, 4, (uint32_t)a[i + 4] * b[i + 4])
+
+        case 0xC0: SIMD_UN(i64x2_t, VSELECT(a < 0, -(u64x2_t)a, a))
+        case 0xC1: SIMD_UN(u64x2_t, -a)
+        case 0xC3: SIMD_ALL_TRUE(i64x2_t, 2)
+        case 0xC4: SIMD_BITMASK(i64x2_t, 2)
+        case 0xC7: SIMD_MAP(i32x4_t, i64x2_t, 2, a[i])
+        case 0xC8: SIMD_MAP(i32x4_t, i64x2_t, 2, a[i + 2])
+        case 0xC9: SIMD_MAP(u32x4_t, u64x2_t, 2, a[i])
+        case 0xCA: SIMD_MAP(u32x4_t, u64x2_t, 2, a[i + 2])
+        case 0xCB: SIMD_SHIFT(u64x2_t, <<, 64)
+        case 0xCC: SIMD_SHIFT(i64x2_t, >>, 64)
+        case 0xCD: SIMD_SHIFT(u64x2_t, >>, 64)
+        case 0xCE: SIMD_BIN(u64x2_t, a + b)
+        case 0xD1: SIMD_BIN(u64x2_t, a - b)
+        case 0xD5: SIMD_BIN(u64x2_t, a * b)
+        case 0xD6: SIMD_BIN(i64x2_t, a == b)
+        case 0xD7: SIMD_BIN(i64x2_t, a != b)
+        case 0xD8: SIMD_BIN(i64x2_t, a < b)
+        case 0xD9: SIMD_BIN(i64x2_t, a > b)
+        case 0xDA: SIMD_BIN(i64x2_t, a <= b)
+        case 0xDB: SIMD_BIN(i64x2_t, a >= b)
+        case 0xDC: SIMD_ZIP(i32x4_t, i64x2_t, 2, (int64_t)a[i] * b[i])
+        case 0xDD: SIMD_ZIP(i32x4_t, i64x2_t, 2, (int64_t)a[i + 2] * b[i + 2])
+        case 0xDE: SIMD_ZIP(u32x4_t, u64x2_t, 2, (uint64_t)a[i] * b[i])
+        case 0xDF: SIMD_ZIP(u32x4_t, u64x2_t, 2, (uint64_t)a[i + 2] * b[i + 2])
+
+        case 0xE0: SIMD_UN(u32x4_t, a & 0x7FFFFFFFu)
+        case 0xE1: SIMD_UN(u32x4_t, a ^ 0x80000000u)
+        case 0xE3: SIMD_MAP(f32x4_t, f32x4_t, 4, sqrtf(a[i]))
+        case 0xE4: SIMD_BIN(f32x4_t, a + b)
+        case 0xE5: SIMD_BIN(f32x4_t, a - b)
+        case 0xE6: SIMD_BIN(f32x4_t, a * b)
+        case 0xE7: SIMD_BIN(f32x4_t, a / b)
+        case 0xE8: SIMD_ZIP(f32x4_t, f32x4_t, 4, min_f32(a[i], b[i]))
+        case 0xE9: SIMD_ZIP(f32x4_t, f32x4_t, 4, max_f32(a[i], b[i]))
+        case 0xEA: SIMD_BIN(f32x4_t, VSELECT(b < a, b, a))
+        case 0xEB: SIMD_BIN(f32x4_t, VSELECT(a < b, b, a))
+        case 0xEC: SIMD_UN(u64x2_t, a & 0x7FFFFFFFFFFFFFFFull)
+        case 0xED: SIMD_UN(u64x2_t, a ^ 0x8000000000000000ull)
+        case 0xEF: SIMD_MAP(f64x2_t, f64x2_t, 2, sqrt(a[i]))
+        case 0xF0: SIMD_BIN(f64x2_t, a + b)
+        case 0xF1: SIMD_BIN(f64x2_t, a - b)
+        case 0xF2: SIMD_BIN(f64x2_t, a * b)
+        case 0xF3: SIMD_BIN(f64x2_t, a / b)
+        case 0xF4: SIMD_ZIP(f64x2_t, f64x2_t, 2, min_f64(a[i], b[i]))
+        case 0xF5: SIMD_ZIP(f64x2_t, f64x2_t, 2, max_f64(a[i], b[i]))
+        case 0xF6: SIMD_BIN(f64x2_t, VSELECT(b < a, b, a))
+        case 0xF7: SIMD_BIN(f64x2_t, VSELECT(a < b, b, a))
+        case 0xF8: SIMD_MAP(f32x4_t, u32x4_t, 4, (uint32_t)trunc_sat(a[i], 0))
+        case 0xF9: SIMD_MAP(f32x4_t, u32x4_t, 4, (uint32_t)trunc_sat(a[i], 1))
+        case 0xFA: SIMD_UN(i32x4_t, __builtin_convertvector(a, f32x4_t))
+        case 0xFB: SIMD_UN(u32x4_t, __builtin_convertvector(a, f32x4_t))
+        case 0xFC: SIMD_MAP(f64x2_t, u32x4_t, 4, i < 2 ? (uint32_t)trunc_sat(a[i & 1], 0) : 0)
+        case 0xFD: SIMD_MAP(f64x2_t, u32x4_t, 4, i < 2 ? (uint32_t)trunc_sat(a[i & 1], 1) : 0)
+        case 0xFE: SIMD_MAP(i32x4_t, f64x2_t, 2, (double)a[i])
+        case 0xFF: SIMD_MAP(u32x4_t, f64x2_t, 2, (double)a[i])
+        default:
+            // Validation only lets defined opcodes through
+            return sp;
+    }
+}
+
+typedef uint64_t* (*simd_kernel_t)(const insn_t* in, uint64_t* sp, uint8_t* mem, uint64_t mem_size);
+
+static uint64_t* simd_baseline(const insn_t* in, uint64_t* sp, uint8_t* mem, uint64_t mem_size) {
+    return simd_exec(in, sp, mem, mem_size);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2,popcnt")))
+static uint64_t* simd_avx2(const insn_t* in, uint64_t* sp, uint8_t* mem, uint64_t mem_size) {
+    return simd_exec(in, sp, mem, mem_size);
+}
+#endif
+
+// Kernels for the host CPU, picked once before the first instance exists
+static simd_kernel_t g_simd = simd_baseline;
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_init(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) g_simd = simd_avx2;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Epoch interruption
+// ---------------------------------------------------------------------------
+
+// Calls under a deadline or in slices are interrupted at loop back-edges and
+// calls. Reading the clock there would cost more than the loop body, so a
+// thread bumps g_epoch every EPOCH_TICK_MS while such calls run and the
+// interpreter only compares it with the epoch it was given; the clock is read
+// once the epoch reaches that, to tell a deadline from a slice or re-arm.
+#define EPOCH_TICK_MS 1
+
+static uint64_t g_epoch = 0;
+static pthread_mutex_t g_epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_epoch_cond = PTHREAD_COND_INITIALIZER;
+static int g_epoch_users = 0;
+static int g_epoch_ticking = 0;
+
+static double epoch_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+}
+
+// Ticks while limited calls run and sleeps on the condition otherwise
+static void* epoch_ticker(void* arg) {
+    (void)arg;
+    const struct timespec tick = { 0, EPOCH_TICK_MS * 1000000L };
+    pthread_mutex_lock(&g_epoch_lock);
+    for (;;) {
+        while (g_epoch_users == 0) pthread_cond_wait(&g_epoch_cond, &g_epoch_lock);
+        pthread_mutex_unlock(&g_epoch_lock);
+        nanosleep(&tick, NULL);
+        __atomic_add_fetch(&g_epoch, 1, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&g_epoch_lock);
+    }
+    return NULL;
+}
+
+// Count a limited call in, starting the ticker the first time. Returns 0 if
+// no ticker could be started, in which case epochs never advance and only
+// fuel limits the call.
+static int epoch_enter(void) {
+    pthread_mutex_lock(&g_epoch_lock);
+    if (!g_epoch_ticking) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        g_epoch_ticking = pthread_create(&thread, &attr, epoch_ticker, NULL) == 0 ? 1 : -1;
+        pthread_attr_destroy(&attr);
+    }
+    if (g_epoch_users++ == 0) pthread_cond_signal(&g_epoch_cond);
+    int ticking = g_epoch_ticking > 0;
+    pthread_mutex_unlock(&g_epoch_lock);
+    return ticking;
+}
+
+static void epoch_leave(void) {
+    pthread_mutex_lock(&g_epoch_lock);
+    g_epoch_users--;
+    pthread_mutex_unlock(&g_epoch_lock);
+}
+
+// Set the epoch at which the interpreter next stops to look at the clock:
+// the deadline or the end of the slice, whichever is sooner. Ticks are never
+// shorter than EPOCH_TICK_MS, so the epoch can only be late, never early.
+// Returns 1 once the deadline has passed and 2 once the slice has.
+static int epoch_arm(wasmify_engine_instance_t* inst) {
+    double now = epoch_now_ms();
+    if (inst->deadline_at > 0 && now >= inst->deadline_at) return 1;
+    if (inst->slice_end > 0 && now >= inst->slice_end) return 2;
+
+    double stop = inst->deadline_at;
+    if (inst->slice_end > 0 && (stop == 0 || inst->slice_end < stop)) stop = inst->slice_end;
+    inst->epoch_deadline = stop == 0 ? UINT64_MAX
+        : __atomic_load_n(&g_epoch, __ATOMIC_RELAXED) + (uint64_t)ceil((stop - now) / EPOCH_TICK_MS);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Threads: atomic accesses and wait/notify on shared memories
+// ---------------------------------------------------------------------------
+
+// Waiters on one bucket of addresses, woken in the order they started waiting
+typedef struct waiter {
+    const void* addr;
+    pthread_cond_t cond;
+    int woken;
+    struct waiter* next;
+} waiter_t;
+
+#define WAIT_BUCKETS 64
+
+static struct {
+    pthread_mutex_t lock;
+    waiter_t* head;
+} g_waiters[WAIT_BUCKETS];
+static pthread_once_t g_waiters_once = PTHREAD_ONCE_INIT;
+
+static void waiters_init(void) {
+    for (int i = 0; i < WAIT_BUCKETS; i++) pthread_mutex_init(&g_waiters[i].lock, NULL);
+}
+
+static uint32_t wait_bucket(const void* addr) {
+    return (uint32_t)(((uintptr_t)addr >> 2) * 0x9E3779B1u >> 26) % WAIT_BUCKETS;
+}
+
+static void waiter_unlink(uint32_t bucket, waiter_t* w) {
+    for (waiter_t** p = &g_waiters[bucket].head; *p; p = &(*p)->next) {
+        if (*p == w) {
+            *p = w->next;
+            return;
+        }
+    }
+}
+
+// Block while the size-byte value at addr equals expected, for at most
+// timeout_ns when that isn't negative. The call's deadline bounds the wait
+// too. Returns 0 once notified, 1 if the value differed, 2 on timeout and -1
+// once the deadline has passed.
+static int atomic_wait(const wasmify_engine_instance_t* inst, const void* addr, uint32_t size, uint64_t expected, int64_t timeout_ns) {
+    pthread_once(&g_waiters_once, waiters_init);
+    uint32_t bucket = wait_bucket(addr);
+    pthread_mutex_lock(&g_waiters[bucket].lock);
+    uint64_t current = size == 4 ? __atomic_load_n((const uint32_t*)addr, __ATOMIC_SEQ_CST)
+                                 : __atomic_load_n((const uint64_t*)addr, __ATOMIC_SEQ_CST);
+    if (current != expected) {
+        pthread_mutex_unlock(&g_waiters[bucket].lock);
+        return 1;
+    }
+
+    waiter_t w = { addr, PTHREAD_COND_INITIALIZER, 0, NULL };
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&w.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    waiter_t** tail = &g_waiters[bucket].head;
+    while (*tail) tail = &(*tail)->next;
+    *tail = &w;
+
+    int bounded = timeout_ns >= 0;
+    double until_ms = bounded ? epoch_now_ms() + timeout_ns / 1e6 : 0;
+    int by_deadline = 0;
+    if (inst->deadline_at > 0 && (!bounded || inst->deadline_at < until_ms)) {
+        bounded = 1;
+        until_ms = inst->deadline_at;
+        by_deadline = 1;
+    }
+
+    int result = 0;
+    while (!w.woken) {
+        if (!bounded) {
+            pthread_cond_wait(&w.cond, &g_waiters[bucket].lock);
+            continue;
+        }
+        struct timespec at;
+        at.tv_sec = (time_t)(until_ms / 1000);
+        at.tv_nsec = (long)((until_ms - at.tv_sec * 1000.0) * 1e6);
+        if (at.tv_nsec >= 1000000000L) {
+            at.tv_sec++;
+            at.tv_nsec -= 1000000000L;
+        }
+        if (pthread_cond_timedwait(&w.cond, &g_waiters[bucket].lock, &at) == ETIMEDOUT && !w.woken) {
+            waiter_unlink(bucket, &w);
+            result = by_deadline ? -1 : 2;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_waiters[bucket].lock);
+    pthread_cond_destroy(&w.cond);
+    return result;
+}
+
+// Wake up to count waiters on addr, oldest first. Returns how many woke.
+static uint32_t atomic_notify(const void* addr, uint32_t count) {
+    pthread_once(&g_waiters_once, waiters_init);
+    uint32_t bucket = wait_bucket(addr);
+    uint32_t woken = 0;
+    pthread_mutex_lock(&g_waiters[bucket].lock);
+    waiter_t** p = &g_waiters[bucket].head;
+    while (*p && woken < count) {
+        waiter_t* w = *p;
+        if (w->addr != addr) {
+            p = &w->next;
+            continue;
+        }
+        *p = w->next;
+        w->woken = 1;
+        pthread_cond_signal(&w->cond);
+        woken++;
+    }
+    pthread_mutex_unlock(&g_waiters[bucket].lock);
+    return woken;
+}
+
+#define ATOMIC_OP(T) do { \
+    T* q = (T*)p; T x = (T)v; \
+    switch (group) { \
+        case ATOMIC_LOAD: return __atomic_load_n(q, __ATOMIC_SEQ_CST); \
+        case ATOMIC_STORE: __atomic_store_n(q, x, __ATOMIC_SEQ_CST); return 0; \
+        case ATOMIC_ADD: return __atomic_fetch_add(q, x, __ATOMIC_SEQ_CST); \
+        case ATOMIC_SUB: return __atomic_fetch_sub(q, x, __ATOMIC_SEQ_CST); \
+        case ATOMIC_AND: return __atomic_fetch_and(q, x, __ATOMIC_SEQ_CST); \
+        case ATOMIC_OR: return __atomic_fetch_or(q, x, __ATOMIC_SEQ_CST); \
+        case ATOMIC_XOR: return __atomic_fetch_xor(q, x, __ATOMIC_SEQ_CST); \
+        case ATOMIC_XCHG: return __atomic_exchange_n(q, x, __ATOMIC_SEQ_CST); \
+        default: \
+            __atomic_compare_exchange_n(q, &x, (T)replacement, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+            return x; \
+    } \
+} while (0)
+
+// One sequentially consistent access of 1 << size_log2 bytes at p; returns
+// the value read, zero-extended. For cmpxchg v is the expected value.
+static uint64_t atomic_rmw(void* p, uint32_t group, uint32_t size_log2, uint64_t v, uint64_t replacement) {
+    switch (size_log2) {
+        case 0: ATOMIC_OP(uint8_t);
+        case 1: ATOMIC_OP(uint16_t);
+        case 2: ATOMIC_OP(uint32_t);
+        default: ATOMIC_OP(uint64_t);
+    }
+}
+
+#define TRAP(msg) do { trap_msg = (msg); goto trap; } while (0)
+
+#define I32_BIN(expr) { uint32_t b = (uint32_t)sp[-1]; uint32_t a = (uint32_t)sp[-2]; sp--; sp[-1] = (uint32_t)(expr); break; }
+#define I64_BIN(expr) { uint64_t b = sp[-1]; uint64_t a = sp[-2]; sp--; sp[-1] = (uint64_t)(expr); break; }
+#define F32_BIN(expr) { float b = f32_of(sp[-1]); float a = f32_of(sp[-2]); sp--; sp[-1] = bits_f32(expr); break; }
+#define F64_BIN(expr) { double b = f64_of(sp[-1]); double a = f64_of(sp[-2]); sp--; sp[-1] = bits_f64(expr); break; }
+#define F32_CMP(expr) { float b = f32_of(sp[-1]); float a = f32_of(sp[-2]); sp--; sp[-1] = (expr) ? 1 : 0; break; }
+#define F64_CMP(expr) { double b = f64_of(sp[-1]); double a = f64_of(sp[-2]); sp--; sp[-1] = (expr) ? 1 : 0; break; }
+#define UNARY(expr) { uint64_t a = sp[-1]; sp[-1] = (uint64_t)(expr); break; }
+
+// Accesses past the size this instance last saw of a shared memory look
+// again, in case another instance grew it since
+#define IN_BOUNDS(end) ((end) <= mem_size || (memory_sync(inst, &mem_size) && (end) <= mem_size))
+
+#define LOAD(ctype, conv) { \
+    uint64_t ea = (uint64_t)(uint32_t)sp[-1] + in->a; \
+    if (!IN_BOUNDS(ea + sizeof(ctype))) TRAP(TRAP_OOB_MEMORY); \
+    ctype v; memcpy(&v, mem + ea, sizeof(v)); \
+    sp[-1] = (uint64_t)(conv); break; }
+
+#define STORE(ctype) { \
+    uint64_t ea = (uint64_t)(uint32_t)sp[-2] + in->a; \
+    if (!IN_BOUNDS(ea + sizeof(ctype))) TRAP(TRAP_OOB_MEMORY); \
+    ctype v = (ctype)sp[-1]; memcpy(mem + ea, &v, sizeof(v)); \
+    sp -= 2; break; }
+
+// Fuel is handed to the interpreter in installments of at most this many
+// units, and the epoch is only looked at when one runs out
+#define EPOCH_CHECK_UNITS 4096
+
+// Burn fuel at a back-edge or call and stop at the end of the installment
+#define CHECKPOINT(cost) do { \
+    fuel -= (int64_t)(cost); \
+    if (__builtin_expect(fuel < 0, 0)) goto checkpoint; \
+} while (0)
+
+#define TRUNC(fval, kind, cast) { \
+    double x = (fval); \
+    if (isnan(x)) TRAP(TRAP_INVALID_CONV); \
+    if (!(x > TRUNC_LO[kind] && x < TRUNC_HI[kind])) TRAP(TRAP_OVERFLOW); \
+    sp[-1] = cast; break; }
+
+// Run a call of func_index, or with resume set the call suspended on the
+// instance. Returns 0 once it has returned, 1 on a trap and 2 when it was
+// suspended at the end of its slice.
+static int interp(wasmify_engine_instance_t* inst, uint32_t func_index, int resume) {
+    const wasmify_engine_module_t* m = inst->module;
+    uint8_t* mem = inst->memory;
+    uint64_t mem_size = inst->memory_size;
+    uint64_t* const stack_end = inst->stack + inst->stack_slots;
+    frame_t* const frames = inst->frames;
+    uint32_t depth = 0;
+    const char* trap_msg = NULL;
+    int64_t fuel = inst->fuel < EPOCH_CHECK_UNITS ? inst->fuel : EPOCH_CHECK_UNITS;
+    int64_t reserve = inst->fuel - fuel;
+
+    const func_t* func = NULL;
+    const insn_t* ip = NULL;
+    uint64_t* fp = NULL;
+    uint64_t* sp = inst->stack + m->types[m->funcs[func_index].type].param_slots;
+    uint32_t callee_index = func_index;
+    const insn_t* in;
+
+    if (resume) {
+        func = inst->suspended_func;
+        ip = inst->suspended_ip;
+        fp = inst->suspended_fp;
+        sp = inst->suspended_sp;
+        depth = inst->suspended_depth;
+    } else {
+        goto do_call;
+    }
+
+    for (;;) {
+        in = ip++;
+        switch (in->op) {
+            case OP_UNREACHABLE:
+                TRAP("unreachable");
+            case OP_JMP:
+                ip = func->code + in->a;
+                break;
+            case OP_IF:
+                if ((uint32_t)*--sp == 0) ip = func->code + in->a;
+                break;
+            case OP_BR_IF:
+                if ((uint32_t)*--sp == 0) break;
+                // fallthrough
+            case OP_BR: {
+                uint32_t keep = (uint32_t)in->b;
+                uint64_t* dst = fp + (in->b >> 32);
+                if (dst != sp - keep) memmove(dst, sp - keep, keep * sizeof(uint64_t));
+                sp = dst + keep;
+                ip = func->code + in->a;
+                // Only branches to a loop go backwards; an iteration costs its length
+                if (ip <= in) CHECKPOINT(in - ip + 1);
+                break;
+            }
+            case OP_BR_TABLE: {
+                uint32_t idx = (uint32_t)*--sp;
+                if (idx > in->b) idx = (uint32_t)in->b;
+                const branch_t* br = &func->branches[in->a + idx];
+                uint64_t* dst = fp + br->base;
+                if (dst != sp - br->keep) memmove(dst, sp - br->keep, br->keep * sizeof(uint64_t));
+                sp = dst + br->keep;
+                ip = func->code + br->target;
+                if (ip <= in) CHECKPOINT(in - ip + 1);
+                break;
+            }
+            case OP_RETURN: {
+                uint32_t n = (uint32_t)in->b;
+                if (fp != sp - n) memmove(fp, sp - n, n * sizeof(uint64_t));
+                sp = fp + n;
+                depth--;
+                func = frames[depth].func;
+                ip = frames[depth].ip;
+                fp = frames[depth].fp;
+                if (!func) goto done;
+                break;
+            }
+            case OP_CALL:
+                callee_index = in->a;
+                goto do_call;
+            case OP_CALL_INDIRECT: {
+                const table_inst_t* t = &inst->tables[in->b];
+                uint32_t idx = (uint32_t)*--sp;
+                if (idx >= t->size) TRAP("undefined element");
+                uint64_t ref = t->elems[idx];
+                if (ref == 0) TRAP("uninitialized element");
+                callee_index = (uint32_t)(ref - 1);
+                if (m->types[m->funcs[callee_index].type].canon != m->types[in->a].canon) {
+                    TRAP("indirect call type mismatch");
+                }
+                goto do_call;
+            }
+            case OP_DROP:
+                sp -= in->b;
+                break;
+            case OP_SELECT: {
+                uint32_t cond = (uint32_t)*--sp;
+                uint32_t n = (uint32_t)in->b;
+                if (!cond) memcpy(sp - 2 * n, sp - n, n * sizeof(uint64_t));
+                sp -= n;
+                break;
+            }
+            case OP_LOCAL_GET:
+                *sp++ = fp[in->a];
+                break;
+            case OP_LOCAL_SET:
+                fp[in->a] = *--sp;
+                break;
+            case OP_LOCAL_TEE:
+                fp[in->a] = sp[-1];
+                break;
+            case OP_GLOBAL_GET:
+                *sp++ = inst->globals[in->a];
+                break;
+            case OP_GLOBAL_SET:
+                inst->globals[in->a] = *--sp;
+                break;
+            case OP_LOCAL_GET_V128:
+                memcpy(sp, fp + in->a, 2 * sizeof(uint64_t));
+                sp += 2;
+                break;
+            case OP_LOCAL_SET_V128:
+                sp -= 2;
+                memcpy(fp + in->a, sp, 2 * sizeof(uint64_t));
+                break;
+            case OP_LOCAL_TEE_V128:
+                memcpy(fp + in->a, sp - 2, 2 * sizeof(uint64_t));
+                break;
+            case OP_GLOBAL_GET_V128:
+                memcpy(sp, inst->globals + in->a, 2 * sizeof(uint64_t));
+                sp += 2;
+                break;
+            case OP_GLOBAL_SET_V128:
+                sp -= 2;
+                memcpy(inst->globals + in->a, sp, 2 * sizeof(uint64_t));
+                break;
+            case OP_TABLE_GET: {
+                const table_inst_t* t = &inst->tables[in->a];
+                uint32_t idx = (uint32_t)sp[-1];
+                if (idx >= t->size) TRAP(TRAP_OOB_TABLE);
+                sp[-1] = t->elems[idx];
+                break;
+            }
+            case OP_TABLE_SET: {
+                table_inst_t* t = &inst->tables[in->a];
+                uint32_t idx = (uint32_t)sp[-2];
+                if (idx >= t->size) TRAP(TRAP_OOB_TABLE);
+                t->elems[idx] = sp[-1];
+                sp -= 2;
+                break;
+            }
+
+            case 0x28: LOAD(uint32_t, v)
+            case 0x29: LOAD(uint64_t, v)
+            case 0x2A: LOAD(uint32_t, v)
+            case 0x2B: LOAD(uint64_t, v)
+            case 0x2C: LOAD(int8_t, (uint32_t)(int32_t)v)
+            case 0x2D: LOAD(uint8_t, v)
+            case 0x2E: LOAD(int16_t, (uint32_t)(int32_t)v)
+            case 0x2F: LOAD(uint16_t, v)
+            case 0x30: LOAD(int8_t, (int64_t)v)
+            case 0x31: LOAD(uint8_t, v)
+            case 0x32: LOAD(int16_t, (int64_t)v)
+            case 0x33: LOAD(uint16_t, v)
+            case 0x34: LOAD(int32_t, (int64_t)v)
+            case 0x35: LOAD(uint32_t, v)
+            case 0x36: STORE(uint32_t)
+            case 0x37: STORE(uint64_t)
+            case 0x38: STORE(uint32_t)
+            case 0x39: STORE(uint64_t)
+            case 0x3A: STORE(uint8_t)
+            case 0x3B: STORE(uint16_t)
+            case 0x3C: STORE(uint8_t)
+            case 0x3D: STORE(uint16_t)
+            case 0x3E: STORE(uint32_t)
+
+            case OP_MEMORY_SIZE:
+                memory_sync(inst, &mem_size);
+                *sp++ = inst->memory_pages;
+                break;
+            case OP_MEMORY_GROW:
+                sp[-1] = memory_grow(inst, (uint32_t)sp[-1]);
+                mem_size = inst->memory_size;
+                break;
+            case OP_CONST:
+                *sp++ = in->b;
+                break;
+
+            case 0x45: UNARY((uint32_t)a == 0)
+            case 0x46: I32_BIN(a == b)
+            case 0x47: I32_BIN(a != b)
+            case 0x48: I32_BIN((int32_t)a < (int32_t)b)
+            case 0x49: I32_BIN(a < b)
+            case 0x4A: I32_BIN((int32_t)a > (int32_t)b)
+            case 0x4B: I32_BIN(a > b)
+            case 0x4C: I32_BIN((int32_t)a <= (int32_t)b)
+            case 0x4D: I32_BIN(a <= b)
+            case 0x4E: I32_BIN((int32_t)a >= (int32_t)b)
+            case 0x4F: I32_BIN(a >= b)
+            case 0x50: UNARY(a == 0)
+            case 0x51: I64_BIN(a == b)
+            case 0x52: I64_BIN(a != b)
+            case 0x53: I64_BIN((int64_t)a < (int64_t)b)
+            case 0x54: I64_BIN(a < b)
+            case 0x55: I64_BIN((int64_t)a > (int64_t)b)
+            case 0x56: I64_BIN(a > b)
+            case 0x57: I64_BIN((int64_t)a <= (int64_t)b)
+            case 0x58: I64_BIN(a <= b)
+            case 0x59: I64_BIN((int64_t)a >= (int64_t)b)
+            case 0x5A: I64_BIN(a >= b)
+            case 0x5B: F32_CMP(a == b)
+            case 0x5C: F32_CMP(a != b)
+            case 0x5D: F32_CMP(a < b)
+            case 0x5E: F32_CMP(a > b)
+            case 0x5F: F32_CMP(a <= b)
+            case 0x60: F32_CMP(a >= b)
+            case 0x61: F64_CMP(a == b)
+            case 0x62: F64_CMP(a != b)
+            case 0x63: F64_CMP(a < b)
+            case 0x64: F64_CMP(a > b)
+            case 0x65: F64_CMP(a <= b)
+            case 0x66: F64_CMP(a >= b)
+
+            case 0x67: UNARY((uint32_t)a == 0 ? 32 : __builtin_clz((uint32_t)a))
+            case 0x68: UNARY((uint32_t)a == 0 ? 32 : __builtin_ctz((uint32_t)a))
+            case 0x69: UNARY(__builtin_popcount((uint32_t)a))
+            case 0x6A: I32_BIN(a + b)
+            case 0x6B: I32_BIN(a - b)
+            case 0x6C: I32_BIN(a * b)
+            case 0x6D: {
+                int32_t b = (int32_t)sp[-1], a = (int32_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                if (a == INT32_MIN && b == -1) TRAP(TRAP_OVERFLOW);
+                sp--;
+                sp[-1] = (uint32_t)(a / b);
+                break;
+            }
+            case 0x6E: {
+                uint32_t b = (uint32_t)sp[-1], a = (uint32_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = a / b;
+                break;
+            }
+            case 0x6F: {
+                int32_t b = (int32_t)sp[-1], a = (int32_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = b == -1 ? 0 : (uint32_t)(a % b);
+                break;
+            }
+            case 0x70: {
+                uint32_t b = (uint32_t)sp[-1], a = (uint32_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = a % b;
+                break;
+            }
+            case 0x71: I32_BIN(a & b)
+            case 0x72: I32_BIN(a | b)
+            case 0x73: I32_BIN(a ^ b)
+            case 0x74: I32_BIN(a << (b & 31))
+            case 0x75: I32_BIN((int32_t)a >> (b & 31))
+            case 0x76: I32_BIN(a >> (b & 31))
+            case 0x77: I32_BIN((a << (b & 31)) | (a >> ((32 - b) & 31)))
+            case 0x78: I32_BIN((a >> (b & 31)) | (a << ((32 - b) & 31)))
+
+            case 0x79: UNARY(a == 0 ? 64 : __builtin_clzll(a))
+            case 0x7A: UNARY(a == 0 ? 64 : __builtin_ctzll(a))
+            case 0x7B: UNARY(__builtin_popcountll(a))
+            case 0x7C: I64_BIN(a + b)
+            case 0x7D: I64_BIN(a - b)
+            case 0x7E: I64_BIN(a * b)
+            case 0x7F: {
+                int64_t b = (int64_t)sp[-1], a = (int64_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                if (a == INT64_MIN && b == -1) TRAP(TRAP_OVERFLOW);
+                sp--;
+                sp[-1] = (uint64_t)(a / b);
+                break;
+            }
+            case 0x80: {
+                uint64_t b = sp[-1], a = sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = a / b;
+                break;
+            }
+            case 0x81: {
+                int64_t b = (int64_t)sp[-1], a = (int64_t)sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = b == -1 ? 0 : (uint64_t)(a % b);
+                break;
+            }
+            case 0x82: {
+                uint64_t b = sp[-1], a = sp[-2];
+                if (b == 0) TRAP(TRAP_DIV_ZERO);
+                sp--;
+                sp[-1] = a % b;
+                break;
+            }
+            case 0x83: I64_BIN(a & b)
+            case 0x84: I64_BIN(a | b)
+            case 0x85: I64_BIN(a ^ b)
+            case 0x86: I64_BIN(a << (b & 63))
+            case 0x87: I64_BIN((int64_t)a >> (b & 63))
+            case 0x88: I64_BIN(a >> (b & 63))
+            case 0x89: I64_BIN((a << (b & 63)) | (a >> ((64 - b) & 63)))
+            case 0x8A: I64_BIN((a >> (b & 63)) | (a << ((64 - b) & 63)))
+
+            case 0x8B: UNARY(a & 0x7FFFFFFFu)
+            case 0x8C: UNARY((a ^ 0x80000000u) & 0xFFFFFFFFu)
+            case 0x8D: UNARY(bits_f32(ceilf(f32_of(a))))
+            case 0x8E: UNARY(bits_f32(floorf(f32_of(a))))
+            case 0x8F: UNARY(bits_f32(truncf(f32_of(a))))
+            case 0x90: UNARY(bits_f32(rintf(f32_of(a))))
+            case 0x91: UNARY(bits_f32(sqrtf(f32_of(a))))
+            case 0x92: F32_BIN(a + b)
+            case 0x93: F32_BIN(a - b)
+            case 0x94: F32_BIN(a * b)
+            case 0x95: F32_BIN(a / b)
+            case 0x96: F32_BIN(min_f32(a, b))
+            case 0x97: F32_BIN(max_f32(a, b))
+            case 0x98: {
+                uint64_t b = sp[-1], a = sp[-2];
+                sp--;
+                sp[-1] = (a & 0x7FFFFFFFu) | (b & 0x80000000u);
+                break;
+            }
+            case 0x99: UNARY(a & 0x7FFFFFFFFFFFFFFFull)
+            case 0x9A: UNARY(a ^ 0x8000000000000000ull)
+            case 0x9B: UNARY(bits_f64(ceil(f64_of(a))))
+            case 0x9C: UNARY(bits_f64(floor(f64_of(a))))
+            case 0x9D: UNARY(bits_f64(trunc(f64_of(a))))
+            case 0x9E: UNARY(bits_f64(rint(f64_of(a))))
+            case 0x9F: UNARY(bits_f64(sqrt(f64_of(a))))
+            case 0xA0: F64_BIN(a + b)
+            case 0xA1: F64_BIN(a - b)
+            case 0xA2: F64_BIN(a * b)
+            case 0xA3: F64_BIN(a / b)
+            case 0xA4: F64_BIN(min_f64(a, b))
+            case 0xA5: F64_BIN(max_f64(a, b))
+            case 0xA6: {
+                uint64_t b = sp[-1], a = sp[-2];
+                sp--;
+                sp[-1] = (a & 0x7FFFFFFFFFFFFFFFull) | (b & 0x8000000000000000ull);
+                break;
+            }
+
+            case 0xA7: UNARY((uint32_t)a)
+            case 0xA8: TRUNC(f32_of(sp[-1]), 0, (uint32_t)(int32_t)x)
+            case 0xA9: TRUNC(f32_of(sp[-1]), 1, (uint32_t)x)
+            case 0xAA: TRUNC(f64_of(sp[-1]), 0, (uint32_t)(int32_t)x)
+            case 0xAB: TRUNC(f64_of(sp[-1]), 1, (uint32_t)x)
+            case 0xAC: UNARY((int64_t)(int32_t)a)
+            case 0xAD: UNARY((uint32_t)a)
+            case 0xAE: TRUNC(f32_of(sp[-1]), 2, (uint64_t)(int64_t)x)
+            case 0xAF: TRUNC(f32_of(sp[-1]), 3, (uint64_t)x)
+            case 0xB0: TRUNC(f64_of(sp[-1]), 2, (uint64_t)(int64_t)x)
+            case 0xB1: TRUNC(f64_of(sp[-1]), 3, (uint64_t)x)
+            case 0xB2: UNARY(bits_f32((float)(int32_t)a))
+            case 0xB3: UNARY(bits_f32((float)(uint32_t)a))
+            case 0xB4: UNARY(bits_f32((float)(int64_t)a))
+            case 0xB5: UNARY(bits_f32((float)a))
+            case 0xB6: UNARY(bits_f32((float)f64_of(a)))
+            case 0xB7: UNARY(bits_f64((double)(int32_t)a))
+            case 0xB8: UNARY(bits_f64((double)(uint32_t)a))
+            case 0xB9: UNARY(bits_f64((double)(int64_t)a))
+            case 0xBA: UNARY(bits_f64((double)a))
+            case 0xBB: UNARY(bits_f64((double)f32_of(a)))
+            case 0xBC:
+            case 0xBD:
+            case 0xBE:
+            case 0xBF:
+                break;
+            case 0xC0: UNARY((uint32_t)(int32_t)(int8_t)a)
+            case 0xC1: UNARY((uint32_t)(int32_t)(int16_t)a)
+            case 0xC2: UNARY((int64_t)(int8_t)a)
+            case 0xC3: UNARY((int64_t)(int16_t)a)
+            case 0xC4: UNARY((int64_t)(int32_t)a)
+            case OP_REF_IS_NULL: UNARY(a == 0)
+
+            case OP_PREFIX_FC + 0: UNARY(trunc_sat(f32_of(a), 0))
+            case OP_PREFIX_FC + 1: UNARY(trunc_sat(f32_of(a), 1))
+            case OP_PREFIX_FC + 2: UNARY(trunc_sat(f64_of(a), 0))
+            case OP_PREFIX_FC + 3: UNARY(trunc_sat(f64_of(a), 1))
+            case OP_PREFIX_FC + 4: UNARY(trunc_sat(f32_of(a), 2))
+            case OP_PREFIX_FC + 5: UNARY(trunc_sat(f32_of(a), 3))
+            case OP_PREFIX_FC + 6: UNARY(trunc_sat(f64_of(a), 2))
+            case OP_PREFIX_FC + 7: UNARY(trunc_sat(f64_of(a), 3))
+            case OP_PREFIX_FC + 8: {  // memory.init
+                const data_t* d = &m->datas[in->a];
+                uint64_t n = (uint32_t)sp[-1], src = (uint32_t)sp[-2], dst = (uint32_t)sp[-3];
+                uint64_t size = inst->data_dropped[in->a] ? 0 : d->size;
+                sp -= 3;
+                if (src + n > size || !IN_BOUNDS(dst + n)) TRAP(TRAP_OOB_MEMORY);
+                if (n) memcpy(mem + dst, d->bytes + src, n);
+                break;
+            }
+            case OP_PREFIX_FC + 9:
+                inst->data_dropped[in->a] = 1;
+                break;
+            case OP_PREFIX_FC + 10: {  // memory.copy
+                uint64_t n = (uint32_t)sp[-1], src = (uint32_t)sp[-2], dst = (uint32_t)sp[-3];
+                sp -= 3;
+                if (!IN_BOUNDS(src + n) || !IN_BOUNDS(dst + n)) TRAP(TRAP_OOB_MEMORY);
+                if (n) memmove(mem + dst, mem + src, n);
+                break;
+            }
+            case OP_PREFIX_FC + 11: {  // memory.fill
+                uint64_t n = (uint32_t)sp[-1], dst = (uint32_t)sp[-3];
+                uint8_t val = (uint8_t)sp[-2];
+                sp -= 3;
+                if (!IN_BOUNDS(dst + n)) TRAP(TRAP_OOB_MEMORY);
+                if (n) memset(mem + dst, val, n);
+                break;
+            }
+            case OP_PREFIX_FC + 12: {  // table.init
+                const elem_t* e = &m->elems[in->a];
+                table_inst_t* t = &inst->tables[in->b];
+                uint64_t n = (uint32_t)sp[-1], src = (uint32_t)sp[-2], dst = (uint32_t)sp[-3];
+                uint64_t size = inst->elem_dropped[in->a] ? 0 : e->count;
+                sp -= 3;
+                if (src + n > size || dst + n > t->size) TRAP(TRAP_OOB_TABLE);
+                for (uint64_t i = 0; i < n; i++) t->elems[dst + i] = eval_const(inst, &e->items[src + i]);
+                break;
+            }
+            case OP_PREFIX_FC + 13:
+                inst->elem_dropped[in->a] = 1;
+                break;
+            case OP_PREFIX_FC + 14: {  // table.copy
+                table_inst_t* dt = &inst->tables[in->a];
+                const table_inst_t* st = &inst->tables[in->b];
+                uint64_t n = (uint32_t)sp[-1], src = (uint32_t)sp[-2], dst = (uint32_t)sp[-3];
+                sp -= 3;
+                if (src + n > st->size || dst + n > dt->size) TRAP(TRAP_OOB_TABLE);
+                if (n) memmove(dt->elems + dst, st->elems + src, n * sizeof(uint64_t));
+                break;
+            }
+            case OP_PREFIX_FC + 15: {  // table.grow
+                table_inst_t* t = &inst->tables[in->a];
+                uint32_t old = t->size;
+                uint32_t n = (uint32_t)sp[-1];
+                sp--;
+                sp[-1] = table_grow(t, n, sp[-1]) ? old : UINT32_MAX;
+                break;
+            }
+            case OP_PREFIX_FC + 16:
+                *sp++ = inst->tables[in->a].size;
+                break;
+            case OP_PREFIX_FC + 17: {  // table.fill
+                table_inst_t* t = &inst->tables[in->a];
+                uint64_t n = (uint32_t)sp[-1], val = sp[-2], dst = (uint32_t)sp[-3];
+                sp -= 3;
+                if (dst + n > t->size) TRAP(TRAP_OOB_TABLE);
+                for (uint64_t i = 0; i < n; i++) t->elems[dst + i] = val;
+                break;
+            }
+            case OP_PREFIX_FD + 0x0C:  // v128.const
+                sp[0] = in->b;
+                sp[1] = ip->b;
+                sp += 2;
+                ip++;
+                break;
+            case OP_PREFIX_FD + 0x0D:  // i8x16.shuffle
+                sp = g_simd(in, sp, mem, mem_size);
+                ip++;
+                break;
+            case OP_PREFIX_FD + 0x00 ... OP_PREFIX_FD + 0x0B:
+            case OP_PREFIX_FD + 0x0E ... OP_PREFIX_FD + 0xFF: {
+                uint64_t* top = g_simd(in, sp, mem, mem_size);
+                if (!top && memory_sync(inst, &mem_size)) top = g_simd(in, sp, mem, mem_size);
+                if (!top) TRAP(TRAP_OOB_MEMORY);
+                sp = top;
+                break;
+            }
+            case OP_PREFIX_FE + 0: {  // memory.atomic.notify
+                uint64_t ea = (uint64_t)(uint32_t)sp[-2] + in->a;
+                if (!IN_BOUNDS(ea + 4)) TRAP(TRAP_OOB_MEMORY);
+                if (ea & 3) TRAP(TRAP_UNALIGNED);
+                uint32_t count = (uint32_t)sp[-1];
+                sp--;
+                // Nothing can wait on memory no other thread sees
+                sp[-1] = inst->shared ? atomic_notify(mem + ea, count) : 0;
+                break;
+            }
+            case OP_PREFIX_FE + 1:
+            case OP_PREFIX_FE + 2: {  // memory.atomic.wait32, memory.atomic.wait64
+                uint32_t size = in->op == OP_PREFIX_FE + 1 ? 4 : 8;
+                uint64_t ea = (uint64_t)(uint32_t)sp[-3] + in->a;
+                if (!IN_BOUNDS(ea + size)) TRAP(TRAP_OOB_MEMORY);
+                if (ea & (size - 1)) TRAP(TRAP_UNALIGNED);
+                if (!inst->shared) TRAP(TRAP_UNSHARED);
+                uint64_t expected = size == 4 ? (uint32_t)sp[-2] : sp[-2];
+                int result = atomic_wait(inst, mem + ea, size, expected, (int64_t)sp[-1]);
+                if (result < 0) {
+                    inst->timed_out = 1;
+                    TRAP(TRAP_DEADLINE);
+                }
+                sp -= 2;
+                sp[-1] = (uint32_t)result;
+                break;
+            }
+            case OP_PREFIX_FE + 3:  // atomic.fence
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                break;
+            case OP_PREFIX_FE + 0x10 ... OP_PREFIX_FE + 0x4E: {
+                uint32_t group = (uint32_t)(in->b >> 8), size_log2 = (uint32_t)(in->b & 0xFF);
+                uint32_t operands = group == ATOMIC_LOAD ? 1 : group == ATOMIC_CMPXCHG ? 3 : 2;
+                uint64_t ea = (uint64_t)(uint32_t)sp[-(int)operands] + in->a;
+                if (!IN_BOUNDS(ea + (1u << size_log2))) TRAP(TRAP_OOB_MEMORY);
+                if (ea & ((1u << size_log2) - 1)) TRAP(TRAP_UNALIGNED);
+                uint64_t v = operands > 1 ? sp[1 - (int)operands] : 0;
+                uint64_t old = atomic_rmw(mem + ea, group, size_log2, v, sp[-1]);
+                sp -= operands;
+                if (group != ATOMIC_STORE) *sp++ = old;
+                break;
+            }
+            default:
+                TRAP("invalid instruction");
+        }
+        continue;
+
+    do_call: {
+            const func_t* callee = &m->funcs[callee_index];
+            const functype_t* ft = &m->types[callee->type];
+            uint64_t* args = sp - ft->param_slots;
+            if (callee_index < m->import_func_count) {
+                int host = inst->host_funcs[callee_index](inst, args);
+                if (host == 1) goto host_trap;
+                sp = args + ft->result_slots;
+                mem_size = inst->memory_size;
+                if (!func) goto done;
+                if (host == 2) goto suspend;
+                continue;
+            }
+            if (depth >= inst->frame_cap || callee->max_slots > (size_t)(stack_end - args)) TRAP(TRAP_STACK);
+            frames[depth].func = func;
+            frames[depth].ip = ip;
+            frames[depth].fp = fp;
+            depth++;
+            memset(args + ft->param_slots, 0, (callee->local_slots - ft->param_slots) * sizeof(uint64_t));
+            fp = args;
+            sp = fp + callee->local_slots;
+            func = callee;
+            ip = callee->code;
+            CHECKPOINT(1);
+            continue;
+        }
+
+    checkpoint:
+        fuel += reserve;
+        reserve = 0;
+        if (fuel < 0) TRAP(TRAP_FUEL);
+        if (__atomic_load_n(&g_epoch, __ATOMIC_RELAXED) >= inst->epoch_deadline) {
+            int stop = epoch_arm(inst);
+            if (stop == 1) {
+                inst->timed_out = 1;
+                TRAP(TRAP_DEADLINE);
+            }
+            if (stop == 2) goto suspend;
+        }
+        if (fuel > EPOCH_CHECK_UNITS) {
+            reserve = fuel - EPOCH_CHECK_UNITS;
+            fuel = EPOCH_CHECK_UNITS;
+        }
+    }
+
+suspend:
+    inst->suspended_func = func;
+    inst->suspended_ip = ip;
+    inst->suspended_fp = fp;
+    inst->suspended_sp = sp;
+    inst->suspended_depth = depth;
+    inst->fuel = fuel + reserve;
+    return 2;
+done:
+    inst->fuel = fuel + reserve;
+    return 0;
+trap:
+    snprintf(inst->trap, sizeof(inst->trap), "%s", trap_msg);
+host_trap:
+    inst->fuel = fuel + reserve;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Instances
+// ---------------------------------------------------------------------------
+
+// Run or resume a call under the limits set on the instance. A call that
+// used up its slice returns successfully with the instance suspended.
+static wasmify_error_t run_call(wasmify_engine_instance_t* inst, uint32_t func_index, int resume, char* err, size_t err_size) {
+    inst->memory_from_image = 0;
+    inst->exited = 0;
+    inst->timed_out = 0;
+    inst->suspended = 0;
+
+    int rc;
+    if (inst->deadline_at > 0 || inst->slice_ms > 0) {
+        epoch_enter();
+        inst->slice_end = inst->slice_ms > 0 ? epoch_now_ms() + inst->slice_ms : 0;
+        if (epoch_arm(inst) == 1) {
+            inst->timed_out = 1;
+            snprintf(inst->trap, sizeof(inst->trap), "%s", TRAP_DEADLINE);
+            rc = 1;
+        } else {
+            rc = interp(inst, func_index, resume);
+        }
+        epoch_leave();
+    } else {
+        inst->epoch_deadline = UINT64_MAX;
+        rc = interp(inst, func_index, resume);
+    }
+
+    if (rc == 0) return WASMIFY_SUCCESS;
+    if (rc == 2) {
+        inst->suspended = 1;
+        return WASMIFY_SUCCESS;
+    }
+    if (inst->exited) {
+        if (inst->exit_code == 0) return WASMIFY_SUCCESS;
+        set_error(err, err_size, "exit status %d", inst->exit_code);
+    } else {
+        set_error(err, err_size, "trap: %s", inst->trap);
+    }
+    return inst->timed_out ? WASMIFY_ERROR_TIMEOUT : WASMIFY_ERROR_EXECUTION;
+}
+
+// Pages a memory of module starts with and may grow to under config
+static wasmify_error_t memory_limits(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    uint32_t* initial_pages,
+    uint32_t* max_pages,
+    char* err,
+    size_t err_size
+) {
+    *max_pages = module->memory_max;
+    if (config && config->max_pages && config->max_pages < *max_pages) *max_pages = config->max_pages;
+    if (module->memory_min > *max_pages) {
+        set_error(err, err_size, "memory minimum of %u pages exceeds the limit of %u", module->memory_min, *max_pages);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    *initial_pages = module->memory_min;
+    if (config && config->min_pages > *initial_pages) {
+        *initial_pages = config->min_pages < *max_pages ? config->min_pages : *max_pages;
+    }
+    return WASMIFY_SUCCESS;
+}
+
+static wasmify_engine_memory_t* shared_memory_new(uint32_t initial_pages, uint32_t max_pages) {
+    wasmify_engine_memory_t* memory = calloc(1, sizeof(wasmify_engine_memory_t));
+    if (!memory) return NULL;
+    memory->max_pages = max_pages;
+    memory->reserved = (size_t)max_pages * WASMIFY_ENGINE_PAGE_SIZE;
+    memory->refs = 1;
+    pthread_mutex_init(&memory->lock, NULL);
+    if (memory->reserved) {
+        // Other threads access it unlocked, so it can never move
+        void* p = mmap(NULL, memory->reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            pthread_mutex_destroy(&memory->lock);
+            free(memory);
+            return NULL;
+        }
+        memory->base = p;
+    }
+    uint64_t size = (uint64_t)initial_pages * WASMIFY_ENGINE_PAGE_SIZE;
+    if (!memory_commit(memory->base, &memory->committed, size)) {
+        wasmify_engine_memory_release(memory);
+        return NULL;
+    }
+    memory->size = size;
+    return memory;
+}
+
+wasmify_error_t wasmify_engine_memory_create(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_memory_t** memory,
+    char* err,
+    size_t err_size
+) {
+    if (!module || !memory) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *memory = NULL;
+    if (!module->has_memory || !module->memory_shared) {
+        set_error(err, err_size, "module has no shared memory");
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    uint32_t initial_pages, max_pages;
+    wasmify_error_t error = memory_limits(module, config, &initial_pages, &max_pages, err, err_size);
+    if (error != WASMIFY_SUCCESS) return error;
+    *memory = shared_memory_new(initial_pages, max_pages);
+    return *memory ? WASMIFY_SUCCESS : WASMIFY_ERROR_MEMORY;
+}
+
+void wasmify_engine_memory_retain(wasmify_engine_memory_t* memory) {
+    if (memory) __atomic_add_fetch(&memory->refs, 1, __ATOMIC_RELAXED);
+}
+
+void wasmify_engine_memory_release(wasmify_engine_memory_t* memory) {
+    if (!memory || __atomic_sub_fetch(&memory->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    if (memory->base) munmap(memory->base, memory->reserved);
+    pthread_mutex_destroy(&memory->lock);
+    free(memory);
+}
+
+// Allocate an instance of module with its imports resolved and its memory
+// reserved, or set to the shared memory it uses. Its own memory and tables
+// are left empty for the caller to fill in.
+static wasmify_error_t instance_new(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_instance_t** instance,
+    uint32_t* initial_pages,
+    char* err,
+    size_t err_size
+) {
+    *instance = NULL;
+    *initial_pages = 0;
+    pthread_once(&g_simd_once, simd_init);
+
+    wasmify_engine_instance_t* inst = calloc(1, sizeof(wasmify_engine_instance_t));
+    if (!inst) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    inst->module = module;
+    inst->fuel = INT64_MAX;
+    inst->stack_slots = config && config->stack_slots ? config->stack_slots : DEFAULT_STACK_SLOTS;
+    inst->frame_cap = config && config->call_depth ? config->call_depth : DEFAULT_CALL_DEPTH;
+    inst->stack = malloc((size_t)inst->stack_slots * sizeof(uint64_t));
+    inst->frames = malloc(((size_t)inst->frame_cap + 1) * sizeof(frame_t));
+    inst->globals = calloc(module->global_slots ? module->global_slots : 1, sizeof(uint64_t));
+    inst->tables = calloc(module->table_count ? module->table_count : 1, sizeof(table_inst_t));
+    inst->host_funcs = calloc(module->import_func_count ? module->import_func_count : 1, sizeof(host_func_t));
+    inst->data_dropped = calloc(module->data_count ? module->data_count : 1, 1);
+    inst->elem_dropped = calloc(module->elem_count ? module->elem_count : 1, 1);
+    if (!inst->stack || !inst->frames || !inst->globals || !inst->tables || !inst->host_funcs ||
+        !inst->data_dropped || !inst->elem_dropped) {
+        wasmify_engine_instance_free(inst);
+        return WASMIFY_ERROR_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < module->import_func_count; i++) {
+        inst->host_funcs[i] = resolve_import(module, &module->funcs[i]);
+    }
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        inst->tables[i].max = module->tables[i].max;
+    }
+
+    if (module->has_memory) {
+        uint32_t max_pages;
+        wasmify_error_t error = memory_limits(module, config, initial_pages, &max_pages, err, err_size);
+        wasmify_engine_memory_t* shared = config ? config->memory : NULL;
+        if (error == WASMIFY_SUCCESS && shared && !module->memory_shared) {
+            set_error(err, err_size, "module memory is not shared");
+            error = WASMIFY_ERROR_INVALID_PARAM;
+        } else if (error == WASMIFY_SUCCESS && shared) {
+            if (shared->size / WASMIFY_ENGINE_PAGE_SIZE < module->memory_min || shared->max_pages > module->memory_max) {
+                set_error(err, err_size, "incompatible shared memory");
+                error = WASMIFY_ERROR_INVALID_PARAM;
+            } else {
+                wasmify_engine_memory_retain(shared);
+            }
+        } else if (error == WASMIFY_SUCCESS && module->memory_shared) {
+            shared = shared_memory_new(*initial_pages, max_pages);
+            if (!shared) error = WASMIFY_ERROR_MEMORY;
+        }
+        if (error != WASMIFY_SUCCESS) {
+            wasmify_engine_instance_free(inst);
+            return error;
+        }
+        if (shared) {
+            inst->shared = shared;
+            inst->memory = shared->base;
+            inst->memory_max_pages = shared->max_pages;
+            memory_sync(inst, NULL);
+        } else {
+            inst->memory_max_pages = max_pages;
+            inst->memory_reserved = (size_t)max_pages * WASMIFY_ENGINE_PAGE_SIZE;
+            if (inst->memory_reserved) {
+                // Reserve the whole range up front so the base never moves on grow
+                void* p = mmap(NULL, inst->memory_reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (p == MAP_FAILED) {
+                    inst->memory_reserved = 0;
+                    wasmify_engine_instance_free(inst);
+                    return WASMIFY_ERROR_MEMORY;
+                }
+                inst->memory = p;
+            }
+        }
+    }
+
+    *instance = inst;
+    return WASMIFY_SUCCESS;
+}
+
+wasmify_error_t wasmify_engine_instantiate(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+) {
+    if (!module || !instance) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *instance = NULL;
+
+    wasmify_engine_instance_t* inst;
+    uint32_t initial_pages;
+    wasmify_error_t error = instance_new(module, config, &inst, &initial_pages, err, err_size);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        const global_t* g = &module->globals[i];
+        uint64_t* slot = inst->globals + g->slot;
+        if (g->type != WASMIFY_TYPE_V128) {
+            *slot = eval_const(inst, &g->init);
+        } else if (g->init.kind == CONST_GLOBAL) {
+            memcpy(slot, inst->globals + module->globals[g->init.value].slot, 2 * sizeof(uint64_t));
+        } else {
+            slot[0] = g->init.value;
+            slot[1] = g->init.high;
+        }
+    }
+
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        if (!table_grow(&inst->tables[i], module->tables[i].min, 0)) {
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_MEMORY;
+        }
+    }
+    if (!inst->shared && memory_grow(inst, initial_pages) == UINT32_MAX) {
+        wasmify_engine_instance_free(inst);
+        return WASMIFY_ERROR_MEMORY;
+    }
+
+    for (uint32_t i = 0; i < module->elem_count; i++) {
+        const elem_t* e = &module->elems[i];
+        if (e->mode == SEGMENT_PASSIVE) continue;
+        inst->elem_dropped[i] = 1;
+        if (e->mode != SEGMENT_ACTIVE) continue;
+        table_inst_t* t = &inst->tables[e->table];
+        uint64_t offset = (uint32_t)eval_const(inst, &e->offset);
+        if (offset + e->count > t->size) {
+            set_error(err, err_size, "instantiation failed: %s", TRAP_OOB_TABLE);
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_EXECUTION;
+        }
+        for (uint32_t j = 0; j < e->count; j++) t->elems[offset + j] = eval_const(inst, &e->items[j]);
+    }
+
+    for (uint32_t i = 0; i < module->data_count; i++) {
+        const data_t* d = &module->datas[i];
+        if (d->mode != SEGMENT_ACTIVE) continue;
+        inst->data_dropped[i] = 1;
+        uint64_t offset = (uint32_t)eval_const(inst, &d->offset);
+        if (offset + d->size > inst->memory_size) {
+            set_error(err, err_size, "instantiation failed: %s", TRAP_OOB_MEMORY);
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_EXECUTION;
+        }
+        if (d->size) memcpy(inst->memory + offset, d->bytes, d->size);
+    }
+
+    if (module->start != NO_INDEX) {
+        error = run_call(inst, module->start, 0, err, err_size);
+        if (error != WASMIFY_SUCCESS) {
+            wasmify_engine_instance_free(inst);
+            return error;
+        }
+    }
+
+    *instance = inst;
+    return WASMIFY_SUCCESS;
+}
+
+static void snapshot_free(wasmify_engine_instance_t* inst) {
+    if (inst->snap_tables) {
+        for (uint32_t i = 0; i < inst->module->table_count; i++) free(inst->snap_tables[i].elems);
+        free(inst->snap_tables);
+    }
+    free(inst->snap_memory);
+    free(inst->snap_globals);
+    free(inst->snap_data_dropped);
+    free(inst->snap_elem_dropped);
+    inst->snap_memory = NULL;
+    inst->snap_globals = NULL;
+    inst->snap_tables = NULL;
+    inst->snap_data_dropped = NULL;
+    inst->snap_elem_dropped = NULL;
+    inst->has_snapshot = 0;
+}
+
+// A memfd holding a copy of data, -1 where there are none
+static int memfd_copy(const char* name, const uint8_t* data, size_t size) {
+#ifdef MFD_CLOEXEC
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    size_t done = 0;
+    int ok = ftruncate(fd, (off_t)size) == 0;
+    while (ok && done < size) {
+        ssize_t n = pwrite(fd, data + done, size - done, (off_t)done);
+        if (n <= 0) ok = 0;
+        else done += (size_t)n;
+    }
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)name;
+    (void)data;
+    (void)size;
+    return -1;
+#endif
+}
+
+// Back the current memory contents with a memfd mapped privately over the
+// reservation. Writes then copy-on-write, and MADV_DONTNEED drops those
+// private pages so the next access sees the snapshot again.
+static int snapshot_map_memory(wasmify_engine_instance_t* inst) {
+    size_t size = (size_t)inst->memory_size;
+    int fd = memfd_copy("wasmify-snapshot", inst->memory, size);
+    if (fd < 0) return 0;
+    void* p = mmap(inst->memory, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+    return p != MAP_FAILED;
+}
+
+wasmify_error_t wasmify_engine_instance_snapshot(wasmify_engine_instance_t* instance) {
+    if (!instance) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    wasmify_engine_instance_t* inst = instance;
+    const wasmify_engine_module_t* module = inst->module;
+    snapshot_free(inst);
+
+    inst->snap_globals = malloc((module->global_slots ? module->global_slots : 1) * sizeof(uint64_t));
+    inst->snap_tables = calloc(module->table_count ? module->table_count : 1, sizeof(table_inst_t));
+    inst->snap_data_dropped = malloc(module->data_count ? module->data_count : 1);
+    inst->snap_elem_dropped = malloc(module->elem_count ? module->elem_count : 1);
+    if (!inst->snap_globals || !inst->snap_tables || !inst->snap_data_dropped || !inst->snap_elem_dropped) {
+        snapshot_free(inst);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    memcpy(inst->snap_globals, inst->globals, module->global_slots * sizeof(uint64_t));
+    memcpy(inst->snap_data_dropped, inst->data_dropped, module->data_count);
+    memcpy(inst->snap_elem_dropped, inst->elem_dropped, module->elem_count);
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        const table_inst_t* t = &inst->tables[i];
+        table_inst_t* snap = &inst->snap_tables[i];
+        snap->size = t->size;
+        snap->max = t->max;
+        if (t->size) {
+            snap->elems = malloc((size_t)t->size * sizeof(uint64_t));
+            if (!snap->elems) {
+                snapshot_free(inst);
+                return WASMIFY_ERROR_MEMORY;
+            }
+            memcpy(snap->elems, t->elems, (size_t)t->size * sizeof(uint64_t));
+        }
+    }
+
+    // A shared memory belongs to every instance using it, not to this one's state.
+    // Memory still mapped from an image is already file-backed.
+    inst->snap_pages = inst->shared ? 0 : inst->memory_pages;
+    if (inst->memory_size && !inst->shared && !inst->memory_from_image && !snapshot_map_memory(inst)) {
+        inst->snap_memory = malloc((size_t)inst->memory_size);
+        if (!inst->snap_memory) {
+            snapshot_free(inst);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        memcpy(inst->snap_memory, inst->memory, (size_t)inst->memory_size);
+    }
+
+    inst->has_snapshot = 1;
+    return WASMIFY_SUCCESS;
+}
+
+wasmify_error_t wasmify_engine_instance_reset(wasmify_engine_instance_t* instance) {
+    if (!instance || !instance->has_snapshot) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    wasmify_engine_instance_t* inst = instance;
+    const wasmify_engine_module_t* module = inst->module;
+    size_t snap_size = (size_t)inst->snap_pages * WASMIFY_ENGINE_PAGE_SIZE;
+
+    if (!inst->shared && inst->memory_size > snap_size) {
+        // Accesses are bounds-checked against memory_size, so pages grown since
+        // the snapshot stay read-write and only need their contents dropped
+        if (madvise(inst->memory + snap_size, (size_t)inst->memory_size - snap_size, MADV_DONTNEED) != 0) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+        inst->memory_pages = inst->snap_pages;
+        inst->memory_size = snap_size;
+    }
+    if (!inst->shared && snap_size) {
+        if (inst->snap_memory) {
+            memcpy(inst->memory, inst->snap_memory, snap_size);
+        } else if (madvise(inst->memory, snap_size, MADV_DONTNEED) != 0) {
+            return WASMIFY_ERROR_MEMORY;
+        }
+    }
+
+    memcpy(inst->globals, inst->snap_globals, module->global_slots * sizeof(uint64_t));
+    memcpy(inst->data_dropped, inst->snap_data_dropped, module->data_count);
+    memcpy(inst->elem_dropped, inst->snap_elem_dropped, module->elem_count);
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        // Tables never shrink, so the live array always has room for the snapshot
+        table_inst_t* t = &inst->tables[i];
+        const table_inst_t* snap = &inst->snap_tables[i];
+        if (snap->size) memcpy(t->elems, snap->elems, (size_t)snap->size * sizeof(uint64_t));
+        t->size = snap->size;
+    }
+    inst->exited = 0;
+    inst->exit_code = 0;
+    inst->suspended = 0;
+    return WASMIFY_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Images: the state of an initialized instance, for new instances to start
+// from instead of running initialization again. Memory lives in a file, a
+// memfd or an image file from disk, that each instance maps privately, so it
+// only copies the pages it writes.
+// ---------------------------------------------------------------------------
+
+#define IMAGE_MAGIC "WMFYIMG1"
+// Memory starts on a page of its own in an image file so it can be mapped in place
+#define IMAGE_ALIGN WASMIFY_ENGINE_PAGE_SIZE
+
+struct wasmify_engine_image {
+    const wasmify_engine_module_t* module;
+    uint32_t pages;
+    int fd;                  // Holds the memory at offset, -1 = in copy
+    uint64_t offset;
+    uint8_t* copy;
+    uint64_t* globals;
+    table_inst_t* tables;
+    uint8_t* data_dropped;
+    uint8_t* elem_dropped;
+};
+
+// An image with everything but its memory allocated
+static wasmify_engine_image_t* image_new(const wasmify_engine_module_t* module) {
+    wasmify_engine_image_t* image = calloc(1, sizeof(wasmify_engine_image_t));
+    if (!image) return NULL;
+    image->module = module;
+    image->fd = -1;
+    image->globals = calloc(module->global_slots ? module->global_slots : 1, sizeof(uint64_t));
+    image->tables = calloc(module->table_count ? module->table_count : 1, sizeof(table_inst_t));
+    image->data_dropped = calloc(module->data_count ? module->data_count : 1, 1);
+    image->elem_dropped = calloc(module->elem_count ? module->elem_count : 1, 1);
+    if (!image->globals || !image->tables || !image->data_dropped || !image->elem_dropped) {
+        wasmify_engine_image_free(image);
+        return NULL;
+    }
+    return image;
+}
+
+wasmify_error_t wasmify_engine_image_capture(
+    const wasmify_engine_instance_t* instance,
+    wasmify_engine_image_t** image
+) {
+    if (!instance || !image || instance->shared || instance->suspended) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *image = NULL;
+
+    const wasmify_engine_module_t* module = instance->module;
+    wasmify_engine_image_t* img = image_new(module);
+    if (!img) {
+        return WASMIFY_ERROR_MEMORY;
+    }
+    memcpy(img->globals, instance->globals, module->global_slots * sizeof(uint64_t));
+    memcpy(img->data_dropped, instance->data_dropped, module->data_count);
+    memcpy(img->elem_dropped, instance->elem_dropped, module->elem_count);
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        const table_inst_t* t = &instance->tables[i];
+        img->tables[i].max = t->max;
+        if (!table_grow(&img->tables[i], t->size, 0)) {
+            wasmify_engine_image_free(img);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        if (t->size) memcpy(img->tables[i].elems, t->elems, (size_t)t->size * sizeof(uint64_t));
+    }
+
+    img->pages = instance->memory_pages;
+    size_t size = (size_t)instance->memory_size;
+    if (size) {
+        img->fd = memfd_copy("wasmify-image", instance->memory, size);
+        if (img->fd < 0) {
+            img->copy = malloc(size);
+            if (!img->copy) {
+                wasmify_engine_image_free(img);
+                return WASMIFY_ERROR_MEMORY;
+            }
+            memcpy(img->copy, instance->memory, size);
+        }
+    }
+
+    *image = img;
+    return WASMIFY_SUCCESS;
+}
+
+wasmify_error_t wasmify_engine_instantiate_image(
+    const wasmify_engine_image_t* image,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+) {
+    if (!image || !instance || (config && config->memory)) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *instance = NULL;
+
+    const wasmify_engine_module_t* module = image->module;
+    wasmify_engine_instance_t* inst;
+    uint32_t initial_pages;
+    wasmify_error_t error = instance_new(module, config, &inst, &initial_pages, err, err_size);
+    if (error != WASMIFY_SUCCESS) {
+        return error;
+    }
+
+    memcpy(inst->globals, image->globals, module->global_slots * sizeof(uint64_t));
+    memcpy(inst->data_dropped, image->data_dropped, module->data_count);
+    memcpy(inst->elem_dropped, image->elem_dropped, module->elem_count);
+    for (uint32_t i = 0; i < module->table_count; i++) {
+        const table_inst_t* t = &image->tables[i];
+        if (!table_grow(&inst->tables[i], t->size, 0)) {
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        if (t->size) memcpy(inst->tables[i].elems, t->elems, (size_t)t->size * sizeof(uint64_t));
+    }
+
+    if (image->pages > inst->memory_max_pages) {
+        set_error(err, err_size, "image memory exceeds %u pages", inst->memory_max_pages);
+        wasmify_engine_instance_free(inst);
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    size_t size = (size_t)image->pages * WASMIFY_ENGINE_PAGE_SIZE;
+    if (size && image->fd >= 0) {
+        void* p = mmap(inst->memory, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, image->fd, (off_t)image->offset);
+        if (p == MAP_FAILED) {
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        inst->memory_committed = size;
+        inst->memory_pages = image->pages;
+        inst->memory_size = size;
+        inst->memory_from_image = 1;
+    } else if (size) {
+        if (memory_grow(inst, image->pages) == UINT32_MAX) {
+            wasmify_engine_instance_free(inst);
+            return WASMIFY_ERROR_MEMORY;
+        }
+        memcpy(inst->memory, image->copy, size);
+    }
+    if (initial_pages > inst->memory_pages && memory_grow(inst, initial_pages - inst->memory_pages) == UINT32_MAX) {
+        wasmify_engine_instance_free(inst);
+        return WASMIFY_ERROR_MEMORY;
+    }
+
+    *instance = inst;
+    return WASMIFY_SUCCESS;
+}
+
+static int write_all(int fd, const void* data, size_t size) {
+    const uint8_t* p = data;
+    while (size) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+wasmify_error_t wasmify_engine_image_save(const wasmify_engine_image_t* image, int fd) {
+    if (!image || fd < 0) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    const wasmify_engine_module_t* m = image->module;
+    art_writer_t w = {0};
+    art_put(&w, IMAGE_MAGIC, 8);
+    art_string(&w, WASMIFY_ENGINE_NAME "/" WASMIFY_ENGINE_VERSION);
+    art_string(&w, wasmify_engine_target());
+    art_u32(&w, m->global_slots);
+    art_u32(&w, m->table_count);
+    art_u32(&w, m->data_count);
+    art_u32(&w, m->elem_count);
+    art_u32(&w, image->pages);
+    art_array(&w, image->globals, m->global_slots, sizeof(uint64_t));
+    for (uint32_t i = 0; i < m->table_count; i++) {
+        art_u32(&w, image->tables[i].max);
+        art_array(&w, image->tables[i].elems, image->tables[i].size, sizeof(uint64_t));
+    }
+    art_put(&w, image->data_dropped, m->data_count);
+    art_put(&w, image->elem_dropped, m->elem_count);
+    size_t pad = (IMAGE_ALIGN - w.size % IMAGE_ALIGN) % IMAGE_ALIGN;
+    while (pad--) art_u8(&w, 0);
+    if (w.failed) {
+        free(w.data);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    int ok = write_all(fd, w.data, w.size);
+    free(w.data);
+
+    size_t size = (size_t)image->pages * WASMIFY_ENGINE_PAGE_SIZE;
+    if (ok && size && image->fd >= 0) {
+        // Page by page, so saving never needs the whole memory in the heap
+        uint8_t* page = malloc(WASMIFY_ENGINE_PAGE_SIZE);
+        if (!page) return WASMIFY_ERROR_MEMORY;
+        for (size_t done = 0; ok && done < size; done += WASMIFY_ENGINE_PAGE_SIZE) {
+            ok = pread(image->fd, page, WASMIFY_ENGINE_PAGE_SIZE, (off_t)(image->offset + done)) == WASMIFY_ENGINE_PAGE_SIZE &&
+                 write_all(fd, page, WASMIFY_ENGINE_PAGE_SIZE);
+        }
+        free(page);
+    } else if (ok && size) {
+        ok = write_all(fd, image->copy, size);
+    }
+    return ok ? WASMIFY_SUCCESS : WASMIFY_ERROR_EXECUTION;
+}
+
+wasmify_error_t wasmify_engine_image_load(
+    const wasmify_engine_module_t* module,
+    int fd,
+    wasmify_engine_image_t** image,
+    char* err,
+    size_t err_size
+) {
+    if (!module || fd < 0 || !image) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+    *image = NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        set_error(err, err_size, "image is empty or unreadable");
+        return WASMIFY_ERROR_PARSE;
+    }
+    size_t file_size = (size_t)st.st_size;
+    uint8_t* bytes = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (bytes == MAP_FAILED) {
+        set_error(err, err_size, "image is empty or unreadable");
+        return WASMIFY_ERROR_PARSE;
+    }
+
+    art_reader_t r = {bytes, bytes, bytes + file_size, 0};
+    const void* magic = art_take(&r, 8);
+    if (!magic || memcmp(magic, IMAGE_MAGIC, 8) != 0 ||
+        !art_read_matches(&r, WASMIFY_ENGINE_NAME "/" WASMIFY_ENGINE_VERSION) ||
+        !art_read_matches(&r, wasmify_engine_target())) {
+        munmap(bytes, file_size);
+        set_error(err, err_size, "image is from another engine build or host");
+        return WASMIFY_ERROR_PARSE;
+    }
+    uint32_t global_slots = art_read_u32(&r);
+    uint32_t table_count = art_read_u32(&r);
+    uint32_t data_count = art_read_u32(&r);
+    uint32_t elem_count = art_read_u32(&r);
+    uint32_t pages = art_read_u32(&r);
+    if (r.failed || global_slots != module->global_slots || table_count != module->table_count ||
+        data_count != module->data_count || elem_count != module->elem_count) {
+        munmap(bytes, file_size);
+        set_error(err, err_size, "image is of another module");
+        return WASMIFY_ERROR_PARSE;
+    }
+
+    wasmify_engine_image_t* img = image_new(module);
+    if (!img) {
+        munmap(bytes, file_size);
+        return WASMIFY_ERROR_MEMORY;
+    }
+    img->pages = pages;
+    uint32_t count;
+    const void* globals = art_read_array(&r, &count, sizeof(uint64_t));
+    if (globals && count == global_slots) memcpy(img->globals, globals, (size_t)count * sizeof(uint64_t));
+    else r.failed = 1;
+    for (uint32_t i = 0; i < table_count && !r.failed; i++) {
+        table_inst_t* t = &img->tables[i];
+        t->max = art_read_u32(&r);
+        const uint64_t* elems = art_read_array(&r, &count, sizeof(uint64_t));
+        if (!elems || !table_grow(t, count, 0)) {
+            r.failed = 1;
+            break;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+            // Function references are indices plus one, so they are checked before any call follows them
+            if (module->tables[i].elem_type == WASMIFY_TYPE_FUNCREF && elems[j] > module->func_count) r.failed = 1;
+            t->elems[j] = elems[j];
+        }
+    }
+    const void* dropped = art_take(&r, data_count);
+    if (dropped) memcpy(img->data_dropped, dropped, data_count);
+    dropped = art_take(&r, elem_count);
+    if (dropped) memcpy(img->elem_dropped, dropped, elem_count);
+    img->offset = ((size_t)(r.p - r.base) + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+    munmap(bytes, file_size);
+
+    if (r.failed || img->offset + (uint64_t)pages * WASMIFY_ENGINE_PAGE_SIZE > file_size) {
+        wasmify_engine_image_free(img);
+        set_error(err, err_size, "image is truncated or corrupt");
+        return WASMIFY_ERROR_PARSE;
+    }
+    if (pages) {
+        img->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (img->fd < 0) {
+            wasmify_engine_image_free(img);
+            return WASMIFY_ERROR_MEMORY;
+        }
+    }
+
+    *image = img;
+    return WASMIFY_SUCCESS;
+}
+
+void wasmify_engine_image_free(wasmify_engine_image_t* image) {
+    if (!image) return;
+
+    // Instances map the file themselves, so they keep it alive past this close
+    if (image->fd >= 0) close(image->fd);
+    if (image->tables) {
+        for (uint32_t i = 0; i < image->module->table_count; i++) free(image->tables[i].elems);
+        free(image->tables);
+    }
+    free(image->copy);
+    free(image->globals);
+    free(image->data_dropped);
+    free(image->elem_dropped);
+    free(image);
+}
+
+void wasmify_engine_instance_free(wasmify_engine_instance_t* instance) {
+    if (!instance) return;
+
+    snapshot_free(instance);
+    if (instance->shared) wasmify_engine_memory_release(instance->shared);
+    else if (instance->memory) munmap(instance->memory, instance->memory_reserved);
+    if (instance->tables) {
+        for (uint32_t i = 0; i < instance->module->table_count; i++) free(instance->tables[i].elems);
+        free(instance->tables);
+    }
+    free(instance->globals);
+    free(instance->host_funcs);
+    free(instance->data_dropped);
+    free(instance->elem_dropped);
+    free(instance->stack);
+    free(instance->frames);
+    free(instance);
+}
+
+// Hand out the results of a call that has returned
+static void call_results(const wasmify_engine_instance_t* instance, uint32_t func_index, uint64_t* results) {
+    const functype_t* ft = &instance->module->types[instance->module->funcs[func_index].type];
+    if (instance->exited) {
+        memset(results, 0, ft->result_slots * sizeof(uint64_t));
+    } else if (ft->result_slots) {
+        memcpy(results, instance->stack, ft->result_slots * sizeof(uint64_t));
+    }
+}
+
+wasmify_error_t wasmify_engine_call(
+    wasmify_engine_instance_t* instance,
+    uint32_t func_index,
+    const uint64_t* args,
+    uint64_t* results,
+    char* err,
+    size_t err_size
+) {
+    return wasmify_engine_call_limited(instance, func_index, args, results, NULL, err, err_size);
+}
+
+wasmify_error_t wasmify_engine_call_limited(
+    wasmify_engine_instance_t* instance,
+    uint32_t func_index,
+    const uint64_t* args,
+    uint64_t* results,
+    const wasmify_limits_t* limits,
+    char* err,
+    size_t err_size
+) {
+    if (!instance || func_index >= instance->module->func_count) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    const functype_t* ft = &instance->module->types[instance->module->funcs[func_index].type];
+    if (ft->param_slots > instance->stack_slots || ft->result_slots > instance->stack_slots) {
+        set_error(err, err_size, "trap: %s", TRAP_STACK);
+        return WASMIFY_ERROR_EXECUTION;
+    }
+    if (ft->param_slots) memcpy(instance->stack, args, ft->param_slots * sizeof(uint64_t));
+
+    instance->fuel = limits && limits->fuel > 0 && limits->fuel < (uint64_t)INT64_MAX ? (int64_t)limits->fuel : INT64_MAX;
+    instance->deadline_at = limits && limits->deadline_ms > 0 ? epoch_now_ms() + limits->deadline_ms : 0;
+    instance->slice_ms = limits ? limits->slice_ms : 0;
+    instance->call_index = func_index;
+    wasmify_error_t error = run_call(instance, func_index, 0, err, err_size);
+    if (error == WASMIFY_SUCCESS && !instance->suspended) {
+        call_results(instance, func_index, results);
+    }
+    return error;
+}
+
+wasmify_error_t wasmify_engine_resume(
+    wasmify_engine_instance_t* instance,
+    uint64_t* results,
+    char* err,
+    size_t err_size
+) {
+    if (!instance || !instance->suspended) {
+        return WASMIFY_ERROR_INVALID_PARAM;
+    }
+
+    wasmify_error_t error = run_call(instance, instance->call_index, 1, err, err_size);
+    if (error == WASMIFY_SUCCESS && !instance->suspended) {
+        call_results(instance, instance->call_index, results);
+    }
+    return error;
+}
+
+int wasmify_engine_suspended(const wasmify_engine_instance_t* instance) {
+    return instance ? instance->suspended : 0;
+}
+
+size_t wasmify_engine_memory_size(const wasmify_engine_instance_t* instance) {
+    if (!instance) return 0;
+    if (instance->shared) return (size_t)__atomic_load_n(&instance->shared->size, __ATOMIC_ACQUIRE);
+    return (size_t)instance->memory_size;
+}
+
+uint8_t* wasmify_engine_memory(wasmify_engine_instance_t* instance) {
+    if (!instance) return NULL;
+    // The caller may write through it
+    instance->memory_from_image = 0;
+    return instance->memory;
+}
+
+uint32_t wasmify_engine_memory_grow(wasmify_engine_instance_t* instance, uint32_t pages) {
+    if (!instance || !instance->module->has_memory) return UINT32_MAX;
+    return memory_grow(instance, pages);
+}
+
+size_t wasmify_engine_module_size(const wasmify_engine_module_t* module) {
+    if (!module) return 0;
+
+    size_t size = sizeof(*module);
+    for (uint32_t i = 0; i < module->type_count; i++) {
+        size += sizeof(functype_t) + module->types[i].param_count + module->types[i].result_count;
+    }
+    for (uint32_t i = 0; i < module->func_count; i++) {
+        const func_t* f = &module->funcs[i];
+        size += sizeof(func_t) + (size_t)f->code_len * sizeof(insn_t) + (size_t)f->branch_count * sizeof(branch_t);
+    }
+    size += (size_t)module->table_count * sizeof(table_t);
+    size += (size_t)module->global_count * sizeof(global_t);
+    for (uint32_t i = 0; i < module->export_count; i++) {
+        size += sizeof(export_t) + strlen(module->exports[i].name) + 1;
+    }
+    for (uint32_t i = 0; i < module->elem_count; i++) {
+        size += sizeof(elem_t) + (size_t)module->elems[i].count * sizeof(const_expr_t);
+    }
+    for (uint32_t i = 0; i < module->data_count; i++) {
+        size += sizeof(data_t) + module->datas[i].size;
+    }
+    return size;
+}
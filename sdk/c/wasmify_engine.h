@@ -0,0 +1,389 @@
+/*
+ * Wasmify C SDK - Embedded execution engine
+ * Internal interface between the SDK and the in-process WebAssembly engine
+ */
+
+#ifndef WASMIFY_ENGINE_H
+#define WASMIFY_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wasmify.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Engine backend selection. The built-in interpreter is the only backend
+// shipped with the SDK; others plug in behind this same interface.
+#if !defined(WASMIFY_ENGINE_INTERP)
+#define WASMIFY_ENGINE_INTERP 1
+#endif
+
+#define WASMIFY_ENGINE_NAME "wasmify-interp"
+#define WASMIFY_ENGINE_VERSION "2"
+
+#define WASMIFY_ENGINE_PAGE_SIZE 65536u
+#define WASMIFY_ENGINE_MAX_PAGES 65536u
+
+// Value types as encoded in the binary format
+typedef enum {
+    WASMIFY_TYPE_I32 = 0x7F,
+    WASMIFY_TYPE_I64 = 0x7E,
+    WASMIFY_TYPE_F32 = 0x7D,
+    WASMIFY_TYPE_F64 = 0x7C,
+    WASMIFY_TYPE_V128 = 0x7B,
+    WASMIFY_TYPE_FUNCREF = 0x70,
+    WASMIFY_TYPE_EXTERNREF = 0x6F
+} wasmify_valtype_t;
+
+typedef struct wasmify_engine_module wasmify_engine_module_t;
+typedef struct wasmify_engine_instance wasmify_engine_instance_t;
+typedef struct wasmify_engine_memory wasmify_engine_memory_t;
+typedef struct wasmify_engine_image wasmify_engine_image_t;
+
+// Instance limits
+typedef struct {
+    uint32_t min_pages;     // Initial linear memory pages, 0 = module minimum
+    uint32_t max_pages;     // Cap on linear memory pages, 0 = module limit
+    uint32_t stack_slots;   // Value stack size in 64-bit slots, 0 = default
+    uint32_t call_depth;    // Maximum call depth, 0 = default
+    wasmify_engine_memory_t* memory; // Shared memory to use, NULL = its own
+} wasmify_engine_config_t;
+
+// Exported function signature
+typedef struct {
+    uint32_t param_count;
+    uint32_t result_count;
+    const uint8_t* params;
+    const uint8_t* results;
+} wasmify_engine_functype_t;
+
+/**
+ * Decode, validate and lower a module for the interpreter
+ * @param bytes Module binary
+ * @param size Size of the binary in bytes
+ * @param module Output compiled module
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_compile(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_engine_module_t** module,
+    char* err,
+    size_t err_size
+);
+
+// Called with an artifact once the module loaded from it is freed
+typedef void (*wasmify_engine_release_t)(const uint8_t* bytes, size_t size);
+
+/**
+ * Describe the host artifacts are built for
+ * Architecture, byte order, pointer width and the CPU features an engine
+ * build may rely on; artifacts only load where this string matches.
+ * @return Static string
+ */
+const char* wasmify_engine_target(void);
+
+/**
+ * Serialize a compiled module into an artifact that later processes load
+ * with wasmify_engine_deserialize instead of compiling the module again
+ * @param module Compiled module
+ * @param bytes Output artifact, release with free
+ * @param size Output artifact size
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_serialize(
+    const wasmify_engine_module_t* module,
+    uint8_t** bytes,
+    size_t* size
+);
+
+/**
+ * Load a compiled module from an artifact
+ * Instruction streams and data segments are used in place, so the artifact
+ * must stay valid, e.g. mapped, until the module is freed; release is then
+ * called with it. On failure release is not called. Artifacts are checked
+ * for truncation and for the engine build and target that wrote them, not
+ * validated again, so they must come from a trusted location.
+ * @param bytes Artifact, 8-byte aligned
+ * @param size Size of the artifact in bytes
+ * @param release Called when the module is freed, may be NULL
+ * @param module Output compiled module
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_deserialize(
+    const uint8_t* bytes,
+    size_t size,
+    wasmify_engine_release_t release,
+    wasmify_engine_module_t** module,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Free a compiled module; no instance of it may be alive
+ * @param module Compiled module
+ */
+void wasmify_engine_module_free(wasmify_engine_module_t* module);
+
+/**
+ * Instantiate a compiled module and run its start function
+ * @param module Compiled module
+ * @param config Instance limits, NULL for defaults
+ * @param instance Output instance
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_instantiate(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Free an instance and its linear memory
+ * A shared memory is only released, and outlives the instance while
+ * other instances or callers still hold it.
+ * @param instance Instance
+ */
+void wasmify_engine_instance_free(wasmify_engine_instance_t* instance);
+
+/**
+ * Create the linear memory a module declares shared, for several instances
+ * of it to use through wasmify_engine_config_t.memory at once. Instances of
+ * a module with a shared memory that aren't given one create their own.
+ * Shared memories are not part of instance snapshots.
+ * @param module Compiled module declaring a shared memory
+ * @param config Page limits, NULL for the module's
+ * @param memory Output memory, with one reference held by the caller
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_memory_create(
+    const wasmify_engine_module_t* module,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_memory_t** memory,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Take another reference to a shared memory
+ * @param memory Shared memory
+ */
+void wasmify_engine_memory_retain(wasmify_engine_memory_t* memory);
+
+/**
+ * Drop a reference to a shared memory, unmapping it with the last one
+ * @param memory Shared memory
+ */
+void wasmify_engine_memory_release(wasmify_engine_memory_t* memory);
+
+/**
+ * Record the instance's current state as its reset point
+ * Linear memory is backed copy-on-write by the snapshot where the platform
+ * allows it, so resetting only discards the pages written since.
+ * @param instance Instance
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_instance_snapshot(wasmify_engine_instance_t* instance);
+
+/**
+ * Restore memory, globals and tables to the last snapshot
+ * @param instance Instance with a snapshot
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_instance_reset(wasmify_engine_instance_t* instance);
+
+/**
+ * Capture an instance's memory, globals and tables as an image that new
+ * instances of its module start from, skipping data segments, element
+ * segments and the start function. The image must not outlive the module.
+ * @param instance Instance, not using a shared memory
+ * @param image Output image
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_image_capture(
+    const wasmify_engine_instance_t* instance,
+    wasmify_engine_image_t** image
+);
+
+/**
+ * Create an instance from an image
+ * Memory is mapped copy-on-write from the image where the platform allows
+ * it, so an instance only copies the pages it writes.
+ * @param image Image
+ * @param config Instance limits, NULL for defaults; memory must be NULL
+ * @param instance Output instance
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_instantiate_image(
+    const wasmify_engine_image_t* image,
+    const wasmify_engine_config_t* config,
+    wasmify_engine_instance_t** instance,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Write an image to a file, for wasmify_engine_image_load
+ * @param image Image
+ * @param fd File descriptor, written from its current position, which
+ *           should be the start of the file
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_image_save(const wasmify_engine_image_t* image, int fd);
+
+/**
+ * Load an image saved from an instance of the same module by this engine
+ * build. The file is trusted the way artifacts are: its layout is checked,
+ * but not that it is a state the module could reach. Memory is mapped from
+ * the file, which must not change while the image or its instances exist.
+ * @param module Compiled module
+ * @param fd File descriptor; the image keeps its own duplicate
+ * @param image Output image
+ * @param err Buffer receiving a message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_image_load(
+    const wasmify_engine_module_t* module,
+    int fd,
+    wasmify_engine_image_t** image,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Free an image; instances created from it stay valid
+ * @param image Image
+ */
+void wasmify_engine_image_free(wasmify_engine_image_t* image);
+
+/**
+ * Find an exported function
+ * @param module Compiled module
+ * @param name Export name
+ * @param func_index Output function index
+ * @param type Output signature, may be NULL
+ * @return 1 if found, 0 otherwise
+ */
+int wasmify_engine_find_func(
+    const wasmify_engine_module_t* module,
+    const char* name,
+    uint32_t* func_index,
+    wasmify_engine_functype_t* type
+);
+
+/**
+ * Call a function; arguments and results are one 64-bit slot per value,
+ * two for a v128, low half first
+ * @param instance Instance
+ * @param func_index Function index from wasmify_engine_find_func
+ * @param args Argument slots
+ * @param results Result slots
+ * @param err Buffer receiving the trap message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_call(
+    wasmify_engine_instance_t* instance,
+    uint32_t func_index,
+    const uint64_t* args,
+    uint64_t* results,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Call a function under execution limits. Fuel is charged at loop
+ * back-edges and calls, and the deadline and time slice are checked there
+ * too, so a function that never returns is still stopped. When the slice
+ * runs out, or the guest calls sched_yield during a sliced call, the call
+ * is suspended and returns success with wasmify_engine_suspended set.
+ * @param instance Instance
+ * @param func_index Function index from wasmify_engine_find_func
+ * @param args Argument slots
+ * @param results Result slots, written once the call returns
+ * @param limits Execution limits, NULL for none
+ * @param err Buffer receiving the trap message on failure
+ * @param err_size Size of err
+ * @return Error code, WASMIFY_ERROR_TIMEOUT past the deadline
+ */
+wasmify_error_t wasmify_engine_call_limited(
+    wasmify_engine_instance_t* instance,
+    uint32_t func_index,
+    const uint64_t* args,
+    uint64_t* results,
+    const wasmify_limits_t* limits,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Continue a suspended call for another time slice
+ * @param instance Instance with a suspended call
+ * @param results Result slots, written once the call returns
+ * @param err Buffer receiving the trap message on failure
+ * @param err_size Size of err
+ * @return Error code
+ */
+wasmify_error_t wasmify_engine_resume(
+    wasmify_engine_instance_t* instance,
+    uint64_t* results,
+    char* err,
+    size_t err_size
+);
+
+/**
+ * Whether the instance holds a suspended call
+ * @param instance Instance
+ * @return 1 if a call is suspended, 0 otherwise
+ */
+int wasmify_engine_suspended(const wasmify_engine_instance_t* instance);
+
+/**
+ * Current linear memory size in bytes
+ * @param instance Instance
+ * @return Size in bytes, 0 if the module has no memory
+ */
+size_t wasmify_engine_memory_size(const wasmify_engine_instance_t* instance);
+
+/**
+ * Base of linear memory; it never moves for the life of the instance
+ * @param instance Instance
+ * @return Base address, NULL if the module has no memory
+ */
+uint8_t* wasmify_engine_memory(wasmify_engine_instance_t* instance);
+
+/**
+ * Grow linear memory as memory.grow would
+ * @param instance Instance
+ * @param pages Pages to add
+ * @return Previous size in pages, UINT32_MAX if memory could not grow
+ */
+uint32_t wasmify_engine_memory_grow(wasmify_engine_instance_t* instance, uint32_t pages);
+
+/**
+ * Approximate heap footprint of a compiled module
+ * @param module Compiled module
+ * @return Size in bytes
+ */
+size_t wasmify_engine_module_size(const wasmify_engine_module_t* module);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WASMIFY_ENGINE_H
@@ -0,0 +1,1028 @@
+/*
+ * Wasmify C SDK tests
+ * Checks the behavior of the SDK's local execution, pipelines and result
+ * cache through its public API. Build from sdk/c with
+ *
+ *   cc -O2 -o wasmify_test wasmify_test.c wasmify.c wasmify_engine.c -lcurl -lcjson -lz -lm -lpthread
+ *
+ * Usage: wasmify_test
+ * Prints every failed check and exits with status 1 if there was one.
+ * Remote tests run against a mock server inside the process, on a loopback
+ * port, which counts requests and answers each with a body the test picks.
+ */
+
+#define _GNU_SOURCE
+#include "wasmify.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        g_failures++; \
+    } \
+} while (0)
+
+// A module with one page of memory exporting
+//   pair(i32) -> (i32, i32)   x + 1, x * 10
+//   sub(i32, i32) -> i32
+//   double(i32) -> i32
+//   id32(f32) -> f32, id64(f64) -> f64
+//   pages() -> i32            memory.size
+static const uint8_t TEST_MODULE[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+    0x01, 0x20, 0x06,
+    0x60, 0x01, 0x7f, 0x02, 0x7f, 0x7f,
+    0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f,
+    0x60, 0x01, 0x7f, 0x01, 0x7f,
+    0x60, 0x01, 0x7d, 0x01, 0x7d,
+    0x60, 0x01, 0x7c, 0x01, 0x7c,
+    0x60, 0x00, 0x01, 0x7f,
+    0x03, 0x07, 0x06, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x05, 0x03, 0x01, 0x00, 0x01,
+    0x07, 0x2d, 0x06,
+    0x04, 'p', 'a', 'i', 'r', 0x00, 0x00,
+    0x03, 's', 'u', 'b', 0x00, 0x01,
+    0x06, 'd', 'o', 'u', 'b', 'l', 'e', 0x00, 0x02,
+    0x04, 'i', 'd', '3', '2', 0x00, 0x03,
+    0x04, 'i', 'd', '6', '4', 0x00, 0x04,
+    0x05, 'p', 'a', 'g', 'e', 's', 0x00, 0x05,
+    0x0a, 0x2d, 0x06,
+    0x0c, 0x00, 0x20, 0x00, 0x41, 0x01, 0x6a, 0x20, 0x00, 0x41, 0x0a, 0x6c, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x20, 0x01, 0x6b, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x02, 0x6c, 0x0b,
+    0x04, 0x00, 0x20, 0x00, 0x0b,
+    0x04, 0x00, 0x20, 0x00, 0x0b,
+    0x04, 0x00, 0x3f, 0x00, 0x0b
+};
+
+// A module exporting
+//   count(i32 n) -> i32       loops n times and returns n
+//   forever()                 loops without end
+static const uint8_t LOOP_MODULE[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+    0x01, 0x09, 0x02,
+    0x60, 0x01, 0x7f, 0x01, 0x7f,
+    0x60, 0x00, 0x00,
+    0x03, 0x03, 0x02, 0x00, 0x01,
+    0x07, 0x13, 0x02,
+    0x05, 'c', 'o', 'u', 'n', 't', 0x00, 0x00,
+    0x07, 'f', 'o', 'r', 'e', 'v', 'e', 'r', 0x00, 0x01,
+    0x0a, 0x1f, 0x02,
+    0x15, 0x01, 0x01, 0x7f, 0x03, 0x40, 0x20, 0x01, 0x41, 0x01, 0x6a, 0x22, 0x01, 0x20, 0x00, 0x48, 0x0d, 0x00, 0x0b,
+    0x20, 0x01, 0x0b,
+    0x07, 0x00, 0x03, 0x40, 0x0c, 0x00, 0x0b, 0x0b
+};
+
+// A reply of the mock server
+typedef struct {
+    const char* content_type;
+    const char* body;
+    size_t size;
+} mock_reply_t;
+
+static const char MOCK_SUCCESS_BODY[] =
+    "{\"success\":true,\"data\":{\"result\":{\"success\":true,\"result\":\"42\","
+    "\"executionTime\":0.1,\"memoryUsed\":65536}}}";
+
+static const char MOCK_FAILURE_BODY[] =
+    "{\"success\":true,\"data\":{\"result\":{\"success\":false,\"result\":null,"
+    "\"error\":\"unreachable\",\"executionTime\":0.1,\"memoryUsed\":65536}}}";
+
+// Magic, success, execution time, memory used, error and no values
+static const char MOCK_FAILURE_FRAME[] =
+    "WMF1" "\0" "\0\0\0\0\0\0\0\0" "\0\0\0\0\0\0\0\0" "\x0b\0\0\0" "unreachable" "\0\0\0\0";
+
+// Magic, success, execution time, memory used, no error and the i32 42
+static const char MOCK_SUCCESS_FRAME[] =
+    "WMF1" "\x01" "\0\0\0\0\0\0\0\0" "\0\0\0\0\0\0\0\0" "\0\0\0\0" "\x01\0\0\0" "\x01" "\x2a\0\0\0";
+
+static const mock_reply_t MOCK_SUCCESS = { "application/json", MOCK_SUCCESS_BODY, sizeof(MOCK_SUCCESS_BODY) - 1 };
+static const mock_reply_t MOCK_FAILURE = { "application/json", MOCK_FAILURE_BODY, sizeof(MOCK_FAILURE_BODY) - 1 };
+static const mock_reply_t MOCK_FAILURE_FRAMED = {
+    "application/x-wasmify-frame", MOCK_FAILURE_FRAME, sizeof(MOCK_FAILURE_FRAME) - 1
+};
+static const mock_reply_t MOCK_SUCCESS_FRAMED = {
+    "application/x-wasmify-frame", MOCK_SUCCESS_FRAME, sizeof(MOCK_SUCCESS_FRAME) - 1
+};
+
+// The mock server's next reply, and the requests it has answered. A route,
+// when set, picks the reply from the request instead.
+static const mock_reply_t* volatile g_mock_reply = &MOCK_SUCCESS;
+static const mock_reply_t* (*volatile g_mock_route)(const char* request, size_t size) = NULL;
+static int g_mock_requests = 0;
+
+// The last request the mock server answered, cut short if it did not fit
+static char g_mock_request[16 * 1024];
+static size_t g_mock_request_size = 0;
+
+// End of the request headers in buf, or NULL while they are incomplete
+static char* headers_end(char* buf, size_t size) {
+    for (size_t i = 3; i < size; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') return buf + i - 3;
+    }
+    return NULL;
+}
+
+static void* mock_connection(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    char buf[64 * 1024];
+    size_t have = 0;
+    for (;;) {
+        // Headers, then as much body as they announce
+        char* end = NULL;
+        while (!(end = headers_end(buf, have))) {
+            if (have == sizeof(buf)) goto done;
+            ssize_t got = recv(fd, buf + have, sizeof(buf) - have, 0);
+            if (got <= 0) goto done;
+            have += (size_t)got;
+        }
+        size_t head = (size_t)(end - buf) + 4;
+        size_t body = 0;
+        for (char* line = buf; line < end; line = memchr(line, '\n', (size_t)(end - line + 2)) + 1) {
+            if (strncasecmp(line, "content-length:", 15) == 0) body = strtoul(line + 15, NULL, 10);
+        }
+        // A body too big for the buffer is read to its end, but only its start is kept
+        size_t total = head + body;
+        size_t kept = total < sizeof(buf) ? total : sizeof(buf);
+        while (have < kept) {
+            ssize_t got = recv(fd, buf + have, sizeof(buf) - have, 0);
+            if (got <= 0) goto done;
+            have += (size_t)got;
+        }
+        for (size_t skipped = kept; skipped < total;) {
+            char sink[16 * 1024];
+            size_t want = total - skipped < sizeof(sink) ? total - skipped : sizeof(sink);
+            ssize_t got = recv(fd, sink, want, 0);
+            if (got <= 0) goto done;
+            skipped += (size_t)got;
+        }
+
+        const mock_reply_t* (*route)(const char*, size_t) = g_mock_route;
+        const mock_reply_t* reply = route ? route(buf, kept) : g_mock_reply;
+        char head_out[256];
+        int head_len = snprintf(head_out, sizeof(head_out),
+            "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+            reply->content_type, reply->size);
+        g_mock_request_size = kept < sizeof(g_mock_request) ? kept : sizeof(g_mock_request);
+        memcpy(g_mock_request, buf, g_mock_request_size);
+        __atomic_add_fetch(&g_mock_requests, 1, __ATOMIC_RELAXED);
+        if (send(fd, head_out, (size_t)head_len, MSG_NOSIGNAL | MSG_MORE) != head_len ||
+            send(fd, reply->body, reply->size, MSG_NOSIGNAL) != (ssize_t)reply->size) goto done;
+        memmove(buf, buf + kept, have - kept);
+        have -= kept;
+    }
+done:
+    close(fd);
+    return NULL;
+}
+
+static void* mock_accept(void* arg) {
+    int listener = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return NULL;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, mock_connection, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+// Start the mock server; returns its port or 0
+static int mock_start(void) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) return 0;
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 256) != 0 ||
+        getsockname(listener, (struct sockaddr*)&addr, &len) != 0) {
+        close(listener);
+        return 0;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, mock_accept, (void*)(intptr_t)listener) != 0) {
+        close(listener);
+        return 0;
+    }
+    pthread_detach(thread);
+    return ntohs(addr.sin_port);
+}
+
+// Body of the last request the mock server answered, NULL if it had none
+static const uint8_t* mock_request_body(size_t* size) {
+    const char* end = memmem(g_mock_request, g_mock_request_size, "\r\n\r\n", 4);
+    if (!end) return NULL;
+    *size = g_mock_request_size - (size_t)(end + 4 - g_mock_request);
+    return (const uint8_t*)end + 4;
+}
+
+// Start a client on a fresh mock server; NULL if either could not be set up
+static wasmify_client_t* mock_client(wasmify_config_t config) {
+    char url[64];
+    int port = mock_start();
+    CHECK(port != 0);
+    if (port == 0) return NULL;
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+    config.api_url = url;
+    if (config.timeout == 0) config.timeout = 10;
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL);
+    return client;
+}
+
+// Little-endian integer of n bytes at *p, which advances past it
+static uint64_t read_le(const uint8_t** p, int n) {
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++) v |= (uint64_t)(*p)[i] << (8 * i);
+    *p += n;
+    return v;
+}
+
+// Call a function of the test module in a fresh instance with text arguments
+static wasmify_error_t call_text(wasmify_compiled_module_t* module, const char* function_name,
+                                 char** args, int args_count, wasmify_result_t* result) {
+    memset(result, 0, sizeof(*result));
+    return wasmify_execute_compiled(module, function_name, args, args_count, result);
+}
+
+static const char BATCH_BODY[] =
+    "{\"success\":true,\"data\":{\"results\":["
+    "{\"success\":true,\"result\":\"3\",\"executionTime\":0.1,\"memoryUsed\":65536},"
+    "{\"success\":false,\"result\":null,\"error\":\"unreachable\",\"executionTime\":0.1,\"memoryUsed\":65536},"
+    "{\"success\":true,\"result\":\"7\",\"executionTime\":0.1,\"memoryUsed\":65536}]}}";
+
+static const mock_reply_t MOCK_BATCH = { "application/json", BATCH_BODY, sizeof(BATCH_BODY) - 1 };
+
+// A batch goes out as one request, and each invocation gets its own result,
+// the failed ones included
+static void test_batch_results_per_invocation(void) {
+    wasmify_client_t* client = mock_client((wasmify_config_t){ 0 });
+    if (!client) return;
+    g_mock_reply = &MOCK_BATCH;
+
+    char* first[] = { "1", "2" };
+    char* second[] = { "0" };
+    char* third[] = { "3", "4" };
+    wasmify_args_t batches[] = { { first, 2 }, { second, 1 }, { third, 2 } };
+    wasmify_result_t out[3];
+    int before = __atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED);
+    CHECK(wasmify_execute_batch(client, "0123456789abcdef", "add", batches, 3, out) == WASMIFY_ERROR_EXECUTION);
+    CHECK(__atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED) == before + 1);
+    CHECK(memmem(g_mock_request, g_mock_request_size, "POST /api/wasm/execute/batch ", 29) != NULL);
+    CHECK(memmem(g_mock_request, g_mock_request_size, "\"invocations\":[[\"1\",\"2\"],[\"0\"],[\"3\",\"4\"]]", 41) != NULL);
+    CHECK(out[0].success && out[0].result && strcmp(out[0].result, "3") == 0);
+    CHECK(!out[1].success && out[1].error && strcmp(out[1].error, "unreachable") == 0);
+    CHECK(out[2].success && out[2].result && strcmp(out[2].result, "7") == 0);
+    for (int i = 0; i < 3; i++) wasmify_result_free(&out[i]);
+
+    // A reply with fewer results than invocations does not parse
+    wasmify_result_t four[4];
+    wasmify_args_t more[] = { { first, 2 }, { second, 1 }, { third, 2 }, { first, 2 } };
+    CHECK(wasmify_execute_batch(client, "0123456789abcdef", "add", more, 4, four) == WASMIFY_ERROR_PARSE);
+    for (int i = 0; i < 4; i++) wasmify_result_free(&four[i]);
+
+    g_mock_reply = &MOCK_SUCCESS;
+    wasmify_client_destroy(client);
+}
+
+// With the binary wire format requests go out as frames holding each
+// argument's own type, and framed results come back as text or typed values
+static void test_binary_wire_format(void) {
+    wasmify_client_t* client = mock_client((wasmify_config_t){ .wire_format = WASMIFY_WIRE_BINARY });
+    if (!client) return;
+    g_mock_reply = &MOCK_SUCCESS_FRAMED;
+
+    char* args[] = { "20", "3000000000", "1.5", "text" };
+    wasmify_result_t result;
+    memset(&result, 0, sizeof(result));
+    CHECK(wasmify_execute_module(client, "0123456789abcdef", "add", args, 4, &result) == WASMIFY_SUCCESS);
+    CHECK(result.success && result.result && strcmp(result.result, "42") == 0);
+    wasmify_result_free(&result);
+
+    CHECK(memmem(g_mock_request, g_mock_request_size, "application/x-wasmify-frame", 27) != NULL);
+    size_t size = 0;
+    const uint8_t* p = mock_request_body(&size);
+    CHECK(p && size > 4 && memcmp(p, "WMF1", 4) == 0);
+    if (p && size > 4) {
+        const uint8_t* end = p + size;
+        p += 4;
+        uint32_t len = (uint32_t)read_le(&p, 4);
+        CHECK(len == 16 && memcmp(p, "0123456789abcdef", 16) == 0);
+        p += len;
+        len = (uint32_t)read_le(&p, 4);
+        CHECK(len == 3 && memcmp(p, "add", 3) == 0);
+        p += len;
+        p += read_le(&p, 4);    // config
+        CHECK(p < end && read_le(&p, 4) == 4);
+        CHECK(read_le(&p, 1) == WASMIFY_VAL_I32 && read_le(&p, 4) == 20);
+        CHECK(read_le(&p, 1) == WASMIFY_VAL_I64 && read_le(&p, 8) == 3000000000u);
+        double d = 0;
+        CHECK(read_le(&p, 1) == WASMIFY_VAL_F64);
+        uint64_t bits = read_le(&p, 8);
+        memcpy(&d, &bits, sizeof(d));
+        CHECK(d == 1.5);
+        CHECK(read_le(&p, 1) == WASMIFY_VAL_BYTES && read_le(&p, 4) == 4 && memcmp(p, "text", 4) == 0);
+        CHECK(p + 4 == end);
+    }
+
+    wasmify_value_t values[] = { { .kind = WASMIFY_VAL_F32, .of.f32 = 0.25f } };
+    wasmify_call_result_t typed;
+    CHECK(wasmify_execute_module_v(client, "0123456789abcdef", "add", values, 1, &typed) == WASMIFY_SUCCESS);
+    CHECK(typed.values_count == 1 && typed.values[0].kind == WASMIFY_VAL_I32 && typed.values[0].of.i32 == 42);
+    wasmify_call_result_free(&typed);
+    p = mock_request_body(&size);
+    CHECK(p && size >= 9 && p[size - 5] == WASMIFY_VAL_F32);
+    if (p && size >= 9) {
+        const uint8_t* value = p + size - 4;
+        uint32_t f32_bits = (uint32_t)read_le(&value, 4);
+        float f;
+        memcpy(&f, &f32_bits, sizeof(f));
+        CHECK(f == 0.25f);
+    }
+
+    g_mock_reply = &MOCK_SUCCESS;
+    wasmify_client_destroy(client);
+}
+
+// Failed results of pure functions are fetched again, whichever format they
+// come in; successful ones come from the cache
+static void test_result_cache_keeps_only_successes(void) {
+    int port = mock_start();
+    CHECK(port != 0);
+    if (port == 0) return;
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+    wasmify_config_t config = { .api_url = url, .timeout = 10, .result_cache_bytes = 1 << 20 };
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL);
+    if (!client) return;
+    CHECK(wasmify_declare_pure(client, "0123456789abcdef", "add") == WASMIFY_SUCCESS);
+
+    char* args[] = { "20", "22" };
+    wasmify_result_t result;
+    const mock_reply_t* failures[] = { &MOCK_FAILURE, &MOCK_FAILURE_FRAMED };
+    for (int i = 0; i < 4; i++) {
+        g_mock_reply = failures[i / 2];
+        memset(&result, 0, sizeof(result));
+        wasmify_execute_module(client, "0123456789abcdef", "add", args, 2, &result);
+        CHECK(!result.success);
+        wasmify_result_free(&result);
+    }
+    CHECK(__atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED) == 4);
+
+    g_mock_reply = &MOCK_SUCCESS;
+    for (int i = 0; i < 2; i++) {
+        memset(&result, 0, sizeof(result));
+        CHECK(wasmify_execute_module(client, "0123456789abcdef", "add", args, 2, &result) == WASMIFY_SUCCESS);
+        CHECK(result.success && result.result && strcmp(result.result, "42") == 0);
+        wasmify_result_free(&result);
+    }
+    CHECK(__atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED) == 5);
+
+    wasmify_result_cache_stats_t stats;
+    wasmify_result_cache_stats(client, &stats);
+    CHECK(stats.entries == 1);
+    CHECK(stats.hits == 1);
+    wasmify_client_destroy(client);
+}
+
+static void count_async_success(wasmify_error_t error, wasmify_result_t* result, void* user_data) {
+    if (error == WASMIFY_SUCCESS && result->success && result->result && strcmp(result->result, "42") == 0) {
+        (*(int*)user_data)++;
+    }
+    wasmify_result_free(result);
+}
+
+// Asynchronous calls on far more sockets than one poll used to serve all complete
+static void test_async_calls_on_many_sockets(void) {
+    int port = mock_start();
+    CHECK(port != 0);
+    if (port == 0) return;
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+    wasmify_config_t config = { .api_url = url, .timeout = 10, .max_connections = 200 };
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL);
+    if (!client) return;
+
+    g_mock_reply = &MOCK_SUCCESS;
+    char* args[] = { "20", "22" };
+    int started = 0, succeeded = 0;
+    for (int i = 0; i < 200; i++) {
+        if (wasmify_execute_module_async(client, "0123456789abcdef", "add", args, 2,
+                                         count_async_success, &succeeded) == WASMIFY_SUCCESS) {
+            started++;
+        }
+    }
+    CHECK(started == 200);
+    CHECK(wasmify_client_run(client) == WASMIFY_SUCCESS);
+    CHECK(succeeded == started);
+    wasmify_client_destroy(client);
+}
+
+// Every execute entry point turns down a negative count or missing arguments
+// before anything is sent
+static void test_execute_rejects_bad_argument_counts(void) {
+    wasmify_config_t config = { .api_url = "http://127.0.0.1:9/api", .timeout = 1,
+                                .wire_format = WASMIFY_WIRE_BINARY };
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL);
+    if (!client) return;
+
+    char* args[] = { "1" };
+    const struct { char** args; int count; } bad[] = { { args, -1 }, { NULL, 1 } };
+    for (int i = 0; i < 2; i++) {
+        wasmify_result_t result;
+        wasmify_result_view_t view;
+        CHECK(wasmify_execute_module(client, "0123456789abcdef", "add", bad[i].args, bad[i].count, &result) ==
+              WASMIFY_ERROR_INVALID_PARAM);
+        CHECK(wasmify_execute_module_view(client, "0123456789abcdef", "add", bad[i].args, bad[i].count, &view) ==
+              WASMIFY_ERROR_INVALID_PARAM);
+        CHECK(wasmify_execute_module_async(client, "0123456789abcdef", "add", bad[i].args, bad[i].count,
+                                           count_async_success, NULL) == WASMIFY_ERROR_INVALID_PARAM);
+    }
+    wasmify_client_destroy(client);
+}
+
+static void* execute_repeatedly(void* arg) {
+    wasmify_client_t* client = (wasmify_client_t*)arg;
+    char* args[] = { "20", "22" };
+    for (int i = 0; i < 200; i++) {
+        wasmify_result_t result;
+        memset(&result, 0, sizeof(result));
+        CHECK(wasmify_execute_module(client, "0123456789abcdef", "add", args, 2, &result) == WASMIFY_SUCCESS);
+        wasmify_result_free(&result);
+    }
+    return NULL;
+}
+
+// An unpooled client shared by several threads opens extra connections and
+// drops them again, but never the one behind its curl field
+static void test_unpooled_client_keeps_its_connection(void) {
+    int port = mock_start();
+    CHECK(port != 0);
+    if (port == 0) return;
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+    wasmify_config_t config = { .api_url = url, .timeout = 10 };
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL && client->curl != NULL);
+    if (!client) return;
+
+    g_mock_reply = &MOCK_SUCCESS;
+    pthread_t threads[8];
+    for (int t = 0; t < 8; t++) pthread_create(&threads[t], NULL, execute_repeatedly, client);
+    for (int t = 0; t < 8; t++) pthread_join(threads[t], NULL);
+
+    // The pinned handle is still alive and still the one requests go out on
+    char* url_used = NULL;
+    CHECK(curl_easy_getinfo(client->curl, CURLINFO_EFFECTIVE_URL, &url_used) == CURLE_OK);
+    CHECK(url_used != NULL && strncmp(url_used, url, strlen(url)) == 0);
+    wasmify_client_destroy(client);
+}
+
+static const char LISTING_FIRST_BODY[] =
+    "{\"success\":true,\"data\":[{\"id\":\"a\",\"name\":\"first\",\"size\":10},"
+    "{\"id\":\"b\",\"name\":\"second\",\"isPublic\":true}],"
+    "\"pagination\":{\"limit\":100,\"nextCursor\":\"b\"}}";
+
+static const char LISTING_LAST_BODY[] =
+    "{\"success\":true,\"data\":[{\"id\":\"c\",\"name\":\"third\"}],"
+    "\"pagination\":{\"limit\":100,\"nextCursor\":null}}";
+
+static const mock_reply_t LISTING_FIRST = { "application/json", LISTING_FIRST_BODY, sizeof(LISTING_FIRST_BODY) - 1 };
+static const mock_reply_t LISTING_LAST = { "application/json", LISTING_LAST_BODY, sizeof(LISTING_LAST_BODY) - 1 };
+static const mock_reply_t LISTING_MISSING = { "application/json", "{\"success\":false}", 17 };
+
+// Pages of a listing by the cursor they are asked for with
+static const mock_reply_t* route_listing(const char* request, size_t size) {
+    const char* line_end = memchr(request, '\r', size);
+    size_t line = line_end ? (size_t)(line_end - request) : size;
+    if (!memmem(request, line, "/modules?limit=100", 18)) return &LISTING_MISSING;
+    return memmem(request, line, "cursor=b", 8) ? &LISTING_LAST : &LISTING_FIRST;
+}
+
+// A listing walks every page, following the cursor each one ends with
+static void test_module_iterator_follows_pages(void) {
+    int port = mock_start();
+    CHECK(port != 0);
+    if (port == 0) return;
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api", port);
+    wasmify_config_t config = { .api_url = url, .timeout = 10 };
+    wasmify_client_t* client = wasmify_client_create(config);
+    CHECK(client != NULL);
+    if (!client) return;
+
+    g_mock_route = route_listing;
+    wasmify_module_iter_t* iter = NULL;
+    CHECK(wasmify_module_iter_create(client, NULL, &iter) == WASMIFY_SUCCESS);
+    const char* expected[] = { "a", "b", "c" };
+    const wasmify_module_info_t* info = NULL;
+    for (int i = 0; iter && i < 3; i++) {
+        CHECK(wasmify_module_iter_next(iter, &info) == WASMIFY_SUCCESS);
+        CHECK(info && strcmp(info->id, expected[i]) == 0);
+        if (info && i == 0) CHECK(info->size == 10 && strcmp(info->name, "first") == 0);
+        if (info && i == 1) CHECK(info->is_public);
+    }
+    if (iter) {
+        CHECK(wasmify_module_iter_next(iter, &info) == WASMIFY_SUCCESS && info == NULL);
+        wasmify_module_iter_free(iter);
+    }
+    g_mock_route = NULL;
+    wasmify_client_destroy(client);
+}
+
+static const char SEVEN_BODY[] =
+    "{\"success\":true,\"data\":{\"result\":{\"success\":true,\"result\":\"7\","
+    "\"executionTime\":0.1,\"memoryUsed\":65536}}}";
+
+static const mock_reply_t MOCK_SEVEN = { "application/json", SEVEN_BODY, sizeof(SEVEN_BODY) - 1 };
+
+// 42 for calls on 1 and 2, 7 for the rest
+static const mock_reply_t* route_by_args(const char* request, size_t size) {
+    return memmem(request, size, "[\"1\",\"2\"]", 9) ? &MOCK_SUCCESS : &MOCK_SEVEN;
+}
+
+// Results taken from an arena stay valid until its reset, across as many
+// blocks as they need, and a reset arena serves the next round
+static void test_arena_results_until_reset(void) {
+    wasmify_client_t* client = mock_client((wasmify_config_t){ 0 });
+    if (!client) return;
+    wasmify_arena_t* arena = wasmify_arena_create(64);
+    CHECK(arena != NULL);
+    if (!arena) {
+        wasmify_client_destroy(client);
+        return;
+    }
+
+    char* args[][2] = { { "1", "2" }, { "3", "4" } };
+    wasmify_result_t results[32];
+    for (int round = 0; round < 2; round++) {
+        g_mock_route = route_by_args;
+        for (int i = 0; i < 32; i++) {
+            CHECK(wasmify_execute_module_arena(client, "0123456789abcdef", "add", args[i % 2], 2, arena, &results[i])
+                  == WASMIFY_SUCCESS);
+        }
+        for (int i = 0; i < 32; i++) {
+            CHECK(results[i].success && results[i].result && strcmp(results[i].result, i % 2 ? "7" : "42") == 0);
+        }
+
+        g_mock_route = route_listing;
+        wasmify_module_t* modules = NULL;
+        int count = 0;
+        CHECK(wasmify_list_modules_arena(client, arena, &modules, &count) == WASMIFY_SUCCESS);
+        CHECK(count == 3);
+        if (count == 3) {
+            CHECK(strcmp(modules[0].id, "a") == 0 && strcmp(modules[0].name, "first") == 0);
+            CHECK(strcmp(modules[2].id, "c") == 0 && strcmp(modules[2].name, "third") == 0);
+        }
+        g_mock_route = NULL;
+        wasmify_arena_reset(arena);
+    }
+
+    wasmify_arena_destroy(arena);
+    wasmify_client_destroy(client);
+}
+
+static const char UPLOAD_FRESH_BODY[] = "{\"success\":true,\"data\":{\"uploadId\":\"u1\",\"received\":[]}}";
+static const char UPLOAD_RESUMED_BODY[] = "{\"success\":true,\"data\":{\"uploadId\":\"u1\",\"received\":[0]}}";
+static const char UPLOAD_CHUNK_BODY[] = "{\"success\":true,\"data\":{}}";
+static const char UPLOAD_COMPLETE_BODY[] = "{\"success\":true,\"data\":{\"id\":\"u1\",\"name\":\"big\"}}";
+
+static const mock_reply_t UPLOAD_FRESH = { "application/json", UPLOAD_FRESH_BODY, sizeof(UPLOAD_FRESH_BODY) - 1 };
+static const mock_reply_t UPLOAD_RESUMED = { "application/json", UPLOAD_RESUMED_BODY, sizeof(UPLOAD_RESUMED_BODY) - 1 };
+static const mock_reply_t UPLOAD_CHUNK = { "application/json", UPLOAD_CHUNK_BODY, sizeof(UPLOAD_CHUNK_BODY) - 1 };
+static const mock_reply_t UPLOAD_COMPLETE = { "application/json", UPLOAD_COMPLETE_BODY, sizeof(UPLOAD_COMPLETE_BODY) - 1 };
+
+// The reply to the next upload session, and what the mock server saw of the upload
+static const mock_reply_t* volatile g_upload_session = &UPLOAD_FRESH;
+static struct {
+    int chunks;             // Chunk PUTs
+    long long bytes;        // Their total length
+    int first_chunk;        // Whether chunk 0 was among them
+    int completed;          // Complete calls
+} g_upload;
+
+// Upload sessions, their chunks and their completion
+static const mock_reply_t* route_upload(const char* request, size_t size) {
+    const char* line_end = memchr(request, '\r', size);
+    size_t line = line_end ? (size_t)(line_end - request) : size;
+    if (line > 4 && memcmp(request, "PUT ", 4) == 0) {
+        const char* length = memmem(request, size, "Content-Length:", 15);
+        __atomic_add_fetch(&g_upload.chunks, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_upload.bytes, length ? strtoll(length + 15, NULL, 10) : 0, __ATOMIC_RELAXED);
+        if (memmem(request, line, "/chunks/0 ", 10)) __atomic_store_n(&g_upload.first_chunk, 1, __ATOMIC_RELAXED);
+        return &UPLOAD_CHUNK;
+    }
+    if (memmem(request, line, "/u1/complete ", 13)) {
+        __atomic_add_fetch(&g_upload.completed, 1, __ATOMIC_RELAXED);
+        return &UPLOAD_COMPLETE;
+    }
+    return g_upload_session;
+}
+
+// Write data to a new temporary file named in path, a mkstemp template
+static int write_temp_file(char* path, const uint8_t* data, size_t size) {
+    int fd = mkstemp(path);
+    if (fd < 0) return 0;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t put = write(fd, data + done, size - done);
+        if (put <= 0) break;
+        done += (size_t)put;
+    }
+    close(fd);
+    if (done == size) return 1;
+    unlink(path);
+    return 0;
+}
+
+// A module goes up in content-defined chunks over parallel connections, and
+// a resumed upload sends only the chunks the server is missing
+static void test_chunked_upload(void) {
+    // More than the largest chunk, so there are at least two
+    size_t size = 6 * 1024 * 1024;
+    uint8_t* data = malloc(size);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; data && i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    char path[] = "/tmp/wasmify_test_XXXXXX";
+    int written = data && write_temp_file(path, data, size);
+    free(data);
+    CHECK(written);
+    if (!written) return;
+    wasmify_client_t* client = mock_client((wasmify_config_t){ 0 });
+    if (!client) {
+        unlink(path);
+        return;
+    }
+
+    g_mock_route = route_upload;
+    int fresh_chunks = 0;
+    char fresh_id[17] = "";
+    for (int round = 0; round < 2; round++) {
+        g_upload_session = round == 0 ? &UPLOAD_FRESH : &UPLOAD_RESUMED;
+        memset(&g_upload, 0, sizeof(g_upload));
+        wasmify_module_t module = { 0 };
+        CHECK(wasmify_upload_module(client, path, "big", "1.0.0", &module) == WASMIFY_SUCCESS);
+        CHECK(g_upload.completed == 1);
+        CHECK(module.metadata != NULL && module.id && strlen(module.id) == 16);
+        if (round == 0) {
+            fresh_chunks = g_upload.chunks;
+            if (module.id) snprintf(fresh_id, sizeof(fresh_id), "%s", module.id);
+            CHECK(fresh_chunks >= 2 && g_upload.first_chunk);
+            CHECK(g_upload.bytes == (long long)size);
+        } else {
+            CHECK(g_upload.chunks == fresh_chunks - 1 && !g_upload.first_chunk);
+            CHECK(g_upload.bytes > 0 && g_upload.bytes < (long long)size);
+            CHECK(module.id && strcmp(module.id, fresh_id) == 0);
+        }
+        wasmify_module_free(&module);
+    }
+
+    g_mock_route = NULL;
+    wasmify_client_destroy(client);
+    unlink(path);
+}
+
+static const char UPLOAD_STORED_BODY[] =
+    "{\"success\":true,\"data\":{\"uploadId\":\"93a44bbb96c751218e4c00d479e4c14358122a389acca16205b1e4d0dc5f9476\","
+    "\"module\":{\"alreadyStored\":true,\"moduleId\":\"93a44bbb96c75121\","
+    "\"sha256\":\"93a44bbb96c751218e4c00d479e4c14358122a389acca16205b1e4d0dc5f9476\"}}}";
+
+static const mock_reply_t UPLOAD_STORED = { "application/json", UPLOAD_STORED_BODY, sizeof(UPLOAD_STORED_BODY) - 1 };
+
+// A module the server already has by its digest is not sent again, and its
+// ID is the digest's leading digits
+static void test_stored_upload_sends_nothing(void) {
+    static const uint8_t empty_module[] = { 0x00, 'a', 's', 'm', 0x01, 0x00, 0x00, 0x00 };
+    char path[] = "/tmp/wasmify_test_XXXXXX";
+    int written = write_temp_file(path, empty_module, sizeof(empty_module));
+    CHECK(written);
+    if (!written) return;
+    wasmify_client_t* client = mock_client((wasmify_config_t){ 0 });
+    if (!client) {
+        unlink(path);
+        return;
+    }
+
+    g_mock_route = route_upload;
+    g_upload_session = &UPLOAD_STORED;
+    memset(&g_upload, 0, sizeof(g_upload));
+    int before = __atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED);
+    wasmify_module_t module = { 0 };
+    CHECK(wasmify_upload_module(client, path, "empty", "1.0.0", &module) == WASMIFY_SUCCESS);
+    CHECK(__atomic_load_n(&g_mock_requests, __ATOMIC_RELAXED) == before + 1);
+    CHECK(g_upload.chunks == 0 && g_upload.completed == 0);
+    CHECK(memmem(g_mock_request, g_mock_request_size,
+                 "\"sha256\":\"93a44bbb96c751218e4c00d479e4c14358122a389acca16205b1e4d0dc5f9476\"", 75) != NULL);
+    CHECK(module.id && strcmp(module.id, "93a44bbb96c75121") == 0);
+    CHECK(module.metadata != NULL);
+    wasmify_module_free(&module);
+
+    g_upload_session = &UPLOAD_FRESH;
+    g_mock_route = NULL;
+    wasmify_client_destroy(client);
+    unlink(path);
+}
+
+// Integer arguments are decimal or 0x hex, and i32 ones must fit in 32 bits
+// read either as signed or as unsigned
+static void test_integer_arguments(wasmify_compiled_module_t* module) {
+    static const struct {
+        const char* text;
+        const char* difference;     // text - 0, NULL when the argument is rejected
+    } cases[] = {
+        { "010", "10" },
+        { "08", "8" },
+        { "0x10", "16" },
+        { "-0x10", "-16" },
+        { "+7", "7" },
+        { "2147483647", "2147483647" },
+        { "4294967295", "-1" },
+        { "-2147483648", "-2147483648" },
+        { "4294967296", NULL },
+        { "-2147483649", NULL },
+        { "-3000000000", NULL },
+        { "0x100000000", NULL },
+        { " 5", NULL },
+        { "--5", NULL },
+        { "+-5", NULL },
+        { "0x", NULL },
+        { "", NULL },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char* args[] = { (char*)cases[i].text, "0" };
+        wasmify_result_t result;
+        wasmify_error_t error = call_text(module, "sub", args, 2, &result);
+        int accepted = error == WASMIFY_SUCCESS && result.success && result.result;
+        int ok = cases[i].difference ? accepted && strcmp(result.result, cases[i].difference) == 0 : !accepted;
+        CHECK(ok);
+        if (!ok) fprintf(stderr, "  argument \"%s\" gave %s\n", cases[i].text, accepted ? result.result : "an error");
+        wasmify_result_free(&result);
+    }
+}
+
+// Float arguments below the normal range are taken as they are; only those beyond it fail
+static void test_subnormal_arguments(wasmify_compiled_module_t* module) {
+    wasmify_result_t result;
+    char* f32_min[] = { "1e-45" };
+    CHECK(call_text(module, "id32", f32_min, 1, &result) == WASMIFY_SUCCESS);
+    CHECK(result.success && result.result && strtof(result.result, NULL) > 0.0f);
+    wasmify_result_free(&result);
+
+    char* f64_min[] = { "5e-324" };
+    CHECK(call_text(module, "id64", f64_min, 1, &result) == WASMIFY_SUCCESS);
+    CHECK(result.success && result.result && strtod(result.result, NULL) > 0.0);
+    wasmify_result_free(&result);
+
+    char* f32_zero[] = { "1e-50" };
+    CHECK(call_text(module, "id32", f32_zero, 1, &result) == WASMIFY_SUCCESS);
+    CHECK(result.success && result.result && strtof(result.result, NULL) == 0.0f);
+    wasmify_result_free(&result);
+
+    char* f32_huge[] = { "1e39" };
+    CHECK(call_text(module, "id32", f32_huge, 1, &result) != WASMIFY_SUCCESS || !result.success);
+    wasmify_result_free(&result);
+}
+
+// Fuel and deadlines stop local calls, and tasks run a call a slice at a time
+static void test_fuel_deadlines_and_tasks(wasmify_compiled_module_t* loop) {
+    wasmify_value_t many = { .kind = WASMIFY_VAL_I32, .of.i32 = 1000000 };
+    wasmify_call_result_t result;
+
+    wasmify_limits_t limits = { .fuel = 1000 };
+    wasmify_set_local_limits(&limits);
+    CHECK(wasmify_call(loop, "count", &many, 1, &result) != WASMIFY_SUCCESS);
+    CHECK(!result.success && result.error && strstr(result.error, "out of fuel"));
+    wasmify_call_result_free(&result);
+
+    limits.fuel = 100000000;
+    wasmify_set_local_limits(&limits);
+    CHECK(wasmify_call(loop, "count", &many, 1, &result) == WASMIFY_SUCCESS);
+    CHECK(result.values_count == 1 && result.values[0].of.i32 == 1000000);
+    wasmify_call_result_free(&result);
+
+    limits = (wasmify_limits_t){ .deadline_ms = 50 };
+    wasmify_set_local_limits(&limits);
+    CHECK(wasmify_call(loop, "forever", NULL, 0, &result) == WASMIFY_ERROR_TIMEOUT);
+    wasmify_call_result_free(&result);
+    wasmify_set_local_limits(NULL);
+
+    // A long call takes several slices, and one never finishing is cancelled
+    wasmify_pool_config_t config = { .limits = { .slice_ms = 1 } };
+    wasmify_instance_pool_t* pool = wasmify_instance_pool_create(loop, config);
+    CHECK(pool != NULL);
+    if (!pool) return;
+    wasmify_value_t longer = { .kind = WASMIFY_VAL_I32, .of.i32 = 50000000 };
+    wasmify_task_t* task = NULL;
+    CHECK(wasmify_pool_spawn(pool, "count", &longer, 1, &task) == WASMIFY_SUCCESS);
+    if (task) {
+        int done = 0, steps = 0;
+        while (!done && wasmify_task_step(task, &done) == WASMIFY_SUCCESS) steps++;
+        CHECK(done && steps > 1);
+        CHECK(wasmify_task_finish(task, &result) == WASMIFY_SUCCESS);
+        CHECK(result.values_count == 1 && result.values[0].of.i32 == 50000000);
+        wasmify_call_result_free(&result);
+    }
+
+    task = NULL;
+    CHECK(wasmify_pool_spawn(pool, "forever", NULL, 0, &task) == WASMIFY_SUCCESS);
+    if (task) {
+        int done = 1;
+        CHECK(wasmify_task_step(task, &done) == WASMIFY_SUCCESS && !done);
+        CHECK(wasmify_task_finish(task, &result) != WASMIFY_SUCCESS);
+        CHECK(result.error && strcmp(result.error, "task cancelled") == 0);
+        wasmify_call_result_free(&result);
+    }
+    wasmify_instance_pool_destroy(pool);
+}
+
+// Calls an executor finishes, and the follow-ups its callbacks submit
+typedef struct {
+    wasmify_executor_t* executor;
+    int64_t sum;
+    int completed;
+    int follow_ups;
+} executor_tally_t;
+
+static void tally_call(wasmify_error_t error, wasmify_call_result_t* result, void* user_data) {
+    executor_tally_t* tally = (executor_tally_t*)user_data;
+    if (error == WASMIFY_SUCCESS && result->values_count == 1) {
+        int32_t n = result->values[0].of.i32;
+        __atomic_add_fetch(&tally->sum, n, __ATOMIC_RELAXED);
+        // Odd counts come back once more as the next even one
+        if (n % 2 == 1) {
+            wasmify_value_t next = { .kind = WASMIFY_VAL_I32, .of.i32 = n + 1 };
+            if (wasmify_executor_submit(tally->executor, "count", &next, 1, tally_call, tally, NULL) == WASMIFY_SUCCESS) {
+                __atomic_add_fetch(&tally->follow_ups, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    __atomic_add_fetch(&tally->completed, 1, __ATOMIC_RELAXED);
+    wasmify_call_result_free(result);
+}
+
+// An executor runs every call it is given, on futures or callbacks, including
+// calls submitted from callbacks before it is destroyed
+static void test_executor_runs_every_call(wasmify_compiled_module_t* loop) {
+    wasmify_executor_config_t config = { .workers = 4 };
+    wasmify_executor_t* executor = wasmify_executor_create(loop, config);
+    CHECK(executor != NULL);
+    if (!executor) return;
+
+    wasmify_future_t* futures[64];
+    for (int i = 0; i < 64; i++) {
+        wasmify_value_t n = { .kind = WASMIFY_VAL_I32, .of.i32 = 1000 * (i + 1) };
+        futures[i] = NULL;
+        CHECK(wasmify_executor_submit(executor, "count", &n, 1, NULL, NULL, &futures[i]) == WASMIFY_SUCCESS);
+    }
+    for (int i = 0; i < 64; i++) {
+        if (!futures[i]) continue;
+        wasmify_call_result_t result;
+        CHECK(wasmify_future_wait(futures[i], &result) == WASMIFY_SUCCESS);
+        CHECK(result.values_count == 1 && result.values[0].of.i32 == 1000 * (i + 1));
+        wasmify_call_result_free(&result);
+    }
+
+    executor_tally_t tally = { .executor = executor };
+    for (int i = 1; i <= 100; i++) {
+        wasmify_value_t n = { .kind = WASMIFY_VAL_I32, .of.i32 = i };
+        CHECK(wasmify_executor_submit(executor, "count", &n, 1, tally_call, &tally, NULL) == WASMIFY_SUCCESS);
+    }
+    wasmify_executor_destroy(executor);
+    // 1..100 plus each odd count again as the even one after it
+    CHECK(tally.follow_ups == 50);
+    CHECK(tally.completed == 150);
+    CHECK(tally.sum == 5050 + 2550);
+}
+
+// Pooled instances start with the memory fresh ones do unless the pool asks for more
+static void test_pool_memory_matches_fresh(wasmify_compiled_module_t* module) {
+    wasmify_result_t result;
+    CHECK(call_text(module, "pages", NULL, 0, &result) == WASMIFY_SUCCESS);
+    CHECK(result.success && result.result && strcmp(result.result, "1") == 0);
+    wasmify_result_free(&result);
+
+    wasmify_pool_config_t config = { 0 };
+    wasmify_instance_pool_t* pool = wasmify_instance_pool_create(module, config);
+    CHECK(pool != NULL);
+    if (pool) {
+        memset(&result, 0, sizeof(result));
+        CHECK(wasmify_pool_execute(pool, "pages", NULL, 0, &result) == WASMIFY_SUCCESS);
+        CHECK(result.success && result.result && strcmp(result.result, "1") == 0);
+        wasmify_result_free(&result);
+        wasmify_instance_pool_destroy(pool);
+    }
+
+    config.memory_min = 3;
+    pool = wasmify_instance_pool_create(module, config);
+    CHECK(pool != NULL);
+    if (pool) {
+        memset(&result, 0, sizeof(result));
+        CHECK(wasmify_pool_execute(pool, "pages", NULL, 0, &result) == WASMIFY_SUCCESS);
+        CHECK(result.success && result.result && strcmp(result.result, "3") == 0);
+        wasmify_result_free(&result);
+        wasmify_instance_pool_destroy(pool);
+    }
+}
+
+// Stage inputs reach the parameter they were added for, from the result they name
+static void test_pipeline_wiring(wasmify_compiled_module_t* module) {
+    wasmify_pipeline_t* pipeline = wasmify_pipeline_create();
+    CHECK(pipeline != NULL);
+    if (!pipeline) return;
+
+    // pair(3) = (4, 30); double(30) = 60; sub(60, 4) = 56; sub(100, 30) = 70
+    size_t pair, twice, diff, rest;
+    CHECK(wasmify_pipeline_add_compiled(pipeline, module, "pair", &pair) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg(pipeline, pair, "3") == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_add_compiled(pipeline, module, "double", &twice) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg_from(pipeline, twice, pair, 1) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_add_compiled(pipeline, module, "sub", &diff) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg_from(pipeline, diff, twice, 0) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg_from(pipeline, diff, pair, 0) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_add_compiled(pipeline, module, "sub", &rest) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg(pipeline, rest, "100") == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_arg_from(pipeline, rest, pair, 1) == WASMIFY_SUCCESS);
+    CHECK(wasmify_pipeline_stage_count(pipeline) == 4);
+
+    // A stage may not take an input from itself or a later stage
+    CHECK(wasmify_pipeline_arg_from(pipeline, twice, twice, 0) != WASMIFY_SUCCESS);
+
+    wasmify_result_t results[4];
+    memset(results, 0, sizeof(results));
+    CHECK(wasmify_pipeline_run_local(pipeline, results) == WASMIFY_SUCCESS);
+    CHECK(results[pair].success && results[pair].result == NULL);
+    CHECK(results[twice].success && results[twice].result == NULL);
+    CHECK(results[diff].success && results[diff].result && strcmp(results[diff].result, "56") == 0);
+    CHECK(results[rest].success && results[rest].result && strcmp(results[rest].result, "70") == 0);
+    for (int i = 0; i < 4; i++) wasmify_result_free(&results[i]);
+    wasmify_pipeline_free(pipeline);
+}
+
+int main(void) {
+    wasmify_compiled_module_t* module = NULL;
+    if (wasmify_module_compile(TEST_MODULE, sizeof(TEST_MODULE), &module) != WASMIFY_SUCCESS) {
+        fprintf(stderr, "wasmify_test: the test module does not compile\n");
+        return 1;
+    }
+    wasmify_compiled_module_t* loop = NULL;
+    if (wasmify_module_compile(LOOP_MODULE, sizeof(LOOP_MODULE), &loop) != WASMIFY_SUCCESS) {
+        fprintf(stderr, "wasmify_test: the loop module does not compile\n");
+        return 1;
+    }
+
+    test_subnormal_arguments(module);
+    test_integer_arguments(module);
+    test_fuel_deadlines_and_tasks(loop);
+    test_executor_runs_every_call(loop);
+    test_pool_memory_matches_fresh(module);
+    test_pipeline_wiring(module);
+    test_result_cache_keeps_only_successes();
+    test_unpooled_client_keeps_its_connection();
+    test_module_iterator_follows_pages();
+    test_async_calls_on_many_sockets();
+    test_execute_rejects_bad_argument_counts();
+    test_binary_wire_format();
+    test_batch_results_per_invocation();
+    test_arena_results_until_reset();
+    test_chunked_upload();
+    test_stored_upload_sends_nothing();
+
+    wasmify_module_release(loop);
+    wasmify_module_release(module);
+    if (g_failures > 0) {
+        fprintf(stderr, "wasmify_test: %d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("wasmify_test: all checks passed\n");
+    return 0;
+}
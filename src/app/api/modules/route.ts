@@ -1,9 +1,36 @@
 import { NextRequest, NextResponse } from 'next/server'
 import { db } from '@/lib/db'
+import { encodedJson } from '@/lib/content-encoding'
 
-export async function GET() {
+const DEFAULT_PAGE_SIZE = 100
+const MAX_PAGE_SIZE = 1000
+
+/**
+ * List modules newest first. name and version filter by prefix. Given a
+ * limit or a cursor the listing comes a page at a time: pagination.nextCursor,
+ * passed back as cursor, picks up after the page and is null on the last one.
+ * Any module ID works as a cursor. Without either, every module is listed.
+ */
+export async function GET(request: NextRequest) {
   try {
+    const { searchParams } = new URL(request.url)
+    const name = searchParams.get('name') || ''
+    const version = searchParams.get('version') || ''
+    const cursor = searchParams.get('cursor') || ''
+    const paged = searchParams.has('limit') || cursor !== ''
+    const requested = parseInt(searchParams.get('limit') || String(DEFAULT_PAGE_SIZE))
+    const limit = Math.min(Math.max(requested || DEFAULT_PAGE_SIZE, 1), MAX_PAGE_SIZE)
+
+    const where: any = {}
+    if (name) {
+      where.name = { startsWith: name }
+    }
+    if (version) {
+      where.version = { startsWith: version }
+    }
+
     const modules = await db.wasmModule.findMany({
+      where,
       include: {
         author: {
           select: {
@@ -28,14 +55,29 @@ export async function GET() {
           }
         }
       },
-      orderBy: {
-        createdAt: 'desc'
-      }
+      orderBy: [{ createdAt: 'desc' }, { id: 'desc' }],
+      // One more than the page shows whether another page follows
+      ...(paged ? { take: limit + 1 } : {}),
+      ...(cursor ? { cursor: { id: cursor }, skip: 1 } : {})
     })
 
-    return NextResponse.json({
+    if (!paged) {
+      return encodedJson(request, { success: true, data: modules })
+    }
+
+    const hasMore = modules.length > limit
+    if (hasMore) {
+      modules.pop()
+    }
+
+    // data stays the array of modules older clients expect
+    return encodedJson(request, {
       success: true,
-      data: modules
+      data: modules,
+      pagination: {
+        limit,
+        nextCursor: hasMore ? modules[modules.length - 1].id : null
+      }
     })
   } catch (error) {
     console.error('Error fetching modules:', error)
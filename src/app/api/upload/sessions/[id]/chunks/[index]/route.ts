@@ -0,0 +1,49 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { uploadSessions } from '@/lib/upload-sessions'
+import { bodyErrorResponse, decodedBody } from '@/lib/content-encoding'
+
+/**
+ * Receive one chunk of an upload as the raw request body. The body is
+ * streamed to disk, so chunks may arrive in any order and in parallel, and
+ * may be sent with a Content-Encoding.
+ */
+export async function PUT(
+  request: NextRequest,
+  { params }: { params: { id: string; index: string } }
+) {
+  if (!request.body) {
+    return NextResponse.json(
+      { success: false, error: 'No chunk data provided' },
+      { status: 400 }
+    )
+  }
+
+  try {
+    await uploadSessions.get(params.id)
+  } catch (error) {
+    return NextResponse.json(
+      { success: false, error: 'Upload session not found' },
+      { status: 404 }
+    )
+  }
+
+  try {
+    const index = Number(params.index)
+    await uploadSessions.writeChunk(params.id, index, decodedBody(request))
+
+    return NextResponse.json({
+      success: true,
+      data: { index }
+    })
+  } catch (error) {
+    const bodyError = bodyErrorResponse(error)
+    if (bodyError) {
+      return bodyError
+    }
+    console.error('Upload chunk error:', error)
+    return NextResponse.json(
+      { success: false, error: error.message || 'Failed to upload chunk' },
+      { status: 400 }
+    )
+  }
+}
@@ -0,0 +1,55 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { fileStorage } from '@/lib/file-storage'
+import { uploadSessions } from '@/lib/upload-sessions'
+
+/**
+ * Finish a chunked upload: join the chunks, store the module under its
+ * digest and drop the session. Fails with the missing chunk count if any
+ * chunk is outstanding. A module stored meanwhile is only acknowledged, and
+ * its session was already dropped by the upload that stored it.
+ */
+export async function POST(
+  request: NextRequest,
+  { params }: { params: { id: string } }
+) {
+  if (await uploadSessions.findModule(params.id)) {
+    return NextResponse.json({ success: true, data: uploadSessions.storedModuleReply(params.id) })
+  }
+
+  let assembled
+  try {
+    assembled = await uploadSessions.assemble(params.id)
+  } catch (error) {
+    return NextResponse.json(
+      { success: false, error: error.message || 'Upload session not found' },
+      { status: 409 }
+    )
+  }
+
+  try {
+    const { session, path } = assembled
+    const result = await fileStorage.uploadWasmStream(path, session.fileName, session.sha256)
+    const module = {
+      ...result,
+      moduleId: session.sha256.substring(0, 16),
+      sha256: session.sha256,
+      name: session.name,
+      version: session.version,
+      originalName: session.fileName,
+      uploadedAt: new Date().toISOString()
+    }
+    await uploadSessions.saveModule(session.sha256, module)
+    await uploadSessions.remove(params.id)
+
+    return NextResponse.json({
+      success: true,
+      data: module
+    })
+  } catch (error) {
+    console.error('Complete upload error:', error)
+    return NextResponse.json(
+      { success: false, error: error.message || 'Failed to complete upload' },
+      { status: 500 }
+    )
+  }
+}
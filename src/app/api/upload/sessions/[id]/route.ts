@@ -0,0 +1,40 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { uploadSessions } from '@/lib/upload-sessions'
+
+export async function GET(
+  request: NextRequest,
+  { params }: { params: { id: string } }
+) {
+  try {
+    const session = await uploadSessions.status(params.id)
+
+    return NextResponse.json({
+      success: true,
+      data: session
+    })
+  } catch (error) {
+    return NextResponse.json(
+      { success: false, error: 'Upload session not found' },
+      { status: 404 }
+    )
+  }
+}
+
+export async function DELETE(
+  request: NextRequest,
+  { params }: { params: { id: string } }
+) {
+  try {
+    await uploadSessions.remove(params.id)
+
+    return NextResponse.json({
+      success: true,
+      message: 'Upload session cancelled'
+    })
+  } catch (error) {
+    return NextResponse.json(
+      { success: false, error: 'Upload session not found' },
+      { status: 404 }
+    )
+  }
+}
@@ -0,0 +1,62 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { uploadSessions } from '@/lib/upload-sessions'
+import { bodyErrorResponse, readJson } from '@/lib/content-encoding'
+
+/**
+ * Start a chunked upload from the module's SHA-256 and chunk list. For a
+ * module the server already has, `module` says so with just its ID, since
+ * stating a digest is no proof of owning the stored record; otherwise the
+ * reply lists the chunks it already has, from this upload or any other.
+ */
+export async function POST(request: NextRequest) {
+  try {
+    const body = await readJson(request)
+    const { fileName, size, sha256, chunks, name, version } = body
+
+    if (!fileName || typeof size !== 'number' || !sha256 || !Array.isArray(chunks)) {
+      return NextResponse.json(
+        { success: false, error: 'fileName, size, sha256 and chunks are required' },
+        { status: 400 }
+      )
+    }
+
+    if (!fileName.endsWith('.wasm')) {
+      return NextResponse.json(
+        { success: false, error: 'Invalid file type. Only WebAssembly files are allowed.' },
+        { status: 400 }
+      )
+    }
+
+    if (await uploadSessions.findModule(sha256)) {
+      return NextResponse.json({
+        success: true,
+        data: { uploadId: sha256, module: uploadSessions.storedModuleReply(sha256) }
+      })
+    }
+
+    let session
+    try {
+      session = await uploadSessions.create({ fileName, size, sha256, chunks, name, version })
+    } catch (error) {
+      return NextResponse.json(
+        { success: false, error: error.message },
+        { status: 400 }
+      )
+    }
+
+    return NextResponse.json({
+      success: true,
+      data: session
+    })
+  } catch (error) {
+    const bodyError = bodyErrorResponse(error)
+    if (bodyError) {
+      return bodyError
+    }
+    console.error('Create upload session error:', error)
+    return NextResponse.json(
+      { success: false, error: error.message || 'Failed to create upload session' },
+      { status: 500 }
+    )
+  }
+}
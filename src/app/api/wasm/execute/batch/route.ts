@@ -0,0 +1,74 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { wasmRuntime } from '@/lib/wasm-runtime'
+import { idempotency } from '@/lib/idempotency'
+import { bodyErrorResponse, encodedJson, readJson } from '@/lib/content-encoding'
+
+const MAX_BATCH_SIZE = 1000
+
+async function executeBatch(request: NextRequest) {
+  try {
+    const { moduleId, functionName, invocations, config = {} } = await readJson(request)
+
+    if (!moduleId || !functionName) {
+      return NextResponse.json(
+        { success: false, error: 'moduleId and functionName are required' },
+        { status: 400 }
+      )
+    }
+
+    if (!Array.isArray(invocations) || !invocations.every(Array.isArray)) {
+      return NextResponse.json(
+        { success: false, error: 'invocations must be an array of argument arrays' },
+        { status: 400 }
+      )
+    }
+
+    if (invocations.length > MAX_BATCH_SIZE) {
+      return NextResponse.json(
+        { success: false, error: `A batch may contain at most ${MAX_BATCH_SIZE} invocations` },
+        { status: 400 }
+      )
+    }
+
+    if (!wasmRuntime.hasModule(moduleId)) {
+      return NextResponse.json(
+        { success: false, error: `Module ${moduleId} not found` },
+        { status: 404 }
+      )
+    }
+
+    // Invocations run in order and each gets its own result, so one failing
+    // call doesn't fail the rest of the batch
+    const results = []
+    for (const args of invocations) {
+      results.push(await wasmRuntime.executeFunction(moduleId, functionName, args, config))
+    }
+
+    return encodedJson(request, {
+      success: true,
+      data: {
+        moduleId,
+        results,
+        stats: wasmRuntime.getStats()
+      }
+    })
+  } catch (error) {
+    const bodyError = bodyErrorResponse(error)
+    if (bodyError) {
+      return bodyError
+    }
+    console.error('WebAssembly batch execution error:', error)
+    return NextResponse.json(
+      {
+        success: false,
+        error: error.message || 'Failed to execute WebAssembly batch'
+      },
+      { status: 500 }
+    )
+  }
+}
+
+// Retries carrying the Idempotency-Key of an earlier request get its response
+export async function POST(request: NextRequest) {
+  return idempotency.run(request, 'execute/batch', () => executeBatch(request))
+}
@@ -0,0 +1,130 @@
+import { NextRequest, NextResponse } from 'next/server'
+import { wasmRuntime } from '@/lib/wasm-runtime'
+import { idempotency } from '@/lib/idempotency'
+import { bodyErrorResponse, encodedJson, readJson } from '@/lib/content-encoding'
+
+const MAX_PIPELINE_STAGES = 64
+
+// An argument taken from the result of an earlier stage
+interface StageInput {
+  stage: number
+  result: number
+}
+
+function isInput(arg: any): arg is StageInput {
+  return arg !== null && typeof arg === 'object' && Number.isInteger(arg.stage) && Number.isInteger(arg.result)
+}
+
+// Stages may only take inputs from stages before them, which keeps the
+// graph acyclic and makes the order they are listed in a valid run order
+function stageError(stages: any[]): string | null {
+  if (!Array.isArray(stages) || stages.length === 0) {
+    return 'stages must be a non-empty array'
+  }
+  if (stages.length > MAX_PIPELINE_STAGES) {
+    return `A pipeline may contain at most ${MAX_PIPELINE_STAGES} stages`
+  }
+  for (let i = 0; i < stages.length; i++) {
+    const { moduleId, functionName, args = [] } = stages[i] || {}
+    if (!moduleId || !functionName || !Array.isArray(args)) {
+      return `Stage ${i} needs a moduleId, a functionName and an args array`
+    }
+    for (const arg of args) {
+      if (typeof arg === 'object' && arg !== null && (!isInput(arg) || arg.stage < 0 || arg.stage >= i || arg.result < 0)) {
+        return `Stage ${i} takes an input that is not a result of an earlier stage`
+      }
+    }
+  }
+  return null
+}
+
+// How many values a stage's result holds; functions with several results return an array
+function resultCount(result: any): number {
+  if (Array.isArray(result)) return result.length
+  return result === undefined ? 0 : 1
+}
+
+function resultValue(result: any, index: number): any {
+  return Array.isArray(result) ? result[index] : result
+}
+
+async function executePipeline(request: NextRequest) {
+  try {
+    const { stages, config = {} } = await readJson(request)
+
+    const invalid = stageError(stages)
+    if (invalid) {
+      return NextResponse.json({ success: false, error: invalid }, { status: 400 })
+    }
+
+    for (const { moduleId } of stages) {
+      if (!wasmRuntime.hasModule(moduleId)) {
+        return NextResponse.json(
+          { success: false, error: `Module ${moduleId} not found` },
+          { status: 404 }
+        )
+      }
+    }
+
+    // Intermediate results are handed to the stages that take them as they
+    // are and never sent back; only stages nothing else consumes report one
+    const consumed = new Set<number>()
+    for (const { args = [] } of stages) {
+      for (const arg of args) {
+        if (isInput(arg)) consumed.add(arg.stage)
+      }
+    }
+
+    const outputs = []
+    const results = []
+    for (let i = 0; i < stages.length; i++) {
+      const { moduleId, functionName, args = [] } = stages[i]
+      const failed = args.find(arg => isInput(arg) && !outputs[arg.stage].success)
+      // Result counts are only known once a stage has run
+      const missing = args.find(arg => isInput(arg) && outputs[arg.stage].success &&
+        arg.result >= resultCount(outputs[arg.stage].result))
+      if (missing) {
+        return NextResponse.json(
+          { success: false, error: `Stage ${i} takes result ${missing.result} of stage ${missing.stage}, which has only ${resultCount(outputs[missing.stage].result)}` },
+          { status: 400 }
+        )
+      }
+      const result = failed
+        ? { result: null, executionTime: 0, memoryUsed: 0, instructions: 0, success: false, error: `Stage ${failed.stage} failed` }
+        : await wasmRuntime.executeFunction(
+          moduleId,
+          functionName,
+          args.map(arg => isInput(arg) ? resultValue(outputs[arg.stage].result, arg.result) : arg),
+          config
+        )
+      outputs.push(result)
+      results.push(consumed.has(i) && result.success ? { ...result, result: null } : result)
+    }
+
+    return encodedJson(request, {
+      success: true,
+      data: {
+        results,
+        stats: wasmRuntime.getStats()
+      }
+    })
+  } catch (error) {
+    const bodyError = bodyErrorResponse(error)
+    if (bodyError) {
+      return bodyError
+    }
+    console.error('WebAssembly pipeline execution error:', error)
+    return NextResponse.json(
+      {
+        success: false,
+        error: error.message || 'Failed to execute WebAssembly pipeline'
+      },
+      { status: 500 }
+    )
+  }
+}
+
+// Retries carrying the Idempotency-Key of an earlier request get its response
+export async function POST(request: NextRequest) {
+  return idempotency.run(request, 'execute/pipeline', () => executePipeline(request))
+}
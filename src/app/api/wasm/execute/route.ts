@@ -1,11 +1,66 @@
 import { NextRequest, NextResponse } from 'next/server'
 import { wasmRuntime } from '@/lib/wasm-runtime'
+import { idempotency } from '@/lib/idempotency'
+import { FRAME_CONTENT_TYPE, decodeExecuteFrame, encodeResultFrame, isFrameRequest } from '@/lib/wire-format'
+import { bodyErrorResponse, encodedResponse, readBody } from '@/lib/content-encoding'
 import { writeFile, mkdir, unlink } from 'fs/promises'
 import path from 'path'
 import { join } from 'path'
 
-export async function POST(request: NextRequest) {
+// Seconds clients may reuse the result of a pure function
+const PURE_RESULT_MAX_AGE = 86400
+
+// Server-Timing header telling clients how long the function itself ran
+function serverTiming(result: { executionTime: number }): string {
+  return `execute;dur=${result.executionTime.toFixed(3)}`
+}
+
+// Execute a loaded module from a binary frame and answer with a frame
+async function executeFrame(request: NextRequest) {
+  const body = await readBody(request)
+
+  let frame
+  try {
+    frame = decodeExecuteFrame(body)
+  } catch (error) {
+    return NextResponse.json(
+      { success: false, error: `Malformed execute frame: ${error.message}` },
+      { status: 400 }
+    )
+  }
+
+  if (!wasmRuntime.hasModule(frame.moduleId)) {
+    return NextResponse.json(
+      { success: false, error: `Module ${frame.moduleId} not found` },
+      { status: 404 }
+    )
+  }
+
+  const result = await wasmRuntime.executeFunction(
+    frame.moduleId,
+    frame.functionName,
+    frame.args,
+    frame.config
+  )
+
+  // Module IDs are content hashes, so results of pure functions never go stale
+  const headers: Record<string, string> = {
+    'Content-Type': FRAME_CONTENT_TYPE,
+    'Server-Timing': serverTiming(result)
+  }
+  if (result.success && wasmRuntime.isPure(frame.moduleId, frame.functionName)) {
+    headers['Cache-Control'] = `private, max-age=${PURE_RESULT_MAX_AGE}`
+  }
+
+  return encodedResponse(request, encodeResultFrame(result), { headers })
+}
+
+async function execute(request: NextRequest) {
   try {
+    if (isFrameRequest(request.headers.get('content-type'))) {
+      return await executeFrame(request)
+    }
+
     const formData = await request.formData()
     const wasmFile = formData.get('wasmFile') as File
     const functionName = formData.get('functionName') as string
@@ -59,6 +114,8 @@ export async function POST(request: NextRequest) {
           result,
           stats: wasmRuntime.getStats()
         }
+      }, {
+        headers: { 'Server-Timing': serverTiming(result) }
       })
     } catch (error) {
       // Clean up temporary file on error
@@ -70,6 +127,10 @@ export async function POST(request: NextRequest) {
       throw error
     }
   } catch (error) {
+    const bodyError = bodyErrorResponse(error)
+    if (bodyError) {
+      return bodyError
+    }
     console.error('WebAssembly execution error:', error)
     return NextResponse.json(
       { 
@@ -79,4 +140,9 @@ export async function POST(request: NextRequest) {
       { status: 500 }
     )
   }
-}
\ No newline at end of file
+}
+
+// Retries carrying the Idempotency-Key of an earlier request get its response
+export async function POST(request: NextRequest) {
+  return idempotency.run(request, 'execute', () => execute(request))
+}
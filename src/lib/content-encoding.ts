@@ -0,0 +1,128 @@
+import { NextResponse } from 'next/server'
+import { Readable, Transform } from 'stream'
+import zlib from 'zlib'
+
+/**
+ * Content-Encoding of API bodies. Requests may arrive gzip or zstd encoded
+ * and responses are encoded for clients that accept it. zstd needs a Node.js
+ * whose zlib provides it; elsewhere zstd requests are refused with 415 and
+ * responses fall back to gzip.
+ */
+export const MIN_ENCODED_SIZE = 1024
+export const MAX_DECODED_BODY = 64 * 1024 * 1024
+
+const zstd = zlib as any
+const HAS_ZSTD = typeof zstd.createZstdDecompress === 'function'
+
+export class BodyEncodingError extends Error {
+  constructor(message: string, public status: number) {
+    super(message)
+  }
+}
+
+function decoderFor(encoding: string): Transform | null {
+  switch (encoding) {
+    case '':
+    case 'identity':
+      return null
+    case 'gzip':
+    case 'x-gzip':
+      return zlib.createGunzip()
+    case 'zstd':
+      if (HAS_ZSTD) return zstd.createZstdDecompress()
+  }
+  throw new BodyEncodingError(`Unsupported Content-Encoding: ${encoding}`, 415)
+}
+
+/**
+ * The request body as a stream, decoded per its Content-Encoding
+ */
+export function decodedBody(request: Request): Readable {
+  if (!request.body) {
+    return Readable.from([])
+  }
+  const encoding = (request.headers.get('content-encoding') || '').trim().toLowerCase()
+  const decoder = decoderFor(encoding)
+  const body = Readable.fromWeb(request.body as any)
+  return decoder ? body.pipe(decoder) : body
+}
+
+/**
+ * Read the whole decoded request body, refusing more than limit bytes
+ */
+export async function readBody(request: Request, limit: number = MAX_DECODED_BODY): Promise<Buffer> {
+  const chunks: Buffer[] = []
+  let size = 0
+  try {
+    for await (const chunk of decodedBody(request)) {
+      size += chunk.length
+      if (size > limit) {
+        throw new BodyEncodingError(`Request body exceeds ${limit} bytes`, 413)
+      }
+      chunks.push(chunk)
+    }
+  } catch (error) {
+    if (error instanceof BodyEncodingError) throw error
+    throw new BodyEncodingError(`Malformed request body: ${error.message}`, 400)
+  }
+  return Buffer.concat(chunks)
+}
+
+export async function readJson(request: Request): Promise<any> {
+  const body = await readBody(request)
+  try {
+    return JSON.parse(body.toString('utf8'))
+  } catch (error) {
+    throw new BodyEncodingError('Malformed JSON body', 400)
+  }
+}
+
+/**
+ * Error response for a body that could not be read, or null for other errors
+ */
+export function bodyErrorResponse(error: any): NextResponse | null {
+  if (!(error instanceof BodyEncodingError)) {
+    return null
+  }
+  return NextResponse.json(
+    { success: false, error: error.message },
+    { status: error.status }
+  )
+}
+
+function acceptedEncoding(request: Request): string | null {
+  const accepted = (request.headers.get('accept-encoding') || '').toLowerCase()
+  const offers = accepted.split(',').map(part => part.trim().split(';')[0])
+  if (HAS_ZSTD && offers.includes('zstd')) return 'zstd'
+  if (offers.includes('gzip')) return 'gzip'
+  return null
+}
+
+/**
+ * A response whose body is encoded with the best encoding the client accepts
+ */
+export function encodedResponse(
+  request: Request,
+  body: Buffer,
+  init: { status?: number; headers?: Record<string, string> } = {}
+): NextResponse {
+  const headers: Record<string, string> = { ...init.headers, Vary: 'Accept-Encoding' }
+  const encoding = body.length >= MIN_ENCODED_SIZE ? acceptedEncoding(request) : null
+
+  if (encoding === 'zstd') {
+    body = zstd.zstdCompressSync(body)
+    headers['Content-Encoding'] = 'zstd'
+  } else if (encoding === 'gzip') {
+    body = zlib.gzipSync(body, { level: 6 })
+    headers['Content-Encoding'] = 'gzip'
+  }
+
+  return new NextResponse(body, { status: init.status, headers })
+}
+
+export function encodedJson(request: Request, data: any, init: { status?: number } = {}): NextResponse {
+  return encodedResponse(request, Buffer.from(JSON.stringify(data)), {
+    status: init.status,
+    headers: { 'Content-Type': 'application/json' }
+  })
+}
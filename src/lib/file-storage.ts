@@ -1,6 +1,8 @@
 import { S3Client, PutObjectCommand, GetObjectCommand, DeleteObjectCommand } from '@aws-sdk/client-s3'
 import { getSignedUrl } from '@aws-sdk/s3-request-presigner'
 import crypto from 'crypto'
+import { createReadStream } from 'fs'
+import { open } from 'fs/promises'
 
 export interface FileUploadResult {
   key: string
@@ -72,6 +74,53 @@ export class FileStorageService {
     return this.uploadFile(file, fileName, 'application/wasm', 'wasm-modules')
   }
 
+  /**
+   * Upload a WebAssembly file from disk without reading it into memory.
+   * With its SHA-256 the file is stored under a key derived from it.
+   */
+  async uploadWasmStream(filePath: string, fileName: string, sha256?: string): Promise<FileUploadResult> {
+    const handle = await open(filePath, 'r')
+    let size: number
+    try {
+      const header = Buffer.alloc(8)
+      await handle.read(header, 0, 8, 0)
+      size = (await handle.stat()).size
+      this.validateWasmHeader(header, size)
+    } finally {
+      await handle.close()
+    }
+
+    try {
+      const key = sha256
+        ? `wasm-modules/sha256/${sha256}.wasm`
+        : `wasm-modules/${this.generateFileName(fileName)}`
+
+      const command = new PutObjectCommand({
+        Bucket: this.bucketName,
+        Key: key,
+        Body: createReadStream(filePath),
+        ContentLength: size,
+        ContentType: 'application/wasm',
+        Metadata: {
+          originalName: fileName,
+          uploadedAt: new Date().toISOString(),
+        },
+      })
+
+      const result = await this.s3Client.send(command)
+
+      return {
+        key,
+        url: `https://${this.bucketName}.s3.${process.env.AWS_REGION}.amazonaws.com/${key}`,
+        etag: result.ETag || '',
+        size,
+        contentType: 'application/wasm',
+      }
+    } catch (error) {
+      throw new Error(`Failed to upload file: ${error.message}`)
+    }
+  }
+
   /**
    * Get a presigned URL for file upload
    */
@@ -133,26 +182,33 @@ export class FileStorageService {
    * Validate WebAssembly file
    */
   private validateWasmFile(file: Buffer): void {
-    if (file.length < 8) {
+    this.validateWasmHeader(file, file.length)
+  }
+
+  /**
+   * Validate the size and first bytes of a WebAssembly file
+   */
+  private validateWasmHeader(header: Buffer, size: number): void {
+    if (size < 8 || header.length < 8) {
       throw new Error('File too small to be a valid WebAssembly module')
     }
 
+    // Check file size (max 100MB)
+    if (size > 100 * 1024 * 1024) {
+      throw new Error('WebAssembly file too large (max 100MB)')
+    }
+
     // Check WebAssembly magic number
-    const magic = file.readUInt32LE(0)
+    const magic = header.readUInt32LE(0)
     if (magic !== 0x6d736100) {
       throw new Error('Invalid WebAssembly file: wrong magic number')
     }
 
     // Check WebAssembly version
-    const version = file.readUInt32LE(4)
+    const version = header.readUInt32LE(4)
     if (version !== 1) {
       throw new Error(`Unsupported WebAssembly version: ${version}`)
     }
-
-    // Check file size (max 100MB)
-    if (file.length > 100 * 1024 * 1024) {
-      throw new Error('WebAssembly file too large (max 100MB)')
-    }
   }
 
   /**
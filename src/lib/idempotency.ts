@@ -0,0 +1,80 @@
+import { NextResponse } from 'next/server'
+
+export const IDEMPOTENCY_TTL_MS = 10 * 60 * 1000
+export const MAX_IDEMPOTENCY_ENTRIES = 10000
+
+const KEY = /^[\x21-\x7e]{1,255}$/
+
+interface StoredResponse {
+  status: number
+  headers: [string, string][]
+  body: ArrayBuffer
+}
+
+function replay(stored: StoredResponse): NextResponse {
+  const headers = new Headers(stored.headers)
+  headers.set('Idempotent-Replayed', 'true')
+  return new NextResponse(stored.body, { status: stored.status, headers })
+}
+
+/**
+ * Responses remembered by the Idempotency-Key their request carried, so that
+ * a client retrying a call whose answer it never got is answered again
+ * without the function running twice. A retry that arrives while the first
+ * attempt is still running waits for its response. Keys are scoped to the
+ * caller's credentials and the route; responses that ask for a retry, 429
+ * and 5xx, are not remembered.
+ */
+export class IdempotencyStore {
+  private entries = new Map<string, { expires: number; response: Promise<StoredResponse | null> }>()
+
+  // Entries are added in the order they expire in
+  private expire(now: number) {
+    for (const [scope, entry] of this.entries) {
+      if (entry.expires > now && this.entries.size <= MAX_IDEMPOTENCY_ENTRIES) break
+      this.entries.delete(scope)
+    }
+  }
+
+  async run(request: Request, route: string, handler: () => Promise<Response>): Promise<Response> {
+    const key = request.headers.get('idempotency-key')
+    if (!key || !KEY.test(key)) {
+      return handler()
+    }
+
+    const now = Date.now()
+    this.expire(now)
+    const scope = `${request.headers.get('authorization') || ''}\n${route}\n${key}`
+    const existing = this.entries.get(scope)
+    if (existing) {
+      const stored = await existing.response
+      if (stored) return replay(stored)
+    }
+
+    let settle: (stored: StoredResponse | null) => void = () => {}
+    const response = new Promise<StoredResponse | null>(resolve => { settle = resolve })
+    this.entries.set(scope, { expires: now + IDEMPOTENCY_TTL_MS, response })
+
+    try {
+      const answer = await handler()
+      if (answer.status === 429 || answer.status >= 500) {
+        this.entries.delete(scope)
+        settle(null)
+        return answer
+      }
+      const stored: StoredResponse = {
+        status: answer.status,
+        headers: Array.from(answer.headers.entries()),
+        body: await answer.arrayBuffer()
+      }
+      settle(stored)
+      return new NextResponse(stored.body, { status: stored.status, headers: new Headers(stored.headers) })
+    } catch (error) {
+      this.entries.delete(scope)
+      settle(null)
+      throw error
+    }
+  }
+}
+
+export const idempotency = new IdempotencyStore()
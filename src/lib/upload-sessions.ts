@@ -0,0 +1,265 @@
+import crypto from 'crypto'
+import { createReadStream, createWriteStream } from 'fs'
+import { access, mkdir, readFile, rename, rm, writeFile } from 'fs/promises'
+import { join } from 'path'
+import { Readable, Transform } from 'stream'
+import { pipeline } from 'stream/promises'
+
+export const MAX_CHUNK_SIZE = 64 * 1024 * 1024
+// The module size limit /api/upload enforces
+export const MAX_UPLOAD_SIZE = 100 * 1024 * 1024
+export const MAX_CHUNK_COUNT = 16384
+
+export interface UploadChunk {
+  hash: string
+  size: number
+}
+
+export interface UploadSession {
+  uploadId: string
+  fileName: string
+  name?: string
+  version?: string
+  size: number
+  sha256: string
+  chunks: UploadChunk[]
+  createdAt: string
+}
+
+export interface UploadStatus extends UploadSession {
+  received: number[]
+}
+
+const DIGEST = /^[0-9a-f]{64}$/
+
+/**
+ * Content-addressed chunked uploads kept on local disk. A session is named
+ * by the SHA-256 of the whole module and lists its chunks by their own
+ * SHA-256; chunks live in one store shared by every upload, so a module
+ * that changed only in places needs just the chunks that are new. Modules
+ * already stored are recorded by digest and never need uploading again.
+ */
+export class UploadSessionStore {
+  private root = join(process.cwd(), 'uploads')
+
+  private sessionDir(uploadId: string): string {
+    if (!DIGEST.test(uploadId)) {
+      throw new Error('Invalid upload ID')
+    }
+    return join(this.root, 'sessions', uploadId)
+  }
+
+  private chunkPath(hash: string): string {
+    return join(this.root, 'chunks', hash.substring(0, 2), hash)
+  }
+
+  private modulePath(sha256: string): string {
+    return join(this.root, 'modules', `${sha256}.json`)
+  }
+
+  /**
+   * The stored module with this digest, if there is one
+   */
+  async findModule(sha256: string): Promise<any | null> {
+    if (!DIGEST.test(sha256)) {
+      return null
+    }
+    try {
+      return JSON.parse(await readFile(this.modulePath(sha256), 'utf8'))
+    } catch (error) {
+      return null
+    }
+  }
+
+  /**
+   * What a caller who only states the digest of a stored module is told about it
+   */
+  storedModuleReply(sha256: string): { alreadyStored: true; moduleId: string; sha256: string } {
+    return { alreadyStored: true, moduleId: sha256.substring(0, 16), sha256 }
+  }
+
+  /**
+   * Record a stored module under its digest
+   */
+  async saveModule(sha256: string, module: any): Promise<void> {
+    await mkdir(join(this.root, 'modules'), { recursive: true })
+    const partial = `${this.modulePath(sha256)}.${crypto.randomBytes(4).toString('hex')}.tmp`
+    await writeFile(partial, JSON.stringify(module))
+    await rename(partial, this.modulePath(sha256))
+  }
+
+  /**
+   * Start the upload of a module described by its chunk list, or pick up
+   * the one already started for the same content
+   */
+  async create(options: {
+    fileName: string
+    size: number
+    sha256: string
+    chunks: UploadChunk[]
+    name?: string
+    version?: string
+  }): Promise<UploadStatus> {
+    const { size, sha256, chunks } = options
+    if (!Number.isSafeInteger(size) || size <= 0 || size > MAX_UPLOAD_SIZE) {
+      throw new Error(`Upload size must be between 1 byte and ${MAX_UPLOAD_SIZE} bytes`)
+    }
+    if (typeof sha256 !== 'string' || !DIGEST.test(sha256)) {
+      throw new Error('sha256 must be a hex SHA-256 digest')
+    }
+    if (!Array.isArray(chunks) || chunks.length === 0 || chunks.length > MAX_CHUNK_COUNT) {
+      throw new Error(`Upload must have between 1 and ${MAX_CHUNK_COUNT} chunks`)
+    }
+
+    let total = 0
+    for (const chunk of chunks) {
+      if (!chunk || typeof chunk.hash !== 'string' || !DIGEST.test(chunk.hash) ||
+          !Number.isSafeInteger(chunk.size) || chunk.size <= 0 || chunk.size > MAX_CHUNK_SIZE) {
+        throw new Error(`Chunks must have a hex SHA-256 hash and a size of at most ${MAX_CHUNK_SIZE} bytes`)
+      }
+      total += chunk.size
+    }
+    if (total !== size) {
+      throw new Error(`Chunk sizes add up to ${total} bytes, expected ${size}`)
+    }
+
+    try {
+      const existing = await this.get(sha256)
+      if (existing.chunks.length === chunks.length &&
+          existing.chunks.every((chunk, i) => chunk.hash === chunks[i].hash)) {
+        return await this.status(sha256)
+      }
+    } catch (error) {
+      // No upload of this content yet
+    }
+
+    const session: UploadSession = {
+      uploadId: sha256,
+      fileName: options.fileName,
+      name: options.name,
+      version: options.version,
+      size,
+      sha256,
+      chunks: chunks.map(({ hash, size }) => ({ hash, size })),
+      createdAt: new Date().toISOString()
+    }
+
+    await mkdir(this.sessionDir(sha256), { recursive: true })
+    await writeFile(join(this.sessionDir(sha256), 'session.json'), JSON.stringify(session))
+
+    return this.status(sha256)
+  }
+
+  async get(uploadId: string): Promise<UploadSession> {
+    return JSON.parse(await readFile(join(this.sessionDir(uploadId), 'session.json'), 'utf8'))
+  }
+
+  private async hasChunk(hash: string): Promise<boolean> {
+    try {
+      await access(this.chunkPath(hash))
+      return true
+    } catch (error) {
+      return false
+    }
+  }
+
+  /**
+   * Session details with the indexes of the chunks the server already has,
+   * whichever upload they came with
+   */
+  async status(uploadId: string): Promise<UploadStatus> {
+    const session = await this.get(uploadId)
+    const present = await Promise.all(session.chunks.map(chunk => this.hasChunk(chunk.hash)))
+    const received = present.flatMap((has, index) => (has ? [index] : []))
+    return { ...session, received }
+  }
+
+  /**
+   * Stream one chunk into the chunk store. It is only stored once it is
+   * complete and matches the hash it was announced with. The body must
+   * already be decoded, since hashes are taken over the chunk contents.
+   */
+  async writeChunk(uploadId: string, index: number, body: Readable): Promise<void> {
+    const session = await this.get(uploadId)
+    if (!Number.isInteger(index) || index < 0 || index >= session.chunks.length) {
+      throw new Error(`Chunk index must be between 0 and ${session.chunks.length - 1}`)
+    }
+
+    const expected = session.chunks[index]
+    const target = this.chunkPath(expected.hash)
+    await mkdir(join(target, '..'), { recursive: true })
+    const partial = `${target}.${crypto.randomBytes(4).toString('hex')}.tmp`
+
+    const hash = crypto.createHash('sha256')
+    let size = 0
+    const measure = new Transform({
+      transform(data, encoding, callback) {
+        size += data.length
+        if (size > expected.size) {
+          callback(new Error(`Chunk ${index} is larger than ${expected.size} bytes`))
+          return
+        }
+        hash.update(data)
+        callback(null, data)
+      }
+    })
+
+    try {
+      await pipeline(body, measure, createWriteStream(partial))
+      if (size !== expected.size) {
+        throw new Error(`Chunk ${index} has ${size} bytes, expected ${expected.size}`)
+      }
+      if (hash.digest('hex') !== expected.hash) {
+        throw new Error(`Chunk ${index} does not match its hash`)
+      }
+      await rename(partial, target)
+    } catch (error) {
+      await rm(partial, { force: true })
+      throw error
+    }
+  }
+
+  /**
+   * Join the chunks of a finished upload into one file and check it against
+   * the digest of the whole module
+   */
+  async assemble(uploadId: string): Promise<{ session: UploadSession; path: string }> {
+    const { received, ...session } = await this.status(uploadId)
+    if (received.length !== session.chunks.length) {
+      const missing = session.chunks.length - received.length
+      throw new Error(`Upload is missing ${missing} of ${session.chunks.length} chunks`)
+    }
+
+    const path = join(this.sessionDir(uploadId), `${crypto.randomBytes(4).toString('hex')}.wasm`)
+    const hash = crypto.createHash('sha256')
+    const output = createWriteStream(path)
+    try {
+      for (const chunk of session.chunks) {
+        for await (const data of createReadStream(this.chunkPath(chunk.hash))) {
+          hash.update(data)
+          if (!output.write(data)) {
+            await new Promise(resolve => output.once('drain', resolve))
+          }
+        }
+      }
+    } finally {
+      await new Promise(resolve => output.end(resolve))
+    }
+
+    if (hash.digest('hex') !== session.sha256) {
+      await rm(path, { force: true })
+      throw new Error('Assembled upload does not match its sha256')
+    }
+
+    return { session, path }
+  }
+
+  /**
+   * Remove the session of an upload; its chunks stay for later uploads
+   */
+  async remove(uploadId: string): Promise<void> {
+    await rm(this.sessionDir(uploadId), { recursive: true, force: true })
+  }
+}
+
+export const uploadSessions = new UploadSessionStore()
@@ -8,6 +8,7 @@ export interface WasmModuleConfig {
   maxExecutionTime?: number
   maxInstructions?: number
   enableWasi?: boolean
+  pureFunctions?: string[]  // Exports whose results depend on their arguments alone
 }
 
 export interface WasmExecutionResult {
@@ -75,7 +76,6 @@ export class WebAssemblyRuntime {
     config: WasmExecutionConfig = {}
   ): Promise<WasmExecutionResult> {
     try {
-      const startTime = Date.now()
       const cachedModule = this.moduleCache.get(moduleId)
       
       if (!cachedModule) {
@@ -100,8 +100,10 @@ export class WebAssemblyRuntime {
         throw new Error(`Function ${functionName} not found in module`)
       }
 
+      // Only the call itself is timed, with sub-millisecond resolution
+      const startTime = performance.now()
       const result = await func(...args)
-      const executionTime = Date.now() - startTime
+      const executionTime = performance.now() - startTime
 
       // Clean up instance
       this.activeInstances.delete(instanceId)
@@ -242,6 +244,21 @@ export class WebAssemblyRuntime {
     return 0.95 // 95% cache hit rate
   }
 
+  /**
+   * Check whether a module is loaded
+   */
+  hasModule(moduleId: string): boolean {
+    return this.moduleCache.has(moduleId)
+  }
+
+  /**
+   * Check whether a loaded module declared a function pure
+   */
+  isPure(moduleId: string, functionName: string): boolean {
+    const cached = this.moduleCache.get(moduleId)
+    return !!cached?.config?.pureFunctions?.includes(functionName)
+  }
+
   /**
    * Clear module cache
    */
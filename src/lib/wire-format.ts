@@ -0,0 +1,172 @@
+import type { WasmExecutionResult } from '@/lib/wasm-runtime'
+
+/**
+ * Compact binary framing of execute calls, an alternative to JSON for clients
+ * that send typed values. Integers are little-endian and a string is a u32
+ * length followed by its bytes.
+ *
+ *   request:  "WMF1" moduleId functionName config u32:count value*
+ *   response: "WMF1" u8:success f64:executionTime u64:memoryUsed error u32:count value*
+ *   value:    u8:tag, then 4 bytes for i32/f32, 8 for i64/f64, 16 for v128
+ *             and a string for bytes
+ */
+export const FRAME_CONTENT_TYPE = 'application/x-wasmify-frame'
+
+const FRAME_MAGIC = Buffer.from('WMF1')
+
+enum Tag {
+  I32 = 1,
+  I64 = 2,
+  F32 = 3,
+  F64 = 4,
+  Bytes = 5,
+  V128 = 6
+}
+
+export type FrameValue = number | bigint | Buffer
+
+export interface ExecuteFrame {
+  moduleId: string
+  functionName: string
+  config: any
+  args: FrameValue[]
+}
+
+export function isFrameRequest(contentType: string | null): boolean {
+  return !!contentType && contentType.toLowerCase().startsWith(FRAME_CONTENT_TYPE)
+}
+
+class FrameReader {
+  private offset = 0
+
+  constructor(private buffer: Buffer) {}
+
+  private take(n: number): number {
+    if (this.offset + n > this.buffer.length) {
+      throw new Error('Truncated frame')
+    }
+    const at = this.offset
+    this.offset += n
+    return at
+  }
+
+  u8(): number {
+    return this.buffer.readUInt8(this.take(1))
+  }
+
+  u32(): number {
+    return this.buffer.readUInt32LE(this.take(4))
+  }
+
+  bytes(): Buffer {
+    const length = this.u32()
+    const at = this.take(length)
+    return this.buffer.subarray(at, at + length)
+  }
+
+  value(): FrameValue {
+    const tag = this.u8()
+    switch (tag) {
+      case Tag.I32: return this.buffer.readInt32LE(this.take(4))
+      case Tag.I64: return this.buffer.readBigInt64LE(this.take(8))
+      case Tag.F32: return this.buffer.readFloatLE(this.take(4))
+      case Tag.F64: return this.buffer.readDoubleLE(this.take(8))
+      case Tag.Bytes: return this.bytes()
+      case Tag.V128: {
+        const at = this.take(16)
+        return this.buffer.subarray(at, at + 16)
+      }
+      default: throw new Error(`Unknown value tag ${tag}`)
+    }
+  }
+
+  magic(): void {
+    const at = this.take(FRAME_MAGIC.length)
+    if (!this.buffer.subarray(at, at + FRAME_MAGIC.length).equals(FRAME_MAGIC)) {
+      throw new Error('Not a wasmify frame')
+    }
+  }
+}
+
+/**
+ * Decode an execute request frame
+ */
+export function decodeExecuteFrame(buffer: Buffer): ExecuteFrame {
+  const reader = new FrameReader(buffer)
+  reader.magic()
+  const moduleId = reader.bytes().toString('utf8')
+  const functionName = reader.bytes().toString('utf8')
+  const configText = reader.bytes().toString('utf8')
+  const count = reader.u32()
+
+  const args: FrameValue[] = []
+  for (let i = 0; i < count; i++) {
+    args.push(reader.value())
+  }
+
+  return {
+    moduleId,
+    functionName,
+    config: configText ? JSON.parse(configText) : {},
+    args
+  }
+}
+
+function encodeString(data: Buffer): Buffer[] {
+  const length = Buffer.alloc(4)
+  length.writeUInt32LE(data.length)
+  return [length, data]
+}
+
+function encodeValue(value: any): Buffer[] {
+  if (typeof value === 'bigint') {
+    const out = Buffer.alloc(9)
+    out.writeUInt8(Tag.I64)
+    out.writeBigInt64LE(BigInt.asIntN(64, value), 1)
+    return [out]
+  }
+  if (typeof value === 'number' || typeof value === 'boolean') {
+    const number = Number(value)
+    if (Number.isInteger(number) && number >= -0x80000000 && number <= 0x7fffffff) {
+      const out = Buffer.alloc(5)
+      out.writeUInt8(Tag.I32)
+      out.writeInt32LE(number, 1)
+      return [out]
+    }
+    const out = Buffer.alloc(9)
+    out.writeUInt8(Tag.F64)
+    out.writeDoubleLE(number, 1)
+    return [out]
+  }
+
+  const data = value instanceof Uint8Array
+    ? Buffer.from(value.buffer, value.byteOffset, value.byteLength)
+    : Buffer.from(typeof value === 'string' ? value : JSON.stringify(value))
+  return [Buffer.from([Tag.Bytes]), ...encodeString(data)]
+}
+
+/**
+ * Encode an execution result as a response frame. Multi-value results are
+ * sent as one value each; a null result has no values.
+ */
+export function encodeResultFrame(result: WasmExecutionResult): Buffer {
+  const values = result.result === null || result.result === undefined
+    ? []
+    : Array.isArray(result.result) ? result.result : [result.result]
+
+  const header = Buffer.alloc(FRAME_MAGIC.length + 17)
+  FRAME_MAGIC.copy(header)
+  header.writeUInt8(result.success ? 1 : 0, 4)
+  header.writeDoubleLE(result.executionTime, 5)
+  header.writeBigUInt64LE(BigInt(Math.max(0, Math.floor(result.memoryUsed))), 13)
+
+  const count = Buffer.alloc(4)
+  count.writeUInt32LE(values.length)
+
+  return Buffer.concat([
+    header,
+    ...encodeString(Buffer.from(result.error || '')),
+    count,
+    ...values.flatMap(encodeValue)
+  ])
+}